@@ -68,7 +68,7 @@ int bld_confirm_running_image(void)
 		.program_doubleword = stm32_flash_program_doubleword,
 	};
 
-	const struct bld_storage_flash_ctx meta_ctx = {
+	struct bld_storage_flash_ctx meta_ctx = {
 		.region_base = BLD_META_BASE,
 		.region_size = BLD_META_SIZE,
 		.page_size = 2048u,
@@ -81,6 +81,13 @@ int bld_confirm_running_image(void)
 		.hw = NULL,
 	};
 
+	/* started from bank 2, the banks are swapped and the metadata with them */
+	__HAL_RCC_SYSCFG_CLK_ENABLE();
+	if (READ_BIT(SYSCFG->MEMRMP, SYSCFG_MEMRMP_FB_MODE) != 0u &&
+	    bld_storage_flash_swap_banks(&meta_ctx) != 0) {
+		return -1;
+	}
+
 	if (bld_storage_flash_init(&meta_storage, &meta_ctx) != 0) {
 		return -1;
 	}
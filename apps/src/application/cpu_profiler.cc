@@ -0,0 +1,118 @@
+#include "cpu_profiler.h"
+
+#include <FreeRTOS.h>
+#include <pw_log/log.h>
+#include <task.h>
+
+#include <array>
+#include <atomic>
+
+#include "cpu_stats.h"
+#include "main.h"
+#include "tickless_idle.h"
+
+namespace play::profiling {
+namespace {
+
+// Only the last window is kept; both are touched from one thread.
+thread::CpuStatsSampler<kMaxProfiledTasks> sampler;
+std::array<TaskStatus_t, kMaxProfiledTasks> status;
+std::array<thread::TaskSample, kMaxProfiledTasks> samples;
+
+// Indexed by FreeRTOS task number (1-based, never reused). Written only by
+// the context switch, read by the sampler.
+std::array<std::atomic<uint32_t>, kMaxProfiledTasks + 1> switch_counts;
+
+thread::CycleCounter64 cycles;
+
+}  // namespace
+
+void SampleCpuStats() {
+  configRUN_TIME_COUNTER_TYPE total = 0;
+  const UBaseType_t n =
+      uxTaskGetSystemState(status.data(), status.size(), &total);
+  if (n == 0) {
+    PW_LOG_WARN("More than %u tasks; CPU stats not sampled",
+                static_cast<unsigned>(kMaxProfiledTasks));
+    return;
+  }
+
+  for (UBaseType_t i = 0; i < n; ++i) {
+    const TaskStatus_t& t = status[i];
+    const uint32_t id = t.xTaskNumber;
+    thread::TaskSample& s = samples[i];
+    s.id = id;
+    s.name = t.pcTaskName;
+    s.run_time = t.ulRunTimeCounter;
+    s.stack_free_min = t.usStackHighWaterMark;
+    s.switches = id < switch_counts.size()
+                     ? switch_counts[id].load(std::memory_order_relaxed)
+                     : 0;
+  }
+  sampler.Update(pw::span<const thread::TaskSample>(samples.data(), n), total);
+}
+
+void DumpCpuStats() {
+  const uint64_t window_us = sampler.window() / (SystemCoreClock / 1000000U);
+  PW_LOG_INFO("CPU stats over %u ms:",
+              static_cast<unsigned>(window_us / 1000U));
+  PW_LOG_INFO("  %-16s %6s %10s %9s %10s",
+              "task",
+              "cpu%",
+              "run(us)",
+              "switches",
+              "stack free");
+  for (const thread::TaskUsage& u : sampler.usage()) {
+    PW_LOG_INFO("  %-16s %3u.%u%% %10u %9u %10u",
+                u.name,
+                static_cast<unsigned>(u.cpu_permille / 10),
+                static_cast<unsigned>(u.cpu_permille % 10),
+                static_cast<unsigned>(u.run_time /
+                                      (SystemCoreClock / 1000000U)),
+                static_cast<unsigned>(u.switches),
+                static_cast<unsigned>(u.stack_free_min));
+  }
+
+  tickless_stats idle;
+  tickless_get_stats(&idle);
+  PW_LOG_INFO(
+      "Idle since boot: %u sleeps (%u STOP2, %u vetoed, %u clipped), %u ms",
+      static_cast<unsigned>(idle.sleeps),
+      static_cast<unsigned>(idle.stops),
+      static_cast<unsigned>(idle.vetoed),
+      static_cast<unsigned>(idle.clipped),
+      static_cast<unsigned>(idle.slept_ticks));
+  PW_LOG_INFO("  worst wake: %u us late, %u cycles to relock the PLL",
+              static_cast<unsigned>(uint64_t{idle.max_late_counts} * 1000000U /
+                                    idle.lptim_hz),
+              static_cast<unsigned>(idle.max_restore_cycles));
+}
+
+}  // namespace play::profiling
+
+// Called by vTaskStartScheduler() with configGENERATE_RUN_TIME_STATS.
+extern "C" void configureTimerForRunTimeStats(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// Called on every context switch (interrupts masked) and from tasks, so the
+// extension is done with interrupts off.
+extern "C" uint64_t getRunTimeCounterValue(void) {
+  const uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  const uint64_t now = play::profiling::cycles.Extend(DWT->CYCCNT);
+  __set_PRIMASK(primask);
+  return now;
+}
+
+// traceTASK_SWITCHED_IN hook, from the context switch.
+extern "C" void traceTaskSwitchedIn(uint32_t task_number) {
+  auto& counts = play::profiling::switch_counts;
+  if (task_number < counts.size()) {
+    counts[task_number].store(
+        counts[task_number].load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+// Per-thread CPU profiling on the DWT cycle counter.
+//
+// FreeRTOS run-time stats count CPU cycles (64-bit, so they do not wrap)
+// instead of 1 ms ticks, and a traceTASK_SWITCHED_IN hook counts
+// switch-ins per task. SampleCpuStats() snapshots every task and keeps the
+// usage of the window since the previous sample; DumpCpuStats() logs it.
+// Both must run on the same thread (the work queue in this app), and
+// sampling has to happen more often than the cycle counter wraps (~53 s at
+// 80 MHz) or the run-time clock loses a wrap. The cycle counter stops in
+// STOP2, so a window only covers time awake; DumpCpuStats() also logs the
+// tickless idle counters for the time spent asleep.
+namespace play::profiling {
+
+inline constexpr uint32_t kMaxProfiledTasks = 16;
+
+void SampleCpuStats();
+void DumpCpuStats();
+
+}  // namespace play::profiling
@@ -0,0 +1,162 @@
+#include "log_drain.h"
+
+#include <pw_bytes/span.h>
+#include <pw_log/levels.h>
+#include <pw_log_tokenized/config.h>
+#include <pw_log_tokenized/handler.h>
+#include <pw_log_tokenized/metadata.h>
+#include <pw_ring_buffer/prefixed_entry_ring_buffer.h>
+#include <pw_span/span.h>
+#include <pw_string/string_builder.h>
+#include <pw_sync/interrupt_spin_lock.h>
+#include <pw_sync/thread_notification.h>
+#include <pw_sys_io/sys_io.h>
+#include <pw_tokenizer/base64.h>
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <string_view>
+#include <utility>
+
+namespace play::log_drain {
+namespace {
+
+// Room for a few dozen records, so a burst at boot (before the scheduler
+// runs the drain) is kept.
+constexpr size_t kRingBytes = 2048;
+constexpr size_t kMaxRecordBytes = PW_LOG_TOKENIZED_ENCODING_BUFFER_SIZE_BYTES;
+
+std::array<std::byte, kRingBytes> ring_storage;
+pw::ring_buffer::PrefixedEntryRingBuffer ring;
+bool ring_ready = false;     // Guarded by lock.
+uint32_t dropped_count = 0;  // Guarded by lock.
+pw::sync::InterruptSpinLock lock;
+pw::sync::ThreadNotification pending;
+
+// Who writes lines. A critical flush may run in an interrupt or a thread
+// that preempted the drain thread halfway through a line, so it cannot wait
+// for the line to end: it takes the output over, and the drain thread
+// checks before every line and backs off while a critical flush runs.
+int critical_flushes = 0;     // Guarded by lock.
+bool drain_mid_line = false;  // Guarded by lock.
+
+// Moves the oldest record into `record`. Returns its size, or 0 once the
+// ring is empty; `dropped` receives the drops counted since the last call.
+// The drain thread gets nothing while a critical flush runs, and otherwise
+// owns the output until EndDrainLine().
+size_t PopRecord(pw::ByteSpan record, uint32_t& dropped, bool critical) {
+  std::lock_guard guard(lock);
+  dropped = 0;
+  if (!critical && critical_flushes != 0) {
+    return 0;
+  }
+  dropped = std::exchange(dropped_count, 0);
+  size_t size = 0;
+  if (ring_ready && ring.PeekFront(record, &size).ok()) {
+    ring.PopFront().IgnoreError();
+  } else {
+    size = 0;
+  }
+  if (!critical && (size != 0 || dropped != 0)) {
+    drain_mid_line = true;
+  }
+  return size;
+}
+
+void EndDrainLine() {
+  std::lock_guard guard(lock);
+  drain_mid_line = false;
+}
+
+// Writes records out until the ring is empty or, for the drain thread,
+// until a critical flush takes over.
+void WriteRecords(bool critical) {
+  std::array<std::byte, kMaxRecordBytes> record;
+  std::array<char, pw::tokenizer::Base64EncodedBufferSize(kMaxRecordBytes)>
+      line;
+
+  for (;;) {
+    uint32_t dropped = 0;
+    const size_t size = PopRecord(record, dropped, critical);
+    if (dropped != 0) {
+      pw::StringBuffer<48> note;
+      note << "[" << dropped << " log messages dropped]";
+      pw::sys_io::WriteLine(note.view()).IgnoreError();
+    }
+    if (size != 0) {
+      const size_t length = pw::tokenizer::PrefixedBase64Encode(
+          pw::span(record.data(), size), line);
+      pw::sys_io::WriteLine(std::string_view(line.data(), length))
+          .IgnoreError();
+    }
+    if (!critical) {
+      EndDrainLine();
+    }
+    if (size == 0) {
+      return;
+    }
+  }
+}
+
+class DrainThread : public pw::thread::ThreadCore {
+ private:
+  void Run() override {
+    for (;;) {
+      pending.acquire();
+      WriteRecords(/*critical=*/false);
+    }
+  }
+};
+
+DrainThread drain_thread;
+
+}  // namespace
+
+pw::thread::ThreadCore& Thread() { return drain_thread; }
+
+void Flush() {
+  bool cut_line;
+  {
+    std::lock_guard guard(lock);
+    ++critical_flushes;
+    cut_line = std::exchange(drain_mid_line, false);
+  }
+
+  // End the line the drain thread was cut off in, so the records below
+  // start on lines of their own; the rest of it arrives later as a line
+  // the detokenizer skips.
+  if (cut_line) {
+    pw::sys_io::WriteLine(std::string_view()).IgnoreError();
+  }
+  WriteRecords(/*critical=*/true);
+
+  std::lock_guard guard(lock);
+  --critical_flushes;
+}
+
+}  // namespace play::log_drain
+
+// Called by every PW_LOG_* in the application, on the caller's thread.
+extern "C" void pw_log_tokenized_HandleLog(uint32_t metadata,
+                                           const uint8_t encoded_message[],
+                                           size_t size_bytes) {
+  using namespace play::log_drain;
+  {
+    std::lock_guard guard(lock);
+    if (!ring_ready) {
+      ring.SetBuffer(ring_storage).IgnoreError();
+      ring_ready = true;
+    }
+    if (!ring.TryPushBack(pw::as_bytes(pw::span(encoded_message, size_bytes)))
+             .ok()) {
+      ++dropped_count;
+    }
+  }
+
+  if (pw::log_tokenized::Metadata(metadata).level() >= PW_LOG_LEVEL_CRITICAL) {
+    Flush();
+    return;
+  }
+  pending.release();
+}
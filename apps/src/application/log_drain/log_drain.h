@@ -0,0 +1,26 @@
+#pragma once
+
+#include <pw_thread/thread_core.h>
+
+#include <cstdint>
+
+// Backend for pw_log_tokenized's handler. Log calls only copy the tokenized
+// record into a RAM ring; a low-priority thread drains the ring to pw_sys_io
+// as prefixed Base64 lines ("$<base64>\n") that //tools:detokenize turns
+// back into text. When the ring is full the newest record is dropped and a
+// plain-text drop count is written ahead of the next record. Critical and
+// fatal logs flush synchronously, since nothing may run after them.
+//
+// Lines never interleave: a critical flush takes the output over even from
+// an interrupt, and the drain thread writes no new line until it is done.
+// A drain line the flush cut into is ended first and its tail is written
+// afterwards as a line of its own, so the critical records stay intact.
+namespace play::log_drain {
+
+// Runs the drain loop; start it at the lowest application priority.
+pw::thread::ThreadCore& Thread();
+
+// Writes out every buffered record from the calling thread.
+void Flush();
+
+}  // namespace play::log_drain
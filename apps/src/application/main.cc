@@ -3,7 +3,6 @@
 #include <FreeRTOS.h>
 #include <pw_assert/check.h>
 #include <pw_chrono/system_clock.h>
-#include <pw_chrono/system_timer.h>
 #include <pw_log/log.h>
 #include <pw_sys_io_stm32cube/init.h>
 #include <pw_system/work_queue.h>
@@ -11,9 +10,18 @@
 #include <pw_thread/sleep.h>
 #include <task.h>
 
+#include <array>
+
 #include "active_object.h"
+#include "button.h"
+#include "button_fsm.h"
+#include "cpu_profiler.h"
+#include "hsm_active_object.h"
+#include "timer_service.h"
 #include "gpio.h"
-#include "state_machine.h"
+#include "led_seq.h"
+#include "log_drain.h"
+#include "tickless_idle.h"
 
 #if defined(BLD_APP_SLOT_BUILD)
 #include "bld_confirm.h"
@@ -24,14 +32,22 @@ using namespace std::chrono_literals;
 
 static constexpr auto kMorseAPeriod = 100ms;
 static constexpr auto kMorseBPeriod = 200ms;
-static constexpr auto kLedBlinkPeriod = 100ms;
-static constexpr auto kButtonWatchdogPeriod = 50ms;
+static constexpr auto kTimerServiceTick = 10ms;
+// Well inside the ~53 s DWT cycle counter wrap.
+static constexpr auto kCpuStatsPeriod = 5s;
 static constexpr auto kMorseAData = 0xA8EEE2A0U;
 static constexpr auto kMorseBData = 0xE22A3800U;
+// A pattern plus its word gap stays inside the 100 ms Morse A period.
+static constexpr uint32_t kMorseSymbolMs = 2;
+static constexpr uint32_t kLedBlinkMs = 100;
+static constexpr uint32_t kButtonDebounceMs = 20;
+static constexpr uint32_t kButtonLongPressMs = 1000;
 
 enum class ThreadPriority : UBaseType_t {
-  kLEDPriority = tskIDLE_PRIORITY + 1,
-  kWorkQueue = tskIDLE_PRIORITY + 2,
+  kLogDrainPriority = tskIDLE_PRIORITY + 1,
+  kLEDPriority = tskIDLE_PRIORITY + 2,
+  kWorkQueue = tskIDLE_PRIORITY + 3,
+  kFsmPriority = tskIDLE_PRIORITY + 4,
   kNumPriorities,
 };
 
@@ -40,22 +56,70 @@ static_assert(static_cast<UBaseType_t>(ThreadPriority::kNumPriorities) <=
 
 constexpr size_t kLEDStackSizeWords = 512;
 constexpr size_t kWorkQueueThreadWords = 512;
+constexpr size_t kFsmStackSizeWords = 512;
+constexpr size_t kLogDrainStackSizeWords = 256;
+constexpr size_t kTimerWheelSlots = 32;
+
+// Run-length encodes a Morse bit pattern (MSB first, trailing zeros not
+// played) into LED sequencer steps, followed by the 7-symbol word gap.
+constexpr std::array<bsp_led_step_t, 35> MorseSteps(uint32_t bits) {
+  std::array<bsp_led_step_t, 35> steps{};
+  size_t n = 0;
+  while (bits != 0) {
+    const bool on = (bits & (1U << 31)) != 0;
+    uint32_t run = 0;
+    while (bits != 0 && ((bits & (1U << 31)) != 0) == on) {
+      ++run;
+      bits <<= 1;
+    }
+    steps[n++] = BSP_LED_STEP(on ? BSP_LED_LEVEL_MAX : 0, run * kMorseSymbolMs);
+  }
+  steps[n++] = BSP_LED_STEP(0, 7 * kMorseSymbolMs);
+  steps[n] = BSP_LED_END;
+  return steps;
+}
+
+constexpr auto kMorseASteps = MorseSteps(kMorseAData);
+constexpr auto kMorseBSteps = MorseSteps(kMorseBData);
+
+constexpr bsp_led_step_t kBlueBlinkSteps[] = {
+    BSP_LED_STEP(BSP_LED_LEVEL_MAX, kLedBlinkMs),
+    BSP_LED_STEP(0, kLedBlinkMs),
+    BSP_LED_REPEAT,
+};
+
+constexpr bsp_led_step_t kBlueSolidSteps[] = {
+    BSP_LED_STEP(BSP_LED_LEVEL_MAX, 0xFFF),
+    BSP_LED_REPEAT,
+};
 
 struct AoEventLED {
   enum class Type : uint8_t {
     kInit,
     kMorseA,
     kMorseB,
+    kMorseDone,
   } type;
 };
 
-pw::sync::Mutex fsm_mutex_;
-
 }  // namespace
 
-// Functions needed when configGENERATE_RUN_TIME_STATS is on.
-extern "C" void configureTimerForRunTimeStats(void) {}
-extern "C" unsigned long getRunTimeCounterValue(void) { return uwTick; }
+// A Morse tick only says "play the pattern now", so a second tick arriving
+// while one is still pending is absorbed rather than queued or dropped.
+// kInit is ordered ahead of any backlog.
+namespace play::thread {
+template <>
+struct EventTraits<AoEventLED> {
+  static constexpr uint8_t Priority(const AoEventLED& ev) {
+    return ev.type == AoEventLED::Type::kInit ? 1 : 0;
+  }
+  static constexpr bool Coalesces(const AoEventLED& pending,
+                                  const AoEventLED& incoming) {
+    return pending.type == incoming.type &&
+           incoming.type != AoEventLED::Type::kInit;
+  }
+};
+}  // namespace play::thread
 
 // System Clock Configuration: 80MHz
 extern "C" void SystemClock_Config(void) {
@@ -101,41 +165,57 @@ extern "C" void SystemClock_Config(void) {
 }
 
 namespace {
-class LEDActiveObject : public play::thread::ActiveObjectCore<AoEventLED, 8> {
+// One kernel timer for every active-object timeout. It is set for the next
+// deadline rather than every wheel tick, so idle stretches cost no wakeups.
+play::thread::TimerService<kTimerWheelSlots> timer_service{kTimerServiceTick};
+
+// Moves CPU stats sampling onto the work queue, which also serves dumps, so
+// the sampler needs no lock and the timer daemon never walks the task list.
+class CpuStatsTimeout : public play::thread::TimeoutBase {
+ private:
+  void Expired() override {
+    (void)pw::system::GetWorkQueue().PushWork(play::profiling::SampleCpuStats);
+  }
+};
+
+CpuStatsTimeout cpu_stats_timeout;
+
+// Morse ticks come from the timer service (timer daemon context). The
+// coalescing queue never blocks it (an interrupt spin lock around a few
+// compares) and bounds the backlog to one pending tick per pattern however
+// far the LED thread falls behind.
+class LEDActiveObject
+    : public play::thread::ActiveObjectCore<
+          AoEventLED,
+          8,
+          play::thread::PriorityCoalescingQueue> {
  public:
   LEDActiveObject()
-      : morse_a_timer_(
-            [this](pw::chrono::SystemClock::time_point expired_deadline) {
-              if (this->Post({AoEventLED::Type::kMorseA}) != true) {
-                PW_LOG_ERROR(
-                    "LEDActiveObject queue full, dropping Morse A event");
-              }
-              morse_a_timer_.InvokeAt(expired_deadline + morse_a_period_);
-            }),
-        morse_b_timer_(
-            [this](pw::chrono::SystemClock::time_point expired_deadline) {
-              if (this->Post({AoEventLED::Type::kMorseB}) != true) {
-                PW_LOG_ERROR(
-                    "LEDActiveObject queue full, dropping Morse B event");
-              }
-              morse_b_timer_.InvokeAt(expired_deadline + morse_b_period_);
-            }),
-        morse_a_period_(kMorseAPeriod),
-        morse_b_period_(kMorseBPeriod) {}
+      : morse_a_tick_(*this, {AoEventLED::Type::kMorseA}),
+        morse_b_tick_(*this, {AoEventLED::Type::kMorseB}) {}
 
  protected:
   void HandleEvent(const AoEventLED& ev) override {
     switch (ev.type) {
       case AoEventLED::Type::kInit:
         bsp_led_green_off();
-        morse_a_timer_.InvokeAfter(morse_a_period_);
-        morse_b_timer_.InvokeAfter(morse_b_period_);
+        timer_service.Arm(morse_a_tick_, kMorseAPeriod, kMorseAPeriod);
+        timer_service.Arm(morse_b_tick_, kMorseBPeriod, kMorseBPeriod);
         break;
       case AoEventLED::Type::kMorseA:
-        bsp_send_morse_code(kMorseAData);
+        Play(kMorseASteps.data(), morse_a_pending_);
         break;
       case AoEventLED::Type::kMorseB:
-        bsp_send_morse_code(kMorseBData);
+        Play(kMorseBSteps.data(), morse_b_pending_);
+        break;
+      case AoEventLED::Type::kMorseDone:
+        if (morse_a_pending_) {
+          morse_a_pending_ = false;
+          Play(kMorseASteps.data(), morse_a_pending_);
+        } else if (morse_b_pending_) {
+          morse_b_pending_ = false;
+          Play(kMorseBSteps.data(), morse_b_pending_);
+        }
         break;
       default:
         PW_LOG_ERROR("LEDActiveObject received unknown event");
@@ -145,69 +225,101 @@ class LEDActiveObject : public play::thread::ActiveObjectCore<AoEventLED, 8> {
   }
 
  private:
-  pw::chrono::SystemTimer morse_a_timer_;
-  pw::chrono::SystemTimer morse_b_timer_;
-  pw::chrono::SystemClock::duration morse_a_period_;
-  pw::chrono::SystemClock::duration morse_b_period_;
+  // Both patterns share the green LED's sequencer channel. A tick that finds
+  // it busy marks its pattern pending (at most once) and kMorseDone starts
+  // it, so HandleEvent() never waits on the LED.
+  void Play(const bsp_led_step_t* steps, bool& pending) {
+    if (bsp_led_seq_busy(BSP_LED_GREEN)) {
+      pending = true;
+      return;
+    }
+    bsp_led_seq_start(BSP_LED_GREEN, steps, OnPatternDone, this);
+  }
+
+  static void OnPatternDone(void* arg) {
+    // Called from the sequencer interrupt; a full queue is counted in
+    // Stats().
+    (void)static_cast<LEDActiveObject*>(arg)->PostFromIsr(
+        {AoEventLED::Type::kMorseDone});
+  }
+
+  play::thread::TimeEvent<LEDActiveObject, AoEventLED> morse_a_tick_;
+  play::thread::TimeEvent<LEDActiveObject, AoEventLED> morse_b_tick_;
+  bool morse_a_pending_ = false;
+  bool morse_b_pending_ = false;
 };
 
-class ButtonObject {
- public:
-  using ReleaseHandler = pw::Function<void()>;
-
-  explicit ButtonObject(ReleaseHandler on_release)
-      : on_release_(std::move(on_release)),
-        button_watchdog_timer_(
-            [this](pw::chrono::SystemClock::time_point expired_deadline) {
-              if (!watchdog_enabled_) {
-                return;
-              }
-              bool pressed = bsp_button_status();
-              if (pressed && !last_state_) {
-                last_state_ = true;
-                blink_timer_.InvokeAfter(blink_period_);
-              } else if (!pressed && last_state_) {
-                last_state_ = false;
-                if (on_release_)
-                  on_release_();
-              }
-              if (watchdog_enabled_) {
-                button_watchdog_timer_.InvokeAt(expired_deadline +
-                                                button_watchdog_period_);
-              }
-            }),
-        blink_timer_([this](pw::chrono::SystemClock::time_point) {
-          bsp_led_blue_toggle();
-          blink_timer_.InvokeAfter(blink_period_);
-        }),
-        button_watchdog_period_(kButtonWatchdogPeriod),
-        blink_period_(kLedBlinkPeriod),
-        last_state_(false) {}
-
-  void StartWatchdog() {
-    watchdog_enabled_ = true;
-    button_watchdog_timer_.InvokeAfter(button_watchdog_period_);
+// Blue blinks while the button is down and goes solid once it is held.
+void OnButtonPressedChanged(bool pressed) {
+  if (pressed) {
+    bsp_led_seq_start(BSP_LED_BLUE, kBlueBlinkSteps, nullptr, nullptr);
+  } else {
+    bsp_led_seq_stop(BSP_LED_BLUE);
   }
+}
 
-  void StopWatchdog() {
-    watchdog_enabled_ = false;
-    button_watchdog_timer_.Cancel();
-    blink_timer_.Cancel();
-    bsp_led_blue_off();
+// A long press also dumps the last CPU stats window.
+void OnButtonLongPress() {
+  bsp_led_seq_start(BSP_LED_BLUE, kBlueSolidSteps, nullptr, nullptr);
+  (void)pw::system::GetWorkQueue().PushWork(play::profiling::DumpCpuStats);
+}
+
+// Owns the button state machine: it is started and driven only on this
+// thread, so no lock is needed. Button events are posted from both the
+// EXTI and the debounce timer interrupts, hence the MPSC queue.
+using FsmActiveObject =
+    play::thread::HsmActiveObject<play::thread::ButtonFsm,
+                                  8,
+                                  play::thread::MpscQueue,
+                                  4,
+                                  play::thread::ButtonPress,
+                                  play::thread::ButtonRelease,
+                                  play::thread::ButtonLongPress>;
+
+static FsmActiveObject fsm_ao{play::thread::ButtonFsmContext{
+    false, OnButtonPressedChanged, OnButtonLongPress}};
+
+// Debounced edges from the BSP, in interrupt context. A full queue drops
+// the event; logging is not allowed here.
+void OnButtonEvent(bsp_button_event ev, uint32_t, void*) {
+  switch (ev) {
+    case BSP_BUTTON_PRESS:
+      (void)fsm_ao.PostFromIsr(play::thread::ButtonPress{});
+      break;
+    case BSP_BUTTON_RELEASE:
+      (void)fsm_ao.PostFromIsr(play::thread::ButtonRelease{});
+      break;
+    case BSP_BUTTON_LONG_PRESS:
+      (void)fsm_ao.PostFromIsr(play::thread::ButtonLongPress{});
+      break;
   }
+}
 
- private:
-  ReleaseHandler on_release_;
-  pw::chrono::SystemTimer button_watchdog_timer_;
-  pw::chrono::SystemTimer blink_timer_;
-  pw::chrono::SystemClock::duration button_watchdog_period_;
-  pw::chrono::SystemClock::duration blink_period_;
-  bool last_state_;
-  bool watchdog_enabled_ = false;
-};
+// STOP2 halts every clock except LPTIM1's; these keep the idle task in
+// plain sleep while something is being timed from the main clock. The
+// active-object queues need no veto: a post readies its thread, and the
+// idle task only sleeps when no thread is ready.
+bool ButtonBusy(void*) { return bsp_button_busy(); }
+
+// The log drain returns once its last byte is in the transmit register;
+// that byte still has to leave the wire.
+bool ConsoleBusy(void*) { return (USART1->ISR & USART_ISR_TC) == 0; }
 
-play::thread::StateMachineContext* fsm = nullptr;
-ButtonObject* button = nullptr;
+// The LED sequencer instead lets the idle task stop until its next step
+// is due, then moves TIM7 on by the time spent in STOP2. A dimmed LED
+// needs the software PWM and keeps the sleep out of STOP2.
+uint32_t LedSequencerStopLimit(void*) { return bsp_led_seq_stop_limit_us(); }
+
+void LedSequencerResume(void*, uint32_t us) { bsp_led_seq_resume(us); }
+
+static void StartFsmThread() {
+  pw::thread::DetachedThread(
+      pw::thread::freertos::Options()
+          .set_name("FsmThread")
+          .set_priority(static_cast<UBaseType_t>(ThreadPriority::kFsmPriority))
+          .set_stack_size(kFsmStackSizeWords),
+      fsm_ao);
+}
 
 static LEDActiveObject led_ao;
 static void StartLEDThread() {
@@ -219,6 +331,18 @@ static void StartLEDThread() {
       led_ao);
 }
 
+// Logging only buffers tokenized records; this thread writes them to the
+// UART when nothing else wants the CPU.
+static void StartLogDrainThread() {
+  pw::thread::DetachedThread(
+      pw::thread::freertos::Options()
+          .set_name("LogDrainThread")
+          .set_priority(
+              static_cast<UBaseType_t>(ThreadPriority::kLogDrainPriority))
+          .set_stack_size(kLogDrainStackSizeWords),
+      play::log_drain::Thread());
+}
+
 auto wq = pw::system::GetWorkQueue;
 static void StartWorkQueueThread() {
   pw::thread::DetachedThread(
@@ -229,14 +353,6 @@ static void StartWorkQueueThread() {
       wq());
 }
 
-static void ButtonPressed() {
-  fsm_mutex_.lock();
-  if (fsm != nullptr) {
-    fsm->HandleButtonPress();
-  }
-  fsm_mutex_.unlock();
-}
-
 }  // namespace
 
 extern "C" int main(void) {
@@ -253,29 +369,27 @@ extern "C" int main(void) {
   PW_LOG_DEBUG("after bld_confirm");
 #endif
 
+  StartLogDrainThread();
   StartWorkQueueThread();
   pw::system::GetWorkQueue().CheckPushWork(StartLEDThread);
+  pw::system::GetWorkQueue().CheckPushWork([] {
+    timer_service.Arm(cpu_stats_timeout, kCpuStatsPeriod, kCpuStatsPeriod);
+  });
 
-  static play::thread::StateMachineContext fsm_instance{
-      [](const play::thread::State* prev_state,
-         const play::thread::State* state) {
-        if (prev_state == &play::thread::StateButtonPressed::instance()) {
-          button->StopWatchdog();
-        }
-        if (state == &play::thread::StateButtonPressed::instance()) {
-          button->StartWatchdog();
-        }
-      }};
-  fsm = &fsm_instance;
+  static constexpr bsp_button_config kButtonConfig = {kButtonDebounceMs,
+                                                      kButtonLongPressMs};
+  PW_CHECK_INT_EQ(bsp_button_debounce_start(&kButtonConfig, OnButtonEvent,
+                                            nullptr),
+                  0);
 
-  static ButtonObject button_instance{[]() {
-    fsm_mutex_.lock();
-    fsm->HandleButtonRelease();
-    fsm_mutex_.unlock();
-  }};
-  button = &button_instance;
+  StartFsmThread();
 
-  fsm->Start();
+  PW_CHECK_INT_EQ(tickless_add_stop_veto(ButtonBusy, nullptr), 0);
+  PW_CHECK_INT_EQ(tickless_add_stop_veto(ConsoleBusy, nullptr), 0);
+  PW_CHECK_INT_EQ(
+      tickless_add_stop_clock(
+          LedSequencerStopLimit, LedSequencerResume, nullptr),
+      0);
 
   vTaskStartScheduler();
 
@@ -285,7 +399,7 @@ extern "C" int main(void) {
 
 extern "C" void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
   if (GPIO_Pin == BUTTON_EXTI13_Pin) {
-    pw::system::GetWorkQueue().CheckPushWork(ButtonPressed);
+    bsp_button_edge_isr();
   }
 }
 extern "C" PW_NO_RETURN void Error_Handler(void) { PW_CRASH("Error"); }
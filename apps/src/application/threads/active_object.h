@@ -3,34 +3,84 @@
 #include <pw_assert/check.h>
 #include <pw_thread/thread_core.h>
 #include <pw_chrono/system_timer.h>
-#include <pw_sync/mutex.h>
+#include <pw_span/span.h>
 #include <pw_sync/thread_notification.h>
-#include <pw_containers/inline_queue.h>
 
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "event_queue.h"
 
 namespace play::thread {
 
 // Empty event type for ActiveObjectCore specialization
 struct EmptyEvent {};
 
-template <typename EventType, size_t kQueueLen>
+// Queue health of one active object. high_water is the deepest backlog the
+// owner thread has found when draining; dropped counts Post() calls that
+// found the queue full; coalesced counts posts absorbed by a pending
+// equivalent event (PriorityCoalescingQueue only).
+struct ActiveObjectStats {
+  size_t high_water;
+  uint32_t dropped;
+  uint32_t coalesced;
+};
+
+namespace internal {
+
+template <typename Queue, typename = void>
+struct HasCoalescedCount : std::false_type {};
+
+template <typename Queue>
+struct HasCoalescedCount<
+    Queue,
+    std::void_t<decltype(std::declval<const Queue&>().coalesced())>>
+    : std::true_type {};
+
+}  // namespace internal
+
+// QueuePolicy selects the event queue (see event_queue.h). MutexQueue
+// accepts any thread-context producer; SpscQueue and MpscQueue are
+// lock-free and may be posted to from timer callbacks and ISRs;
+// PriorityCoalescingQueue reorders and merges events per EventTraits.
+template <typename EventType,
+          size_t kQueueLen,
+          template <typename, size_t> class QueuePolicy = MutexQueue>
 class ActiveObjectCore : public pw::thread::ThreadCore {
  public:
-  ActiveObjectCore() : queue_(), queue_mutex_(), notification_() {}
+  using Queue = QueuePolicy<EventType, kQueueLen>;
+
+  ActiveObjectCore() : queue_(), notification_() {}
 
   bool Post(const EventType& e) {
-    queue_mutex_.lock();
-    
-    if (!queue_.full()) {
-      queue_.push(e);
-      queue_mutex_.unlock();
-      notification_.release();
-      return true;
-    } else {
-      queue_mutex_.unlock();
+    if (!queue_.Push(e)) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
       return false;
     }
+    notification_.release();
+    return true;
+  }
+
+  // Post() for interrupt handlers. The push is lock-free and
+  // ThreadNotification::release() is interrupt-safe, so the owning thread
+  // is woken directly from the ISR without a work-queue hop.
+  bool PostFromIsr(const EventType& e) {
+    static_assert(Queue::kIsrSafe,
+                  "PostFromIsr requires a lock-free QueuePolicy");
+    return Post(e);
+  }
+
+  ActiveObjectStats Stats() const {
+    ActiveObjectStats stats{};
+    stats.high_water = high_water_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    if constexpr (internal::HasCoalescedCount<Queue>::value) {
+      stats.coalesced = queue_.coalesced();
+    }
+    return stats;
   }
 
   void Run() override {
@@ -39,21 +89,7 @@ class ActiveObjectCore : public pw::thread::ThreadCore {
 
     for (;;) {
       notification_.acquire();
-
-      EventType ev;
-      while (true) {
-        {
-          queue_mutex_.lock();
-          if (queue_.empty()){
-            queue_mutex_.unlock();
-            break;
-          }
-          ev = queue_.front();
-          queue_.pop(); 
-          queue_mutex_.unlock();
-        }
-        HandleEvent(ev);
-      }
+      DispatchPending();
     }
   }
 
@@ -61,10 +97,41 @@ class ActiveObjectCore : public pw::thread::ThreadCore {
   // To be implemented by derived classes
   virtual void HandleEvent(const EventType& ev) = 0;
 
+  // Receives each drained burst in FIFO order. Override to handle bursts
+  // more cheaply than one virtual call per event (e.g. keep only the last
+  // of several equivalent events).
+  virtual void HandleEvents(pw::span<const EventType> events) {
+    for (const EventType& ev : events) {
+      HandleEvent(ev);
+    }
+  }
+
+  // Drains the queue in batches: each batch is taken in one queue
+  // operation (a single lock for MutexQueue) and dispatched with the queue
+  // released. Returns the number of events dispatched.
+  //
+  // A batch may hold the whole queue, so the first batch after a wakeup is
+  // the backlog depth at that moment; the queue only shrinks here, so the
+  // largest batch seen is the queue's high-water mark.
+  size_t DispatchPending() {
+    std::array<EventType, kQueueLen> batch;
+    size_t total = 0;
+    size_t n;
+    while ((n = queue_.PopBatch(batch.data(), batch.size())) > 0) {
+      if (n > high_water_.load(std::memory_order_relaxed)) {
+        high_water_.store(n, std::memory_order_relaxed);
+      }
+      HandleEvents(pw::span<const EventType>(batch.data(), n));
+      total += n;
+    }
+    return total;
+  }
+
  private:
-  pw::InlineQueue<EventType, kQueueLen> queue_;
-  pw::sync::Mutex queue_mutex_;
+  Queue queue_;
   pw::sync::ThreadNotification notification_;
+  std::atomic<size_t> high_water_{0};
+  std::atomic<uint32_t> dropped_{0};
 };
 
 }  // namespace play::thread
\ No newline at end of file
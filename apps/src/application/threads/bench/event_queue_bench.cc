@@ -0,0 +1,155 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "event_queue.h"
+
+// Host benchmarks comparing the ActiveObjectCore queue policies.
+//
+// BM_*Uncontended measures a Push/Pop pair on one thread, i.e. the fixed
+// cost a timer callback pays per posted event. BM_*Contended runs
+// range(0) producer threads against one consumer and reports events per
+// second through the queue, which is where the mutex policy serialises.
+// BM_Drain* compare draining a full queue per event and in one batch.
+
+namespace play::thread {
+namespace {
+
+struct BenchEvent {
+  enum class Type : uint8_t { kInit, kTick } type;
+  uint32_t value;
+};
+
+constexpr size_t kQueueLen = 8;
+constexpr uint32_t kEventsPerProducer = 50000;
+
+template <typename Queue>
+void BM_Uncontended(benchmark::State& state) {
+  Queue queue;
+  BenchEvent ev{BenchEvent::Type::kTick, 0};
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(queue.Push(ev));
+    benchmark::DoNotOptimize(queue.Pop(ev));
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+template <typename Queue>
+void BM_Contended(benchmark::State& state) {
+  const size_t producers = static_cast<size_t>(state.range(0));
+
+  for (auto _ : state) {
+    Queue queue;
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+
+    for (size_t p = 0; p < producers; ++p) {
+      threads.emplace_back([&queue, &start]() {
+        while (!start.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+        const BenchEvent ev{BenchEvent::Type::kTick, 0};
+        for (uint32_t i = 0; i < kEventsPerProducer; ++i) {
+          while (!queue.Push(ev)) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+
+    const size_t total = producers * kEventsPerProducer;
+    size_t received = 0;
+    BenchEvent ev{};
+    start.store(true, std::memory_order_release);
+    while (received < total) {
+      if (queue.Pop(ev)) {
+        ++received;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          state.range(0) * kEventsPerProducer);
+}
+
+// A full queue drained one Pop() at a time versus one PopBatch(), i.e.
+// ActiveObjectCore::Run() before and after batched draining.
+template <typename Queue>
+void BM_DrainPerEvent(benchmark::State& state) {
+  Queue queue;
+  BenchEvent ev{BenchEvent::Type::kTick, 0};
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < kQueueLen; ++i) {
+      queue.Push(ev);
+    }
+    while (queue.Pop(ev)) {
+      benchmark::DoNotOptimize(ev);
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kQueueLen);
+}
+
+template <typename Queue>
+void BM_DrainBatch(benchmark::State& state) {
+  Queue queue;
+  std::array<BenchEvent, kQueueLen> batch{};
+  const BenchEvent ev{BenchEvent::Type::kTick, 0};
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < kQueueLen; ++i) {
+      queue.Push(ev);
+    }
+    benchmark::DoNotOptimize(queue.PopBatch(batch.data(), batch.size()));
+    benchmark::DoNotOptimize(batch);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kQueueLen);
+}
+
+BENCHMARK_TEMPLATE(BM_Uncontended, MutexQueue<BenchEvent, kQueueLen>);
+BENCHMARK_TEMPLATE(BM_Uncontended, SpscQueue<BenchEvent, kQueueLen>);
+BENCHMARK_TEMPLATE(BM_Uncontended, MpscQueue<BenchEvent, kQueueLen>);
+BENCHMARK_TEMPLATE(BM_Uncontended,
+                   PriorityCoalescingQueue<BenchEvent, kQueueLen>);
+
+BENCHMARK_TEMPLATE(BM_DrainPerEvent, MutexQueue<BenchEvent, kQueueLen>);
+BENCHMARK_TEMPLATE(BM_DrainBatch, MutexQueue<BenchEvent, kQueueLen>);
+BENCHMARK_TEMPLATE(BM_DrainPerEvent, SpscQueue<BenchEvent, kQueueLen>);
+BENCHMARK_TEMPLATE(BM_DrainBatch, SpscQueue<BenchEvent, kQueueLen>);
+BENCHMARK_TEMPLATE(BM_DrainPerEvent, MpscQueue<BenchEvent, kQueueLen>);
+BENCHMARK_TEMPLATE(BM_DrainBatch, MpscQueue<BenchEvent, kQueueLen>);
+BENCHMARK_TEMPLATE(BM_DrainPerEvent,
+                   PriorityCoalescingQueue<BenchEvent, kQueueLen>);
+BENCHMARK_TEMPLATE(BM_DrainBatch,
+                   PriorityCoalescingQueue<BenchEvent, kQueueLen>);
+
+BENCHMARK_TEMPLATE(BM_Contended, MutexQueue<BenchEvent, kQueueLen>)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Contended, SpscQueue<BenchEvent, kQueueLen>)
+    ->Arg(1)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Contended, MpscQueue<BenchEvent, kQueueLen>)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace play::thread
+
+BENCHMARK_MAIN();
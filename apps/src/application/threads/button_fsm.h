@@ -0,0 +1,85 @@
+#pragma once
+
+#include <pw_log/log.h>
+
+#include "hsm.h"
+
+namespace play::thread {
+
+// Button state machine on the compile-time hsm engine. Idle / Pressed
+// behave like StateMachineContext with StateIdle / StateButtonPressed;
+// Pressed is composite so a long press can be told apart:
+//
+//   Idle
+//   Pressed (Initial = Short)
+//     Short --ButtonLongPress--> Held
+
+struct ButtonPress {};
+struct ButtonRelease {};
+struct ButtonLongPress {};
+
+struct ButtonFsmContext {
+  bool button_pressed = false;
+  // Called with true on entry to Pressed and false on exit from it, e.g.
+  // to blink an LED only while the button is down.
+  void (*on_pressed_changed)(bool pressed) = nullptr;
+  // Called on entry to Held, once per long press.
+  void (*on_long_press)() = nullptr;
+};
+
+namespace button_fsm {
+
+struct Idle {
+  static void Entry(ButtonFsmContext& ctx) {
+    ctx.button_pressed = false;
+    PW_LOG_INFO("Entering StateIdle");
+  }
+  static void Exit(ButtonFsmContext&) { PW_LOG_INFO("Exiting StateIdle"); }
+};
+
+struct Short;
+
+struct Pressed {
+  using Initial = Short;
+  static void Entry(ButtonFsmContext& ctx) {
+    ctx.button_pressed = true;
+    PW_LOG_INFO("Entering StateButtonPressed");
+    if (ctx.on_pressed_changed != nullptr) {
+      ctx.on_pressed_changed(true);
+    }
+  }
+  static void Exit(ButtonFsmContext& ctx) {
+    PW_LOG_INFO("Exiting StateButtonPressed");
+    if (ctx.on_pressed_changed != nullptr) {
+      ctx.on_pressed_changed(false);
+    }
+  }
+};
+
+struct Short {
+  using Parent = Pressed;
+};
+
+struct Held {
+  using Parent = Pressed;
+  static void Entry(ButtonFsmContext& ctx) {
+    PW_LOG_INFO("Entering StateButtonHeld");
+    if (ctx.on_long_press != nullptr) {
+      ctx.on_long_press();
+    }
+  }
+};
+
+using StateList = hsm::States<Idle, Pressed, Short, Held>;
+using TransitionTable =
+    hsm::Transitions<hsm::Transition<Idle, ButtonPress, Pressed>,
+                     hsm::Transition<Short, ButtonLongPress, Held>,
+                     hsm::Transition<Pressed, ButtonRelease, Idle>>;
+
+}  // namespace button_fsm
+
+using ButtonFsm = hsm::StateMachine<ButtonFsmContext,
+                                    button_fsm::StateList,
+                                    button_fsm::TransitionTable>;
+
+}  // namespace play::thread
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <pw_span/span.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace play::thread {
+
+// Extends a free-running 32-bit counter (the DWT cycle counter wraps every
+// ~53 s at 80 MHz) to 64 bits. Extend() must see every wrap, so it has to
+// be called at least once per counter period; the caller serialises calls.
+class CycleCounter64 {
+ public:
+  uint64_t Extend(uint32_t now) {
+    if (now < last_) {
+      high_ += uint64_t{1} << 32;
+    }
+    last_ = now;
+    return high_ | now;
+  }
+
+ private:
+  uint64_t high_ = 0;
+  uint32_t last_ = 0;
+};
+
+// One task as seen in a run-time stats snapshot. Counters are cumulative
+// since the task was created.
+struct TaskSample {
+  uint32_t id = 0;  // Unique for the task's lifetime (FreeRTOS task number).
+  const char* name = "";
+  uint64_t run_time = 0;  // Run-time counter units (CPU cycles).
+  uint32_t stack_free_min = 0;  // Stack high-water mark, in words.
+  uint32_t switches = 0;  // Times the task was switched in.
+};
+
+// One task's share of a sampling window.
+struct TaskUsage {
+  uint32_t id = 0;
+  const char* name = "";
+  uint64_t run_time = 0;  // Spent in the window.
+  uint32_t cpu_permille = 0;
+  uint32_t stack_free_min = 0;
+  uint32_t switches = 0;  // Switch-ins in the window.
+};
+
+// Turns successive cumulative snapshots into per-window usage. Tasks are
+// matched by id, so a task created mid-window is charged from zero and a
+// deleted task simply drops out.
+template <size_t kMaxTasks>
+class CpuStatsSampler {
+ public:
+  // `now` is the run-time counter when `tasks` was taken. Returns the usage
+  // since the previous Update() (since boot for the first one); the span
+  // stays valid until the next call. Tasks beyond kMaxTasks are ignored.
+  pw::span<const TaskUsage> Update(pw::span<const TaskSample> tasks,
+                                   uint64_t now) {
+    const size_t count = tasks.size() < kMaxTasks ? tasks.size() : kMaxTasks;
+    window_ = now - previous_now_;
+    for (size_t i = 0; i < count; ++i) {
+      const TaskSample& cur = tasks[i];
+      const TaskSample* prev = Previous(cur.id);
+      TaskUsage& u = usage_[i];
+      u.id = cur.id;
+      u.name = cur.name;
+      u.run_time = cur.run_time - (prev != nullptr ? prev->run_time : 0);
+      u.switches = cur.switches - (prev != nullptr ? prev->switches : 0);
+      u.stack_free_min = cur.stack_free_min;
+      u.cpu_permille =
+          window_ == 0 ? 0
+                       : static_cast<uint32_t>((u.run_time * 1000) / window_);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      previous_[i] = tasks[i];
+    }
+    previous_count_ = count;
+    previous_now_ = now;
+    usage_count_ = count;
+    return usage();
+  }
+
+  // The result of the last Update().
+  pw::span<const TaskUsage> usage() const {
+    return pw::span<const TaskUsage>(usage_.data(), usage_count_);
+  }
+
+  // Length of the last window in run-time counter units.
+  uint64_t window() const { return window_; }
+
+ private:
+  const TaskSample* Previous(uint32_t id) const {
+    for (size_t i = 0; i < previous_count_; ++i) {
+      if (previous_[i].id == id) {
+        return &previous_[i];
+      }
+    }
+    return nullptr;
+  }
+
+  std::array<TaskSample, kMaxTasks> previous_{};
+  size_t previous_count_ = 0;
+  uint64_t previous_now_ = 0;
+  std::array<TaskUsage, kMaxTasks> usage_{};
+  size_t usage_count_ = 0;
+  uint64_t window_ = 0;
+};
+
+}  // namespace play::thread
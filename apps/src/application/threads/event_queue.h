@@ -0,0 +1,292 @@
+#pragma once
+
+#include <pw_containers/inline_queue.h>
+#include <pw_sync/interrupt_spin_lock.h>
+#include <pw_sync/mutex.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace play::thread {
+
+// Queue policies for ActiveObjectCore. Each policy stores up to kQueueLen
+// events and provides:
+//
+//   bool Push(const EventType& e);  // false when full
+//   bool Pop(EventType& out);       // false when empty
+//   size_t PopBatch(EventType* out, size_t max);  // up to max, in order
+//   static constexpr bool kIsrSafe; // Push() may run in interrupt context
+//
+// Pop() is only ever called from the owning active object's thread. All
+// policies but PriorityCoalescingQueue deliver in FIFO order.
+
+// Customisation point for PriorityCoalescingQueue. Specialise for an event
+// type to give events a priority (higher is dispatched first, FIFO within a
+// priority) and to mark idempotent events: when Coalesces(pending, incoming)
+// holds for an event already queued, the incoming one is absorbed instead
+// of taking a slot.
+template <typename EventType>
+struct EventTraits {
+  static constexpr uint8_t Priority(const EventType&) { return 0; }
+  static constexpr bool Coalesces(const EventType&, const EventType&) {
+    return false;
+  }
+};
+
+// Mutex-protected queue. Any number of thread-context producers; must not
+// be used from interrupts.
+template <typename EventType, size_t kQueueLen>
+class MutexQueue {
+ public:
+  static constexpr bool kIsrSafe = false;
+
+  bool Push(const EventType& e) {
+    mutex_.lock();
+    if (queue_.full()) {
+      mutex_.unlock();
+      return false;
+    }
+    queue_.push(e);
+    mutex_.unlock();
+    return true;
+  }
+
+  bool Pop(EventType& out) {
+    mutex_.lock();
+    if (queue_.empty()) {
+      mutex_.unlock();
+      return false;
+    }
+    out = queue_.front();
+    queue_.pop();
+    mutex_.unlock();
+    return true;
+  }
+
+  // One lock acquisition for the whole burst.
+  size_t PopBatch(EventType* out, size_t max) {
+    size_t n = 0;
+    mutex_.lock();
+    while (n < max && !queue_.empty()) {
+      out[n++] = queue_.front();
+      queue_.pop();
+    }
+    mutex_.unlock();
+    return n;
+  }
+
+ private:
+  pw::InlineQueue<EventType, kQueueLen> queue_;
+  pw::sync::Mutex mutex_;
+};
+
+// Lock-free single-producer/single-consumer ring. Exactly one context may
+// Push() (e.g. the timer daemon or one ISR) while the owner thread Pop()s.
+// Neither side ever blocks, so a low-priority producer cannot invert the
+// consumer's priority.
+template <typename EventType, size_t kQueueLen>
+class SpscQueue {
+ public:
+  static_assert(kQueueLen > 0 && (kQueueLen & (kQueueLen - 1)) == 0,
+                "SpscQueue length must be a power of two");
+
+  static constexpr bool kIsrSafe = true;
+
+  bool Push(const EventType& e) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == kQueueLen) {
+      return false;
+    }
+    slots_[tail & kMask] = e;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Pop(EventType& out) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (tail_.load(std::memory_order_acquire) == head) {
+      return false;
+    }
+    out = slots_[head & kMask];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // One acquire of the producer index and one release of the slots.
+  size_t PopBatch(EventType* out, size_t max) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    size_t n = tail_.load(std::memory_order_acquire) - head;
+    if (n > max) {
+      n = max;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = slots_[(head + i) & kMask];
+    }
+    head_.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+ private:
+  static constexpr size_t kMask = kQueueLen - 1;
+
+  std::array<EventType, kQueueLen> slots_{};
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+};
+
+// Lock-free bounded multi-producer/single-consumer queue (per-slot sequence
+// numbers). Producers claim a slot with a CAS and publish it by bumping the
+// slot sequence, so threads, timer callbacks and ISRs may all Push()
+// concurrently. A producer preempted between claim and publish only delays
+// delivery of later events until it completes; it never blocks anyone.
+template <typename EventType, size_t kQueueLen>
+class MpscQueue {
+ public:
+  static_assert(kQueueLen > 0 && (kQueueLen & (kQueueLen - 1)) == 0,
+                "MpscQueue length must be a power of two");
+
+  static constexpr bool kIsrSafe = true;
+
+  MpscQueue() {
+    for (size_t i = 0; i < kQueueLen; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool Push(const EventType& e) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+      cell = &cells_[pos & kMask];
+      const size_t seq = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos,
+                                               pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = e;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Pop(EventType& out) {
+    Cell& cell = cells_[dequeue_pos_ & kMask];
+    const size_t seq = cell.sequence.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(seq) -
+            static_cast<intptr_t>(dequeue_pos_ + 1) <
+        0) {
+      return false;
+    }
+    out = cell.data;
+    cell.sequence.store(dequeue_pos_ + kQueueLen, std::memory_order_release);
+    ++dequeue_pos_;
+    return true;
+  }
+
+  // Slots are published individually, so this stops at the first one a
+  // producer has claimed but not yet filled.
+  size_t PopBatch(EventType* out, size_t max) {
+    size_t n = 0;
+    while (n < max && Pop(out[n])) {
+      ++n;
+    }
+    return n;
+  }
+
+ private:
+  static constexpr size_t kMask = kQueueLen - 1;
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    EventType data;
+  };
+
+  std::array<Cell, kQueueLen> cells_{};
+  std::atomic<size_t> enqueue_pos_{0};
+  size_t dequeue_pos_ = 0;
+};
+
+// Bounded queue ordered by EventTraits<EventType>::Priority() that absorbs
+// duplicates of pending idempotent events, so a burst of timer ticks
+// collapses into one pending event instead of filling the queue, and an
+// urgent event overtakes the backlog. Guarded by an InterruptSpinLock held
+// for a short O(kQueueLen) scan, so it may be pushed to from ISRs.
+template <typename EventType, size_t kQueueLen>
+class PriorityCoalescingQueue {
+ public:
+  using Traits = EventTraits<EventType>;
+
+  static constexpr bool kIsrSafe = true;
+
+  bool Push(const EventType& e) {
+    const uint8_t priority = Traits::Priority(e);
+
+    lock_.lock();
+    for (size_t i = 0; i < count_; ++i) {
+      if (Traits::Coalesces(items_[i].event, e)) {
+        coalesced_.fetch_add(1, std::memory_order_relaxed);
+        lock_.unlock();
+        return true;
+      }
+    }
+    if (count_ == kQueueLen) {
+      lock_.unlock();
+      return false;
+    }
+
+    // items_[count_ - 1] is dispatched next. The new event goes behind
+    // everything of equal or higher priority.
+    size_t pos = 0;
+    while (pos < count_ && items_[pos].priority < priority) {
+      ++pos;
+    }
+    for (size_t i = count_; i > pos; --i) {
+      items_[i] = items_[i - 1];
+    }
+    items_[pos] = {e, priority};
+    ++count_;
+    lock_.unlock();
+    return true;
+  }
+
+  bool Pop(EventType& out) { return PopBatch(&out, 1) == 1; }
+
+  size_t PopBatch(EventType* out, size_t max) {
+    size_t n = 0;
+    lock_.lock();
+    while (n < max && count_ > 0) {
+      out[n++] = items_[--count_].event;
+    }
+    lock_.unlock();
+    return n;
+  }
+
+  // Pushes absorbed by an equivalent pending event.
+  uint32_t coalesced() const {
+    return coalesced_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Item {
+    EventType event;
+    uint8_t priority;
+  };
+
+  std::array<Item, kQueueLen> items_{};
+  size_t count_ = 0;
+  std::atomic<uint32_t> coalesced_{0};
+  pw::sync::InterruptSpinLock lock_;
+};
+
+}  // namespace play::thread
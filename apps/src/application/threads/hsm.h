@@ -0,0 +1,397 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+
+namespace play::thread::hsm {
+
+// Compile-time hierarchical state machine.
+//
+// States and events are types. A state may declare
+//
+//   using Parent = OtherState;      // nest inside a composite state
+//   using Initial = ChildState;     // default child when entered directly
+//   static void Entry(Context&);    // entry action
+//   static void Exit(Context&);     // exit action
+//   using Deferred = Events<E...>;  // events to hold while in this state
+//
+// and transitions are listed in a Transitions<> table:
+//
+//   Transition<Source, Event, Target, kGuard, kAction>
+//
+// where kGuard is a `bool (*)(Context&, const Event&)` and kAction a
+// `void (*)(Context&, const Event&)` (either may be nullptr). Target may be
+// Internal to run the action without leaving Source. An event not handled
+// by the active state bubbles to its parent; the first transition in table
+// order whose guard passes wins.
+//
+// The parent/entry/exit/initial tables and one handler table per event type
+// are constexpr arrays, so dispatch is a single indexed call with no
+// vtables, no function-local statics and no allocation. The machine itself
+// is its Context plus a one-byte state index.
+
+template <typename... Ss>
+struct States {};
+
+template <typename... Ts>
+struct Transitions {};
+
+template <typename... Es>
+struct Events {};
+
+// Transition target that runs the action without exit/entry.
+struct Internal {};
+
+template <typename Source,
+          typename Event,
+          typename Target,
+          auto kGuard = nullptr,
+          auto kAction = nullptr>
+struct Transition {
+  using SourceState = Source;
+  using EventType = Event;
+  using TargetState = Target;
+  static constexpr auto guard = kGuard;
+  static constexpr auto action = kAction;
+};
+
+namespace internal {
+
+inline constexpr uint8_t kNone = 0xFF;
+
+template <typename T, typename... Ts>
+struct IndexOf;
+
+template <typename T, typename... Ts>
+struct IndexOf<T, T, Ts...> : std::integral_constant<uint8_t, 0> {};
+
+template <typename T, typename U, typename... Ts>
+struct IndexOf<T, U, Ts...>
+    : std::integral_constant<uint8_t, 1 + IndexOf<T, Ts...>::value> {};
+
+template <typename T>
+struct IndexOf<T> {
+  static_assert(!std::is_same_v<T, T>, "state is not in the States<> list");
+};
+
+template <typename S, typename = void>
+struct ParentOf {
+  using type = void;
+};
+
+template <typename S>
+struct ParentOf<S, std::void_t<typename S::Parent>> {
+  using type = typename S::Parent;
+};
+
+template <typename S, typename = void>
+struct InitialOf {
+  using type = void;
+};
+
+template <typename S>
+struct InitialOf<S, std::void_t<typename S::Initial>> {
+  using type = typename S::Initial;
+};
+
+template <typename S, typename = void>
+struct DeferredOf {
+  using type = Events<>;
+};
+
+template <typename S>
+struct DeferredOf<S, std::void_t<typename S::Deferred>> {
+  using type = typename S::Deferred;
+};
+
+template <typename E, typename List>
+struct Contains;
+
+template <typename E, typename... Es>
+struct Contains<E, Events<Es...>>
+    : std::bool_constant<(std::is_same_v<E, Es> || ...)> {};
+
+template <typename S, typename Context, typename = void>
+struct HasEntry : std::false_type {};
+
+template <typename S, typename Context>
+struct HasEntry<S,
+                Context,
+                std::void_t<decltype(S::Entry(std::declval<Context&>()))>>
+    : std::true_type {};
+
+template <typename S, typename Context, typename = void>
+struct HasExit : std::false_type {};
+
+template <typename S, typename Context>
+struct HasExit<S,
+               Context,
+               std::void_t<decltype(S::Exit(std::declval<Context&>()))>>
+    : std::true_type {};
+
+template <auto kFn>
+inline constexpr bool kIsSet =
+    !std::is_same_v<std::remove_cv_t<decltype(kFn)>, std::nullptr_t>;
+
+}  // namespace internal
+
+template <typename Context, typename StateList, typename TransitionTable>
+class StateMachine;
+
+// The first state of the list is the initial state (refined through its
+// Initial chain).
+template <typename Context, typename... Ss, typename... Ts>
+class StateMachine<Context, States<Ss...>, Transitions<Ts...>> {
+ public:
+  static constexpr size_t kNumStates = sizeof...(Ss);
+  static_assert(kNumStates > 0 && kNumStates < internal::kNone,
+                "a state machine needs between 1 and 254 states");
+
+  template <typename S>
+  static constexpr uint8_t kStateId = internal::IndexOf<S, Ss...>::value;
+
+  template <typename... Args>
+  explicit StateMachine(Args&&... args)
+      : context_{static_cast<Args&&>(args)...} {}
+
+  // Enters the initial state. Must be called once before Dispatch().
+  void Start() { EnterFrom(internal::kNone, kStateId<FirstState>); }
+
+  // Delivers one event to the active state. Returns false if neither the
+  // active state nor any of its ancestors has an enabled transition.
+  template <typename E>
+  bool Dispatch(const E& ev) {
+    if (state_ == internal::kNone) {
+      return false;
+    }
+    return kHandlers<E>[state_](*this, ev);
+  }
+
+  // Visits the alternative held by `ev`, so a queue of std::variant events
+  // dispatches through the same per-type tables.
+  template <typename... Es>
+  bool Dispatch(const std::variant<Es...>& ev) {
+    return std::visit([this](const auto& e) { return Dispatch(e); }, ev);
+  }
+
+  // True if the active state or one of its ancestors lists E in its
+  // Deferred events. The machine does not hold events itself; the owner
+  // (see HsmActiveObject) keeps them until a state change. A state should
+  // not both defer and handle the same event.
+  template <typename E>
+  bool Defers(const E&) const {
+    return state_ != internal::kNone && kDefers<E>[state_];
+  }
+
+  template <typename... Es>
+  bool Defers(const std::variant<Es...>& ev) const {
+    return std::visit([this](const auto& e) { return Defers(e); }, ev);
+  }
+
+  // True if S is the active leaf state or one of its ancestors.
+  template <typename S>
+  bool IsIn() const {
+    for (uint8_t s = state_; s != internal::kNone; s = kParent[s]) {
+      if (s == kStateId<S>) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool started() const { return state_ != internal::kNone; }
+  uint8_t state_id() const { return state_; }
+
+  Context& context() { return context_; }
+  const Context& context() const { return context_; }
+
+ private:
+  using FirstState = std::tuple_element_t<0, std::tuple<Ss...>>;
+  using Action = void (*)(Context&);
+
+  template <typename E>
+  using Handler = bool (*)(StateMachine&, const E&);
+
+  template <typename S>
+  static constexpr uint8_t IdOrNone() {
+    if constexpr (std::is_void_v<S>) {
+      return internal::kNone;
+    } else {
+      return kStateId<S>;
+    }
+  }
+
+  template <typename S>
+  static constexpr uint8_t DepthOf() {
+    if constexpr (std::is_void_v<S>) {
+      return 0;
+    } else {
+      return 1 + DepthOf<typename internal::ParentOf<S>::type>();
+    }
+  }
+
+  template <typename S>
+  static void EntryOf(Context& ctx) {
+    S::Entry(ctx);
+  }
+
+  template <typename S>
+  static void ExitOf(Context& ctx) {
+    S::Exit(ctx);
+  }
+
+  template <typename S>
+  static constexpr Action EntryPtr() {
+    if constexpr (internal::HasEntry<S, Context>::value) {
+      return &EntryOf<S>;
+    } else {
+      return nullptr;
+    }
+  }
+
+  template <typename S>
+  static constexpr Action ExitPtr() {
+    if constexpr (internal::HasExit<S, Context>::value) {
+      return &ExitOf<S>;
+    } else {
+      return nullptr;
+    }
+  }
+
+  static constexpr std::array<uint8_t, kNumStates> kParent{
+      IdOrNone<typename internal::ParentOf<Ss>::type>()...};
+  static constexpr std::array<uint8_t, kNumStates> kInitial{
+      IdOrNone<typename internal::InitialOf<Ss>::type>()...};
+  static constexpr std::array<uint8_t, kNumStates> kDepth{DepthOf<Ss>()...};
+  static constexpr std::array<Action, kNumStates> kEntry{EntryPtr<Ss>()...};
+  static constexpr std::array<Action, kNumStates> kExit{ExitPtr<Ss>()...};
+  static constexpr uint8_t kMaxDepth = [] {
+    uint8_t max = 0;
+    for (uint8_t d : kDepth) {
+      max = d > max ? d : max;
+    }
+    return max;
+  }();
+
+  // Fires T if it belongs to state S and event E and its guard passes.
+  template <typename S, typename E, typename T>
+  bool Try(const E& ev) {
+    if constexpr (!std::is_same_v<typename T::SourceState, S> ||
+                  !std::is_same_v<typename T::EventType, E>) {
+      return false;
+    } else {
+      if constexpr (internal::kIsSet<T::guard>) {
+        if (!T::guard(context_, ev)) {
+          return false;
+        }
+      }
+      if constexpr (std::is_same_v<typename T::TargetState, Internal>) {
+        if constexpr (internal::kIsSet<T::action>) {
+          T::action(context_, ev);
+        }
+      } else {
+        const uint8_t target = kStateId<typename T::TargetState>;
+        const uint8_t lca = CommonAncestor(kStateId<S>, target);
+        ExitTo(lca);
+        if constexpr (internal::kIsSet<T::action>) {
+          T::action(context_, ev);
+        }
+        EnterFrom(lca, target);
+      }
+      return true;
+    }
+  }
+
+  template <typename S, typename E>
+  static bool Handle(StateMachine& m, const E& ev) {
+    if ((m.template Try<S, E, Ts>(ev) || ...)) {
+      return true;
+    }
+    using Parent = typename internal::ParentOf<S>::type;
+    if constexpr (std::is_void_v<Parent>) {
+      return false;
+    } else {
+      return Handle<Parent, E>(m, ev);
+    }
+  }
+
+  template <typename E>
+  static constexpr std::array<Handler<E>, kNumStates> kHandlers{
+      &Handle<Ss, E>...};
+
+  template <typename S, typename E>
+  static constexpr bool DefersIn() {
+    if constexpr (std::is_void_v<S>) {
+      return false;
+    } else {
+      using Deferred = typename internal::DeferredOf<S>::type;
+      return internal::Contains<E, Deferred>::value ||
+             DefersIn<typename internal::ParentOf<S>::type, E>();
+    }
+  }
+
+  template <typename E>
+  static constexpr std::array<bool, kNumStates> kDefers{DefersIn<Ss, E>()...};
+
+  static uint8_t Depth(uint8_t s) {
+    return s == internal::kNone ? 0 : kDepth[s];
+  }
+
+  // Deepest state that is a proper ancestor of both, so a self-transition
+  // exits and re-enters its state (UML external transition).
+  static uint8_t CommonAncestor(uint8_t a, uint8_t b) {
+    a = kParent[a];
+    b = kParent[b];
+    while (Depth(a) > Depth(b)) {
+      a = kParent[a];
+    }
+    while (Depth(b) > Depth(a)) {
+      b = kParent[b];
+    }
+    while (a != b) {
+      a = kParent[a];
+      b = kParent[b];
+    }
+    return a;
+  }
+
+  // Exits the active configuration from the leaf up to, not including, lca.
+  void ExitTo(uint8_t lca) {
+    while (state_ != lca) {
+      if (kExit[state_] != nullptr) {
+        kExit[state_](context_);
+      }
+      state_ = kParent[state_];
+    }
+  }
+
+  // Enters from below lca down to target, then follows Initial children.
+  void EnterFrom(uint8_t lca, uint8_t target) {
+    std::array<uint8_t, kMaxDepth> path{};
+    size_t n = 0;
+    for (uint8_t s = target; s != lca; s = kParent[s]) {
+      path[n++] = s;
+    }
+    while (n > 0) {
+      state_ = path[--n];
+      if (kEntry[state_] != nullptr) {
+        kEntry[state_](context_);
+      }
+    }
+    while (kInitial[state_] != internal::kNone) {
+      state_ = kInitial[state_];
+      if (kEntry[state_] != nullptr) {
+        kEntry[state_](context_);
+      }
+    }
+  }
+
+  Context context_;
+  uint8_t state_ = internal::kNone;
+};
+
+}  // namespace play::thread::hsm
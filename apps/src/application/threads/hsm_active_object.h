@@ -0,0 +1,124 @@
+#pragma once
+
+#include <pw_log/log.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+
+#include "active_object.h"
+#include "hsm.h"
+
+namespace play::thread {
+
+// Queue element of an HsmActiveObject: the start marker posted by Run(), or
+// one of the machine's events. Converts implicitly from each event type, so
+// producers write ao.Post(ButtonPress{}).
+template <typename... Es>
+struct HsmEvent {
+  enum class Type : uint8_t { kInit, kEvent };
+
+  HsmEvent() = default;
+  HsmEvent(Type t) : type(t) {}
+  template <typename E,
+            typename = std::enable_if_t<(std::is_same_v<E, Es> || ...)>>
+  HsmEvent(const E& e) : type(Type::kEvent), event(e) {}
+
+  Type type = Type::kInit;
+  std::variant<Es...> event;
+};
+
+// Active object that owns an hsm::StateMachine. The machine is started and
+// every event is dispatched on the AO thread, so handling is
+// run-to-completion and needs no lock however many threads, timers or ISRs
+// post to it.
+//
+// An event the active configuration defers (hsm::Events<> in a state's
+// Deferred) is held in a kDeferLen-deep FIFO instead of being dispatched.
+// After each state change the held events are offered again in arrival
+// order, so a press that arrives while the machine is busy is handled once
+// a state that accepts it is entered.
+template <typename Machine,
+          size_t kQueueLen,
+          template <typename, size_t> class QueuePolicy,
+          size_t kDeferLen,
+          typename... Es>
+class HsmActiveObject
+    : public ActiveObjectCore<HsmEvent<Es...>, kQueueLen, QueuePolicy> {
+ public:
+  using Event = HsmEvent<Es...>;
+
+  template <typename... Args>
+  explicit HsmActiveObject(Args&&... args)
+      : machine_(static_cast<Args&&>(args)...) {}
+
+  // Owner thread only; for inspection in tests and from HandleEvent().
+  const Machine& machine() const { return machine_; }
+
+  // Events held for a later state; dropped_deferrals() counts those lost
+  // because the FIFO was full.
+  size_t deferred() const { return deferred_count_; }
+  uint32_t dropped_deferrals() const {
+    return dropped_deferrals_.load(std::memory_order_relaxed);
+  }
+
+ protected:
+  void HandleEvent(const Event& ev) override {
+    if (ev.type == Event::Type::kInit) {
+      machine_.Start();
+      return;
+    }
+    if (machine_.Defers(ev.event)) {
+      Defer(ev.event);
+      return;
+    }
+    const uint8_t before = machine_.state_id();
+    machine_.Dispatch(ev.event);
+    if (machine_.state_id() != before) {
+      Recall();
+    }
+  }
+
+ private:
+  using Variant = std::variant<Es...>;
+
+  void Defer(const Variant& ev) {
+    if (deferred_count_ == kDeferLen) {
+      dropped_deferrals_.fetch_add(1, std::memory_order_relaxed);
+      PW_LOG_ERROR("HsmActiveObject defer queue full, dropping event");
+      return;
+    }
+    deferred_[deferred_count_++] = ev;
+  }
+
+  // Offers every held event to the current state, oldest first, and
+  // repeats while a recalled event changes state.
+  void Recall() {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      size_t kept = 0;
+      for (size_t i = 0; i < deferred_count_; ++i) {
+        const Variant ev = deferred_[i];
+        if (machine_.Defers(ev)) {
+          deferred_[kept++] = ev;
+          continue;
+        }
+        const uint8_t before = machine_.state_id();
+        machine_.Dispatch(ev);
+        changed = changed || machine_.state_id() != before;
+      }
+      deferred_count_ = kept;
+    }
+  }
+
+  Machine machine_;
+  std::array<Variant, kDeferLen> deferred_{};
+  size_t deferred_count_ = 0;
+  std::atomic<uint32_t> dropped_deferrals_{0};
+};
+
+}  // namespace play::thread
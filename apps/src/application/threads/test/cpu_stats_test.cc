@@ -0,0 +1,100 @@
+#include "cpu_stats.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace play::thread {
+namespace {
+
+TEST(CycleCounter64Test, CarriesAcrossWraps) {
+  CycleCounter64 counter;
+
+  EXPECT_EQ(counter.Extend(10), 10u);
+  EXPECT_EQ(counter.Extend(0xFFFFFFF0u), 0xFFFFFFF0u);
+  EXPECT_EQ(counter.Extend(5), (uint64_t{1} << 32) + 5);
+  EXPECT_EQ(counter.Extend(5), (uint64_t{1} << 32) + 5);
+  EXPECT_EQ(counter.Extend(4), (uint64_t{2} << 32) + 4);
+}
+
+TEST(CycleCounter64Test, DeltasStayExactPastThirtyTwoBits) {
+  CycleCounter64 counter;
+  uint32_t raw = 0xFFFF0000u;
+  const uint64_t start = counter.Extend(raw);
+
+  // Three full wraps in steps shorter than one counter period.
+  for (int i = 0; i < 12; ++i) {
+    raw += 0x40000000u;
+    counter.Extend(raw);
+  }
+  EXPECT_EQ(counter.Extend(raw) - start, uint64_t{3} << 32);
+}
+
+TEST(CpuStatsSamplerTest, FirstWindowIsSinceBoot) {
+  CpuStatsSampler<4> sampler;
+  const std::vector<TaskSample> tasks = {
+      {1, "IDLE", 750, 100, 3},
+      {2, "LEDThread", 250, 40, 7},
+  };
+
+  auto usage = sampler.Update(tasks, 1000);
+  ASSERT_EQ(usage.size(), 2u);
+  EXPECT_EQ(sampler.window(), 1000u);
+  EXPECT_EQ(usage[0].cpu_permille, 750u);
+  EXPECT_EQ(usage[1].cpu_permille, 250u);
+  EXPECT_EQ(usage[1].switches, 7u);
+  EXPECT_EQ(usage[1].stack_free_min, 40u);
+}
+
+TEST(CpuStatsSamplerTest, LaterWindowsUseDeltas) {
+  CpuStatsSampler<4> sampler;
+  sampler.Update(std::vector<TaskSample>{{1, "IDLE", 500, 100, 2},
+                                         {2, "LEDThread", 500, 40, 5}},
+                 1000);
+
+  // LEDThread takes 90% of the second window; IDLE is starved.
+  auto usage = sampler.Update(
+      std::vector<TaskSample>{{1, "IDLE", 600, 100, 3},
+                              {2, "LEDThread", 1400, 32, 105}},
+      2000);
+  ASSERT_EQ(usage.size(), 2u);
+  EXPECT_EQ(sampler.window(), 1000u);
+  EXPECT_EQ(usage[0].run_time, 100u);
+  EXPECT_EQ(usage[0].cpu_permille, 100u);
+  EXPECT_EQ(usage[1].cpu_permille, 900u);
+  EXPECT_EQ(usage[1].switches, 100u);
+  EXPECT_EQ(usage[1].stack_free_min, 32u);
+}
+
+TEST(CpuStatsSamplerTest, TasksAreMatchedById) {
+  CpuStatsSampler<4> sampler;
+  sampler.Update(std::vector<TaskSample>{{1, "IDLE", 100, 100, 1},
+                                         {2, "Gone", 100, 50, 1}},
+                 200);
+
+  // Task 2 was deleted, task 3 is new, and the order changed.
+  auto usage =
+      sampler.Update(std::vector<TaskSample>{{3, "New", 40, 60, 2},
+                                             {1, "IDLE", 260, 100, 4}},
+                     400);
+  ASSERT_EQ(usage.size(), 2u);
+  EXPECT_STREQ(usage[0].name, "New");
+  EXPECT_EQ(usage[0].run_time, 40u);
+  EXPECT_EQ(usage[0].switches, 2u);
+  EXPECT_EQ(usage[1].run_time, 160u);
+  EXPECT_EQ(usage[1].cpu_permille, 800u);
+}
+
+TEST(CpuStatsSamplerTest, ExtraTasksAreIgnored) {
+  CpuStatsSampler<2> sampler;
+  auto usage = sampler.Update(std::vector<TaskSample>{{1, "a", 1, 1, 1},
+                                                      {2, "b", 1, 1, 1},
+                                                      {3, "c", 1, 1, 1}},
+                              3);
+  EXPECT_EQ(usage.size(), 2u);
+  EXPECT_EQ(sampler.usage().size(), 2u);
+}
+
+}  // namespace
+}  // namespace play::thread
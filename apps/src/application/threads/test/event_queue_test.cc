@@ -0,0 +1,378 @@
+#include "event_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "active_object.h"
+
+namespace play::thread {
+namespace {
+
+struct TestEvent {
+  enum class Type : uint8_t { kInit, kPing } type;
+  uint32_t value;
+};
+
+// kUrgent jumps the backlog; pending kTicks absorb later ones.
+struct PrioEvent {
+  enum class Type : uint8_t { kInit, kPing, kTick, kUrgent } type;
+  uint32_t value;
+};
+
+}  // namespace
+
+template <>
+struct EventTraits<PrioEvent> {
+  static constexpr uint8_t Priority(const PrioEvent& ev) {
+    return ev.type == PrioEvent::Type::kUrgent ? 1 : 0;
+  }
+  static constexpr bool Coalesces(const PrioEvent& pending,
+                                  const PrioEvent& incoming) {
+    return incoming.type == PrioEvent::Type::kTick &&
+           pending.type == PrioEvent::Type::kTick;
+  }
+};
+
+namespace {
+
+template <typename Queue>
+void ExpectFifoAcrossWraparound() {
+  Queue queue;
+  TestEvent ev{};
+  uint32_t next_in = 0;
+  uint32_t next_out = 0;
+
+  // Several laps with a varying fill level so every slot index is reused.
+  for (int round = 0; round < 16; ++round) {
+    const uint32_t burst = 1u + static_cast<uint32_t>(round % 4);
+    for (uint32_t i = 0; i < burst; ++i) {
+      ASSERT_TRUE(queue.Push({TestEvent::Type::kPing, next_in++}));
+    }
+    for (uint32_t i = 0; i < burst; ++i) {
+      ASSERT_TRUE(queue.Pop(ev));
+      EXPECT_EQ(ev.value, next_out++);
+    }
+    EXPECT_FALSE(queue.Pop(ev));
+  }
+}
+
+template <typename Queue>
+void ExpectBoundedCapacity(size_t capacity) {
+  Queue queue;
+  TestEvent ev{};
+
+  EXPECT_FALSE(queue.Pop(ev));
+  for (size_t i = 0; i < capacity; ++i) {
+    EXPECT_TRUE(
+        queue.Push({TestEvent::Type::kPing, static_cast<uint32_t>(i)}));
+  }
+  EXPECT_FALSE(queue.Push({TestEvent::Type::kPing, 99}));
+
+  ASSERT_TRUE(queue.Pop(ev));
+  EXPECT_EQ(ev.value, 0u);
+  EXPECT_TRUE(queue.Push({TestEvent::Type::kPing, 100}));
+  EXPECT_FALSE(queue.Push({TestEvent::Type::kPing, 101}));
+}
+
+// Producers push [0, kPerProducer) tagged with their index; the consumer
+// checks that each producer's events arrive complete and in order.
+template <typename Queue>
+void ExpectConcurrentDelivery(size_t producers) {
+  constexpr uint32_t kPerProducer = 20000;
+  Queue queue;
+  std::atomic<bool> start{false};
+  std::vector<std::thread> threads;
+
+  for (size_t p = 0; p < producers; ++p) {
+    threads.emplace_back([&queue, &start, p]() {
+      while (!start.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      for (uint32_t i = 0; i < kPerProducer; ++i) {
+        const TestEvent ev{TestEvent::Type::kPing,
+                           (static_cast<uint32_t>(p) << 24) | i};
+        while (!queue.Push(ev)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::vector<uint32_t> expected(producers, 0);
+  size_t received = 0;
+  start.store(true, std::memory_order_release);
+
+  TestEvent ev{};
+  while (received < producers * kPerProducer) {
+    if (!queue.Pop(ev)) {
+      std::this_thread::yield();
+      continue;
+    }
+    const size_t p = ev.value >> 24;
+    ASSERT_LT(p, producers);
+    EXPECT_EQ(ev.value & 0xFFFFFFu, expected[p]);
+    expected[p] = (ev.value & 0xFFFFFFu) + 1;
+    ++received;
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_FALSE(queue.Pop(ev));
+  for (size_t p = 0; p < producers; ++p) {
+    EXPECT_EQ(expected[p], kPerProducer);
+  }
+}
+
+template <typename Queue>
+void ExpectBatchPop() {
+  Queue queue;
+  std::array<TestEvent, 8> batch{};
+
+  EXPECT_EQ(queue.PopBatch(batch.data(), batch.size()), 0u);
+
+  for (uint32_t round = 0; round < 5; ++round) {
+    for (uint32_t i = 0; i < 3; ++i) {
+      ASSERT_TRUE(queue.Push({TestEvent::Type::kPing, round * 10 + i}));
+    }
+    // A short batch limit leaves the rest queued in order.
+    ASSERT_EQ(queue.PopBatch(batch.data(), 2), 2u);
+    EXPECT_EQ(batch[0].value, round * 10);
+    EXPECT_EQ(batch[1].value, round * 10 + 1);
+    ASSERT_EQ(queue.PopBatch(batch.data(), batch.size()), 1u);
+    EXPECT_EQ(batch[0].value, round * 10 + 2);
+  }
+  EXPECT_EQ(queue.PopBatch(batch.data(), batch.size()), 0u);
+}
+
+TEST(MutexQueueTest, FifoAcrossWraparound) {
+  ExpectFifoAcrossWraparound<MutexQueue<TestEvent, 4>>();
+}
+
+TEST(MutexQueueTest, BoundedCapacity) {
+  ExpectBoundedCapacity<MutexQueue<TestEvent, 4>>(4);
+}
+
+TEST(MutexQueueTest, BatchPop) { ExpectBatchPop<MutexQueue<TestEvent, 4>>(); }
+
+TEST(MutexQueueTest, ConcurrentProducers) {
+  ExpectConcurrentDelivery<MutexQueue<TestEvent, 8>>(3);
+}
+
+TEST(SpscQueueTest, FifoAcrossWraparound) {
+  ExpectFifoAcrossWraparound<SpscQueue<TestEvent, 4>>();
+}
+
+TEST(SpscQueueTest, BoundedCapacity) {
+  ExpectBoundedCapacity<SpscQueue<TestEvent, 4>>(4);
+}
+
+TEST(SpscQueueTest, BatchPop) { ExpectBatchPop<SpscQueue<TestEvent, 4>>(); }
+
+TEST(SpscQueueTest, SingleProducerSingleConsumer) {
+  ExpectConcurrentDelivery<SpscQueue<TestEvent, 8>>(1);
+}
+
+TEST(MpscQueueTest, FifoAcrossWraparound) {
+  ExpectFifoAcrossWraparound<MpscQueue<TestEvent, 4>>();
+}
+
+TEST(MpscQueueTest, BoundedCapacity) {
+  ExpectBoundedCapacity<MpscQueue<TestEvent, 4>>(4);
+}
+
+TEST(MpscQueueTest, BatchPop) { ExpectBatchPop<MpscQueue<TestEvent, 4>>(); }
+
+TEST(MpscQueueTest, ConcurrentProducers) {
+  ExpectConcurrentDelivery<MpscQueue<TestEvent, 8>>(4);
+}
+
+// With the default EventTraits the policy behaves as a plain FIFO.
+TEST(PriorityCoalescingQueueTest, FifoAcrossWraparound) {
+  ExpectFifoAcrossWraparound<PriorityCoalescingQueue<TestEvent, 4>>();
+}
+
+TEST(PriorityCoalescingQueueTest, BoundedCapacity) {
+  ExpectBoundedCapacity<PriorityCoalescingQueue<TestEvent, 3>>(3);
+}
+
+TEST(PriorityCoalescingQueueTest, BatchPop) {
+  ExpectBatchPop<PriorityCoalescingQueue<TestEvent, 4>>();
+}
+
+TEST(PriorityCoalescingQueueTest, ConcurrentProducers) {
+  ExpectConcurrentDelivery<PriorityCoalescingQueue<TestEvent, 8>>(3);
+}
+
+TEST(PriorityCoalescingQueueTest, UrgentEventsOvertakeBacklog) {
+  PriorityCoalescingQueue<PrioEvent, 8> queue;
+  std::array<PrioEvent, 8> batch{};
+
+  ASSERT_TRUE(queue.Push({PrioEvent::Type::kPing, 0}));
+  ASSERT_TRUE(queue.Push({PrioEvent::Type::kPing, 1}));
+  ASSERT_TRUE(queue.Push({PrioEvent::Type::kUrgent, 2}));
+  ASSERT_TRUE(queue.Push({PrioEvent::Type::kPing, 3}));
+  ASSERT_TRUE(queue.Push({PrioEvent::Type::kUrgent, 4}));
+
+  ASSERT_EQ(queue.PopBatch(batch.data(), batch.size()), 5u);
+  EXPECT_EQ(batch[0].value, 2u);
+  EXPECT_EQ(batch[1].value, 4u);
+  EXPECT_EQ(batch[2].value, 0u);
+  EXPECT_EQ(batch[3].value, 1u);
+  EXPECT_EQ(batch[4].value, 3u);
+}
+
+TEST(PriorityCoalescingQueueTest, PendingEventAbsorbsDuplicates) {
+  PriorityCoalescingQueue<PrioEvent, 2> queue;
+  PrioEvent ev{};
+
+  ASSERT_TRUE(queue.Push({PrioEvent::Type::kTick, 0}));
+  for (uint32_t i = 1; i < 10; ++i) {
+    EXPECT_TRUE(queue.Push({PrioEvent::Type::kTick, i}));
+  }
+  EXPECT_EQ(queue.coalesced(), 9u);
+  ASSERT_TRUE(queue.Push({PrioEvent::Type::kPing, 10}));
+  EXPECT_FALSE(queue.Push({PrioEvent::Type::kPing, 11}));
+  // A full queue still absorbs an event that coalesces.
+  EXPECT_TRUE(queue.Push({PrioEvent::Type::kTick, 12}));
+
+  ASSERT_TRUE(queue.Pop(ev));
+  EXPECT_EQ(ev.type, PrioEvent::Type::kTick);
+  EXPECT_EQ(ev.value, 0u);
+  ASSERT_TRUE(queue.Pop(ev));
+  EXPECT_EQ(ev.value, 10u);
+  EXPECT_FALSE(queue.Pop(ev));
+
+  // Once dispatched, the next tick is queued again.
+  EXPECT_TRUE(queue.Push({PrioEvent::Type::kTick, 13}));
+  EXPECT_EQ(queue.coalesced(), 10u);
+  ASSERT_TRUE(queue.Pop(ev));
+  EXPECT_EQ(ev.value, 13u);
+}
+
+template <template <typename, size_t> class Policy>
+class PostOnlyObject : public ActiveObjectCore<TestEvent, 4, Policy> {
+ protected:
+  void HandleEvent(const TestEvent&) override {}
+};
+
+TEST(ActiveObjectQueuePolicyTest, PostReportsFullQueueForEveryPolicy) {
+  PostOnlyObject<MutexQueue> mutex_ao;
+  PostOnlyObject<SpscQueue> spsc_ao;
+  PostOnlyObject<MpscQueue> mpsc_ao;
+
+  for (uint32_t i = 0; i < 4; ++i) {
+    EXPECT_TRUE(mutex_ao.Post({TestEvent::Type::kPing, i}));
+    EXPECT_TRUE(spsc_ao.Post({TestEvent::Type::kPing, i}));
+    EXPECT_TRUE(mpsc_ao.Post({TestEvent::Type::kPing, i}));
+  }
+  EXPECT_FALSE(mutex_ao.Post({TestEvent::Type::kPing, 4}));
+  EXPECT_FALSE(spsc_ao.Post({TestEvent::Type::kPing, 4}));
+  EXPECT_FALSE(mpsc_ao.Post({TestEvent::Type::kPing, 4}));
+}
+
+static_assert(!MutexQueue<TestEvent, 4>::kIsrSafe);
+static_assert(SpscQueue<TestEvent, 4>::kIsrSafe);
+static_assert(MpscQueue<TestEvent, 4>::kIsrSafe);
+static_assert(PriorityCoalescingQueue<TestEvent, 4>::kIsrSafe);
+
+// Stands in for an interrupt: PostFromIsr() from another context while the
+// owner keeps its regular producers.
+TEST(ActiveObjectQueuePolicyTest, PostFromIsrSharesQueueWithPost) {
+  PostOnlyObject<MpscQueue> ao;
+
+  EXPECT_TRUE(ao.Post({TestEvent::Type::kPing, 0}));
+  std::thread isr([&ao]() {
+    EXPECT_TRUE(ao.PostFromIsr({TestEvent::Type::kPing, 1}));
+    EXPECT_TRUE(ao.PostFromIsr({TestEvent::Type::kPing, 2}));
+  });
+  isr.join();
+  EXPECT_TRUE(ao.Post({TestEvent::Type::kPing, 3}));
+  EXPECT_FALSE(ao.PostFromIsr({TestEvent::Type::kPing, 4}));
+}
+
+class BatchRecordingObject : public ActiveObjectCore<TestEvent, 4> {
+ public:
+  using ActiveObjectCore::DispatchPending;
+
+  std::vector<size_t> batch_sizes;
+  std::vector<uint32_t> values;
+
+ protected:
+  void HandleEvent(const TestEvent& ev) override { values.push_back(ev.value); }
+
+  void HandleEvents(pw::span<const TestEvent> events) override {
+    batch_sizes.push_back(events.size());
+    ActiveObjectCore::HandleEvents(events);
+  }
+};
+
+TEST(ActiveObjectBatchTest, DispatchPendingDeliversWholeBurstAtOnce) {
+  BatchRecordingObject ao;
+
+  EXPECT_EQ(ao.DispatchPending(), 0u);
+  for (uint32_t i = 0; i < 4; ++i) {
+    ASSERT_TRUE(ao.Post({TestEvent::Type::kPing, i}));
+  }
+  EXPECT_EQ(ao.DispatchPending(), 4u);
+
+  ASSERT_EQ(ao.batch_sizes.size(), 1u);
+  EXPECT_EQ(ao.batch_sizes[0], 4u);
+  EXPECT_EQ(ao.values, (std::vector<uint32_t>{0, 1, 2, 3}));
+  EXPECT_TRUE(ao.Post({TestEvent::Type::kPing, 4}));
+}
+
+template <template <typename, size_t> class Policy>
+class StatsObject : public ActiveObjectCore<PrioEvent, 4, Policy> {
+ public:
+  using ActiveObjectCore<PrioEvent, 4, Policy>::DispatchPending;
+
+ protected:
+  void HandleEvent(const PrioEvent&) override {}
+};
+
+TEST(ActiveObjectStatsTest, CountsDropsAndHighWater) {
+  StatsObject<SpscQueue> ao;
+
+  EXPECT_EQ(ao.Stats().high_water, 0u);
+  EXPECT_EQ(ao.Stats().dropped, 0u);
+
+  ASSERT_TRUE(ao.Post({PrioEvent::Type::kPing, 0}));
+  ASSERT_TRUE(ao.Post({PrioEvent::Type::kPing, 1}));
+  EXPECT_EQ(ao.DispatchPending(), 2u);
+  EXPECT_EQ(ao.Stats().high_water, 2u);
+
+  for (uint32_t i = 0; i < 6; ++i) {
+    ao.Post({PrioEvent::Type::kPing, i});
+  }
+  EXPECT_EQ(ao.DispatchPending(), 4u);
+  ASSERT_TRUE(ao.Post({PrioEvent::Type::kPing, 0}));
+  EXPECT_EQ(ao.DispatchPending(), 1u);
+
+  const ActiveObjectStats stats = ao.Stats();
+  EXPECT_EQ(stats.high_water, 4u);
+  EXPECT_EQ(stats.dropped, 2u);
+  EXPECT_EQ(stats.coalesced, 0u);
+}
+
+TEST(ActiveObjectStatsTest, BurstOfTicksCollapsesInsteadOfDropping) {
+  StatsObject<PriorityCoalescingQueue> ao;
+
+  for (uint32_t i = 0; i < 20; ++i) {
+    EXPECT_TRUE(ao.Post({PrioEvent::Type::kTick, i}));
+  }
+  EXPECT_EQ(ao.DispatchPending(), 1u);
+
+  const ActiveObjectStats stats = ao.Stats();
+  EXPECT_EQ(stats.high_water, 1u);
+  EXPECT_EQ(stats.dropped, 0u);
+  EXPECT_EQ(stats.coalesced, 19u);
+}
+
+}  // namespace
+}  // namespace play::thread
@@ -0,0 +1,139 @@
+#include "hsm_active_object.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace play::thread {
+namespace {
+
+// Idle accepts a Job and becomes Busy; Busy defers further Jobs until Done
+// returns it to Idle. Cancel is handled by the Working superstate.
+
+struct Job {
+  uint32_t id;
+};
+struct Done {};
+struct Cancel {};
+
+struct Ctx {
+  std::vector<uint32_t> started;
+  uint32_t cancels = 0;
+};
+
+struct Working {};
+
+struct Idle {
+  using Parent = Working;
+};
+
+struct Busy {
+  using Parent = Working;
+  using Deferred = hsm::Events<Job>;
+};
+
+void StartJob(Ctx& c, const Job& job) { c.started.push_back(job.id); }
+void CountCancel(Ctx& c, const Cancel&) { ++c.cancels; }
+
+using JobMachine = hsm::StateMachine<
+    Ctx,
+    hsm::States<Idle, Busy, Working>,
+    hsm::Transitions<
+        hsm::Transition<Idle, Job, Busy, nullptr, &StartJob>,
+        hsm::Transition<Busy, Done, Idle>,
+        hsm::Transition<Working, Cancel, Idle, nullptr, &CountCancel>>>;
+
+template <size_t kDeferLen>
+class JobObject : public HsmActiveObject<JobMachine,
+                                         8,
+                                         MutexQueue,
+                                         kDeferLen,
+                                         Job,
+                                         Done,
+                                         Cancel> {
+ public:
+  using Base =
+      HsmActiveObject<JobMachine, 8, MutexQueue, kDeferLen, Job, Done, Cancel>;
+  using Base::DispatchPending;
+
+  void Start() {
+    ASSERT_TRUE(this->Post({Base::Event::Type::kInit}));
+    DispatchPending();
+  }
+
+  const std::vector<uint32_t>& started() const {
+    return this->machine().context().started;
+  }
+};
+
+TEST(HsmActiveObjectTest, InitEventStartsMachineOnOwnerThread) {
+  JobObject<4> ao;
+  EXPECT_FALSE(ao.machine().started());
+
+  ao.Start();
+  EXPECT_TRUE(ao.machine().IsIn<Idle>());
+}
+
+TEST(HsmActiveObjectTest, DeferredEventsReplayAfterStateChange) {
+  JobObject<4> ao;
+  ao.Start();
+
+  ASSERT_TRUE(ao.Post(Job{1}));
+  ASSERT_TRUE(ao.Post(Job{2}));
+  ASSERT_TRUE(ao.Post(Job{3}));
+  EXPECT_EQ(ao.DispatchPending(), 3u);
+  EXPECT_TRUE(ao.machine().IsIn<Busy>());
+  EXPECT_EQ(ao.started(), (std::vector<uint32_t>{1}));
+  EXPECT_EQ(ao.deferred(), 2u);
+
+  // Leaving Busy recalls Job 2, which makes the machine Busy again, so
+  // Job 3 stays held.
+  ASSERT_TRUE(ao.Post(Done{}));
+  ao.DispatchPending();
+  EXPECT_EQ(ao.started(), (std::vector<uint32_t>{1, 2}));
+  EXPECT_EQ(ao.deferred(), 1u);
+
+  ASSERT_TRUE(ao.Post(Done{}));
+  ASSERT_TRUE(ao.Post(Done{}));
+  ao.DispatchPending();
+  EXPECT_EQ(ao.started(), (std::vector<uint32_t>{1, 2, 3}));
+  EXPECT_EQ(ao.deferred(), 0u);
+  EXPECT_TRUE(ao.machine().IsIn<Idle>());
+}
+
+TEST(HsmActiveObjectTest, SuperstateTransitionAlsoRecalls) {
+  JobObject<4> ao;
+  ao.Start();
+
+  ASSERT_TRUE(ao.Post(Job{1}));
+  ASSERT_TRUE(ao.Post(Job{2}));
+  ASSERT_TRUE(ao.Post(Cancel{}));
+  ao.DispatchPending();
+
+  EXPECT_EQ(ao.machine().context().cancels, 1u);
+  EXPECT_EQ(ao.started(), (std::vector<uint32_t>{1, 2}));
+  EXPECT_TRUE(ao.machine().IsIn<Busy>());
+}
+
+TEST(HsmActiveObjectTest, FullDeferQueueDropsAndCounts) {
+  JobObject<2> ao;
+  ao.Start();
+
+  for (uint32_t id = 1; id <= 4; ++id) {
+    ASSERT_TRUE(ao.Post(Job{id}));
+  }
+  ao.DispatchPending();
+  EXPECT_EQ(ao.deferred(), 2u);
+  EXPECT_EQ(ao.dropped_deferrals(), 1u);
+
+  ASSERT_TRUE(ao.Post(Done{}));
+  ASSERT_TRUE(ao.Post(Done{}));
+  ao.DispatchPending();
+  EXPECT_EQ(ao.started(), (std::vector<uint32_t>{1, 2, 3}));
+}
+
+static_assert(JobMachine::kNumStates == 3);
+
+}  // namespace
+}  // namespace play::thread
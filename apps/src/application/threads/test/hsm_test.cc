@@ -0,0 +1,241 @@
+#include "hsm.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "button_fsm.h"
+
+namespace play::thread {
+namespace {
+
+// Test machine:
+//
+//   Off
+//   On (Initial = Normal)
+//     Normal
+//     Boosted
+//
+// Power toggles Off <-> On, Boost enters Boosted when the guard allows it,
+// Tick is handled internally by On, Reset re-enters On from any substate.
+
+struct Power {};
+struct Boost {
+  bool allowed;
+};
+struct Tick {};
+struct Reset {};
+struct Unused {};
+
+struct Ctx {
+  std::vector<std::string> log;
+  int ticks = 0;
+};
+
+struct Off {
+  static void Entry(Ctx& c) { c.log.push_back("Off+"); }
+  static void Exit(Ctx& c) { c.log.push_back("Off-"); }
+};
+
+struct Normal;
+
+struct On {
+  using Initial = Normal;
+  static void Entry(Ctx& c) { c.log.push_back("On+"); }
+  static void Exit(Ctx& c) { c.log.push_back("On-"); }
+};
+
+struct Normal {
+  using Parent = On;
+  static void Entry(Ctx& c) { c.log.push_back("Normal+"); }
+  static void Exit(Ctx& c) { c.log.push_back("Normal-"); }
+};
+
+// No entry/exit actions.
+struct Boosted {
+  using Parent = On;
+};
+
+bool BoostAllowed(Ctx&, const Boost& ev) { return ev.allowed; }
+void CountTick(Ctx& c, const Tick&) { ++c.ticks; }
+void LogPowerOff(Ctx& c, const Power&) { c.log.push_back("power-off"); }
+
+using TestMachine = hsm::StateMachine<
+    Ctx,
+    hsm::States<Off, On, Normal, Boosted>,
+    hsm::Transitions<
+        hsm::Transition<Off, Power, On>,
+        hsm::Transition<On, Power, Off, nullptr, &LogPowerOff>,
+        hsm::Transition<Normal, Boost, Boosted, &BoostAllowed>,
+        hsm::Transition<On, Tick, hsm::Internal, nullptr, &CountTick>,
+        hsm::Transition<On, Reset, On>>>;
+
+using Log = std::vector<std::string>;
+
+class HsmTest : public ::testing::Test {
+ protected:
+  Log TakeLog() {
+    Log out;
+    out.swap(machine.context().log);
+    return out;
+  }
+
+  TestMachine machine;
+};
+
+TEST_F(HsmTest, NothingIsDispatchedBeforeStart) {
+  EXPECT_FALSE(machine.started());
+  EXPECT_FALSE(machine.Dispatch(Power{}));
+  EXPECT_TRUE(TakeLog().empty());
+}
+
+TEST_F(HsmTest, StartEntersFirstState) {
+  machine.Start();
+  EXPECT_TRUE(machine.started());
+  EXPECT_TRUE(machine.IsIn<Off>());
+  EXPECT_EQ(machine.state_id(), TestMachine::kStateId<Off>);
+  EXPECT_EQ(TakeLog(), (Log{"Off+"}));
+}
+
+TEST_F(HsmTest, EnteringCompositeStateFollowsInitialChild) {
+  machine.Start();
+  TakeLog();
+
+  EXPECT_TRUE(machine.Dispatch(Power{}));
+  EXPECT_TRUE(machine.IsIn<On>());
+  EXPECT_TRUE(machine.IsIn<Normal>());
+  EXPECT_FALSE(machine.IsIn<Off>());
+  EXPECT_EQ(TakeLog(), (Log{"Off-", "On+", "Normal+"}));
+}
+
+TEST_F(HsmTest, ParentTransitionExitsActiveLeafFirst) {
+  machine.Start();
+  machine.Dispatch(Power{});
+  TakeLog();
+
+  // Normal has no Power transition; it bubbles to On.
+  EXPECT_TRUE(machine.Dispatch(Power{}));
+  EXPECT_TRUE(machine.IsIn<Off>());
+  EXPECT_EQ(TakeLog(), (Log{"Normal-", "On-", "power-off", "Off+"}));
+}
+
+TEST_F(HsmTest, GuardSelectsWhetherTransitionFires) {
+  machine.Start();
+  machine.Dispatch(Power{});
+  TakeLog();
+
+  EXPECT_FALSE(machine.Dispatch(Boost{false}));
+  EXPECT_TRUE(machine.IsIn<Normal>());
+  EXPECT_TRUE(TakeLog().empty());
+
+  EXPECT_TRUE(machine.Dispatch(Boost{true}));
+  EXPECT_TRUE(machine.IsIn<Boosted>());
+  EXPECT_TRUE(machine.IsIn<On>());
+  EXPECT_EQ(TakeLog(), (Log{"Normal-"}));
+}
+
+TEST_F(HsmTest, InternalTransitionRunsActionWithoutExitOrEntry) {
+  machine.Start();
+  machine.Dispatch(Power{});
+  machine.Dispatch(Boost{true});
+  TakeLog();
+
+  EXPECT_TRUE(machine.Dispatch(Tick{}));
+  EXPECT_TRUE(machine.Dispatch(Tick{}));
+  EXPECT_EQ(machine.context().ticks, 2);
+  EXPECT_TRUE(machine.IsIn<Boosted>());
+  EXPECT_TRUE(TakeLog().empty());
+}
+
+TEST_F(HsmTest, SelfTransitionOnCompositeReentersInitialChild) {
+  machine.Start();
+  machine.Dispatch(Power{});
+  machine.Dispatch(Boost{true});
+  TakeLog();
+
+  EXPECT_TRUE(machine.Dispatch(Reset{}));
+  EXPECT_TRUE(machine.IsIn<Normal>());
+  EXPECT_EQ(TakeLog(), (Log{"On-", "On+", "Normal+"}));
+}
+
+TEST_F(HsmTest, UnhandledEventLeavesStateUnchanged) {
+  machine.Start();
+  TakeLog();
+
+  EXPECT_FALSE(machine.Dispatch(Tick{}));
+  EXPECT_FALSE(machine.Dispatch(Unused{}));
+  EXPECT_TRUE(machine.IsIn<Off>());
+  EXPECT_EQ(machine.context().ticks, 0);
+  EXPECT_TRUE(TakeLog().empty());
+}
+
+TEST_F(HsmTest, VariantEventsDispatchByAlternative) {
+  using Event = std::variant<Power, Boost, Tick>;
+  machine.Start();
+
+  EXPECT_TRUE(machine.Dispatch(Event{Power{}}));
+  EXPECT_TRUE(machine.Dispatch(Event{Tick{}}));
+  EXPECT_TRUE(machine.Dispatch(Event{Boost{true}}));
+  EXPECT_TRUE(machine.IsIn<Boosted>());
+  EXPECT_EQ(machine.context().ticks, 1);
+}
+
+// The dispatch tables are compile-time data; the machine is its context
+// plus the state index.
+static_assert(sizeof(ButtonFsm) <= sizeof(ButtonFsmContext) + 8);
+
+std::vector<bool> pressed_changes;
+
+TEST(ButtonFsmTest, MatchesLegacyPressReleaseCycle) {
+  pressed_changes.clear();
+  ButtonFsm fsm(ButtonFsmContext{
+      false, [](bool pressed) { pressed_changes.push_back(pressed); }});
+
+  fsm.Start();
+  EXPECT_TRUE(fsm.IsIn<button_fsm::Idle>());
+  EXPECT_FALSE(fsm.context().button_pressed);
+
+  EXPECT_FALSE(fsm.Dispatch(ButtonRelease{}));
+  EXPECT_TRUE(fsm.Dispatch(ButtonPress{}));
+  EXPECT_TRUE(fsm.IsIn<button_fsm::Pressed>());
+  EXPECT_TRUE(fsm.context().button_pressed);
+  EXPECT_FALSE(fsm.Dispatch(ButtonPress{}));
+
+  EXPECT_TRUE(fsm.Dispatch(ButtonRelease{}));
+  EXPECT_TRUE(fsm.IsIn<button_fsm::Idle>());
+  EXPECT_FALSE(fsm.context().button_pressed);
+
+  EXPECT_EQ(pressed_changes, (std::vector<bool>{true, false}));
+}
+
+int long_presses = 0;
+
+TEST(ButtonFsmTest, LongPressMovesToHeldUntilRelease) {
+  pressed_changes.clear();
+  long_presses = 0;
+  ButtonFsm fsm(ButtonFsmContext{
+      false,
+      [](bool pressed) { pressed_changes.push_back(pressed); },
+      [] { ++long_presses; }});
+
+  fsm.Start();
+  EXPECT_FALSE(fsm.Dispatch(ButtonLongPress{}));
+
+  EXPECT_TRUE(fsm.Dispatch(ButtonPress{}));
+  EXPECT_TRUE(fsm.IsIn<button_fsm::Short>());
+  EXPECT_TRUE(fsm.Dispatch(ButtonLongPress{}));
+  EXPECT_TRUE(fsm.IsIn<button_fsm::Held>());
+  EXPECT_TRUE(fsm.IsIn<button_fsm::Pressed>());
+  EXPECT_FALSE(fsm.Dispatch(ButtonLongPress{}));
+  EXPECT_EQ(long_presses, 1);
+
+  // Release is handled by Pressed from either child.
+  EXPECT_TRUE(fsm.Dispatch(ButtonRelease{}));
+  EXPECT_TRUE(fsm.IsIn<button_fsm::Idle>());
+  EXPECT_EQ(pressed_changes, (std::vector<bool>{true, false}));
+}
+
+}  // namespace
+}  // namespace play::thread
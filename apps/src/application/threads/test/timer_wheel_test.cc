@@ -0,0 +1,352 @@
+#include "timer_wheel.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace play::thread {
+namespace {
+
+// Records the wheel tick of every expiry.
+class RecordingTimeout : public TimeoutBase {
+ public:
+  explicit RecordingTimeout(const TimerWheel<8>* wheel = nullptr)
+      : wheel_(wheel) {}
+
+  std::vector<uint32_t> fired;
+  size_t count = 0;
+
+ private:
+  void Expired() override {
+    ++count;
+    if (wheel_ != nullptr) {
+      fired.push_back(wheel_->now());
+    }
+  }
+
+  const TimerWheel<8>* wheel_;
+};
+
+void TickN(TimerWheel<8>& wheel, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i) {
+    wheel.Tick();
+  }
+}
+
+TEST(TimerWheelTest, OneShotFiresOnceAfterDelay) {
+  TimerWheel<8> wheel;
+  RecordingTimeout t(&wheel);
+
+  EXPECT_TRUE(wheel.Arm(t, 3));
+  EXPECT_TRUE(t.armed());
+  TickN(wheel, 10);
+
+  EXPECT_EQ(t.fired, (std::vector<uint32_t>{3}));
+  EXPECT_FALSE(t.armed());
+  EXPECT_EQ(wheel.armed_count(), 0u);
+}
+
+TEST(TimerWheelTest, DelayLongerThanWheelWaitsForItsLap) {
+  TimerWheel<8> wheel;
+  RecordingTimeout t(&wheel);
+
+  wheel.Arm(t, 21);
+  TickN(wheel, 30);
+  EXPECT_EQ(t.fired, (std::vector<uint32_t>{21}));
+}
+
+TEST(TimerWheelTest, PeriodicKeepsPhase) {
+  TimerWheel<8> wheel;
+  RecordingTimeout t(&wheel);
+
+  wheel.Arm(t, 2, 8);
+  TickN(wheel, 30);
+  EXPECT_EQ(t.fired, (std::vector<uint32_t>{2, 10, 18, 26}));
+  EXPECT_TRUE(t.armed());
+}
+
+TEST(TimerWheelTest, DisarmAndRearm) {
+  TimerWheel<8> wheel;
+  RecordingTimeout a(&wheel);
+  RecordingTimeout b(&wheel);
+
+  wheel.Arm(a, 4);
+  wheel.Arm(b, 4);
+  wheel.Disarm(a);
+  wheel.Disarm(a);
+  EXPECT_EQ(wheel.armed_count(), 1u);
+
+  // Re-arming an armed timeout moves it instead of adding a second entry.
+  wheel.Arm(b, 6);
+  EXPECT_EQ(wheel.armed_count(), 1u);
+  TickN(wheel, 10);
+
+  EXPECT_TRUE(a.fired.empty());
+  EXPECT_EQ(b.fired, (std::vector<uint32_t>{6}));
+}
+
+TEST(TimerWheelTest, TickReportsIdleSoSourceCanStop) {
+  TimerWheel<8> wheel;
+  RecordingTimeout t;
+
+  EXPECT_TRUE(wheel.Arm(t, 2));
+  EXPECT_FALSE(wheel.Arm(t, 2));
+  EXPECT_TRUE(wheel.Tick());
+  EXPECT_FALSE(wheel.Tick());
+  EXPECT_EQ(t.count, 1u);
+  EXPECT_TRUE(wheel.Arm(t, 1));
+}
+
+TEST(TimerWheelTest, TickCounterWraparound) {
+  TimerWheel<8> wheel(UINT32_MAX - 3);
+  RecordingTimeout t(&wheel);
+
+  wheel.Arm(t, 6);
+  TickN(wheel, 10);
+  EXPECT_EQ(t.fired, (std::vector<uint32_t>{2}));
+}
+
+// Self re-arming one-shot, as an AO handler would do from Expired().
+class RearmingTimeout : public TimeoutBase {
+ public:
+  explicit RearmingTimeout(TimerWheel<8>& wheel) : wheel_(wheel) {}
+  size_t count = 0;
+
+ private:
+  void Expired() override {
+    if (++count < 3) {
+      wheel_.Arm(*this, 1);
+    }
+  }
+
+  TimerWheel<8>& wheel_;
+};
+
+TEST(TimerWheelTest, ExpiredMayRearm) {
+  TimerWheel<8> wheel;
+  RearmingTimeout t(wheel);
+
+  wheel.Arm(t, 1);
+  TickN(wheel, 10);
+  EXPECT_EQ(t.count, 3u);
+}
+
+// A source that sleeps until next_due() and replays the gap with Advance()
+// must fire everything on the same ticks as one that calls Tick() every
+// tick.
+TEST(TimerWheelTest, AdvanceSkipsEmptyTicksExactly) {
+  TimerWheel<8> ticking;
+  TimerWheel<8> skipping;
+  RecordingTimeout a_tick(&ticking), b_tick(&ticking), c_tick(&ticking);
+  RecordingTimeout a_skip(&skipping), b_skip(&skipping), c_skip(&skipping);
+
+  ticking.Arm(a_tick, 3, 10);
+  ticking.Arm(b_tick, 7, 20);
+  ticking.Arm(c_tick, 45);
+  EXPECT_TRUE(skipping.Arm(a_skip, 3, 10));
+  EXPECT_FALSE(skipping.Arm(b_skip, 7, 20));
+  EXPECT_FALSE(skipping.Arm(c_skip, 45));
+  EXPECT_EQ(skipping.next_due(), 3u);
+
+  TickN(ticking, 100);
+
+  size_t wakeups = 0;
+  uint32_t until = skipping.next_due() - skipping.now();
+  while (skipping.now() + until <= 100) {
+    until = skipping.Advance(until);
+    ++wakeups;
+  }
+  skipping.Advance(100 - skipping.now());
+
+  EXPECT_EQ(a_skip.fired, a_tick.fired);
+  EXPECT_EQ(b_skip.fired, b_tick.fired);
+  EXPECT_EQ(c_skip.fired, c_tick.fired);
+  EXPECT_EQ(a_skip.fired, (std::vector<uint32_t>{3, 13, 23, 33, 43, 53, 63,
+                                                 73, 83, 93}));
+  // One wakeup per distinct expiry tick instead of one per tick.
+  EXPECT_EQ(wakeups, 16u);
+}
+
+TEST(TimerWheelTest, EarlierDeadlineAsksForReschedule) {
+  TimerWheel<8> wheel;
+  RecordingTimeout late(&wheel), early(&wheel), later(&wheel);
+
+  EXPECT_TRUE(wheel.Arm(late, 20));
+  EXPECT_TRUE(wheel.Arm(early, 5));
+  EXPECT_EQ(wheel.next_due(), 5u);
+  EXPECT_FALSE(wheel.Arm(later, 30));
+
+  EXPECT_EQ(wheel.Advance(5), 15u);
+  EXPECT_EQ(early.fired, (std::vector<uint32_t>{5}));
+  EXPECT_EQ(wheel.Advance(15), 10u);
+  EXPECT_EQ(wheel.Advance(10), 0u);
+  EXPECT_FALSE(wheel.ticking());
+}
+
+TEST(TimerWheelTest, ArmFromCountsFromSourceTime) {
+  TimerWheel<8> wheel;
+  RecordingTimeout idle(&wheel), busy(&wheel), other(&wheel);
+
+  // An idle wheel jumps to the source's tick.
+  EXPECT_TRUE(wheel.ArmFrom(1000, idle, 4));
+  EXPECT_EQ(wheel.now(), 1000u);
+  EXPECT_EQ(wheel.next_due(), 1004u);
+
+  // A busy wheel lags the source while it sleeps; the delay still counts
+  // from the source's tick.
+  wheel.Arm(busy, 50);
+  wheel.Advance(4);
+  EXPECT_EQ(wheel.now(), 1004u);
+  EXPECT_TRUE(wheel.ArmFrom(1030, other, 6));
+  EXPECT_EQ(wheel.next_due(), 1036u);
+  wheel.Advance(wheel.next_due() - wheel.now());
+  EXPECT_EQ(other.fired, (std::vector<uint32_t>{1036}));
+}
+
+TEST(TimerWheelTest, AdvanceToReplaysOnlyTicksNotYetTaken) {
+  TimerWheel<8> wheel;
+  RecordingTimeout gone(&wheel), fresh(&wheel);
+
+  // The source is set for tick 10, then the only timeout is disarmed and
+  // a new one armed from tick 500 on the now idle wheel.
+  wheel.Arm(gone, 10);
+  wheel.Disarm(gone);
+  wheel.ArmFrom(500, fresh, 5);
+
+  // The expiry set for tick 10 arrives late: it replays nothing, rather
+  // than ten ticks from 500 that would fire `fresh` early.
+  EXPECT_EQ(wheel.AdvanceTo(10), 5u);
+  EXPECT_EQ(wheel.now(), 500u);
+  EXPECT_TRUE(fresh.fired.empty());
+
+  EXPECT_EQ(wheel.AdvanceTo(wheel.next_due()), 0u);
+  EXPECT_EQ(fresh.fired, (std::vector<uint32_t>{505}));
+  EXPECT_TRUE(gone.fired.empty());
+}
+
+// Jitter on a simulated clock, with the wheel driven the way TimerService
+// drives it: the kernel timer is set for next_due() only, its callback runs
+// a pseudo-random 0..kMaxLatencyNs after that deadline (several ticks, as
+// the timer daemon might behind higher-priority work, and never before an
+// earlier callback), and each callback replays the wheel up to the tick it
+// was set for. Meanwhile a thread arms one-shots from the clock's current
+// tick, which runs ahead of the lagging wheel. Every timeout must fire on
+// exactly its tick, however late or bunched up the callbacks ran.
+
+constexpr uint64_t kTickNs = 10'000'000;
+constexpr uint64_t kMaxLatencyNs = 35'000'000;
+constexpr uint32_t kTicks = 20000;
+
+class JitterTimeout : public TimeoutBase {
+ public:
+  JitterTimeout(const TimerWheel<64>& wheel, const uint64_t& now_ns)
+      : wheel_(wheel), now_ns_(now_ns) {}
+
+  std::vector<uint32_t> fire_ticks;
+  uint64_t max_late_ns = 0;
+
+ private:
+  void Expired() override {
+    const uint32_t tick = wheel_.now();
+    fire_ticks.push_back(tick);
+    max_late_ns = std::max(max_late_ns, now_ns_ - tick * kTickNs);
+  }
+
+  const TimerWheel<64>& wheel_;
+  const uint64_t& now_ns_;
+};
+
+class TimerWheelJitterTest : public ::testing::Test {
+ protected:
+  uint32_t Random() {
+    lcg_ = lcg_ * 1664525u + 1013904223u;
+    return lcg_ >> 8;
+  }
+
+  // One kernel timer callback: the wheel's next deadline, delivered late.
+  void DeliverNext(TimerWheel<64>& wheel) {
+    const uint32_t due = wheel.next_due();
+    now_ns = std::max(now_ns, due * kTickNs + Random() % kMaxLatencyNs);
+    wheel.AdvanceTo(due);
+  }
+
+  uint64_t now_ns = 0;
+
+ private:
+  uint32_t lcg_ = 12345;
+};
+
+TEST_F(TimerWheelJitterTest, LateCallbacksKeepPeriodicTimeoutsOnTheirTicks) {
+  for (size_t timeouts : {1u, 50u, 500u}) {
+    TimerWheel<64> wheel;
+    now_ns = 0;
+    std::vector<std::unique_ptr<JitterTimeout>> all;
+    std::vector<uint32_t> periods;
+    for (size_t i = 0; i < timeouts; ++i) {
+      periods.push_back(1 + static_cast<uint32_t>((i * 7) % 97));
+      all.push_back(std::make_unique<JitterTimeout>(wheel, now_ns));
+      wheel.Arm(*all.back(), periods.back(), periods.back());
+    }
+
+    while (wheel.next_due() <= kTicks) {
+      DeliverNext(wheel);
+    }
+
+    for (size_t i = 0; i < timeouts; ++i) {
+      const auto& fired = all[i]->fire_ticks;
+      ASSERT_EQ(fired.size(), kTicks / periods[i]) << timeouts << "/" << i;
+      for (size_t k = 0; k < fired.size(); ++k) {
+        ASSERT_EQ(fired[k], (k + 1) * periods[i]) << timeouts << "/" << i;
+      }
+      // Lateness is the callback latency alone; it never accumulates.
+      EXPECT_LT(all[i]->max_late_ns, kMaxLatencyNs);
+    }
+  }
+}
+
+TEST_F(TimerWheelJitterTest, OneShotsArmedFromTheClockFireOnTheirTicks) {
+  constexpr size_t kShots = 16;
+  TimerWheel<64> wheel;
+  JitterTimeout heartbeat(wheel, now_ns);
+  wheel.Arm(heartbeat, 3, 3);
+
+  std::vector<std::unique_ptr<JitterTimeout>> shots;
+  std::vector<std::vector<uint32_t>> expected(kShots);
+  for (size_t i = 0; i < kShots; ++i) {
+    shots.push_back(std::make_unique<JitterTimeout>(wheel, now_ns));
+  }
+
+  size_t armed = 0;
+  while (wheel.next_due() <= kTicks) {
+    DeliverNext(wheel);
+
+    // A thread re-arms a one-shot that has fired, from the clock's tick,
+    // which runs ahead of the wheel while callbacks are late.
+    const size_t i = Random() % kShots;
+    if (!shots[i]->armed()) {
+      const uint32_t current = static_cast<uint32_t>(now_ns / kTickNs);
+      const uint32_t delay = 1 + Random() % 40;
+      wheel.ArmFrom(current, *shots[i], delay);
+      expected[i].push_back(current + delay);
+      ++armed;
+    }
+  }
+
+  EXPECT_GT(armed, 1000u);
+  for (size_t i = 0; i < kShots; ++i) {
+    // The last one may still be pending when the run stops.
+    auto& want = expected[i];
+    if (shots[i]->armed()) {
+      want.pop_back();
+    }
+    EXPECT_EQ(shots[i]->fire_ticks, want) << i;
+    EXPECT_LT(shots[i]->max_late_ns, kMaxLatencyNs) << i;
+  }
+  EXPECT_EQ(heartbeat.fire_ticks.size(), kTicks / 3);
+}
+
+}  // namespace
+}  // namespace play::thread
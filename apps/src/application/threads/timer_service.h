@@ -0,0 +1,86 @@
+#pragma once
+
+#include <pw_chrono/system_clock.h>
+#include <pw_chrono/system_timer.h>
+#include <pw_sync/mutex.h>
+
+#include <cstdint>
+#include <mutex>
+
+#include "timer_wheel.h"
+
+namespace play::thread {
+
+// Drives a TimerWheel from one pw::chrono::SystemTimer. The kernel timer
+// is only set for the next deadline in the wheel, never for empty ticks,
+// so with tickless idle the CPU wakes once per expiry rather than once per
+// tick. Wheel tick n is fixed at origin + n * tick; each wakeup replays
+// exactly the ticks up to its deadline, so timeouts keep their phase however
+// many ticks were skipped and however late the callback ran. Timeouts are
+// delivered from the SystemTimer callback context (the FreeRTOS timer daemon
+// task). Arm() and Disarm() are for thread context.
+template <size_t kSlots>
+class TimerService {
+ public:
+  using Clock = pw::chrono::SystemClock;
+
+  explicit TimerService(Clock::duration tick)
+      : tick_(tick),
+        origin_(Clock::now()),
+        timer_([this](Clock::time_point expired_deadline) {
+          OnTimer(expired_deadline);
+        }) {}
+
+  // Delays and periods are rounded up to whole ticks. Because Arm() lands
+  // part way through the current tick, the first expiry comes up to one
+  // tick early; periodic expiries after that are exact multiples of tick.
+  void Arm(TimeoutBase& t,
+           Clock::duration delay,
+           Clock::duration period = Clock::duration::zero()) {
+    if (wheel_.ArmFrom(CurrentTick(), t, ToTicks(delay), ToTicks(period))) {
+      Schedule();
+    }
+  }
+
+  void Disarm(TimeoutBase& t) { wheel_.Disarm(t); }
+
+  Clock::duration tick() const { return tick_; }
+
+ private:
+  uint32_t ToTicks(Clock::duration d) const {
+    return static_cast<uint32_t>((d + tick_ - Clock::duration(1)) / tick_);
+  }
+
+  uint32_t CurrentTick() const {
+    return static_cast<uint32_t>((Clock::now() - origin_) / tick_);
+  }
+
+  Clock::time_point TimeOf(uint32_t tick) const {
+    return origin_ + tick_ * static_cast<int64_t>(tick);
+  }
+
+  // Points the kernel timer at the wheel's next deadline. Serialised so the
+  // last caller, which saw the newest deadline, wins.
+  void Schedule() {
+    std::lock_guard lock(schedule_mutex_);
+    if (wheel_.ticking()) {
+      timer_.InvokeAt(TimeOf(wheel_.next_due()));
+    }
+  }
+
+  // The wheel works out the ticks to replay under its own lock: an Arm()
+  // on an idle wheel may have moved it on since this expiry was set.
+  void OnTimer(Clock::time_point expired_deadline) {
+    wheel_.AdvanceTo(
+        static_cast<uint32_t>((expired_deadline - origin_) / tick_));
+    Schedule();
+  }
+
+  const Clock::duration tick_;
+  const Clock::time_point origin_;
+  TimerWheel<kSlots> wheel_;
+  pw::sync::Mutex schedule_mutex_;
+  pw::chrono::SystemTimer timer_;
+};
+
+}  // namespace play::thread
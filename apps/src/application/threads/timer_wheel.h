@@ -0,0 +1,313 @@
+#pragma once
+
+#include <pw_sync/interrupt_spin_lock.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace play::thread {
+
+template <size_t kSlots>
+class TimerWheel;
+
+// Intrusive timeout node, owned by whoever arms it (typically as a member
+// of an active object) and linked into a TimerWheel while armed. Expired()
+// runs in the wheel's tick context after the wheel lock is released.
+class TimeoutBase {
+ public:
+  TimeoutBase(const TimeoutBase&) = delete;
+  TimeoutBase& operator=(const TimeoutBase&) = delete;
+
+  bool armed() const { return armed_; }
+
+ protected:
+  TimeoutBase() = default;
+  ~TimeoutBase() = default;
+
+  virtual void Expired() = 0;
+
+ private:
+  template <size_t>
+  friend class TimerWheel;
+
+  TimeoutBase* next_ = nullptr;
+  TimeoutBase* prev_ = nullptr;
+  TimeoutBase* fire_next_ = nullptr;
+  uint32_t deadline_ = 0;
+  uint32_t period_ = 0;
+  bool armed_ = false;
+};
+
+// Timeout that posts a fixed event to an active object when it expires.
+template <typename ActiveObject, typename Event>
+class TimeEvent : public TimeoutBase {
+ public:
+  TimeEvent(ActiveObject& ao, const Event& ev) : ao_(ao), ev_(ev) {}
+
+ private:
+  // A full queue is counted in the AO's Stats().dropped.
+  void Expired() override { ao_.Post(ev_); }
+
+  ActiveObject& ao_;
+  Event ev_;
+};
+
+// Hashed timing wheel: kSlots buckets indexed by deadline tick, each an
+// intrusive doubly linked list, so Arm() and Disarm() are O(1) and Tick()
+// only walks the one bucket that can be due. Any number of timeouts share
+// the single periodic source that calls Tick() (see TimerService).
+//
+// A timeout armed with delay d fires on the d-th Tick() after Arm();
+// periodic timeouts are re-armed from their deadline rather than from the
+// time they ran, so their phase never drifts. Arm()/Disarm() may be called
+// from any thread or ISR concurrently with Tick(). A timeout disarmed while
+// its tick is already delivering may still fire once.
+//
+// A tick source that should not wake for empty ticks uses Advance()
+// instead of Tick(): it sleeps until next_due() and then replays exactly
+// the ticks that elapsed, so skipped ticks cost nothing and nothing fires
+// early or late. Such a source arms with ArmFrom() so that delays count
+// from its own notion of now rather than from the last replayed tick.
+template <size_t kSlots>
+class TimerWheel {
+ public:
+  static_assert(kSlots > 0 && (kSlots & (kSlots - 1)) == 0,
+                "TimerWheel slot count must be a power of two");
+
+  explicit TimerWheel(uint32_t start_tick = 0) : now_(start_tick) {}
+
+  // (Re)arms `t` to fire after delay_ticks ticks (at least one), then every
+  // period_ticks ticks if that is non-zero. Returns true if the tick source
+  // must be (re)scheduled for next_due(): the wheel was idle, or `t` is now
+  // due before the tick the source was waiting for.
+  bool Arm(TimeoutBase& t, uint32_t delay_ticks, uint32_t period_ticks = 0) {
+    lock_.lock();
+    const bool reschedule = ArmLocked(t, now_, delay_ticks, period_ticks);
+    lock_.unlock();
+    return reschedule;
+  }
+
+  // Arm() with the delay counted from current_tick, the source's current
+  // tick, which runs ahead of now() while empty ticks are being skipped.
+  // An idle wheel jumps straight to current_tick.
+  bool ArmFrom(uint32_t current_tick,
+               TimeoutBase& t,
+               uint32_t delay_ticks,
+               uint32_t period_ticks = 0) {
+    lock_.lock();
+    if (armed_count_ == 0 && static_cast<int32_t>(current_tick - now_) > 0) {
+      now_ = current_tick;
+    }
+    const bool reschedule =
+        ArmLocked(t, current_tick, delay_ticks, period_ticks);
+    lock_.unlock();
+    return reschedule;
+  }
+
+  void Disarm(TimeoutBase& t) {
+    lock_.lock();
+    if (t.armed_) {
+      Unlink(t);
+      t.armed_ = false;
+      --armed_count_;
+    }
+    lock_.unlock();
+  }
+
+  // Advances the wheel by one tick and runs every timeout that is due.
+  // Returns false once nothing is armed, so the tick source may stop until
+  // the next Arm() reports true.
+  bool Tick() {
+    TimeoutBase* fire = nullptr;
+
+    lock_.lock();
+    StepLocked(fire);
+    const bool keep_ticking = armed_count_ > 0;
+    ticking_ = keep_ticking;
+    next_due_ = now_ + 1;
+    lock_.unlock();
+
+    Fire(fire);
+    return keep_ticking;
+  }
+
+  // Replays `ticks` ticks, running due timeouts tick by tick exactly as
+  // that many Tick() calls would. Returns the number of ticks until the
+  // next deadline, or 0 once nothing is armed.
+  uint32_t Advance(uint32_t ticks) {
+    for (uint32_t i = 0; i < ticks; ++i) {
+      TimeoutBase* fire = nullptr;
+      lock_.lock();
+      StepLocked(fire);
+      lock_.unlock();
+      Fire(fire);
+    }
+    return Reschedule();
+  }
+
+  // Advance() up to and including `tick`, the source's tick. The distance
+  // is taken from now() under the lock at every step, so ticks an
+  // ArmFrom() skipped on an idle wheel meanwhile are not replayed; a tick
+  // at or behind now() replays nothing.
+  uint32_t AdvanceTo(uint32_t tick) {
+    for (;;) {
+      TimeoutBase* fire = nullptr;
+      lock_.lock();
+      if (static_cast<int32_t>(tick - now_) <= 0) {
+        lock_.unlock();
+        break;
+      }
+      StepLocked(fire);
+      lock_.unlock();
+      Fire(fire);
+    }
+    return Reschedule();
+  }
+
+  // The tick the source is scheduled to deliver next; meaningful while
+  // ticking().
+  uint32_t next_due() const {
+    lock_.lock();
+    const uint32_t due = next_due_;
+    lock_.unlock();
+    return due;
+  }
+
+  bool ticking() const {
+    lock_.lock();
+    const bool ticking = ticking_;
+    lock_.unlock();
+    return ticking;
+  }
+
+  uint32_t now() const {
+    lock_.lock();
+    const uint32_t now = now_;
+    lock_.unlock();
+    return now;
+  }
+
+  size_t armed_count() const { return armed_count_; }
+
+ private:
+  static constexpr size_t kMask = kSlots - 1;
+
+  bool ArmLocked(TimeoutBase& t,
+                 uint32_t from,
+                 uint32_t delay_ticks,
+                 uint32_t period_ticks) {
+    if (t.armed_) {
+      Unlink(t);
+    } else {
+      ++armed_count_;
+    }
+    t.period_ = period_ticks;
+    t.deadline_ = from + (delay_ticks == 0 ? 1 : delay_ticks);
+    t.armed_ = true;
+    Link(t);
+    const bool reschedule =
+        !ticking_ || static_cast<int32_t>(t.deadline_ - next_due_) < 0;
+    if (reschedule) {
+      next_due_ = t.deadline_;
+    }
+    ticking_ = true;
+    return reschedule;
+  }
+
+  // Returns the ticks until the earliest deadline, 0 once nothing is armed,
+  // and points next_due() at it.
+  uint32_t Reschedule() {
+    lock_.lock();
+    uint32_t until = 0;
+    if (armed_count_ > 0) {
+      until = UntilEarliestLocked();
+      next_due_ = now_ + until;
+    }
+    ticking_ = until != 0;
+    lock_.unlock();
+    return until;
+  }
+
+  // Moves to the next tick and collects the timeouts due on it into `fire`.
+  void StepLocked(TimeoutBase*& fire) {
+    TimeoutBase** fire_tail = &fire;
+    ++now_;
+    TimeoutBase* t = slots_[now_ & kMask];
+    while (t != nullptr) {
+      TimeoutBase* next = t->next_;
+      // Later laps of the wheel share this bucket.
+      if (static_cast<int32_t>(t->deadline_ - now_) <= 0) {
+        Unlink(*t);
+        if (t->period_ != 0) {
+          t->deadline_ += t->period_;
+          Link(*t);
+        } else {
+          t->armed_ = false;
+          --armed_count_;
+        }
+        t->fire_next_ = nullptr;
+        *fire_tail = t;
+        fire_tail = &t->fire_next_;
+      }
+      t = next;
+    }
+  }
+
+  // Runs collected timeouts outside the lock; Expired() may re-arm.
+  static void Fire(TimeoutBase* fire) {
+    while (fire != nullptr) {
+      TimeoutBase* next = fire->fire_next_;
+      fire->Expired();
+      fire = next;
+    }
+  }
+
+  // Ticks from now_ to the earliest deadline (at least 1). O(slots + armed),
+  // paid once per wakeup rather than once per tick.
+  uint32_t UntilEarliestLocked() const {
+    uint32_t until = UINT32_MAX;
+    for (const TimeoutBase* head : slots_) {
+      for (const TimeoutBase* t = head; t != nullptr; t = t->next_) {
+        const int32_t d = static_cast<int32_t>(t->deadline_ - now_);
+        const uint32_t ticks = d <= 0 ? 1 : static_cast<uint32_t>(d);
+        if (ticks < until) {
+          until = ticks;
+        }
+      }
+    }
+    return until;
+  }
+
+  void Link(TimeoutBase& t) {
+    TimeoutBase*& head = slots_[t.deadline_ & kMask];
+    t.prev_ = nullptr;
+    t.next_ = head;
+    if (head != nullptr) {
+      head->prev_ = &t;
+    }
+    head = &t;
+  }
+
+  void Unlink(TimeoutBase& t) {
+    if (t.prev_ != nullptr) {
+      t.prev_->next_ = t.next_;
+    } else {
+      slots_[t.deadline_ & kMask] = t.next_;
+    }
+    if (t.next_ != nullptr) {
+      t.next_->prev_ = t.prev_;
+    }
+    t.next_ = nullptr;
+    t.prev_ = nullptr;
+  }
+
+  std::array<TimeoutBase*, kSlots> slots_{};
+  uint32_t now_;
+  uint32_t next_due_ = 0;
+  size_t armed_count_ = 0;
+  bool ticking_ = false;
+  mutable pw::sync::InterruptSpinLock lock_;
+};
+
+}  // namespace play::thread
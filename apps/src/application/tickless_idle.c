@@ -0,0 +1,395 @@
+/*Tickless idle on LPTIM1 with STOP2 for the application*/
+#include "tickless_idle.h"
+
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stm32l4xx_hal.h"
+
+#if configUSE_TICKLESS_IDLE != 2
+#error "tickless_idle.c replaces the port's tick; set configUSE_TICKLESS_IDLE 2"
+#endif
+_Static_assert(configTICK_RATE_HZ == 1000,
+	       "tick boundaries below assume a 1 kHz tick");
+
+#define LSE_HZ 32768U
+#define LSI_HZ 32000U
+/*bounded wait for the crystal; LSE start-up is typically ~250 ms*/
+#define LSE_START_POLLS 4000000U
+/*
+ * 125 ticks is a whole number of counts for both clocks (4096 and 4000),
+ * so tick positions are renormalised every block and never accumulate
+ * rounding.
+ */
+#define BLOCK_TICKS 125U
+/*a CMP write lands two LPTIM clocks after CMPOK; keep clear of that*/
+#define MIN_LEAD 4U
+#define LPTIM_IRQ_PRIORITY 15U
+
+/*in port.c; FreeRTOSConfig.h maps it to SysTick_Handler*/
+void xPortSysTickHandler(void);
+
+static struct {
+	uint32_t hz;
+	uint16_t base;          /*LPTIM count of tick 0 of the current block*/
+	uint32_t next;          /*next tick to announce, within the block*/
+	bool cmp_writing;       /*CMP write in flight, CMPOK not seen yet*/
+	struct {
+		bool (*busy)(void *arg);
+		void *arg;
+	} veto[TICKLESS_MAX_VETOES];
+	unsigned int nveto;
+	struct {
+		uint32_t (*limit)(void *arg);
+		void (*resume)(void *arg, uint32_t us);
+		void *arg;
+	} clock[TICKLESS_MAX_STOP_CLOCKS];
+	unsigned int nclock;
+	void (*hook)(const struct tickless_wake *w);
+	struct tickless_stats stats;
+} lp;
+
+static uint16_t lptim_read(void)
+{
+	uint16_t a, b;
+
+	/*CNT is asynchronous to the bus; two equal reads are valid*/
+	do {
+		a = (uint16_t)LPTIM1->CNT;
+		b = (uint16_t)LPTIM1->CNT;
+	} while (a != b);
+	return a;
+}
+
+/*LPTIM count of tick j of the current block, modulo 2^16*/
+static uint16_t boundary(uint32_t j)
+{
+	return (uint16_t)(lp.base + (j * lp.hz) / configTICK_RATE_HZ);
+}
+
+/*
+ * Announce up to max tick boundaries at or before now and return how many.
+ * now must be less than one counter wrap past the block base, which the
+ * idle clamp guarantees.
+ */
+static uint32_t ticks_passed(uint16_t now, uint32_t max)
+{
+	uint32_t pos = (uint16_t)(now - lp.base);
+	/*latest tick j with j * hz / 1000 <= pos*/
+	uint32_t last = ((pos + 1U) * configTICK_RATE_HZ - 1U) / lp.hz;
+	uint32_t n;
+
+	if (last < lp.next)
+		return 0;
+	n = last - lp.next + 1U;
+	if (n > max)
+		n = max;
+	lp.next += n;
+	/*base stays at or before the last announced tick*/
+	while (lp.next > BLOCK_TICKS) {
+		lp.base += (uint16_t)(lp.hz / (configTICK_RATE_HZ / BLOCK_TICKS));
+		lp.next -= BLOCK_TICKS;
+	}
+	return n;
+}
+
+static void cmp_write(uint16_t at)
+{
+	/*a second write before CMPOK would be lost*/
+	if (lp.cmp_writing)
+		while (!(LPTIM1->ISR & LPTIM_ISR_CMPOK))
+			;
+	LPTIM1->ICR = LPTIM_ICR_CMPOKCF;
+	LPTIM1->CMP = at;
+	lp.cmp_writing = true;
+}
+
+/*arm the compare for the next tick, or pend the handler if it is too close*/
+static void program_next(void)
+{
+	uint16_t at = boundary(lp.next);
+	uint16_t lead = (uint16_t)(at - lptim_read());
+
+	if (lead < MIN_LEAD || lead >= 0x8000U)
+		NVIC_SetPendingIRQ(LPTIM1_IRQn);
+	else
+		cmp_write(at);
+}
+
+static uint32_t lptim_clock_start(void)
+{
+	uint32_t polls = LSE_START_POLLS;
+
+	__HAL_RCC_PWR_CLK_ENABLE();
+	PWR->CR1 |= PWR_CR1_DBP;
+	RCC->BDCR |= RCC_BDCR_LSEON;
+	while (!(RCC->BDCR & RCC_BDCR_LSERDY) && --polls != 0U)
+		;
+	if (RCC->BDCR & RCC_BDCR_LSERDY) {
+		MODIFY_REG(RCC->CCIPR, RCC_CCIPR_LPTIM1SEL, RCC_CCIPR_LPTIM1SEL);
+		return LSE_HZ;
+	}
+
+	RCC->BDCR &= ~RCC_BDCR_LSEON;
+	RCC->CSR |= RCC_CSR_LSION;
+	while (!(RCC->CSR & RCC_CSR_LSIRDY))
+		;
+	MODIFY_REG(RCC->CCIPR, RCC_CCIPR_LPTIM1SEL, RCC_CCIPR_LPTIM1SEL_0);
+	return LSI_HZ;
+}
+
+/*overrides the port's weak SysTick setup, from vTaskStartScheduler()*/
+void vPortSetupTimerInterrupt(void)
+{
+	uint16_t now;
+
+	/*HAL_Init() started SysTick; only LPTIM1 may tick the kernel*/
+	SysTick->CTRL = 0;
+
+	lp.hz = lptim_clock_start();
+	lp.stats.lptim_hz = lp.hz;
+
+	__HAL_RCC_LPTIM1_CLK_ENABLE();
+	LPTIM1->CR = 0;
+	LPTIM1->CFGR = 0;               /*internal clock, no prescaler*/
+	LPTIM1->IER = LPTIM_IER_CMPMIE; /*IER is writable only while disabled*/
+	LPTIM1->CR = LPTIM_CR_ENABLE;
+	LPTIM1->ARR = 0xFFFFU;
+	while (!(LPTIM1->ISR & LPTIM_ISR_ARROK))
+		;
+	LPTIM1->ICR = LPTIM_ICR_ARROKCF;
+	LPTIM1->CR = LPTIM_CR_ENABLE | LPTIM_CR_CNTSTRT;
+
+	/*EXTI line 32 lets the compare wake the core from STOP2*/
+	EXTI->IMR2 |= EXTI_IMR2_IM32;
+	HAL_NVIC_SetPriority(LPTIM1_IRQn, LPTIM_IRQ_PRIORITY, 0);
+	NVIC_EnableIRQ(LPTIM1_IRQn);
+
+	/*the counter may sit at 0 until the first clock edge is synchronised*/
+	now = lptim_read();
+	lp.base = now;
+	lp.next = 1;
+	lp.cmp_writing = false;
+	program_next();
+}
+
+void LPTIM1_IRQHandler(void)
+{
+	uint32_t n;
+
+	LPTIM1->ICR = LPTIM_ICR_CMPMCF;
+	n = ticks_passed(lptim_read(), UINT32_MAX);
+	while (n-- != 0U)
+		xPortSysTickHandler();
+	program_next();
+}
+
+static bool stop_vetoed(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < lp.nveto; i++)
+		if (lp.veto[i].busy(lp.veto[i].arg))
+			return true;
+	return false;
+}
+
+/*LPTIM counts until the nearest stop clock deadline, or UINT32_MAX*/
+static uint32_t stop_clock_limit(void)
+{
+	uint32_t counts = UINT32_MAX;
+	unsigned int i;
+
+	for (i = 0; i < lp.nclock; i++) {
+		uint32_t us = lp.clock[i].limit(lp.clock[i].arg);
+		uint32_t c;
+
+		if (us == UINT32_MAX)
+			continue;
+		/*round down so the wake is never after the deadline*/
+		c = (uint32_t)(((uint64_t)us * lp.hz) / 1000000U);
+		if (c < counts)
+			counts = c;
+	}
+	return counts;
+}
+
+/*
+ * Step deadlines fall just short of a tick boundary, where program_next()
+ * would pend on the tick until it passes. Wake early enough to arm it.
+ */
+static uint32_t clear_of_tick(uint16_t now, uint32_t limit)
+{
+	uint32_t pos, j, gap;
+
+	if (limit == UINT32_MAX)
+		return limit;
+	pos = (uint16_t)(now - lp.base) + limit;
+	/*first tick boundary at or after the wake*/
+	j = (pos * configTICK_RATE_HZ + lp.hz - 1U) / lp.hz;
+	gap = (j * lp.hz) / configTICK_RATE_HZ - pos;
+	if (gap >= 2U * MIN_LEAD)
+		return limit;
+	return limit > 2U * MIN_LEAD - gap ? limit - (2U * MIN_LEAD - gap) : 0;
+}
+
+static void stop_clock_resume(uint16_t stopped_counts)
+{
+	uint32_t us = (uint32_t)(((uint64_t)stopped_counts * 1000000U +
+				  lp.hz / 2U) / lp.hz);
+	unsigned int i;
+
+	for (i = 0; i < lp.nclock; i++)
+		lp.clock[i].resume(lp.clock[i].arg, us);
+}
+
+/*STOP2 wakes on MSI (4 MHz, the PLL's input); relock and switch back*/
+static void clock_restore(void)
+{
+	RCC->CR |= RCC_CR_PLLON;
+	while (!(RCC->CR & RCC_CR_PLLRDY))
+		;
+	MODIFY_REG(RCC->CFGR, RCC_CFGR_SW, RCC_CFGR_SW_PLL);
+	while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL)
+		;
+}
+
+static void account(const struct tickless_wake *w)
+{
+	struct tickless_stats *s = &lp.stats;
+
+	s->sleeps++;
+	s->slept_ticks += w->slept_ticks;
+	if (w->stop)
+		s->stops++;
+	if (w->timer_wake && w->late_counts > s->max_late_counts)
+		s->max_late_counts = w->late_counts;
+	if (w->restore_cycles > s->max_restore_cycles)
+		s->max_restore_cycles = w->restore_cycles;
+	if (lp.hook != NULL)
+		lp.hook(w);
+}
+
+/*portSUPPRESS_TICKS_AND_SLEEP, from the idle task with the scheduler held*/
+void vPortSuppressTicksAndSleep(TickType_t expected)
+{
+	struct tickless_wake w = {0};
+	uint16_t target, now, lead, t_stop;
+	uint32_t t0, limit;
+
+	if (expected > TICKLESS_MAX_IDLE_TICKS)
+		expected = TICKLESS_MAX_IDLE_TICKS;
+
+	/*masked interrupts still end WFI; they run once we unmask below*/
+	__disable_irq();
+	__DSB();
+	__ISB();
+	if (eTaskConfirmSleepModeStatus() == eAbortSleep ||
+	    NVIC_GetPendingIRQ(LPTIM1_IRQn)) {
+		__enable_irq();
+		return;
+	}
+
+	/*wake on the tick the kernel is waiting for, not the ones before it*/
+	target = boundary(lp.next + expected - 1U);
+	now = lptim_read();
+	lead = (uint16_t)(target - now);
+	if (lead < MIN_LEAD || lead >= 0x8000U) {
+		__enable_irq();
+		return;
+	}
+
+	w.expected_ticks = expected;
+	w.stop = expected >= TICKLESS_STOP_MIN_TICKS;
+	if (w.stop && stop_vetoed()) {
+		w.stop = false;
+		lp.stats.vetoed++;
+	}
+	if (w.stop) {
+		/*
+		 * A stop clock deadline before the tick ends the sleep there;
+		 * closer than the STOP2 minimum, plain sleep is cheaper.
+		 */
+		limit = clear_of_tick(now, stop_clock_limit());
+		if (limit < lead) {
+			if (limit < TICKLESS_STOP_MIN_TICKS * lp.hz /
+					    configTICK_RATE_HZ) {
+				w.stop = false;
+				lp.stats.clipped++;
+			} else {
+				target = (uint16_t)(now + limit);
+			}
+		}
+	}
+	cmp_write(target);
+
+	if (w.stop) {
+		t_stop = lptim_read();
+		HAL_PWREx_EnterSTOP2Mode(PWR_STOPENTRY_WFI);
+		t0 = DWT->CYCCNT;
+		clock_restore();
+		w.restore_cycles = DWT->CYCCNT - t0;
+		stop_clock_resume((uint16_t)(lptim_read() - t_stop));
+	} else {
+		__DSB();
+		__WFI();
+		__ISB();
+	}
+
+	now = lptim_read();
+	w.late_counts = (uint16_t)(now - target);
+	w.timer_wake = w.late_counts < 0x8000U;
+	if (!w.timer_wake)
+		w.late_counts = 0;
+
+	/*
+	 * Step by what actually passed, at most what the kernel allowed; any
+	 * later boundary is announced by the tick handler as usual.
+	 */
+	w.slept_ticks = ticks_passed(now, expected);
+	vTaskStepTick(w.slept_ticks);
+	/*the sleep compare is spent; program_next() pends again if needed*/
+	LPTIM1->ICR = LPTIM_ICR_CMPMCF;
+	NVIC_ClearPendingIRQ(LPTIM1_IRQn);
+	program_next();
+	account(&w);
+	__enable_irq();
+}
+
+int tickless_add_stop_veto(bool (*busy)(void *arg), void *arg)
+{
+	if (busy == NULL || lp.nveto >= TICKLESS_MAX_VETOES)
+		return -1;
+	lp.veto[lp.nveto].busy = busy;
+	lp.veto[lp.nveto].arg = arg;
+	lp.nveto++;
+	return 0;
+}
+
+int tickless_add_stop_clock(uint32_t (*limit)(void *arg),
+			    void (*resume)(void *arg, uint32_t us), void *arg)
+{
+	if (limit == NULL || resume == NULL ||
+	    lp.nclock >= TICKLESS_MAX_STOP_CLOCKS)
+		return -1;
+	lp.clock[lp.nclock].limit = limit;
+	lp.clock[lp.nclock].resume = resume;
+	lp.clock[lp.nclock].arg = arg;
+	lp.nclock++;
+	return 0;
+}
+
+void tickless_set_wake_hook(void (*hook)(const struct tickless_wake *w))
+{
+	lp.hook = hook;
+}
+
+void tickless_get_stats(struct tickless_stats *out)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	*out = lp.stats;
+	__set_PRIMASK(primask);
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Tickless idle for FreeRTOS (configUSE_TICKLESS_IDLE 2) on LPTIM1.
+ *
+ * The kernel tick comes from LPTIM1 on the 32.768 kHz LSE (LSI if the
+ * crystal does not start) instead of SysTick. Tick n is due at the LPTIM
+ * count of n ms, rounded down, so ticks never drift from the low-power
+ * clock. When every task is blocked the idle task programs the compare for
+ * the next kernel deadline and sleeps: STOP2 if nothing vetoes it, plain
+ * WFI otherwise. On wake the kernel is stepped by exactly the ticks that
+ * passed.
+ */
+
+/*longest single sleep; LPTIM1 is 16 bits and wraps every 2 s*/
+#define TICKLESS_MAX_IDLE_TICKS 1500U
+/*below this a STOP2 entry and PLL relock cost more than they save*/
+#define TICKLESS_STOP_MIN_TICKS 3U
+#define TICKLESS_MAX_VETOES 8
+#define TICKLESS_MAX_STOP_CLOCKS 4
+
+/*
+ * busy(arg) returning true keeps the next sleep out of STOP2, e.g. while a
+ * peripheral clocked from the PLL domain is still running. It is called
+ * from the idle task with interrupts masked. Returns 0, or -1 if busy is
+ * NULL or the table is full.
+ */
+int tickless_add_stop_veto(bool (*busy)(void *arg), void *arg);
+
+/*
+ * A stop clock is a deadline timed from the main clock, which halts in
+ * STOP2. limit(arg) returns the microseconds left until that deadline
+ * (UINT32_MAX for none, 0 to keep this sleep out of STOP2). A STOP2 sleep
+ * then ends at the deadline at the latest, and resume(arg, us) is told
+ * how long the clocks were stopped so the timer can catch up. Both are
+ * called from the idle task with interrupts masked. Returns 0, or -1 if
+ * either is NULL or the table is full.
+ */
+int tickless_add_stop_clock(uint32_t (*limit)(void *arg),
+			    void (*resume)(void *arg, uint32_t us), void *arg);
+
+struct tickless_wake {
+	uint32_t expected_ticks;  /*what the kernel allowed*/
+	uint32_t slept_ticks;     /*what it was stepped by*/
+	uint32_t late_counts;     /*LPTIM counts past the deadline; timer wakes*/
+	uint32_t restore_cycles;  /*CPU cycles to relock the PLL after STOP2*/
+	bool stop;                /*STOP2 rather than sleep*/
+	bool timer_wake;          /*the deadline, not another interrupt, woke us*/
+};
+
+/*
+ * hook(w) runs after every sleep, before interrupts are unmasked, so it
+ * sees the wake before any handler does; keep it short. NULL removes it.
+ */
+void tickless_set_wake_hook(void (*hook)(const struct tickless_wake *w));
+
+struct tickless_stats {
+	uint32_t lptim_hz;
+	uint32_t sleeps;
+	uint32_t stops;
+	uint32_t vetoed;          /*sleeps kept out of STOP2 by a veto*/
+	uint32_t clipped;         /*kept out of STOP2 by a stop clock*/
+	uint32_t slept_ticks;
+	uint32_t max_late_counts;
+	uint32_t max_restore_cycles;
+};
+
+void tickless_get_stats(struct tickless_stats *out);
+
+#ifdef __cplusplus
+}
+#endif
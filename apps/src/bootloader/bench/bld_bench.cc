@@ -0,0 +1,394 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bld_config.h"
+#include "bld_engine.h"
+#include "test_stubs.h"
+
+// Host microbenchmarks for the bootloader hot paths.
+//
+// Results are written as JSON (bld_bench.json in the workspace when run via
+// `bazel run`, otherwise in the current directory) unless --benchmark_out is
+// given explicitly, so runs can be diffed and tracked over time.
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+// CRC32
+////////////////////////////////////////////////////////////////////////////////
+
+void BM_Crc32Ieee(benchmark::State& state) {
+  std::vector<uint8_t> data(static_cast<size_t>(state.range(0)));
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 31u);
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        bld_crc32_ieee(data.data(), data.size(), BLD_CRC32_INITIAL));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          state.range(0));
+}
+BENCHMARK(BM_Crc32Ieee)->Arg(16)->Arg(128)->Arg(1024)->Arg(4096)->Arg(65536);
+
+////////////////////////////////////////////////////////////////////////////////
+// UART DMA frame parser
+////////////////////////////////////////////////////////////////////////////////
+
+int NopRxStart(void*, uint8_t*, uint16_t) { return 0; }
+int NopTxBlocking(void*, uint8_t*, uint16_t, uint32_t) { return 0; }
+void NopDisableIt(void*) {}
+uint32_t ZeroNowMs(void*) { return 0u; }
+
+const bld_uart_dma_ll_ops kUartOps = {
+    .rx_start = NopRxStart,
+    .tx_blocking = NopTxBlocking,
+    .disable_dma_it = NopDisableIt,
+    .now_ms = ZeroNowMs,
+};
+
+enum class RingFill : int {
+  // One frame at the read index.
+  kAligned = 0,
+  // One frame preceded by bytes that must be resynchronised past.
+  kGarbagePrefix = 1,
+  // One frame straddling the end of the ring buffer.
+  kWrapped = 2,
+};
+
+constexpr uint32_t kGarbagePrefixLen = 64u;
+
+void FillRing(bld_uart_dma_ctx& ctx,
+              uint32_t start,
+              const std::vector<uint8_t>& bytes) {
+  ctx.r = start;
+  ctx.w = start;
+  for (uint8_t b : bytes) {
+    ctx.ring[ctx.w % BLD_UART_RING_SIZE] = b;
+    ctx.w++;
+  }
+}
+
+void BM_UartDmaParseFrame(benchmark::State& state) {
+  const auto fill = static_cast<RingFill>(state.range(0));
+  const auto chunk_len = static_cast<uint16_t>(state.range(1));
+
+  std::vector<uint8_t> payload(chunk_len, 0x5Au);
+  const auto frame = test::MakeDataFrame(0u, payload.data(), chunk_len);
+
+  std::vector<uint8_t> ring_bytes;
+  uint32_t start = 0u;
+  if (fill == RingFill::kGarbagePrefix) {
+    ring_bytes.assign(kGarbagePrefixLen, 0x00u);
+  } else if (fill == RingFill::kWrapped) {
+    start = BLD_UART_RING_SIZE - static_cast<uint32_t>(frame.size() / 2u);
+  }
+  ring_bytes.insert(ring_bytes.end(), frame.begin(), frame.end());
+
+  static bld_uart_dma_ctx ctx;
+  std::memset(&ctx, 0, sizeof(ctx));
+  ctx.ops = &kUartOps;
+  const bld_transport transport = bld_transport_uart_dma_make(&ctx);
+  uint8_t out[1024];
+
+  for (auto _ : state) {
+    FillRing(ctx, start, ring_bytes);
+    const int len = transport.parse(out, sizeof(out), 0u, transport.ctx);
+    if (len != static_cast<int>(frame.size())) {
+      state.SkipWithError("parser did not return the frame");
+      break;
+    }
+    benchmark::DoNotOptimize(out);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(ring_bytes.size()));
+}
+BENCHMARK(BM_UartDmaParseFrame)
+    ->ArgNames({"fill", "chunk"})
+    ->ArgsProduct({{static_cast<int>(RingFill::kAligned),
+                    static_cast<int>(RingFill::kGarbagePrefix),
+                    static_cast<int>(RingFill::kWrapped)},
+                   {128, 512}});
+
+////////////////////////////////////////////////////////////////////////////////
+// Engine DATA frame handling
+////////////////////////////////////////////////////////////////////////////////
+
+void BM_EnginePollDataFrame(benchmark::State& state) {
+  const auto chunk_len = static_cast<uint16_t>(state.range(0));
+
+  test::FakeStorageCtx slot_a_ctx;
+  test::FakeStorageCtx slot_b_ctx;
+  test::FakeStorageCtx meta_ctx;
+  test::FakeTransportCtx transport_ctx;
+  slot_a_ctx.bytes.resize(BLD_SLOT_A_SIZE, 0xFF);
+  slot_b_ctx.bytes.resize(BLD_SLOT_B_SIZE, 0xFF);
+  meta_ctx.bytes.resize(128u, 0xFF);
+
+  const bld_storage slots[BLD_SLOT_COUNT] = {
+      test::MakeFakeStorage(&slot_a_ctx), test::MakeFakeStorage(&slot_b_ctx)};
+  const bld_storage meta = test::MakeFakeStorage(&meta_ctx);
+  const bld_transport transport = test::MakeFakeTransport(&transport_ctx);
+
+  bld_engine engine{};
+  if (bld_engine_init(&engine, &transport, slots, &meta) != 0) {
+    state.SkipWithError("engine init failed");
+    return;
+  }
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_START);
+  bld_engine_poll(&engine, 0u);
+  transport_ctx.next_frame =
+      test::MakeHeaderFrame(BLD_SLOT_A_SIZE, 0x12345678u, 1u);
+  bld_engine_poll(&engine, 0u);
+  if (engine.state != BLD_STATE_RECV_DATA) {
+    state.SkipWithError("engine did not enter RECV_DATA");
+    return;
+  }
+
+  std::vector<uint8_t> payload(chunk_len, 0xA5u);
+  transport_ctx.next_frame = test::MakeDataFrame(0u, payload.data(), chunk_len);
+
+  for (auto _ : state) {
+    // Rewind the session so the same seq 0 frame is accepted every time.
+    engine.session.expected_seq = 0u;
+    engine.session.received_size = 0u;
+    bld_engine_poll(&engine, 0u);
+  }
+
+  if (engine.state != BLD_STATE_RECV_DATA) {
+    state.SkipWithError("engine left RECV_DATA");
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          chunk_len);
+}
+BENCHMARK(BM_EnginePollDataFrame)->Arg(64)->Arg(128)->Arg(256)->Arg(512)->Arg(
+    1008);
+
+// END on a full-slot image under each verify mode. The slot is received
+// once; every iteration restores the session and replays END.
+void BM_EngineEndVerify(benchmark::State& state) {
+  const auto mode = static_cast<bld_verify_mode>(state.range(0));
+  constexpr uint16_t kChunk = 1000u;
+
+  test::FakeStorageCtx slot_a_ctx;
+  test::FakeStorageCtx slot_b_ctx;
+  test::FakeStorageCtx meta_ctx;
+  test::FakeTransportCtx transport_ctx;
+  slot_a_ctx.bytes.resize(BLD_SLOT_A_SIZE, 0xFF);
+  slot_b_ctx.bytes.resize(BLD_SLOT_B_SIZE, 0xFF);
+  meta_ctx.bytes.resize(128u, 0xFF);
+
+  const bld_storage slots[BLD_SLOT_COUNT] = {
+      test::MakeFakeStorage(&slot_a_ctx), test::MakeFakeStorage(&slot_b_ctx)};
+  const bld_storage meta = test::MakeFakeStorage(&meta_ctx);
+  const bld_transport transport = test::MakeFakeTransport(&transport_ctx);
+
+  bld_engine engine{};
+  if (bld_engine_init(&engine, &transport, slots, &meta) != 0 ||
+      bld_engine_set_verify_mode(&engine, mode) != 0) {
+    state.SkipWithError("engine init failed");
+    return;
+  }
+
+  std::vector<uint8_t> image(BLD_SLOT_A_SIZE);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<uint8_t>(i * 31u);
+  }
+  const uint32_t crc =
+      bld_crc32_ieee(image.data(), image.size(), BLD_CRC32_INITIAL);
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_START);
+  bld_engine_poll(&engine, 0u);
+  transport_ctx.next_frame =
+      test::MakeHeaderFrame(static_cast<uint32_t>(image.size()), crc, 1u);
+  bld_engine_poll(&engine, 0u);
+  uint32_t seq = 0u;
+  for (size_t off = 0; off < image.size(); off += kChunk) {
+    const auto n = static_cast<uint16_t>(
+        image.size() - off < kChunk ? image.size() - off : kChunk);
+    transport_ctx.next_frame =
+        test::MakeDataFrame(seq++, image.data() + off, n);
+    bld_engine_poll(&engine, 0u);
+  }
+  if (engine.state != BLD_STATE_WAIT_END) {
+    state.SkipWithError("engine did not reach WAIT_END");
+    return;
+  }
+
+  const bld_session session = engine.session;
+  const bld_slot_id slot = engine.target_slot;
+  const std::vector<uint8_t> end = test::MakeCmdFrame(BLD_CMD_END);
+  for (auto _ : state) {
+    engine.session = session;
+    engine.target_slot = slot;
+    engine.state = BLD_STATE_WAIT_END;
+    transport_ctx.next_frame = end;
+    bld_engine_poll(&engine, 0u);
+  }
+
+  if (engine.state != BLD_STATE_IDLE) {
+    state.SkipWithError("END was rejected");
+  }
+}
+BENCHMARK(BM_EngineEndVerify)
+    ->ArgName("mode")
+    ->Arg(BLD_VERIFY_NONE)
+    ->Arg(BLD_VERIFY_RUNNING)
+    ->Arg(BLD_VERIFY_SAMPLED)
+    ->Arg(BLD_VERIFY_FULL);
+
+////////////////////////////////////////////////////////////////////////////////
+// STM32L4 flash storage backend
+////////////////////////////////////////////////////////////////////////////////
+
+int NopFlashUnlock(void*) { return 0; }
+int NopFlashLock(void*) { return 0; }
+int NopFlashRead(void*, uint32_t, uint8_t*, uint32_t) { return 0; }
+int NopFlashErasePages(void*, uint32_t, uint32_t, uint32_t) { return 0; }
+int NopFlashProgramDoubleword(void*, uint32_t, uint64_t data) {
+  benchmark::DoNotOptimize(data);
+  return 0;
+}
+
+const bld_flash_ops kFlashOps = {
+    .unlock = NopFlashUnlock,
+    .lock = NopFlashLock,
+    .read = NopFlashRead,
+    .erase_pages = NopFlashErasePages,
+    .program_doubleword = NopFlashProgramDoubleword,
+};
+
+void BM_Stm32l4Write(benchmark::State& state) {
+  const auto len = static_cast<uint32_t>(state.range(0));
+
+  const bld_storage_flash_ctx ctx = {
+      .region_base = BLD_SLOT_A_BASE,
+      .region_size = BLD_SLOT_A_SIZE,
+      .page_size = BLD_FLASH_PAGE_SIZE,
+      .flash_base = BLD_FLASH_BASE,
+      .flash_bank_size = BLD_FLASH_BANK_SIZE,
+      .flash_page_size = BLD_FLASH_PAGE_SIZE,
+      .flash_bank1 = 1u,
+      .flash_bank2 = 2u,
+      .ops = &kFlashOps,
+      .hw = nullptr,
+  };
+  bld_storage storage{};
+  if (bld_storage_flash_init(&storage, &ctx) != 0) {
+    state.SkipWithError("storage init failed");
+    return;
+  }
+
+  std::vector<uint8_t> data(len, 0x3Cu);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(storage.write(&storage, 0u, data.data(), len));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * len);
+}
+BENCHMARK(BM_Stm32l4Write)->Arg(8)->Arg(128)->Arg(1024);
+
+////////////////////////////////////////////////////////////////////////////////
+// Boot-control metadata
+////////////////////////////////////////////////////////////////////////////////
+
+bld_boot_control MakeBootCtrl() {
+  bld_boot_control ctrl{};
+  ctrl.active_slot = BLD_SLOT_ID_A;
+  ctrl.confirmed_slot = BLD_SLOT_ID_A;
+  ctrl.pending_slot = BLD_SLOT_ID_NONE;
+  ctrl.slots[BLD_SLOT_ID_A].version = 1u;
+  ctrl.slots[BLD_SLOT_ID_A].size = 4096u;
+  ctrl.slots[BLD_SLOT_ID_A].crc32 = 0xDEADBEEFu;
+  ctrl.slots[BLD_SLOT_ID_A].state = BLD_SLOT_STATE_CONFIRMED;
+  ctrl.slots[BLD_SLOT_ID_B].state = BLD_SLOT_STATE_EMPTY;
+  return ctrl;
+}
+
+void BM_MetaRead(benchmark::State& state) {
+  test::FakeStorageCtx ctx;
+  ctx.bytes.resize(128u, 0xFF);
+  const bld_storage storage = test::MakeFakeStorage(&ctx);
+  const bld_boot_control ctrl = MakeBootCtrl();
+  (void)bld_meta_write_boot_control(&storage, &ctrl);
+
+  bld_boot_control out{};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(bld_meta_read_boot_control(&storage, &out));
+  }
+}
+BENCHMARK(BM_MetaRead);
+
+void BM_MetaWrite(benchmark::State& state) {
+  test::FakeStorageCtx ctx;
+  ctx.bytes.resize(128u, 0xFF);
+  const bld_storage storage = test::MakeFakeStorage(&ctx);
+  const bld_boot_control ctrl = MakeBootCtrl();
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(bld_meta_write_boot_control(&storage, &ctrl));
+  }
+}
+BENCHMARK(BM_MetaWrite);
+
+// One full update cycle: install as pending, count a boot, confirm.
+void BM_MetaUpdateCycle(benchmark::State& state) {
+  test::FakeStorageCtx ctx;
+  ctx.bytes.resize(128u, 0xFF);
+  const bld_storage storage = test::MakeFakeStorage(&ctx);
+  const bld_boot_control ctrl = MakeBootCtrl();
+  (void)bld_meta_write_boot_control(&storage, &ctrl);
+
+  uint8_t attempts_left = 0u;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(bld_meta_set_pending(
+        &storage, BLD_SLOT_ID_B, 2u, 4096u, 0xCAFEF00Du, 3u));
+    benchmark::DoNotOptimize(
+        bld_meta_decrement_pending_attempts(&storage, &attempts_left));
+    benchmark::DoNotOptimize(bld_meta_confirm_slot(&storage));
+  }
+}
+BENCHMARK(BM_MetaUpdateCycle);
+
+bool HasFlag(int argc, char** argv, const char* prefix) {
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], prefix, std::strlen(prefix)) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<char*> args(argv, argv + argc);
+
+  std::string out_flag;
+  std::string format_flag = "--benchmark_out_format=json";
+  if (!HasFlag(argc, argv, "--benchmark_out=")) {
+    const char* workspace = std::getenv("BUILD_WORKSPACE_DIRECTORY");
+    out_flag = std::string("--benchmark_out=") +
+               ((workspace != nullptr) ? std::string(workspace) + "/" : "") +
+               "bld_bench.json";
+    args.push_back(out_flag.data());
+    if (!HasFlag(argc, argv, "--benchmark_out_format=")) {
+      args.push_back(format_flag.data());
+    }
+  }
+
+  int bench_argc = static_cast<int>(args.size());
+  benchmark::Initialize(&bench_argc, args.data());
+  if (benchmark::ReportUnrecognizedArguments(bench_argc, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
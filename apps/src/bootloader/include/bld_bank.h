@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Flash bank selection for the dual-bank boot mode.
+ *
+ * Slot A sits in bank 0 and slot B at the same offset in bank 1. Instead of
+ * jumping to a slot in the other bank, the bootloader selects that bank for
+ * the next reset (BFB2 on the STM32L4); the banks then swap places in the
+ * memory map and the bootloader copy in that bank starts the image at the
+ * same address slot A's image runs at. Neither slot needs its own link
+ * address, and an image is never relocated or copied on install.
+ *
+ * Banks are numbered like slots: 0 holds slot A, 1 holds slot B.
+ *
+ * active - returns the bank the CPU started from, or a negative value.
+ * select - makes the next reset start from bank. On hardware this resets
+ *          and does not return on success. Returns a negative value if the
+ *          bank cannot be selected.
+ * ctx    - backend-specific context owned by the caller.
+ */
+struct bld_bank_ops {
+	int (*active)(const struct bld_bank_ops *self);
+	int (*select)(const struct bld_bank_ops *self, uint8_t bank);
+	const void *ctx;
+};
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,12 +1,20 @@
 #pragma once
 #include <stdint.h>
 
+#include "bld_bank.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void bld_jump_to_image(uint32_t image_base);
 
+/*
+ * Bank selection through the BFB2 option bit, for the dual-bank boot mode.
+ * Selecting a bank reloads the option bytes, which resets the device.
+ */
+struct bld_bank_ops bld_boot_bank_ops(void);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
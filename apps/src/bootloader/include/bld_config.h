@@ -15,8 +15,19 @@ extern "C" {
  *
  * The default layout is:
  *   flash base -> bootloader -> metadata -> app slot_A -> app slot_B
+ *
+ * With BLD_BOOT_BANK_SWAP set, slot B moves to slot A's offset in bank 2
+ * and the bootloader is programmed into the start of both banks:
+ *   bank 1: bootloader -> metadata -> app slot_A
+ *   bank 2: bootloader -> (unused) -> app slot_B
+ * The bootloader then starts slot B by swapping the banks (bld_bank.h), so
+ * both slots run at BLD_SLOT_A_BASE. The metadata stays in bank 1.
  */
 
+#ifndef BLD_BOOT_BANK_SWAP
+#define BLD_BOOT_BANK_SWAP 0
+#endif
+
 #define BLD_FLASH_BASE 0x08000000u
 
 #define BLD_BOOTLOADER_SIZE (128u * KB_TO_BYTES)
@@ -29,9 +40,94 @@ extern "C" {
 #define BLD_SLOT_A_BASE (BLD_META_BASE + BLD_META_SIZE)
 #define BLD_SLOT_A_SIZE (376u * KB_TO_BYTES)
 
+#if BLD_BOOT_BANK_SWAP
+#define BLD_SLOT_B_BASE (BLD_SLOT_A_BASE + BLD_FLASH_BANK_SIZE)
+#else
 #define BLD_SLOT_B_BASE (BLD_FLASH_BASE + BLD_FLASH_BANK_SIZE)
+#endif
 #define BLD_SLOT_B_SIZE (376u * KB_TO_BYTES)
 
+/*
+ * Firmware slots
+ *
+ * BLD_SLOT_COUNT slots are described by BLD_SLOT_BASES and BLD_SLOT_SIZES,
+ * both initialisers with one entry per slot, indexed by enum bld_slot_id.
+ * A part with more flash defines all three (for example through the build's
+ * defines) to keep more fallback images.
+ *
+ * BLD_SLOT_FACTORY names a recovery slot that is programmed in production,
+ * together with a metadata record marking it confirmed, and that updates
+ * never overwrite. It is booted when no other image is left. 0xFF means
+ * there is none.
+ */
+#ifndef BLD_SLOT_COUNT
+#define BLD_SLOT_COUNT 2u
+#define BLD_SLOT_BASES { BLD_SLOT_A_BASE, BLD_SLOT_B_BASE }
+#define BLD_SLOT_SIZES { BLD_SLOT_A_SIZE, BLD_SLOT_B_SIZE }
+#endif
+
+#ifndef BLD_SLOT_FACTORY
+#define BLD_SLOT_FACTORY 0xFFu
+#endif
+
+#if BLD_SLOT_COUNT < 2u || BLD_SLOT_COUNT > 16u
+#error "BLD_SLOT_COUNT must be 2..16"
+#endif
+
+#if BLD_BOOT_BANK_SWAP && BLD_SLOT_COUNT != 2u
+#error "the dual-bank boot mode has one slot per bank"
+#endif
+
+/*
+ * RAM an image's initial stack pointer may point into (SRAM1 and SRAM2).
+ */
+#define BLD_SRAM1_BASE 0x20000000u
+#define BLD_SRAM1_SIZE (96u * KB_TO_BYTES)
+#define BLD_SRAM2_BASE 0x10000000u
+#define BLD_SRAM2_SIZE (32u * KB_TO_BYTES)
+
+/*
+ * Read-back verification at END (enum bld_verify_mode). Sampled mode reads
+ * back at most BLD_VERIFY_SAMPLE_PAGES flash pages spread over the image,
+ * always including the first (vector table) and the last.
+ */
+#define BLD_VERIFY_MODE_DEFAULT BLD_VERIFY_SAMPLED
+#define BLD_VERIFY_SAMPLE_PAGES 16u
+
+/*
+ * Largest relocation table a relocatable image may carry (bld_reloc.h). The
+ * table is held in RAM until the image behind it has been programmed.
+ */
+#define BLD_RELOC_TABLE_MAX (4u * KB_TO_BYTES)
+
+/*
+ * External staging flash (the B-L475E-IOT01A's 8 MiB MX25R6435F on QUADSPI)
+ *
+ * With BLD_STAGING_QSPI set, an update is received into the staging region
+ * and copied into its slot, BLD_STAGING_COPY_CHUNK bytes at a time, only
+ * once END has verified it. Every slot keeps its image through the slow
+ * transfer; an aborted or failed download leaves internal flash untouched.
+ */
+#ifndef BLD_STAGING_QSPI
+#define BLD_STAGING_QSPI 0
+#endif
+
+#define BLD_QSPI_FLASH_SIZE (8u * 1024u * KB_TO_BYTES)
+#define BLD_QSPI_SECTOR_SIZE (4u * KB_TO_BYTES)
+#define BLD_QSPI_BLOCK_SIZE (64u * KB_TO_BYTES)
+#define BLD_QSPI_PAGE_SIZE 256u
+
+#define BLD_STAGING_BASE 0u
+#define BLD_STAGING_SIZE (512u * KB_TO_BYTES)
+#define BLD_STAGING_COPY_CHUNK BLD_FLASH_PAGE_SIZE
+
+/*
+ * Largest program unit a write-combining storage (bld_storage_wc.h) buffers:
+ * one STM32L4 fast-programming row of 32 doublewords. Slot writes are
+ * combined into whole rows, whatever the DATA chunk size.
+ */
+#define BLD_WRITE_COMBINE_SIZE 256u
+
 /*
  * Maximum number of boot attempts before the image is considered invalid.
  */
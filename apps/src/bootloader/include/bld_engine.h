@@ -1,7 +1,10 @@
 #pragma once
 #include <stdint.h>
 
+#include "bld_bank.h"
+#include "bld_config.h"
 #include "bld_meta.h"
+#include "bld_reloc.h"
 #include "bld_storage.h"
 #include "bld_transport.h"
 
@@ -22,10 +25,29 @@ enum bld_state {
 	BLD_STATE_ERROR = 4,
 };
 
+/*
+ * How END checks the image before marking it pending.
+ *
+ * The engine keeps a CRC of the payload as it hands it to storage, so it
+ * knows whether it received the image the header describes without reading
+ * flash back. The read-back modes also catch writes that did not land as
+ * sent; a pending image is verified in full before its trial boot anyway.
+ */
+enum bld_verify_mode {
+	BLD_VERIFY_NONE = 0,    /* accept the image unchecked */
+	BLD_VERIFY_RUNNING = 1, /* running payload CRC against the header */
+	BLD_VERIFY_SAMPLED = 2, /* RUNNING, then read back sampled pages */
+	BLD_VERIFY_FULL = 3,    /* RUNNING, then read back the whole image */
+};
+
 /*
  * Runtime transfer session state.
  *
  * This state exists only while a firmware transfer is in progress.
+ *
+ * image_size and image_crc32 describe the bytes sent, as in the HEADER
+ * frame. The write_* fields describe what lands in the slot: the same bytes
+ * for a raw image, the relocated image for a relocatable one.
  */
 struct bld_session {
 	uint32_t expected_seq;
@@ -33,6 +55,17 @@ struct bld_session {
 	uint32_t image_size;
 	uint32_t image_crc32;
 	uint32_t image_version;
+	uint32_t running_crc32;
+	uint32_t write_size;
+	uint32_t write_crc32;
+	/* pages between sampled pages; the last page is sampled as well */
+	uint32_t sample_stride;
+	uint32_t sample_crc32[BLD_VERIFY_SAMPLE_PAGES];
+	/* relocatable image: header and table bytes, 0 for a raw image */
+	uint32_t prefix_size;
+	struct bld_reloc_header reloc_header;
+	struct bld_reloc reloc;
+	uint8_t reloc_table[BLD_RELOC_TABLE_MAX];
 };
 
 /*
@@ -40,29 +73,68 @@ struct bld_session {
  *
  * The engine owns the protocol state machine and uses the transport,
  * firmware-slot storage, and metadata storage provided by the caller.
+ * bank holds no functions unless the dual-bank boot mode is in use, and
+ * staging none unless updates are staged; copy_buf carries a staged image
+ * into its slot.
  */
 struct bld_engine {
 	enum bld_state state;
 	struct bld_transport transport;
-	struct bld_storage slot_storage[2];
+	struct bld_storage slot_storage[BLD_SLOT_COUNT];
 	struct bld_storage meta_storage;
+	struct bld_bank_ops bank;
+	struct bld_storage staging;
+	uint32_t staging_size;
 	struct bld_boot_control boot_ctrl;
 	enum bld_slot_id target_slot;
+	enum bld_verify_mode verify_mode;
 	struct bld_session session;
+	uint8_t copy_buf[BLD_STAGING_COPY_CHUNK];
 };
 
 /*
  * Initializes the bootloader engine.
  *
- * The transport, slot storage, and metadata storage objects are copied into
+ * slot_storage holds BLD_SLOT_COUNT storage objects, indexed by slot. The
+ * transport, slot storage, and metadata storage objects are copied into
  * the engine. The current image metadata is loaded from persistent storage.
+ * Slot storage that buffers writes (bld_storage_wc.h) is synced before END
+ * verifies the image.
  */
 int bld_engine_init(struct bld_engine *engine,
 		    const struct bld_transport *transport,
-		    const struct bld_storage *slot_a_storage,
-		    const struct bld_storage *slot_b_storage,
+		    const struct bld_storage *slot_storage,
 		    const struct bld_storage *meta_storage);
 
+/*
+ * Selects how END verifies the written image (BLD_VERIFY_MODE_DEFAULT after
+ * init). Returns 0, or a negative value for an unknown mode.
+ */
+int bld_engine_set_verify_mode(struct bld_engine *engine,
+			       enum bld_verify_mode mode);
+
+/*
+ * Selects the dual-bank boot mode (bld_bank.h): images run at
+ * BLD_SLOT_A_BASE whichever slot holds them, and a slot in the other bank is
+ * started by selecting that bank. ops is copied into the engine; NULL goes
+ * back to jumping to each slot's own address. Returns 0, or a negative value
+ * if ops lacks a function.
+ */
+int bld_engine_set_bank_ops(struct bld_engine *engine,
+			    const struct bld_bank_ops *ops);
+
+/*
+ * Receives updates into staging (for example external flash, see
+ * bld_storage_qspi.h) instead of straight into the target slot. END verifies
+ * the staged image, copies it into the slot and only then marks it pending,
+ * so the slot keeps its old image until the transfer is complete. Images are
+ * limited to size bytes as well as to the slot size. staging is copied into
+ * the engine; NULL goes back to writing the slot directly. Returns 0, or a
+ * negative value if staging lacks a function or size is 0.
+ */
+int bld_engine_set_staging(struct bld_engine *engine,
+			   const struct bld_storage *staging, uint32_t size);
+
 /*
  * Processes one incoming transport frame.
  *
@@ -74,11 +146,42 @@ void bld_engine_poll(struct bld_engine *engine, uint32_t frame_timeout_ms);
 /*
  * Validates the stored image and jumps to it.
  *
- * Returns 0 on success. On a successful jump this function does not return.
- * Returns a negative value if no bootable image is available.
+ * A pending image gets its trial boot. Otherwise the confirmed image is
+ * booted; each one that fails verification is marked bad and the next
+ * fallback tried, down to the factory slot.
+ *
+ * In the dual-bank boot mode an image in the other bank is verified and that
+ * bank selected instead; the bootloader there counts the trial boot attempt
+ * after the reset. If the bank cannot be selected, the confirmed image is
+ * booted and a pending one is left pending.
+ *
+ * Returns 0 on success. On a successful jump or bank switch this function
+ * does not return. Returns a negative value if no bootable image is
+ * available.
  */
 int bld_engine_boot_decide_and_jump(struct bld_engine *engine);
 
+/*
+ * Early-boot fast path; needs no transport, clock or peripheral setup.
+ *
+ * Reads the boot control record and, when no trial boot is pending and the
+ * confirmed slot holds a plausible vector table (initial stack in SRAM,
+ * Thumb reset handler inside the slot), stores that slot's base address in
+ * image_base. The confirmed image was CRC-verified before its trial boot and
+ * then confirmed by the application, so it is not verified again here.
+ *
+ * slot_storage is indexed by slot, as for bld_engine_init(). bank is NULL
+ * unless the dual-bank boot mode is in use. In that mode only a confirmed
+ * slot in the running bank is taken, and image_base is BLD_SLOT_A_BASE.
+ *
+ * Returns 0 if the image can be jumped to directly. Returns a negative value
+ * if the full decision in bld_engine_boot_decide_and_jump() is needed.
+ */
+int bld_engine_fast_boot_slot(const struct bld_storage *meta_storage,
+			      const struct bld_storage *slot_storage,
+			      const struct bld_bank_ops *bank,
+			      uint32_t *image_base);
+
 #ifdef __cplusplus
 }
 #endif
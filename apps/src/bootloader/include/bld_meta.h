@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 
+#include "bld_config.h"
 #include "bld_storage.h"
 
 #ifdef __cplusplus
@@ -9,6 +10,9 @@ extern "C" {
 
 #define BLD_META_MAGIC (0xB00710ADu)
 
+/*
+ * Slots are numbered 0 .. BLD_SLOT_COUNT - 1; A and B name the first two.
+ */
 enum bld_slot_id {
 	BLD_SLOT_ID_A = 0,
 	BLD_SLOT_ID_B = 1,
@@ -49,7 +53,7 @@ struct bld_boot_control {
 	uint8_t confirmed_slot;
 	uint8_t pending_slot;
 	uint8_t reserved0;
-	struct bld_slot_info slots[2];
+	struct bld_slot_info slots[BLD_SLOT_COUNT];
 };
 
 int bld_meta_init(const struct bld_storage *meta_storage);
@@ -60,12 +64,39 @@ int bld_meta_read_boot_control(const struct bld_storage *meta_storage,
 int bld_meta_write_boot_control(const struct bld_storage *meta_storage,
 				const struct bld_boot_control *ctrl);
 
+/*
+ * Slot a new image should be written to. Never the factory slot; an empty
+ * slot first, then a bad one, a pending one not yet booted, then the valid
+ * fallback with the lowest version. The active or confirmed slot is only
+ * taken when nothing else is left. Returns BLD_SLOT_ID_NONE if no slot can
+ * take an image.
+ */
+enum bld_slot_id
+bld_meta_choose_target_slot(const struct bld_boot_control *ctrl);
+
+/*
+ * Slot to fall back to when exclude can no longer be booted: the valid or
+ * confirmed slot (or pending one, with accept_pending) with the highest
+ * version, the factory slot only if there is no other. Returns
+ * BLD_SLOT_ID_NONE if there is none.
+ */
+enum bld_slot_id
+bld_meta_choose_fallback_slot(const struct bld_boot_control *ctrl,
+			      enum bld_slot_id exclude, int accept_pending);
+
+/*
+ * Marks slot pending with the image described. Fails for the factory slot.
+ */
 int bld_meta_set_pending(const struct bld_storage *meta_storage,
 			 enum bld_slot_id slot, uint32_t version, uint32_t size,
 			 uint32_t crc32, uint8_t attempts);
 
 int bld_meta_confirm_slot(const struct bld_storage *meta_storage);
 
+/*
+ * Marks slot bad. If it was the active or confirmed slot, the one
+ * bld_meta_choose_fallback_slot() picks takes its place.
+ */
 int bld_meta_mark_slot_bad(const struct bld_storage *meta_storage,
 			   enum bld_slot_id slot);
 
@@ -157,18 +157,27 @@ struct __attribute__((packed)) bld_status_frame {
 /*
  * Metadata frame
  *
- * Transfers full boot-control metadata for A/B slot management.
+ * Transfers the boot-control metadata of every slot, so the host can inspect
+ * the slots and see which one START will write.
  *
- * This allows the host to inspect both slots and decide which image/linker
- * layout should be transmitted.
+ * Frame layout on wire:
+ *
+ *   bld_meta_frame + slots[slot_count] + crc32 + eof
+ *
+ * LEN is 8 + slot_count * sizeof(struct bld_meta_slot_wire). load_base is the
+ * address an image in that slot runs at, which a relocatable image is
+ * rebased to on install.
  */
+#define BLD_META_SLOT_FACTORY 0x0001u /* recovery slot, never written */
+
 struct __attribute__((packed)) bld_meta_slot_wire {
 	uint32_t version;
 	uint32_t size;
 	uint32_t crc32;
 	uint8_t state;
 	uint8_t boot_attempts_left;
-	uint16_t reserved;
+	uint16_t flags;
+	uint32_t load_base;
 };
 
 struct __attribute__((packed)) bld_meta_frame {
@@ -179,13 +188,11 @@ struct __attribute__((packed)) bld_meta_frame {
 	uint8_t active_slot;
 	uint8_t confirmed_slot;
 	uint8_t pending_slot;
-	uint8_t reserved0;
-
-	struct bld_meta_slot_wire slot_a;
-	struct bld_meta_slot_wire slot_b;
+	uint8_t slot_count;
+	uint8_t target_slot; /* slot START would pick */
+	uint8_t reserved[3];
 
-	uint32_t crc32;
-	uint8_t eof;
+	struct bld_meta_slot_wire slots[];
 };
 
 #ifdef __cplusplus
@@ -0,0 +1,97 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Relocatable application image
+ *
+ * The application is linked once, for slot A, and shipped as one artifact
+ * that installs into either slot:
+ *
+ *   bld_reloc_header | relocation table | image
+ *
+ * The image is the flat binary as linked at link_base. The table lists the
+ * 32-bit words in the image that hold absolute addresses inside the image
+ * (vector table, literal pools, function pointers, initialised data). While
+ * the image is programmed into a slot based at load_base, each of those
+ * words is rebased by load_base - link_base; every other byte is written
+ * unchanged.
+ *
+ * The table is a ULEB128 stream of word-index gaps: the first value is the
+ * index of the first relocated word, each next value the distance to the
+ * following one, so the list is strictly ascending. The table is padded with
+ * zero bytes so that the image starts BLD_RELOC_ALIGN bytes aligned within
+ * the artifact, which keeps flash programming aligned.
+ *
+ * The magic can never start a raw image, whose first word is an initial
+ * stack pointer in SRAM, so raw images keep working unchanged.
+ */
+
+#define BLD_RELOC_MAGIC (0x52444C42u) /* "BLDR" */
+#define BLD_RELOC_ALIGN 8u
+
+struct __attribute__((packed)) bld_reloc_header {
+	uint32_t magic;
+	uint32_t link_base;   /* address the image was linked for */
+	uint32_t image_size;  /* bytes of image after the table */
+	uint32_t image_crc32; /* CRC of the image as linked */
+	uint32_t table_size;  /* bytes of table, padding included */
+	uint32_t count;       /* relocated words */
+};
+
+/*
+ * Streaming relocator.
+ *
+ * Applies a table to an image handed over in consecutive pieces of any size;
+ * a relocated word may straddle two pieces. The table must stay valid until
+ * the last piece has been relocated.
+ */
+struct bld_reloc {
+	const uint8_t *table;
+	uint32_t table_size;
+	uint32_t table_pos;
+	uint32_t delta;
+	uint32_t remaining; /* relocations not yet started */
+	uint32_t next;      /* image offset of the current relocated word */
+	uint32_t offset;    /* image offset of the next byte expected */
+	uint32_t carry;     /* carry into the current word's next byte */
+	uint8_t active;     /* next is a word still to be relocated */
+};
+
+/*
+ * Checks that hdr describes an artifact of artifact_size bytes whose image
+ * fits in max_image_size bytes and whose table fits in max_table_size bytes.
+ * Returns 0 if it does, or a negative value.
+ */
+int bld_reloc_check_header(const struct bld_reloc_header *hdr,
+			   uint32_t artifact_size, uint32_t max_image_size,
+			   uint32_t max_table_size);
+
+/*
+ * Prepares reloc to rebase the image described by hdr to load_base using
+ * table. Returns 0, or a negative value if the table is malformed.
+ */
+int bld_reloc_begin(struct bld_reloc *reloc,
+		    const struct bld_reloc_header *hdr, const uint8_t *table,
+		    uint32_t load_base);
+
+/*
+ * Relocates len image bytes in place. offset is the image offset of data[0]
+ * and must follow on from the previous call. Returns 0, or a negative value
+ * if the pieces are out of order or the table is malformed.
+ */
+int bld_reloc_apply(struct bld_reloc *reloc, uint32_t offset, uint8_t *data,
+		    uint32_t len);
+
+/*
+ * Returns 0 if every relocation in the table has been applied to an image of
+ * image_size bytes, or a negative value.
+ */
+int bld_reloc_finish(const struct bld_reloc *reloc, uint32_t image_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -13,7 +13,9 @@ extern "C" {
  * instance. Backends translate offsets to backend-specific physical addresses.
  *
  * All functions return 0 on success and a negative value on failure.
- * ctx - Backend-specific context owned by the caller.
+ * sync - Writes out anything the backend holds back (bld_storage_wc.h);
+ *        NULL if every write goes straight to the medium.
+ * ctx  - Backend-specific context owned by the caller.
  */
 struct bld_storage {
 	int (*erase)(const struct bld_storage *self, uint32_t offset,
@@ -22,6 +24,7 @@ struct bld_storage {
 		     const uint8_t *data, uint32_t len);
 	int (*read)(const struct bld_storage *self, uint32_t offset,
 		    uint8_t *out, uint32_t len);
+	int (*sync)(const struct bld_storage *self);
 	const void *ctx;
 };
 
@@ -41,6 +41,14 @@ struct bld_storage_flash_ctx {
 int bld_storage_flash_init(struct bld_storage *storage,
 			   const struct bld_storage_flash_ctx *ctx);
 
+/*
+ * Moves ctx, written for the default memory map, to the map with the two
+ * banks swapped (FB_MODE): the region appears in the other half of flash and
+ * the physical bank numbers trade places. Returns 0, or a negative value if
+ * the region spans both banks or the flash has only one.
+ */
+int bld_storage_flash_swap_banks(struct bld_storage_flash_ctx *ctx);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "bld_storage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * QSPI NOR flash operations. Addresses are byte addresses in the external
+ * flash. Every operation waits for the device to finish.
+ *
+ * read         - reads len bytes.
+ * erase_sector - erases the sector_size sector at addr.
+ * erase_block  - erases the block_size block at addr; NULL if the backend
+ *                only erases sectors.
+ * program_page - programs len bytes at addr, all within one page.
+ */
+struct bld_qspi_ops {
+	int (*read)(void *hw, uint32_t addr, uint8_t *out, uint32_t len);
+	int (*erase_sector)(void *hw, uint32_t addr);
+	int (*erase_block)(void *hw, uint32_t addr);
+	int (*program_page)(void *hw, uint32_t addr, const uint8_t *data,
+			    uint32_t len);
+};
+
+/*
+ * External QSPI NOR flash storage context.
+ *
+ * Each context describes one partition of the external flash. NOR programs
+ * any byte range, so writes need no alignment; they are split at page
+ * boundaries. Erases start on a sector and are rounded up to whole sectors,
+ * using block erases where a whole block is covered. block_size is 0 when
+ * ops has no erase_block.
+ */
+struct bld_storage_qspi_ctx {
+	uint32_t region_base;
+	uint32_t region_size;
+	uint32_t sector_size;
+	uint32_t block_size;
+	uint32_t page_size;
+	const struct bld_qspi_ops *ops;
+	void *hw;
+};
+
+int bld_storage_qspi_init(struct bld_storage *storage,
+			  const struct bld_storage_qspi_ctx *ctx);
+
+#ifdef __cplusplus
+}
+#endif
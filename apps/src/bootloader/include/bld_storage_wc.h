@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "bld_config.h"
+#include "bld_storage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Write-combining storage context.
+ *
+ * Wraps another storage whose writes must start on a program unit (a
+ * doubleword or a row) and cover whole units. Writes of any offset and
+ * length are gathered in buf and handed on one aligned unit at a time;
+ * runs of whole units in the middle of a write go straight through. The
+ * unit in buf is written out when it fills up, when a write does not
+ * continue where the last one stopped, and on sync. Bytes of a unit that
+ * were never written are sent as 0xFF, the erased value.
+ *
+ * Reads see buffered bytes. An erase drops buffered bytes it covers.
+ */
+struct bld_storage_wc_ctx {
+	struct bld_storage inner;
+	uint32_t unit;
+	uint32_t base;  /* offset of the unit in buf */
+	uint32_t start; /* first buffered byte in the unit */
+	uint32_t end;   /* one past the last; 0 when empty */
+	uint8_t buf[BLD_WRITE_COMBINE_SIZE];
+};
+
+/*
+ * Sets up storage to write through ctx into inner, which is copied. unit is
+ * inner's program granularity, a power of two up to BLD_WRITE_COMBINE_SIZE.
+ * Returns 0, or a negative value for a bad unit or incomplete inner.
+ */
+int bld_storage_wc_init(struct bld_storage *storage,
+			struct bld_storage_wc_ctx *ctx,
+			const struct bld_storage *inner, uint32_t unit);
+
+#ifdef __cplusplus
+}
+#endif
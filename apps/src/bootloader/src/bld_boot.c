@@ -1,5 +1,8 @@
 #include "bld_boot.h"
 #include "stm32l4xx.h"
+#include "stm32l4xx_hal.h"
+
+#include <string.h>
 
 #define BLD_MSP_POSITION 0u
 #define BLD_RESET_HANDLER_POSITION 4u
@@ -38,3 +41,63 @@ void bld_jump_to_image(uint32_t image_base)
 	while (1) {
 	}
 }
+
+/*
+ * The boot ROM maps the bank it started from at the flash base and reports
+ * which through FB_MODE; it picks bank 2 while BFB2 is set and bank 2 holds
+ * a valid vector table.
+ */
+static int bld_boot_bank_active(const struct bld_bank_ops *self)
+{
+	(void)self;
+	__HAL_RCC_SYSCFG_CLK_ENABLE();
+	return (READ_BIT(SYSCFG->MEMRMP, SYSCFG_MEMRMP_FB_MODE) != 0u) ? 1 : 0;
+}
+
+static int bld_boot_bank_select(const struct bld_bank_ops *self, uint8_t bank)
+{
+	FLASH_OBProgramInitTypeDef ob;
+	uint32_t bfb2;
+
+	(void)self;
+	if (bank > 1u) {
+		return -1;
+	}
+
+	/*
+	 * BFB2 already asks for this bank, yet the ROM started the other one:
+	 * the bank has no bootloader, and reloading would only loop.
+	 */
+	bfb2 = (bank == 1u) ? OB_BFB2_ENABLE : OB_BFB2_DISABLE;
+	if (READ_BIT(FLASH->OPTR, FLASH_OPTR_BFB2) == bfb2) {
+		return -1;
+	}
+
+	memset(&ob, 0, sizeof(ob));
+	ob.OptionType = OPTIONBYTE_USER;
+	ob.USERType = OB_USER_BFB2;
+	ob.USERConfig = bfb2;
+
+	if (HAL_FLASH_Unlock() != HAL_OK) {
+		return -1;
+	}
+	if (HAL_FLASH_OB_Unlock() == HAL_OK &&
+	    HAL_FLASHEx_OBProgram(&ob) == HAL_OK) {
+		/* resets with the new option bytes */
+		(void)HAL_FLASH_OB_Launch();
+	}
+
+	(void)HAL_FLASH_OB_Lock();
+	(void)HAL_FLASH_Lock();
+	return -1;
+}
+
+struct bld_bank_ops bld_boot_bank_ops(void)
+{
+	struct bld_bank_ops ops;
+
+	ops.active = bld_boot_bank_active;
+	ops.select = bld_boot_bank_select;
+	ops.ctx = NULL;
+	return ops;
+}
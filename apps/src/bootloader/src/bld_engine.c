@@ -4,6 +4,7 @@
 #include "bld_config.h"
 #include "bld_crc32.h"
 #include "bld_protocol.h"
+#include "bld_reloc.h"
 
 #include <string.h>
 
@@ -14,7 +15,7 @@
 #define BLD_CRC32_FIELD_SIZE 4u
 #define BLD_EOF_FIELD_SIZE 1u
 #define BLD_STATUS_PAYLOAD_SIZE 8u
-#define BLD_META_PAYLOAD_SIZE 36u
+#define BLD_META_HEAD_PAYLOAD_SIZE 8u
 #define BLD_MAX_FRAME_SIZE 1024u
 
 enum {
@@ -22,6 +23,9 @@ enum {
 		4u + BLD_CRC32_FIELD_SIZE + BLD_EOF_FIELD_SIZE,
 };
 
+static const uint32_t bld_engine_slot_bases[BLD_SLOT_COUNT] = BLD_SLOT_BASES;
+static const uint32_t bld_engine_slot_sizes[BLD_SLOT_COUNT] = BLD_SLOT_SIZES;
+
 static void bld_engine_reset_session(struct bld_engine *engine)
 {
 	if (engine == NULL) {
@@ -58,9 +62,8 @@ static uint32_t bld_engine_frame_crc32(const uint8_t *frame,
 
 static int bld_engine_slot_id_valid(enum bld_slot_id slot)
 {
-	return (slot == BLD_SLOT_ID_A || slot == BLD_SLOT_ID_B) ?
-		       BLD_ENGINE_OK :
-		       BLD_ENGINE_ERR;
+	return ((uint32_t)slot < BLD_SLOT_COUNT) ? BLD_ENGINE_OK :
+						   BLD_ENGINE_ERR;
 }
 
 static struct bld_storage *bld_engine_slot_storage(struct bld_engine *engine,
@@ -75,12 +78,33 @@ static struct bld_storage *bld_engine_slot_storage(struct bld_engine *engine,
 
 static uint32_t bld_engine_slot_base(enum bld_slot_id slot)
 {
-	return (slot == BLD_SLOT_ID_A) ? BLD_SLOT_A_BASE : BLD_SLOT_B_BASE;
+	return bld_engine_slot_bases[(uint8_t)slot];
+}
+
+static int bld_engine_bank_mode(const struct bld_bank_ops *bank)
+{
+	return bank != NULL && bank->active != NULL && bank->select != NULL;
+}
+
+/* Address an image in slot executes at. */
+static uint32_t bld_engine_run_base(const struct bld_bank_ops *bank,
+				    enum bld_slot_id slot)
+{
+	return bld_engine_bank_mode(bank) ? BLD_SLOT_A_BASE :
+					    bld_engine_slot_base(slot);
+}
+
+/* Whether slot can be jumped to without switching banks first. */
+static int bld_engine_slot_in_running_bank(const struct bld_bank_ops *bank,
+					   enum bld_slot_id slot)
+{
+	return !bld_engine_bank_mode(bank) ||
+	       bank->active(bank) == (int)slot;
 }
 
 static uint32_t bld_engine_slot_size(enum bld_slot_id slot)
 {
-	return (slot == BLD_SLOT_ID_A) ? BLD_SLOT_A_SIZE : BLD_SLOT_B_SIZE;
+	return bld_engine_slot_sizes[(uint8_t)slot];
 }
 
 static int bld_engine_slot_is_bootable(const struct bld_boot_control *ctrl,
@@ -98,32 +122,6 @@ static int bld_engine_slot_is_bootable(const struct bld_boot_control *ctrl,
 		state == (uint8_t)BLD_SLOT_STATE_PENDING);
 }
 
-static enum bld_slot_id
-bld_engine_choose_target_slot(const struct bld_boot_control *ctrl)
-{
-	if (ctrl == NULL) {
-		return BLD_SLOT_ID_A;
-	}
-
-	if (ctrl->active_slot == (uint8_t)BLD_SLOT_ID_A) {
-		return BLD_SLOT_ID_B;
-	}
-
-	if (ctrl->active_slot == (uint8_t)BLD_SLOT_ID_B) {
-		return BLD_SLOT_ID_A;
-	}
-
-	if (ctrl->confirmed_slot == (uint8_t)BLD_SLOT_ID_A) {
-		return BLD_SLOT_ID_B;
-	}
-
-	if (ctrl->confirmed_slot == (uint8_t)BLD_SLOT_ID_B) {
-		return BLD_SLOT_ID_A;
-	}
-
-	return BLD_SLOT_ID_A;
-}
-
 static int bld_engine_send_status(struct bld_engine *engine,
 				  enum bld_status status, uint32_t detail)
 {
@@ -155,8 +153,14 @@ static int bld_engine_send_status(struct bld_engine *engine,
 
 static int bld_engine_send_meta(struct bld_engine *engine)
 {
-	struct bld_meta_frame frame;
+	uint8_t buf[sizeof(struct bld_meta_frame) +
+		    BLD_SLOT_COUNT * sizeof(struct bld_meta_slot_wire) +
+		    BLD_CRC32_FIELD_SIZE + BLD_EOF_FIELD_SIZE];
+	struct bld_meta_frame *frame = (struct bld_meta_frame *)buf;
+	const struct bld_slot_info *info;
+	struct bld_meta_slot_wire *wire;
 	uint32_t crc_input_size;
+	uint32_t crc;
 
 	if (engine == NULL || engine->transport.send == NULL) {
 		return BLD_ENGINE_ERR;
@@ -169,40 +173,41 @@ static int bld_engine_send_meta(struct bld_engine *engine)
 		engine->boot_ctrl.pending_slot = (uint8_t)BLD_SLOT_ID_NONE;
 	}
 
-	memset(&frame, 0, sizeof(frame));
-	frame.sof = BLD_SOF;
-	frame.type = BLD_PKT_META;
-	frame.len = BLD_META_PAYLOAD_SIZE;
-
-	frame.active_slot = engine->boot_ctrl.active_slot;
-	frame.confirmed_slot = engine->boot_ctrl.confirmed_slot;
-	frame.pending_slot = engine->boot_ctrl.pending_slot;
-	frame.reserved0 = engine->boot_ctrl.reserved0;
-
-	frame.slot_a.version = engine->boot_ctrl.slots[BLD_SLOT_ID_A].version;
-	frame.slot_a.size = engine->boot_ctrl.slots[BLD_SLOT_ID_A].size;
-	frame.slot_a.crc32 = engine->boot_ctrl.slots[BLD_SLOT_ID_A].crc32;
-	frame.slot_a.state = engine->boot_ctrl.slots[BLD_SLOT_ID_A].state;
-	frame.slot_a.boot_attempts_left =
-		engine->boot_ctrl.slots[BLD_SLOT_ID_A].boot_attempts_left;
-	frame.slot_a.reserved = 0u;
-
-	frame.slot_b.version = engine->boot_ctrl.slots[BLD_SLOT_ID_B].version;
-	frame.slot_b.size = engine->boot_ctrl.slots[BLD_SLOT_ID_B].size;
-	frame.slot_b.crc32 = engine->boot_ctrl.slots[BLD_SLOT_ID_B].crc32;
-	frame.slot_b.state = engine->boot_ctrl.slots[BLD_SLOT_ID_B].state;
-	frame.slot_b.boot_attempts_left =
-		engine->boot_ctrl.slots[BLD_SLOT_ID_B].boot_attempts_left;
-	frame.slot_b.reserved = 0u;
+	memset(buf, 0, sizeof(buf));
+	frame->sof = BLD_SOF;
+	frame->type = BLD_PKT_META;
+	frame->len = (uint16_t)(BLD_META_HEAD_PAYLOAD_SIZE +
+				BLD_SLOT_COUNT * sizeof(*wire));
+
+	frame->active_slot = engine->boot_ctrl.active_slot;
+	frame->confirmed_slot = engine->boot_ctrl.confirmed_slot;
+	frame->pending_slot = engine->boot_ctrl.pending_slot;
+	frame->slot_count = (uint8_t)BLD_SLOT_COUNT;
+	frame->target_slot =
+		(uint8_t)bld_meta_choose_target_slot(&engine->boot_ctrl);
+
+	for (uint8_t i = 0u; i < BLD_SLOT_COUNT; ++i) {
+		info = &engine->boot_ctrl.slots[i];
+		wire = &frame->slots[i];
+		wire->version = info->version;
+		wire->size = info->size;
+		wire->crc32 = info->crc32;
+		wire->state = info->state;
+		wire->boot_attempts_left = info->boot_attempts_left;
+		wire->flags = (i == (uint8_t)BLD_SLOT_FACTORY) ?
+				      BLD_META_SLOT_FACTORY :
+				      0u;
+		wire->load_base = bld_engine_run_base(&engine->bank,
+						      (enum bld_slot_id)i);
+	}
 
-	crc_input_size = (uint32_t)(sizeof(frame) - sizeof(frame.crc32) -
-				    sizeof(frame.eof));
-	frame.crc32 =
-		bld_engine_frame_crc32((const uint8_t *)&frame, crc_input_size);
-	frame.eof = BLD_EOF;
+	crc_input_size = (uint32_t)(sizeof(buf) - BLD_CRC32_FIELD_SIZE -
+				    BLD_EOF_FIELD_SIZE);
+	crc = bld_engine_frame_crc32(buf, crc_input_size);
+	memcpy(buf + crc_input_size, &crc, sizeof(crc));
+	buf[sizeof(buf) - 1u] = BLD_EOF;
 
-	return engine->transport.send((uint8_t *)&frame,
-				      (uint16_t)sizeof(frame),
+	return engine->transport.send(buf, (uint16_t)sizeof(buf),
 				      engine->transport.ctx);
 }
 
@@ -249,50 +254,358 @@ static int bld_engine_validate_crc(const uint8_t *buf, uint16_t len)
 	return (actual_crc == expected_crc) ? BLD_ENGINE_OK : BLD_ENGINE_ERR;
 }
 
+static int bld_engine_crc_range(struct bld_storage *storage, uint32_t offset,
+				uint32_t size, uint32_t *crc)
+{
+	uint8_t chunk[256];
+	uint32_t read_size;
+
+	if (storage == NULL || storage->read == NULL || crc == NULL) {
+		return BLD_ENGINE_ERR;
+	}
+
+	while (size > 0u) {
+		read_size = (size > sizeof(chunk)) ? (uint32_t)sizeof(chunk) :
+						     size;
+
+		if (storage->read(storage, offset, chunk, read_size) != 0) {
+			return BLD_ENGINE_ERR;
+		}
+
+		*crc = bld_crc32_ieee(chunk, read_size, *crc);
+		size -= read_size;
+		offset += read_size;
+	}
+
+	return BLD_ENGINE_OK;
+}
+
+static int bld_engine_verify_image(struct bld_storage *storage,
+				   uint32_t image_size, uint32_t image_crc32)
+{
+	uint32_t crc;
+
+	if (image_size == 0u || image_crc32 == 0u) {
+		return BLD_ENGINE_ERR;
+	}
+
+	crc = BLD_CRC32_INITIAL;
+	if (bld_engine_crc_range(storage, 0u, image_size, &crc) !=
+	    BLD_ENGINE_OK) {
+		return BLD_ENGINE_ERR;
+	}
+
+	return (crc == image_crc32) ? BLD_ENGINE_OK : BLD_ENGINE_ERR;
+}
+
 static int bld_engine_verify_slot_image(struct bld_engine *engine,
 					enum bld_slot_id slot,
 					uint32_t image_size,
 					uint32_t image_crc32)
 {
-	uint8_t chunk[256];
-	uint32_t remaining;
-	uint32_t offset;
-	uint32_t crc;
-	uint32_t read_size;
-	struct bld_storage *storage;
-
 	if (engine == NULL) {
 		return BLD_ENGINE_ERR;
 	}
 
-	storage = bld_engine_slot_storage(engine, slot);
-	if (storage == NULL || storage->read == NULL) {
+	return bld_engine_verify_image(bld_engine_slot_storage(engine, slot),
+				       image_size, image_crc32);
+}
+
+/* Writes out whatever storage still holds back (bld_storage_wc.h). */
+static int bld_engine_sync(const struct bld_storage *storage)
+{
+	if (storage == NULL) {
 		return BLD_ENGINE_ERR;
 	}
 
-	if (image_size == 0u || image_crc32 == 0u) {
+	if (storage->sync != NULL && storage->sync(storage) != 0) {
 		return BLD_ENGINE_ERR;
 	}
 
-	crc = BLD_CRC32_INITIAL;
-	remaining = image_size;
-	offset = 0u;
+	return BLD_ENGINE_OK;
+}
+
+static int bld_engine_staged(const struct bld_engine *engine)
+{
+	return engine->staging.write != NULL;
+}
 
-	while (remaining > 0u) {
-		read_size = (remaining > sizeof(chunk)) ?
-				    (uint32_t)sizeof(chunk) :
-				    remaining;
+/* Where DATA lands: the staging storage if set, else the target slot. */
+static struct bld_storage *bld_engine_write_storage(struct bld_engine *engine)
+{
+	if (bld_engine_staged(engine)) {
+		return &engine->staging;
+	}
 
-		if (storage->read(storage, offset, chunk, read_size) != 0) {
+	return bld_engine_slot_storage(engine, engine->target_slot);
+}
+
+static uint32_t bld_engine_page_count(uint32_t image_size)
+{
+	return (image_size + BLD_FLASH_PAGE_SIZE - 1u) / BLD_FLASH_PAGE_SIZE;
+}
+
+static void bld_engine_plan_samples(struct bld_session *session)
+{
+	uint32_t pages = bld_engine_page_count(session->write_size);
+	uint32_t spread = BLD_VERIFY_SAMPLE_PAGES - 1u;
+
+	/* multiples of the stride use spread slots; the last page one more */
+	session->sample_stride = (pages + spread - 1u) / spread;
+	if (session->sample_stride == 0u) {
+		session->sample_stride = 1u;
+	}
+}
+
+/* Returns the sample slot of page, or -1 if the page is not sampled. */
+static int bld_engine_sample_index(const struct bld_session *session,
+				   uint32_t page)
+{
+	uint32_t last = bld_engine_page_count(session->write_size) - 1u;
+
+	if (page % session->sample_stride == 0u) {
+		return (int)(page / session->sample_stride);
+	}
+
+	if (page == last) {
+		return (int)(last / session->sample_stride) + 1;
+	}
+
+	return -1;
+}
+
+static void bld_engine_track_payload(struct bld_session *session,
+				     uint32_t offset, const uint8_t *data,
+				     uint32_t len)
+{
+	uint32_t piece;
+	int idx;
+
+	session->write_crc32 = bld_crc32_ieee(data, len, session->write_crc32);
+
+	while (len > 0u) {
+		piece = BLD_FLASH_PAGE_SIZE - (offset % BLD_FLASH_PAGE_SIZE);
+		if (piece > len) {
+			piece = len;
+		}
+
+		idx = bld_engine_sample_index(session,
+					      offset / BLD_FLASH_PAGE_SIZE);
+		if (idx >= 0) {
+			session->sample_crc32[idx] = bld_crc32_ieee(
+				data, piece, session->sample_crc32[idx]);
+		}
+
+		data += piece;
+		offset += piece;
+		len -= piece;
+	}
+}
+
+static int bld_engine_verify_sampled_pages(struct bld_engine *engine,
+					   struct bld_storage *storage)
+{
+	const struct bld_session *session = &engine->session;
+	uint32_t pages;
+	uint32_t page;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t crc;
+	int idx;
+
+	pages = bld_engine_page_count(session->write_size);
+
+	for (page = 0u; page < pages; page++) {
+		idx = bld_engine_sample_index(session, page);
+		if (idx < 0) {
+			continue;
+		}
+
+		offset = page * BLD_FLASH_PAGE_SIZE;
+		size = session->write_size - offset;
+		if (size > BLD_FLASH_PAGE_SIZE) {
+			size = BLD_FLASH_PAGE_SIZE;
+		}
+
+		crc = BLD_CRC32_INITIAL;
+		if (bld_engine_crc_range(storage, offset, size, &crc) !=
+			    BLD_ENGINE_OK ||
+		    crc != session->sample_crc32[idx]) {
 			return BLD_ENGINE_ERR;
 		}
+	}
 
-		crc = bld_crc32_ieee(chunk, read_size, crc);
-		remaining -= read_size;
-		offset += read_size;
+	return BLD_ENGINE_OK;
+}
+
+/* Reads storage back as far as the verify mode asks. */
+static int bld_engine_read_back(struct bld_engine *engine,
+				struct bld_storage *storage)
+{
+	const struct bld_session *session = &engine->session;
+
+	switch (engine->verify_mode) {
+	case BLD_VERIFY_NONE:
+	case BLD_VERIFY_RUNNING:
+		return BLD_ENGINE_OK;
+	case BLD_VERIFY_SAMPLED:
+		return bld_engine_verify_sampled_pages(engine, storage);
+	case BLD_VERIFY_FULL:
+		return bld_engine_verify_image(storage, session->write_size,
+					       session->write_crc32);
+	default:
+		return BLD_ENGINE_ERR;
 	}
+}
 
-	return (crc == image_crc32) ? BLD_ENGINE_OK : BLD_ENGINE_ERR;
+static int bld_engine_verify_received_image(struct bld_engine *engine)
+{
+	const struct bld_session *session = &engine->session;
+
+	if (engine->verify_mode == BLD_VERIFY_NONE) {
+		return BLD_ENGINE_OK;
+	}
+
+	if (session->running_crc32 != session->image_crc32) {
+		return BLD_ENGINE_ERR;
+	}
+
+	return bld_engine_read_back(engine, bld_engine_write_storage(engine));
+}
+
+/*
+ * Copies the verified image from staging into the target slot. The bytes
+ * read back from staging must still carry the CRC tracked on the way in,
+ * and the slot is then read back as the verify mode asks: that copy is
+ * what will boot.
+ */
+static enum bld_status bld_engine_install_staged(struct bld_engine *engine)
+{
+	const struct bld_session *session = &engine->session;
+	struct bld_storage *slot;
+	uint32_t offset;
+	uint32_t n;
+	uint32_t crc = BLD_CRC32_INITIAL;
+
+	slot = bld_engine_slot_storage(engine, engine->target_slot);
+	if (slot == NULL || slot->erase == NULL || slot->write == NULL ||
+	    slot->erase(slot, 0u, session->write_size) != 0) {
+		return BLD_ST_FLASH_ERR;
+	}
+
+	for (offset = 0u; offset < session->write_size; offset += n) {
+		n = session->write_size - offset;
+		if (n > sizeof(engine->copy_buf)) {
+			n = (uint32_t)sizeof(engine->copy_buf);
+		}
+
+		if (engine->staging.read(&engine->staging, offset,
+					 engine->copy_buf, n) != 0) {
+			return BLD_ST_FLASH_ERR;
+		}
+
+		crc = bld_crc32_ieee(engine->copy_buf, n, crc);
+		if (slot->write(slot, offset, engine->copy_buf, n) != 0) {
+			return BLD_ST_FLASH_ERR;
+		}
+	}
+
+	if (bld_engine_sync(slot) != BLD_ENGINE_OK) {
+		return BLD_ST_FLASH_ERR;
+	}
+
+	if (crc != session->write_crc32 ||
+	    bld_engine_read_back(engine, slot) != BLD_ENGINE_OK) {
+		return BLD_ST_BAD_CRC;
+	}
+
+	return BLD_ST_OK;
+}
+
+/*
+ * Takes the relocatable-image header and table off the front of the stream.
+ * The first chunk decides: a raw image is written as it arrives, while a
+ * relocatable one is held back until its table is in RAM. On return *data
+ * and *len cover the image bytes of the chunk, if any.
+ */
+static enum bld_status bld_engine_take_prefix(struct bld_engine *engine,
+					      uint8_t **data, uint32_t *len)
+{
+	struct bld_session *session = &engine->session;
+	const uint32_t header_size = (uint32_t)sizeof(session->reloc_header);
+	uint32_t pos = session->received_size;
+	uint32_t magic = 0u;
+	uint32_t n;
+
+	if (pos == 0u) {
+		if (*len >= sizeof(magic)) {
+			memcpy(&magic, *data, sizeof(magic));
+		}
+
+		if (magic != BLD_RELOC_MAGIC) {
+			return BLD_ST_OK;
+		}
+		session->prefix_size = header_size;
+	}
+
+	while (pos < session->prefix_size && *len > 0u) {
+		if (pos < header_size) {
+			n = header_size - pos;
+			n = (n < *len) ? n : *len;
+			memcpy((uint8_t *)&session->reloc_header + pos, *data,
+			       n);
+		} else {
+			n = session->prefix_size - pos;
+			n = (n < *len) ? n : *len;
+			memcpy(&session->reloc_table[pos - header_size], *data,
+			       n);
+		}
+		pos += n;
+		*data += n;
+		*len -= n;
+
+		if (pos == header_size) {
+			if (bld_reloc_check_header(&session->reloc_header,
+						   session->image_size,
+						   session->image_size,
+						   BLD_RELOC_TABLE_MAX) != 0) {
+				return (session->reloc_header.table_size >
+					BLD_RELOC_TABLE_MAX) ?
+					       BLD_ST_TOO_LARGE :
+					       BLD_ST_BAD_FRAME;
+			}
+
+			session->prefix_size += session->reloc_header.table_size;
+			session->write_size = session->reloc_header.image_size;
+			bld_engine_plan_samples(session);
+		}
+
+		if (pos == session->prefix_size &&
+		    bld_reloc_begin(&session->reloc, &session->reloc_header,
+				    session->reloc_table,
+				    bld_engine_run_base(&engine->bank,
+							engine->target_slot)) !=
+			    0) {
+			return BLD_ST_BAD_FRAME;
+		}
+	}
+
+	return BLD_ST_OK;
+}
+
+/* Whether every byte sent was accounted for: all relocations applied. */
+static int bld_engine_image_complete(const struct bld_session *session)
+{
+	if (session->prefix_size == 0u) {
+		return BLD_ENGINE_OK;
+	}
+
+	if (session->received_size < session->prefix_size ||
+	    bld_reloc_finish(&session->reloc, session->write_size) != 0) {
+		return BLD_ENGINE_ERR;
+	}
+
+	return BLD_ENGINE_OK;
 }
 
 static int bld_engine_handle_cmd(struct bld_engine *engine,
@@ -322,8 +635,14 @@ static int bld_engine_handle_cmd(struct bld_engine *engine,
 		if (frame->cmd == BLD_CMD_START) {
 			(void)bld_engine_refresh_boot_control(engine);
 			bld_engine_reset_session(engine);
-			engine->target_slot = bld_engine_choose_target_slot(
+			engine->target_slot = bld_meta_choose_target_slot(
 				&engine->boot_ctrl);
+			if (bld_engine_slot_id_valid(engine->target_slot) !=
+			    BLD_ENGINE_OK) {
+				return bld_engine_send_status(
+					engine, BLD_ST_ERR,
+					(uint32_t)BLD_SLOT_ID_NONE);
+			}
 			engine->state = BLD_STATE_WAIT_HEADER;
 			return bld_engine_send_status(
 				engine, BLD_ST_OK,
@@ -346,28 +665,46 @@ static int bld_engine_handle_cmd(struct bld_engine *engine,
 	case BLD_STATE_WAIT_END:
 		if (frame->cmd == BLD_CMD_END) {
 			if (engine->session.received_size !=
-			    engine->session.image_size) {
+				    engine->session.image_size ||
+			    bld_engine_image_complete(&engine->session) !=
+				    BLD_ENGINE_OK) {
 				engine->state = BLD_STATE_ERROR;
 				return bld_engine_send_status(
 					engine, BLD_ST_BAD_FRAME,
 					engine->session.received_size);
 			}
 
-			if (bld_engine_verify_slot_image(
-				    engine, engine->target_slot,
-				    engine->session.image_size,
-				    engine->session.image_crc32) != 0) {
+			if (bld_engine_sync(bld_engine_write_storage(engine)) !=
+			    BLD_ENGINE_OK) {
+				engine->state = BLD_STATE_ERROR;
+				return bld_engine_send_status(
+					engine, BLD_ST_FLASH_ERR,
+					engine->session.received_size);
+			}
+
+			if (bld_engine_verify_received_image(engine) != 0) {
 				engine->state = BLD_STATE_ERROR;
 				return bld_engine_send_status(
 					engine, BLD_ST_BAD_CRC,
 					engine->session.image_crc32);
 			}
 
+			if (bld_engine_staged(engine)) {
+				enum bld_status status =
+					bld_engine_install_staged(engine);
+
+				if (status != BLD_ST_OK) {
+					engine->state = BLD_STATE_ERROR;
+					return bld_engine_send_status(
+						engine, status, 0u);
+				}
+			}
+
 			if (bld_meta_set_pending(&engine->meta_storage,
 						 engine->target_slot,
 						 engine->session.image_version,
-						 engine->session.image_size,
-						 engine->session.image_crc32,
+						 engine->session.write_size,
+						 engine->session.write_crc32,
 						 BLD_MAX_BOOT_ATTEMPTS) != 0) {
 				engine->state = BLD_STATE_ERROR;
 				return bld_engine_send_status(
@@ -412,7 +749,11 @@ static int bld_engine_handle_header(struct bld_engine *engine,
 		return bld_engine_send_status(engine, BLD_ST_FLASH_ERR, 0u);
 	}
 
+	/* a relocatable image must fit with its header and table */
 	slot_size = bld_engine_slot_size(engine->target_slot);
+	if (bld_engine_staged(engine) && engine->staging_size < slot_size) {
+		slot_size = engine->staging_size;
+	}
 	if (frame->image_size == 0u || frame->image_size > slot_size) {
 		engine->state = BLD_STATE_IDLE;
 		bld_engine_reset_session(engine);
@@ -420,7 +761,7 @@ static int bld_engine_handle_header(struct bld_engine *engine,
 					      frame->image_size);
 	}
 
-	storage = bld_engine_slot_storage(engine, engine->target_slot);
+	storage = bld_engine_write_storage(engine);
 	if (storage == NULL || storage->erase == NULL) {
 		engine->state = BLD_STATE_ERROR;
 		return bld_engine_send_status(engine, BLD_ST_FLASH_ERR, 0u);
@@ -436,19 +777,30 @@ static int bld_engine_handle_header(struct bld_engine *engine,
 	engine->session.image_size = frame->image_size;
 	engine->session.image_crc32 = frame->image_crc32;
 	engine->session.image_version = frame->version;
+	engine->session.running_crc32 = BLD_CRC32_INITIAL;
+	engine->session.write_size = frame->image_size;
+	engine->session.write_crc32 = BLD_CRC32_INITIAL;
+	engine->session.prefix_size = 0u;
+	memset(engine->session.sample_crc32, 0,
+	       sizeof(engine->session.sample_crc32));
+	bld_engine_plan_samples(&engine->session);
 	engine->state = BLD_STATE_RECV_DATA;
 
 	return bld_engine_send_status(engine, BLD_ST_OK, 0u);
 }
 
-static int bld_engine_handle_data(struct bld_engine *engine, const uint8_t *buf,
+static int bld_engine_handle_data(struct bld_engine *engine, uint8_t *buf,
 				  uint16_t len)
 {
-	const struct bld_data_prefix *frame;
+	struct bld_data_prefix *frame;
 	uint16_t payload_len;
 	uint16_t chunk_len;
 	uint32_t expected_total_len;
 	struct bld_storage *storage;
+	enum bld_status status;
+	uint8_t *data;
+	uint32_t data_len;
+	uint32_t offset;
 
 	if (engine == NULL || buf == NULL) {
 		return BLD_ENGINE_ERR;
@@ -459,7 +811,7 @@ static int bld_engine_handle_data(struct bld_engine *engine, const uint8_t *buf,
 					      engine->state);
 	}
 
-	frame = (const struct bld_data_prefix *)buf;
+	frame = (struct bld_data_prefix *)buf;
 	if (frame->type != BLD_PKT_DATA) {
 		return bld_engine_send_status(engine, BLD_ST_BAD_FRAME, 0u);
 	}
@@ -495,19 +847,47 @@ static int bld_engine_handle_data(struct bld_engine *engine, const uint8_t *buf,
 						      chunk_len);
 	}
 
-	storage = bld_engine_slot_storage(engine, engine->target_slot);
+	storage = bld_engine_write_storage(engine);
 	if (storage == NULL || storage->write == NULL) {
 		engine->state = BLD_STATE_ERROR;
 		return bld_engine_send_status(engine, BLD_ST_FLASH_ERR, 0u);
 	}
 
-	if (storage->write(storage, engine->session.received_size, frame->data,
-			   chunk_len) != 0) {
+	/* the CRC covers the bytes sent, before any relocation */
+	engine->session.running_crc32 = bld_crc32_ieee(
+		frame->data, chunk_len, engine->session.running_crc32);
+
+	data = frame->data;
+	data_len = chunk_len;
+	status = bld_engine_take_prefix(engine, &data, &data_len);
+	if (status != BLD_ST_OK) {
 		engine->state = BLD_STATE_ERROR;
-		return bld_engine_send_status(engine, BLD_ST_FLASH_ERR,
+		return bld_engine_send_status(engine, status,
 					      engine->session.received_size);
 	}
 
+	if (data_len > 0u) {
+		offset = engine->session.received_size + chunk_len - data_len -
+			 engine->session.prefix_size;
+
+		if (engine->session.prefix_size != 0u &&
+		    bld_reloc_apply(&engine->session.reloc, offset, data,
+				    data_len) != 0) {
+			engine->state = BLD_STATE_ERROR;
+			return bld_engine_send_status(engine, BLD_ST_BAD_FRAME,
+						      offset);
+		}
+
+		if (storage->write(storage, offset, data, data_len) != 0) {
+			engine->state = BLD_STATE_ERROR;
+			return bld_engine_send_status(engine, BLD_ST_FLASH_ERR,
+						      offset);
+		}
+
+		bld_engine_track_payload(&engine->session, offset, data,
+					 data_len);
+	}
+
 	engine->session.received_size += chunk_len;
 	engine->session.expected_seq += 1u;
 
@@ -520,27 +900,88 @@ static int bld_engine_handle_data(struct bld_engine *engine, const uint8_t *buf,
 
 int bld_engine_init(struct bld_engine *engine,
 		    const struct bld_transport *transport,
-		    const struct bld_storage *slot_a_storage,
-		    const struct bld_storage *slot_b_storage,
+		    const struct bld_storage *slot_storage,
 		    const struct bld_storage *meta_storage)
 {
-	if (engine == NULL || transport == NULL || slot_a_storage == NULL ||
-	    slot_b_storage == NULL || meta_storage == NULL) {
+	if (engine == NULL || transport == NULL || slot_storage == NULL ||
+	    meta_storage == NULL) {
 		return BLD_ENGINE_ERR;
 	}
 
 	memset(engine, 0, sizeof(*engine));
 	engine->state = BLD_STATE_IDLE;
 	engine->transport = *transport;
-	engine->slot_storage[BLD_SLOT_ID_A] = *slot_a_storage;
-	engine->slot_storage[BLD_SLOT_ID_B] = *slot_b_storage;
+	memcpy(engine->slot_storage, slot_storage,
+	       sizeof(engine->slot_storage));
 	engine->meta_storage = *meta_storage;
 	engine->target_slot = BLD_SLOT_ID_NONE;
+	engine->verify_mode = BLD_VERIFY_MODE_DEFAULT;
 
 	(void)bld_engine_refresh_boot_control(engine);
 	return BLD_ENGINE_OK;
 }
 
+int bld_engine_set_verify_mode(struct bld_engine *engine,
+			       enum bld_verify_mode mode)
+{
+	if (engine == NULL || (mode != BLD_VERIFY_NONE &&
+			       mode != BLD_VERIFY_RUNNING &&
+			       mode != BLD_VERIFY_SAMPLED &&
+			       mode != BLD_VERIFY_FULL)) {
+		return BLD_ENGINE_ERR;
+	}
+
+	engine->verify_mode = mode;
+	return BLD_ENGINE_OK;
+}
+
+int bld_engine_set_bank_ops(struct bld_engine *engine,
+			    const struct bld_bank_ops *ops)
+{
+	if (engine == NULL ||
+	    (ops != NULL && (ops->active == NULL || ops->select == NULL))) {
+		return BLD_ENGINE_ERR;
+	}
+
+	if (ops == NULL) {
+		memset(&engine->bank, 0, sizeof(engine->bank));
+	} else {
+		engine->bank = *ops;
+	}
+	return BLD_ENGINE_OK;
+}
+
+int bld_engine_set_staging(struct bld_engine *engine,
+			   const struct bld_storage *staging, uint32_t size)
+{
+	if (engine == NULL ||
+	    (staging != NULL &&
+	     (staging->erase == NULL || staging->write == NULL ||
+	      staging->read == NULL || size == 0u))) {
+		return BLD_ENGINE_ERR;
+	}
+
+	if (staging == NULL) {
+		memset(&engine->staging, 0, sizeof(engine->staging));
+		engine->staging_size = 0u;
+	} else {
+		engine->staging = *staging;
+		engine->staging_size = size;
+	}
+	return BLD_ENGINE_OK;
+}
+
+/*
+ * Hands over to the bootloader copy in slot's bank; it verifies the image
+ * again after the reset, counts a trial boot attempt and jumps.
+ */
+static int bld_engine_switch_bank(struct bld_engine *engine,
+				  enum bld_slot_id slot)
+{
+	(void)bld_engine_send_status(engine, BLD_ST_OK, (uint32_t)slot);
+	return engine->bank.select(&engine->bank, (uint8_t)slot);
+}
+
 int bld_engine_boot_decide_and_jump(struct bld_engine *engine)
 {
 	enum bld_slot_id slot;
@@ -571,18 +1012,25 @@ int bld_engine_boot_decide_and_jump(struct bld_engine *engine)
 				   engine->boot_ctrl.slots[(uint8_t)slot].size,
 				   engine->boot_ctrl.slots[(uint8_t)slot]
 					   .crc32) == 0) {
-			if (bld_meta_decrement_pending_attempts(
-				    &engine->meta_storage, &attempts_left) ==
-			    0) {
+			if (!bld_engine_slot_in_running_bank(&engine->bank,
+							     slot)) {
+				/* on failure the trial waits; boot confirmed */
+				if (bld_engine_switch_bank(engine, slot) == 0) {
+					return BLD_ENGINE_OK;
+				}
+			} else if (bld_meta_decrement_pending_attempts(
+					   &engine->meta_storage,
+					   &attempts_left) == 0) {
 				(void)bld_engine_send_status(engine, BLD_ST_OK,
 							     (uint32_t)slot);
-				bld_jump_to_image(bld_engine_slot_base(slot));
+				bld_jump_to_image(
+					bld_engine_run_base(&engine->bank, slot));
 				return BLD_ENGINE_OK;
+			} else {
+				(void)bld_meta_mark_slot_bad(
+					&engine->meta_storage, slot);
+				(void)bld_engine_refresh_boot_control(engine);
 			}
-
-			(void)bld_meta_mark_slot_bad(&engine->meta_storage,
-						     slot);
-			(void)bld_engine_refresh_boot_control(engine);
 		} else {
 			(void)bld_meta_mark_slot_bad(&engine->meta_storage,
 						     slot);
@@ -590,28 +1038,120 @@ int bld_engine_boot_decide_and_jump(struct bld_engine *engine)
 		}
 	}
 
-	if (engine->boot_ctrl.confirmed_slot != (uint8_t)BLD_SLOT_ID_NONE) {
+	/* marking a slot bad moves confirmed_slot on to the next fallback */
+	for (uint8_t tries = 0u;
+	     tries < BLD_SLOT_COUNT &&
+	     engine->boot_ctrl.confirmed_slot != (uint8_t)BLD_SLOT_ID_NONE;
+	     ++tries) {
 		slot = (enum bld_slot_id)engine->boot_ctrl.confirmed_slot;
 
 		if (bld_engine_verify_slot_image(
 			    engine, slot,
 			    engine->boot_ctrl.slots[(uint8_t)slot].size,
-			    engine->boot_ctrl.slots[(uint8_t)slot].crc32) ==
+			    engine->boot_ctrl.slots[(uint8_t)slot].crc32) !=
 		    0) {
+			(void)bld_meta_mark_slot_bad(&engine->meta_storage,
+						     slot);
+			(void)bld_engine_refresh_boot_control(engine);
+		} else if (!bld_engine_slot_in_running_bank(&engine->bank,
+							    slot)) {
+			if (bld_engine_switch_bank(engine, slot) == 0) {
+				return BLD_ENGINE_OK;
+			}
+			break;
+		} else {
 			(void)bld_engine_send_status(engine, BLD_ST_OK,
 						     (uint32_t)slot);
-			bld_jump_to_image(bld_engine_slot_base(slot));
+			bld_jump_to_image(
+				bld_engine_run_base(&engine->bank, slot));
 			return BLD_ENGINE_OK;
 		}
-
-		(void)bld_meta_mark_slot_bad(&engine->meta_storage, slot);
-		(void)bld_engine_refresh_boot_control(engine);
 	}
 
 	(void)bld_engine_send_status(engine, BLD_ST_BOOT_ERR, 0u);
 	return BLD_ENGINE_ERR;
 }
 
+static int bld_engine_stack_in_sram(uint32_t msp)
+{
+	/* full-descending stack: the initial value may equal the RAM end */
+	if ((msp & 7u) != 0u) {
+		return 0;
+	}
+
+	return (msp > BLD_SRAM1_BASE &&
+		msp <= BLD_SRAM1_BASE + BLD_SRAM1_SIZE) ||
+	       (msp > BLD_SRAM2_BASE && msp <= BLD_SRAM2_BASE + BLD_SRAM2_SIZE);
+}
+
+static int bld_engine_vectors_plausible(const struct bld_storage *storage,
+					const struct bld_bank_ops *bank,
+					enum bld_slot_id slot)
+{
+	uint32_t vectors[2];
+	uint32_t base;
+	uint32_t reset;
+
+	if (storage == NULL || storage->read == NULL) {
+		return 0;
+	}
+
+	if (storage->read(storage, 0u, (uint8_t *)vectors, sizeof(vectors)) !=
+	    0) {
+		return 0;
+	}
+
+	base = bld_engine_run_base(bank, slot);
+	reset = vectors[1] & ~1u;
+
+	return bld_engine_stack_in_sram(vectors[0]) && (vectors[1] & 1u) &&
+	       reset >= base + sizeof(vectors) &&
+	       reset < base + bld_engine_slot_size(slot);
+}
+
+int bld_engine_fast_boot_slot(const struct bld_storage *meta_storage,
+			      const struct bld_storage *slot_storage,
+			      const struct bld_bank_ops *bank,
+			      uint32_t *image_base)
+{
+	struct bld_boot_control ctrl;
+	enum bld_slot_id slot;
+
+	if (meta_storage == NULL || slot_storage == NULL ||
+	    image_base == NULL) {
+		return BLD_ENGINE_ERR;
+	}
+
+	if (bld_meta_read_boot_control(meta_storage, &ctrl) != 0) {
+		return BLD_ENGINE_ERR;
+	}
+
+	/* A trial boot needs its image verified and its attempt counted. */
+	if (ctrl.pending_slot != (uint8_t)BLD_SLOT_ID_NONE) {
+		return BLD_ENGINE_ERR;
+	}
+
+	slot = (enum bld_slot_id)ctrl.confirmed_slot;
+	if (bld_engine_slot_id_valid(slot) != BLD_ENGINE_OK ||
+	    ctrl.slots[(uint8_t)slot].state !=
+		    (uint8_t)BLD_SLOT_STATE_CONFIRMED) {
+		return BLD_ENGINE_ERR;
+	}
+
+	/* switching banks is left to the full path */
+	if (!bld_engine_slot_in_running_bank(bank, slot)) {
+		return BLD_ENGINE_ERR;
+	}
+
+	if (!bld_engine_vectors_plausible(&slot_storage[(uint8_t)slot], bank,
+					  slot)) {
+		return BLD_ENGINE_ERR;
+	}
+
+	*image_base = bld_engine_run_base(bank, slot);
+	return BLD_ENGINE_OK;
+}
+
 void bld_engine_poll(struct bld_engine *engine, uint32_t frame_timeout_ms)
 {
 	uint8_t frame_buf[BLD_MAX_FRAME_SIZE];
@@ -9,13 +9,21 @@
 #define BLD_META_OK 0
 #define BLD_META_ERR (-1)
 
+/* target ranks; lower is written first */
+#define BLD_META_RANK_IN_USE 4u
+#define BLD_META_RANK_NEVER 0xFFu
+
+/*
+ * slot_count is the BLD_SLOT_COUNT the record was written with. Records
+ * from before it was stored hold 0 there and describe two slots.
+ */
 struct __attribute__((packed)) bld_meta_record {
 	uint32_t magic;
 	uint8_t active_slot;
 	uint8_t confirmed_slot;
 	uint8_t pending_slot;
-	uint8_t reserved0;
-	struct bld_slot_info slots[2];
+	uint8_t slot_count;
+	struct bld_slot_info slots[BLD_SLOT_COUNT];
 	uint32_t record_crc32;
 };
 
@@ -33,6 +41,7 @@ static void bld_meta_record_init_default(struct bld_meta_record *record)
 	record->active_slot = (uint8_t)BLD_SLOT_ID_NONE;
 	record->confirmed_slot = (uint8_t)BLD_SLOT_ID_NONE;
 	record->pending_slot = (uint8_t)BLD_SLOT_ID_NONE;
+	record->slot_count = (uint8_t)BLD_SLOT_COUNT;
 
 	struct bld_slot_info empty_slot;
 
@@ -40,8 +49,9 @@ static void bld_meta_record_init_default(struct bld_meta_record *record)
 	empty_slot.state = (uint8_t)BLD_SLOT_STATE_EMPTY;
 	empty_slot.boot_attempts_left = 0u;
 
-	record->slots[BLD_SLOT_ID_A] = empty_slot;
-	record->slots[BLD_SLOT_ID_B] = empty_slot;
+	for (uint8_t i = 0u; i < BLD_SLOT_COUNT; ++i) {
+		record->slots[i] = empty_slot;
+	}
 
 	record->record_crc32 = bld_meta_crc32(record);
 }
@@ -68,12 +78,16 @@ static int bld_meta_storage_valid(const struct bld_storage *meta_storage)
 
 static int bld_meta_slot_id_valid(uint8_t slot)
 {
-	return (slot == BLD_SLOT_ID_A || slot == BLD_SLOT_ID_B ||
-		slot == BLD_SLOT_ID_NONE) ?
+	return (slot < BLD_SLOT_COUNT || slot == BLD_SLOT_ID_NONE) ?
 		       BLD_META_OK :
 		       BLD_META_ERR;
 }
 
+static int bld_meta_slot_is_factory(uint8_t slot)
+{
+	return slot == (uint8_t)BLD_SLOT_FACTORY;
+}
+
 static int bld_meta_slot_state_valid(uint8_t state)
 {
 	return (state == BLD_SLOT_STATE_EMPTY ||
@@ -93,12 +107,16 @@ static int bld_meta_record_validate(const struct bld_meta_record *record)
 	if (record->magic != BLD_META_MAGIC) {
 		return BLD_META_ERR;
 	}
+	if (record->slot_count != BLD_SLOT_COUNT &&
+	    (record->slot_count != 0u || BLD_SLOT_COUNT != 2u)) {
+		return BLD_META_ERR;
+	}
 	if (bld_meta_slot_id_valid(record->active_slot) != BLD_META_OK ||
 	    bld_meta_slot_id_valid(record->confirmed_slot) != BLD_META_OK ||
 	    bld_meta_slot_id_valid(record->pending_slot) != BLD_META_OK) {
 		return BLD_META_ERR;
 	}
-	for (uint8_t i = 0u; i < 2u; ++i) {
+	for (uint8_t i = 0u; i < BLD_SLOT_COUNT; ++i) {
 		if (bld_meta_slot_state_valid(record->slots[i].state) !=
 		    BLD_META_OK) {
 			return BLD_META_ERR;
@@ -157,6 +175,16 @@ bld_meta_record_load_or_default(const struct bld_storage *meta_storage,
 	return BLD_META_OK;
 }
 
+static void bld_meta_record_to_ctrl(const struct bld_meta_record *record,
+				    struct bld_boot_control *out)
+{
+	out->active_slot = record->active_slot;
+	out->confirmed_slot = record->confirmed_slot;
+	out->pending_slot = record->pending_slot;
+	out->reserved0 = 0u;
+	memcpy(out->slots, record->slots, sizeof(out->slots));
+}
+
 int bld_meta_read_boot_control(const struct bld_storage *meta_storage,
 			       struct bld_boot_control *out)
 {
@@ -171,12 +199,7 @@ int bld_meta_read_boot_control(const struct bld_storage *meta_storage,
 		return BLD_META_ERR;
 	}
 
-	out->active_slot = record.active_slot;
-	out->confirmed_slot = record.confirmed_slot;
-	out->pending_slot = record.pending_slot;
-	out->reserved0 = record.reserved0;
-	out->slots[0] = record.slots[0];
-	out->slots[1] = record.slots[1];
+	bld_meta_record_to_ctrl(&record, out);
 	return BLD_META_OK;
 }
 
@@ -194,9 +217,8 @@ int bld_meta_write_boot_control(const struct bld_storage *meta_storage,
 	record.active_slot = ctrl->active_slot;
 	record.confirmed_slot = ctrl->confirmed_slot;
 	record.pending_slot = ctrl->pending_slot;
-	record.reserved0 = ctrl->reserved0;
-	record.slots[0] = ctrl->slots[0];
-	record.slots[1] = ctrl->slots[1];
+	record.slot_count = (uint8_t)BLD_SLOT_COUNT;
+	memcpy(record.slots, ctrl->slots, sizeof(record.slots));
 
 	if (bld_meta_record_validate(&record) != BLD_META_OK) {
 		return BLD_META_ERR;
@@ -215,7 +237,8 @@ int bld_meta_set_pending(const struct bld_storage *meta_storage,
 		return BLD_META_ERR;
 	}
 
-	if (slot != BLD_SLOT_ID_A && slot != BLD_SLOT_ID_B) {
+	if ((uint8_t)slot >= BLD_SLOT_COUNT ||
+	    bld_meta_slot_is_factory((uint8_t)slot)) {
 		return BLD_META_ERR;
 	}
 
@@ -254,7 +277,7 @@ int bld_meta_confirm_slot(const struct bld_storage *meta_storage)
 
 	slot = record.pending_slot;
 
-	if (slot != BLD_SLOT_ID_A && slot != BLD_SLOT_ID_B) {
+	if ((uint8_t)slot >= BLD_SLOT_COUNT) {
 		return BLD_META_ERR;
 	}
 
@@ -267,7 +290,7 @@ int bld_meta_confirm_slot(const struct bld_storage *meta_storage)
 		record.pending_slot = (uint8_t)BLD_SLOT_ID_NONE;
 	}
 
-	for (uint8_t i = 0u; i < 2u; ++i) {
+	for (uint8_t i = 0u; i < BLD_SLOT_COUNT; ++i) {
 		if (i == (uint8_t)slot) {
 			continue;
 		}
@@ -281,32 +304,107 @@ int bld_meta_confirm_slot(const struct bld_storage *meta_storage)
 	return bld_meta_record_write(meta_storage, &record);
 }
 
-static int
-bld_meta_slot_is_selectable_for_active(const struct bld_meta_record *record,
-				       uint8_t slot)
+static uint8_t bld_meta_target_rank(const struct bld_boot_control *ctrl,
+				    uint8_t slot)
 {
-	return (record->slots[slot].state ==
-			(uint8_t)BLD_SLOT_STATE_CONFIRMED ||
-		record->slots[slot].state == (uint8_t)BLD_SLOT_STATE_VALID ||
-		record->slots[slot].state == (uint8_t)BLD_SLOT_STATE_PENDING);
+	if (bld_meta_slot_is_factory(slot)) {
+		return BLD_META_RANK_NEVER;
+	}
+
+	if (slot == ctrl->active_slot || slot == ctrl->confirmed_slot) {
+		return BLD_META_RANK_IN_USE;
+	}
+
+	switch (ctrl->slots[slot].state) {
+	case BLD_SLOT_STATE_EMPTY:
+		return 0u;
+	case BLD_SLOT_STATE_BAD:
+		return 1u;
+	case BLD_SLOT_STATE_PENDING:
+		return 2u;
+	case BLD_SLOT_STATE_VALID:
+		return 3u;
+	default:
+		return BLD_META_RANK_IN_USE;
+	}
 }
 
-static int
-bld_meta_slot_is_selectable_for_confirmed(const struct bld_meta_record *record,
-					  uint8_t slot)
+enum bld_slot_id
+bld_meta_choose_target_slot(const struct bld_boot_control *ctrl)
 {
-	return (record->slots[slot].state ==
-			(uint8_t)BLD_SLOT_STATE_CONFIRMED ||
-		record->slots[slot].state == (uint8_t)BLD_SLOT_STATE_VALID);
+	uint8_t best = (uint8_t)BLD_SLOT_ID_NONE;
+	uint8_t best_rank = BLD_META_RANK_NEVER;
+	uint8_t rank;
+
+	if (ctrl == NULL) {
+		return BLD_SLOT_ID_NONE;
+	}
+
+	for (uint8_t i = 0u; i < BLD_SLOT_COUNT; ++i) {
+		rank = bld_meta_target_rank(ctrl, i);
+		if (rank < best_rank ||
+		    (rank == best_rank && rank == 3u &&
+		     ctrl->slots[i].version < ctrl->slots[best].version)) {
+			best = i;
+			best_rank = rank;
+		}
+	}
+
+	return (enum bld_slot_id)best;
+}
+
+static int bld_meta_slot_can_fall_back(const struct bld_slot_info *slot,
+				       int accept_pending)
+{
+	return slot->state == (uint8_t)BLD_SLOT_STATE_CONFIRMED ||
+	       slot->state == (uint8_t)BLD_SLOT_STATE_VALID ||
+	       (accept_pending &&
+		slot->state == (uint8_t)BLD_SLOT_STATE_PENDING);
+}
+
+enum bld_slot_id
+bld_meta_choose_fallback_slot(const struct bld_boot_control *ctrl,
+			      enum bld_slot_id exclude, int accept_pending)
+{
+	uint8_t best = (uint8_t)BLD_SLOT_ID_NONE;
+
+	if (ctrl == NULL) {
+		return BLD_SLOT_ID_NONE;
+	}
+
+	for (uint8_t i = 0u; i < BLD_SLOT_COUNT; ++i) {
+		if (i == (uint8_t)exclude || bld_meta_slot_is_factory(i) ||
+		    !bld_meta_slot_can_fall_back(&ctrl->slots[i],
+						 accept_pending)) {
+			continue;
+		}
+
+		if (best == (uint8_t)BLD_SLOT_ID_NONE ||
+		    ctrl->slots[i].version > ctrl->slots[best].version) {
+			best = i;
+		}
+	}
+
+#if BLD_SLOT_FACTORY < BLD_SLOT_COUNT
+	/* the recovery image is the last resort */
+	if (best == (uint8_t)BLD_SLOT_ID_NONE &&
+	    (uint8_t)exclude != (uint8_t)BLD_SLOT_FACTORY &&
+	    bld_meta_slot_can_fall_back(&ctrl->slots[BLD_SLOT_FACTORY],
+					accept_pending)) {
+		best = (uint8_t)BLD_SLOT_FACTORY;
+	}
+#endif
+
+	return (enum bld_slot_id)best;
 }
 
 int bld_meta_mark_slot_bad(const struct bld_storage *meta_storage,
 			   enum bld_slot_id slot)
 {
 	struct bld_meta_record record;
-	uint8_t other_slot;
+	struct bld_boot_control ctrl;
 
-	if (slot != BLD_SLOT_ID_A && slot != BLD_SLOT_ID_B) {
+	if ((uint8_t)slot >= BLD_SLOT_COUNT) {
 		return BLD_META_ERR;
 	}
 
@@ -315,9 +413,6 @@ int bld_meta_mark_slot_bad(const struct bld_storage *meta_storage,
 		return BLD_META_ERR;
 	}
 
-	other_slot = (slot == BLD_SLOT_ID_A) ? (uint8_t)BLD_SLOT_ID_B :
-					       (uint8_t)BLD_SLOT_ID_A;
-
 	record.slots[slot].state = (uint8_t)BLD_SLOT_STATE_BAD;
 	record.slots[slot].boot_attempts_left = 0u;
 
@@ -325,19 +420,16 @@ int bld_meta_mark_slot_bad(const struct bld_storage *meta_storage,
 		record.pending_slot = (uint8_t)BLD_SLOT_ID_NONE;
 	}
 
+	bld_meta_record_to_ctrl(&record, &ctrl);
+
 	if (record.confirmed_slot == (uint8_t)slot) {
 		record.confirmed_slot =
-			bld_meta_slot_is_selectable_for_confirmed(&record,
-								  other_slot) ?
-				other_slot :
-				(uint8_t)BLD_SLOT_ID_NONE;
+			(uint8_t)bld_meta_choose_fallback_slot(&ctrl, slot, 0);
 	}
 
 	if (record.active_slot == (uint8_t)slot) {
-		record.active_slot = bld_meta_slot_is_selectable_for_active(
-					     &record, other_slot) ?
-					     other_slot :
-					     (uint8_t)BLD_SLOT_ID_NONE;
+		record.active_slot =
+			(uint8_t)bld_meta_choose_fallback_slot(&ctrl, slot, 1);
 	}
 
 	return bld_meta_record_write(meta_storage, &record);
@@ -360,8 +452,7 @@ int bld_meta_decrement_pending_attempts(const struct bld_storage *meta_storage,
 	}
 
 	slot = record.pending_slot;
-	if (slot == (uint8_t)BLD_SLOT_ID_NONE ||
-	    slot > (uint8_t)BLD_SLOT_ID_B) {
+	if (slot >= BLD_SLOT_COUNT) {
 		return BLD_META_ERR;
 	}
 
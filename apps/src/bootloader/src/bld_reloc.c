@@ -0,0 +1,165 @@
+#include "bld_reloc.h"
+
+#include <stddef.h>
+
+#define BLD_RELOC_OK 0
+#define BLD_RELOC_ERR (-1)
+
+#define BLD_RELOC_WORD_SIZE 4u
+#define BLD_RELOC_MAX_WORD_INDEX (UINT32_MAX / BLD_RELOC_WORD_SIZE)
+
+int bld_reloc_check_header(const struct bld_reloc_header *hdr,
+			   uint32_t artifact_size, uint32_t max_image_size,
+			   uint32_t max_table_size)
+{
+	uint32_t prefix;
+
+	if (hdr == NULL || hdr->magic != BLD_RELOC_MAGIC) {
+		return BLD_RELOC_ERR;
+	}
+
+	if (hdr->image_size == 0u || hdr->image_size > max_image_size ||
+	    hdr->table_size > max_table_size) {
+		return BLD_RELOC_ERR;
+	}
+
+	/* every entry takes at least one byte */
+	if (hdr->count > hdr->table_size) {
+		return BLD_RELOC_ERR;
+	}
+
+	prefix = (uint32_t)sizeof(*hdr) + hdr->table_size;
+	if ((prefix % BLD_RELOC_ALIGN) != 0u || artifact_size < prefix ||
+	    artifact_size - prefix != hdr->image_size) {
+		return BLD_RELOC_ERR;
+	}
+
+	return BLD_RELOC_OK;
+}
+
+static int bld_reloc_read_gap(struct bld_reloc *reloc, uint32_t *gap)
+{
+	uint32_t value = 0u;
+	uint32_t shift = 0u;
+	uint8_t byte;
+
+	do {
+		if (reloc->table_pos >= reloc->table_size || shift > 28u) {
+			return BLD_RELOC_ERR;
+		}
+
+		byte = reloc->table[reloc->table_pos++];
+		/* the fifth byte may only carry the top four bits */
+		if (shift == 28u && (byte & 0x70u) != 0u) {
+			return BLD_RELOC_ERR;
+		}
+
+		value |= (uint32_t)(byte & 0x7Fu) << shift;
+		shift += 7u;
+	} while ((byte & 0x80u) != 0u);
+
+	*gap = value;
+	return BLD_RELOC_OK;
+}
+
+/* Moves to the next relocated word, or goes inactive after the last one. */
+static int bld_reloc_advance(struct bld_reloc *reloc, int first)
+{
+	uint32_t index;
+	uint32_t gap;
+
+	reloc->active = 0u;
+	reloc->carry = 0u;
+	if (reloc->remaining == 0u) {
+		return BLD_RELOC_OK;
+	}
+
+	if (bld_reloc_read_gap(reloc, &gap) != BLD_RELOC_OK) {
+		return BLD_RELOC_ERR;
+	}
+
+	index = first ? 0u : reloc->next / BLD_RELOC_WORD_SIZE;
+	if ((!first && gap == 0u) || gap > BLD_RELOC_MAX_WORD_INDEX - index) {
+		return BLD_RELOC_ERR;
+	}
+
+	reloc->next = (index + gap) * BLD_RELOC_WORD_SIZE;
+	reloc->remaining--;
+	reloc->active = 1u;
+	return BLD_RELOC_OK;
+}
+
+int bld_reloc_begin(struct bld_reloc *reloc,
+		    const struct bld_reloc_header *hdr, const uint8_t *table,
+		    uint32_t load_base)
+{
+	if (reloc == NULL || hdr == NULL ||
+	    (table == NULL && hdr->table_size != 0u)) {
+		return BLD_RELOC_ERR;
+	}
+
+	reloc->table = table;
+	reloc->table_size = hdr->table_size;
+	reloc->table_pos = 0u;
+	reloc->delta = load_base - hdr->link_base;
+	reloc->remaining = hdr->count;
+	reloc->next = 0u;
+	reloc->offset = 0u;
+
+	return bld_reloc_advance(reloc, 1);
+}
+
+int bld_reloc_apply(struct bld_reloc *reloc, uint32_t offset, uint8_t *data,
+		    uint32_t len)
+{
+	uint32_t end;
+	uint32_t pos;
+	uint32_t byte;
+	uint32_t sum;
+
+	if (reloc == NULL || (data == NULL && len != 0u) ||
+	    offset != reloc->offset) {
+		return BLD_RELOC_ERR;
+	}
+
+	end = offset + len;
+	pos = offset;
+
+	/*
+	 * Little-endian addition runs from the low byte up, so a word is
+	 * rebased byte by byte with a carry and may span two pieces.
+	 */
+	while (reloc->active) {
+		if (pos < reloc->next) {
+			pos = reloc->next;
+		}
+		if (pos >= end) {
+			break;
+		}
+
+		byte = pos - reloc->next;
+		sum = (uint32_t)data[pos - offset] +
+		      ((reloc->delta >> (8u * byte)) & 0xFFu) + reloc->carry;
+		data[pos - offset] = (uint8_t)sum;
+		reloc->carry = sum >> 8;
+		pos++;
+
+		if (byte == BLD_RELOC_WORD_SIZE - 1u &&
+		    bld_reloc_advance(reloc, 0) != BLD_RELOC_OK) {
+			return BLD_RELOC_ERR;
+		}
+	}
+
+	reloc->offset = end;
+	return BLD_RELOC_OK;
+}
+
+int bld_reloc_finish(const struct bld_reloc *reloc, uint32_t image_size)
+{
+	if (reloc == NULL || reloc->offset != image_size || reloc->active ||
+	    reloc->remaining != 0u) {
+		return BLD_RELOC_ERR;
+	}
+
+	return BLD_RELOC_OK;
+}
@@ -244,6 +244,42 @@ int bld_storage_flash_init(struct bld_storage *storage,
 	storage->erase = stm32l4_erase;
 	storage->write = stm32l4_write;
 	storage->read = stm32l4_read;
+	storage->sync = NULL;
 	storage->ctx = ctx;
 	return BLD_STORAGE_OK;
-}
\ No newline at end of file
+}
+
+int bld_storage_flash_swap_banks(struct bld_storage_flash_ctx *ctx)
+{
+	uint32_t bank2_base;
+	uint32_t bank;
+
+	if (ctx == NULL || ctx->flash_bank2 == 0u ||
+	    ctx->flash_bank_size == 0u) {
+		return BLD_STORAGE_ERR;
+	}
+
+	bank2_base = ctx->flash_base + ctx->flash_bank_size;
+	if (ctx->region_base < ctx->flash_base ||
+	    ctx->region_base - ctx->flash_base >= 2u * ctx->flash_bank_size) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (ctx->region_base < bank2_base) {
+		if (ctx->region_size > bank2_base - ctx->region_base) {
+			return BLD_STORAGE_ERR;
+		}
+		ctx->region_base += ctx->flash_bank_size;
+	} else {
+		if (ctx->region_size >
+		    bank2_base + ctx->flash_bank_size - ctx->region_base) {
+			return BLD_STORAGE_ERR;
+		}
+		ctx->region_base -= ctx->flash_bank_size;
+	}
+
+	bank = ctx->flash_bank1;
+	ctx->flash_bank1 = ctx->flash_bank2;
+	ctx->flash_bank2 = bank;
+	return BLD_STORAGE_OK;
+}
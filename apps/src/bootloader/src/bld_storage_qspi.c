@@ -0,0 +1,162 @@
+#include "bld_storage_qspi.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BLD_STORAGE_OK 0
+#define BLD_STORAGE_ERR (-1)
+
+static inline uint32_t align_up(uint32_t size, uint32_t align)
+{
+	return ((size + align - 1u) / align) * align;
+}
+
+static bool range_valid(const struct bld_storage_qspi_ctx *ctx,
+			uint32_t offset, uint32_t len)
+{
+	if (offset > ctx->region_size) {
+		return false;
+	}
+	if (len > (ctx->region_size - offset)) {
+		return false;
+	}
+	return true;
+}
+
+static const struct bld_storage_qspi_ctx *
+qspi_ctx(const struct bld_storage *self)
+{
+	if (self == NULL || self->ctx == NULL) {
+		return NULL;
+	}
+	return (const struct bld_storage_qspi_ctx *)self->ctx;
+}
+
+static int qspi_erase(const struct bld_storage *self, uint32_t offset,
+		      uint32_t size)
+{
+	const struct bld_storage_qspi_ctx *ctx = qspi_ctx(self);
+	uint32_t addr;
+	uint32_t end;
+	int rc;
+
+	if (ctx == NULL || size == 0u ||
+	    (offset % ctx->sector_size) != 0u) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (size > ctx->region_size) {
+		return BLD_STORAGE_ERR;
+	}
+
+	size = align_up(size, ctx->sector_size);
+	if (!range_valid(ctx, offset, size)) {
+		return BLD_STORAGE_ERR;
+	}
+
+	addr = ctx->region_base + offset;
+	end = addr + size;
+
+	/* a block erase takes about as long as one sector erase */
+	while (addr < end) {
+		if (ctx->block_size != 0u && (addr % ctx->block_size) == 0u &&
+		    end - addr >= ctx->block_size) {
+			rc = ctx->ops->erase_block(ctx->hw, addr);
+			addr += ctx->block_size;
+		} else {
+			rc = ctx->ops->erase_sector(ctx->hw, addr);
+			addr += ctx->sector_size;
+		}
+
+		if (rc != 0) {
+			return BLD_STORAGE_ERR;
+		}
+	}
+
+	return BLD_STORAGE_OK;
+}
+
+static int qspi_write(const struct bld_storage *self, uint32_t offset,
+		      const uint8_t *data, uint32_t len)
+{
+	const struct bld_storage_qspi_ctx *ctx = qspi_ctx(self);
+	uint32_t addr;
+	uint32_t piece;
+
+	if (ctx == NULL || data == NULL || len == 0u) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (!range_valid(ctx, offset, len)) {
+		return BLD_STORAGE_ERR;
+	}
+
+	addr = ctx->region_base + offset;
+	while (len > 0u) {
+		/* a program command wraps around within its page */
+		piece = ctx->page_size - (addr % ctx->page_size);
+		if (piece > len) {
+			piece = len;
+		}
+
+		if (ctx->ops->program_page(ctx->hw, addr, data, piece) != 0) {
+			return BLD_STORAGE_ERR;
+		}
+
+		addr += piece;
+		data += piece;
+		len -= piece;
+	}
+
+	return BLD_STORAGE_OK;
+}
+
+static int qspi_read(const struct bld_storage *self, uint32_t offset,
+		     uint8_t *out, uint32_t len)
+{
+	const struct bld_storage_qspi_ctx *ctx = qspi_ctx(self);
+
+	if (ctx == NULL || out == NULL || len == 0u) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (!range_valid(ctx, offset, len)) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (ctx->ops->read(ctx->hw, ctx->region_base + offset, out, len) !=
+	    0) {
+		return BLD_STORAGE_ERR;
+	}
+
+	return BLD_STORAGE_OK;
+}
+
+int bld_storage_qspi_init(struct bld_storage *storage,
+			  const struct bld_storage_qspi_ctx *ctx)
+{
+	if (storage == NULL || ctx == NULL || ctx->ops == NULL ||
+	    ctx->ops->read == NULL || ctx->ops->erase_sector == NULL ||
+	    ctx->ops->program_page == NULL) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (ctx->sector_size == 0u || ctx->page_size == 0u ||
+	    (ctx->sector_size % ctx->page_size) != 0u ||
+	    (ctx->region_base % ctx->sector_size) != 0u) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (ctx->block_size != 0u &&
+	    (ctx->ops->erase_block == NULL ||
+	     (ctx->block_size % ctx->sector_size) != 0u)) {
+		return BLD_STORAGE_ERR;
+	}
+
+	storage->erase = qspi_erase;
+	storage->write = qspi_write;
+	storage->read = qspi_read;
+	storage->sync = NULL;
+	storage->ctx = ctx;
+	return BLD_STORAGE_OK;
+}
@@ -0,0 +1,180 @@
+#include "bld_storage_wc.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define BLD_STORAGE_OK 0
+#define BLD_STORAGE_ERR (-1)
+
+#define BLD_STORAGE_WC_ERASED_BYTE 0xFFu
+
+/* The context is the caller's and writable; bld_storage only holds it const. */
+static struct bld_storage_wc_ctx *wc_ctx(const struct bld_storage *self)
+{
+	if (self == NULL || self->ctx == NULL) {
+		return NULL;
+	}
+	return (struct bld_storage_wc_ctx *)self->ctx;
+}
+
+/* Writes out the buffered unit; the buffer is empty afterwards either way. */
+static int wc_flush(struct bld_storage_wc_ctx *ctx)
+{
+	uint32_t len = ctx->end;
+
+	if (len == 0u) {
+		return BLD_STORAGE_OK;
+	}
+
+	ctx->end = 0u;
+	if (ctx->inner.write(&ctx->inner, ctx->base, ctx->buf, len) != 0) {
+		return BLD_STORAGE_ERR;
+	}
+
+	return BLD_STORAGE_OK;
+}
+
+static int wc_erase(const struct bld_storage *self, uint32_t offset,
+		    uint32_t size)
+{
+	struct bld_storage_wc_ctx *ctx = wc_ctx(self);
+
+	if (ctx == NULL) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (ctx->end != 0u && ctx->base + ctx->start < offset + size &&
+	    offset < ctx->base + ctx->end) {
+		ctx->end = 0u;
+	}
+
+	return ctx->inner.erase(&ctx->inner, offset, size);
+}
+
+static int wc_write(const struct bld_storage *self, uint32_t offset,
+		    const uint8_t *data, uint32_t len)
+{
+	struct bld_storage_wc_ctx *ctx = wc_ctx(self);
+	uint32_t head;
+	uint32_t n;
+
+	if (ctx == NULL || data == NULL || len == 0u ||
+	    len > UINT32_MAX - offset) {
+		return BLD_STORAGE_ERR;
+	}
+
+	while (len > 0u) {
+		if (ctx->end != 0u && offset != ctx->base + ctx->end &&
+		    wc_flush(ctx) != 0) {
+			return BLD_STORAGE_ERR;
+		}
+
+		head = offset & (ctx->unit - 1u);
+		if (ctx->end == 0u && head == 0u && len >= ctx->unit) {
+			n = len & ~(ctx->unit - 1u);
+			if (ctx->inner.write(&ctx->inner, offset, data, n) !=
+			    0) {
+				return BLD_STORAGE_ERR;
+			}
+		} else {
+			if (ctx->end == 0u) {
+				memset(ctx->buf, BLD_STORAGE_WC_ERASED_BYTE,
+				       ctx->unit);
+				ctx->base = offset - head;
+				ctx->start = head;
+				ctx->end = head;
+			}
+
+			n = ctx->unit - ctx->end;
+			if (n > len) {
+				n = len;
+			}
+			memcpy(&ctx->buf[ctx->end], data, n);
+			ctx->end += n;
+
+			if (ctx->end == ctx->unit && wc_flush(ctx) != 0) {
+				return BLD_STORAGE_ERR;
+			}
+		}
+
+		offset += n;
+		data += n;
+		len -= n;
+	}
+
+	return BLD_STORAGE_OK;
+}
+
+static int wc_read(const struct bld_storage *self, uint32_t offset,
+		   uint8_t *out, uint32_t len)
+{
+	struct bld_storage_wc_ctx *ctx = wc_ctx(self);
+	uint32_t lo;
+	uint32_t hi;
+
+	if (ctx == NULL ||
+	    ctx->inner.read(&ctx->inner, offset, out, len) != 0) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (ctx->end == 0u) {
+		return BLD_STORAGE_OK;
+	}
+
+	/* overlay the part of the buffered unit that was asked for */
+	lo = ctx->base + ctx->start;
+	hi = ctx->base + ctx->end;
+	if (lo < offset) {
+		lo = offset;
+	}
+	if (hi > offset + len) {
+		hi = offset + len;
+	}
+	if (lo < hi) {
+		memcpy(&out[lo - offset], &ctx->buf[lo - ctx->base], hi - lo);
+	}
+
+	return BLD_STORAGE_OK;
+}
+
+static int wc_sync(const struct bld_storage *self)
+{
+	struct bld_storage_wc_ctx *ctx = wc_ctx(self);
+
+	if (ctx == NULL || wc_flush(ctx) != 0) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (ctx->inner.sync != NULL) {
+		return ctx->inner.sync(&ctx->inner);
+	}
+
+	return BLD_STORAGE_OK;
+}
+
+int bld_storage_wc_init(struct bld_storage *storage,
+			struct bld_storage_wc_ctx *ctx,
+			const struct bld_storage *inner, uint32_t unit)
+{
+	if (storage == NULL || ctx == NULL || inner == NULL ||
+	    inner->erase == NULL || inner->write == NULL ||
+	    inner->read == NULL) {
+		return BLD_STORAGE_ERR;
+	}
+
+	if (unit == 0u || unit > BLD_WRITE_COMBINE_SIZE ||
+	    (unit & (unit - 1u)) != 0u) {
+		return BLD_STORAGE_ERR;
+	}
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->inner = *inner;
+	ctx->unit = unit;
+
+	storage->erase = wc_erase;
+	storage->write = wc_write;
+	storage->read = wc_read;
+	storage->sync = wc_sync;
+	storage->ctx = ctx;
+	return BLD_STORAGE_OK;
+}
@@ -10,6 +10,8 @@
 #include "bld_config.h"
 #include "bld_engine.h"
 #include "bld_storage_flash.h"
+#include "bld_storage_qspi.h"
+#include "bld_storage_wc.h"
 #include "bld_transport_uart_dma.h"
 #include "gpio.h"
 #include "stm32l4xx_hal_flash_ex.h"
@@ -17,6 +19,9 @@
 UART_HandleTypeDef huart4;
 struct bld_uart_dma_ctx g_bld_uart_ctx;
 DMA_HandleTypeDef hdma_uart4_rx;
+#if BLD_STAGING_QSPI
+QSPI_HandleTypeDef hqspi;
+#endif
 
 extern "C" {
 // System Clock Configuration: 80MHz
@@ -140,6 +145,200 @@ int stm32_flash_program_doubleword(void* hw, uint32_t addr, uint64_t data) {
              : -1;
 }
 
+#if BLD_STAGING_QSPI
+/* MX25R6435F commands and status bits */
+#define MX25R_WRITE_ENABLE 0x06u
+#define MX25R_READ_STATUS 0x05u
+#define MX25R_WRITE_STATUS 0x01u
+#define MX25R_QUAD_READ 0x6Bu
+#define MX25R_PAGE_PROGRAM 0x02u
+#define MX25R_SECTOR_ERASE 0x20u
+#define MX25R_BLOCK_ERASE 0xD8u
+#define MX25R_QUAD_READ_DUMMY 8u
+#define MX25R_SR_WIP 0x01u
+#define MX25R_SR_WEL 0x02u
+#define MX25R_SR_QE 0x40u
+
+/* Worst-case times from the datasheet, in ms */
+#define MX25R_PROGRAM_TIMEOUT 10u
+#define MX25R_SECTOR_ERASE_TIMEOUT 240u
+#define MX25R_BLOCK_ERASE_TIMEOUT 3500u
+
+static QSPI_CommandTypeDef stm32_qspi_command(uint8_t instruction) {
+  QSPI_CommandTypeDef cmd;
+
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.InstructionMode = QSPI_INSTRUCTION_1_LINE;
+  cmd.Instruction = instruction;
+  cmd.AddressMode = QSPI_ADDRESS_NONE;
+  cmd.AddressSize = QSPI_ADDRESS_24_BITS;
+  cmd.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE;
+  cmd.DataMode = QSPI_DATA_NONE;
+  cmd.DdrMode = QSPI_DDR_MODE_DISABLE;
+  cmd.DdrHoldHalfCycle = QSPI_DDR_HHC_ANALOG_DELAY;
+  cmd.SIOOMode = QSPI_SIOO_INST_EVERY_CMD;
+  return cmd;
+}
+
+/* Polls the status register until (status & mask) == match. */
+static int stm32_qspi_wait_status(QSPI_HandleTypeDef* hqspi,
+                                  uint8_t mask,
+                                  uint8_t match,
+                                  uint32_t timeout_ms) {
+  QSPI_CommandTypeDef cmd = stm32_qspi_command(MX25R_READ_STATUS);
+  QSPI_AutoPollingTypeDef poll;
+
+  cmd.DataMode = QSPI_DATA_1_LINE;
+  memset(&poll, 0, sizeof(poll));
+  poll.Match = match;
+  poll.Mask = mask;
+  poll.MatchMode = QSPI_MATCH_MODE_AND;
+  poll.StatusBytesSize = 1;
+  poll.Interval = 0x10;
+  poll.AutomaticStop = QSPI_AUTOMATIC_STOP_ENABLE;
+
+  return (HAL_QSPI_AutoPolling(hqspi, &cmd, &poll, timeout_ms) == HAL_OK)
+             ? 0
+             : -1;
+}
+
+static int stm32_qspi_write_enable(QSPI_HandleTypeDef* hqspi) {
+  QSPI_CommandTypeDef cmd = stm32_qspi_command(MX25R_WRITE_ENABLE);
+
+  if (HAL_QSPI_Command(hqspi, &cmd, HAL_QSPI_TIMEOUT_DEFAULT_VALUE) !=
+      HAL_OK) {
+    return -1;
+  }
+  return stm32_qspi_wait_status(
+      hqspi, MX25R_SR_WEL, MX25R_SR_WEL, HAL_QSPI_TIMEOUT_DEFAULT_VALUE);
+}
+
+static int stm32_qspi_erase(QSPI_HandleTypeDef* hqspi,
+                            uint8_t instruction,
+                            uint32_t addr,
+                            uint32_t timeout_ms) {
+  QSPI_CommandTypeDef cmd = stm32_qspi_command(instruction);
+
+  if (stm32_qspi_write_enable(hqspi) != 0) {
+    return -1;
+  }
+
+  cmd.AddressMode = QSPI_ADDRESS_1_LINE;
+  cmd.Address = addr;
+  if (HAL_QSPI_Command(hqspi, &cmd, HAL_QSPI_TIMEOUT_DEFAULT_VALUE) !=
+      HAL_OK) {
+    return -1;
+  }
+  return stm32_qspi_wait_status(hqspi, MX25R_SR_WIP, 0u, timeout_ms);
+}
+
+/* QSPI NOR hardware wrapper functions */
+int stm32_qspi_read(void* hw, uint32_t addr, uint8_t* out, uint32_t len) {
+  QSPI_HandleTypeDef* hqspi = (QSPI_HandleTypeDef*)hw;
+  QSPI_CommandTypeDef cmd = stm32_qspi_command(MX25R_QUAD_READ);
+
+  cmd.AddressMode = QSPI_ADDRESS_1_LINE;
+  cmd.Address = addr;
+  cmd.DataMode = QSPI_DATA_4_LINES;
+  cmd.DummyCycles = MX25R_QUAD_READ_DUMMY;
+  cmd.NbData = len;
+
+  if (HAL_QSPI_Command(hqspi, &cmd, HAL_QSPI_TIMEOUT_DEFAULT_VALUE) !=
+      HAL_OK) {
+    return -1;
+  }
+  return (HAL_QSPI_Receive(hqspi, out, HAL_QSPI_TIMEOUT_DEFAULT_VALUE) ==
+          HAL_OK)
+             ? 0
+             : -1;
+}
+
+int stm32_qspi_erase_sector(void* hw, uint32_t addr) {
+  return stm32_qspi_erase((QSPI_HandleTypeDef*)hw,
+                          MX25R_SECTOR_ERASE,
+                          addr,
+                          MX25R_SECTOR_ERASE_TIMEOUT);
+}
+
+int stm32_qspi_erase_block(void* hw, uint32_t addr) {
+  return stm32_qspi_erase((QSPI_HandleTypeDef*)hw,
+                          MX25R_BLOCK_ERASE,
+                          addr,
+                          MX25R_BLOCK_ERASE_TIMEOUT);
+}
+
+int stm32_qspi_program_page(void* hw,
+                            uint32_t addr,
+                            const uint8_t* data,
+                            uint32_t len) {
+  QSPI_HandleTypeDef* hqspi = (QSPI_HandleTypeDef*)hw;
+  QSPI_CommandTypeDef cmd = stm32_qspi_command(MX25R_PAGE_PROGRAM);
+
+  if (stm32_qspi_write_enable(hqspi) != 0) {
+    return -1;
+  }
+
+  cmd.AddressMode = QSPI_ADDRESS_1_LINE;
+  cmd.Address = addr;
+  cmd.DataMode = QSPI_DATA_1_LINE;
+  cmd.NbData = len;
+
+  if (HAL_QSPI_Command(hqspi, &cmd, HAL_QSPI_TIMEOUT_DEFAULT_VALUE) !=
+          HAL_OK ||
+      HAL_QSPI_Transmit(hqspi, (uint8_t*)data,
+                        HAL_QSPI_TIMEOUT_DEFAULT_VALUE) != HAL_OK) {
+    return -1;
+  }
+  return stm32_qspi_wait_status(
+      hqspi, MX25R_SR_WIP, 0u, MX25R_PROGRAM_TIMEOUT);
+}
+
+/* 80 MHz / 3 stays under the MX25R's 33 MHz in its ultra-low-power mode. */
+int MX_QUADSPI_Init(void) {
+  QSPI_CommandTypeDef cmd;
+  uint8_t status = 0;
+
+  hqspi.Instance = QUADSPI;
+  hqspi.Init.ClockPrescaler = 2;
+  hqspi.Init.FifoThreshold = 4;
+  hqspi.Init.SampleShifting = QSPI_SAMPLE_SHIFTING_HALFCYCLE;
+  hqspi.Init.FlashSize = POSITION_VAL(BLD_QSPI_FLASH_SIZE) - 1u;
+  hqspi.Init.ChipSelectHighTime = QSPI_CS_HIGH_TIME_1_CYCLE;
+  hqspi.Init.ClockMode = QSPI_CLOCK_MODE_0;
+  if (HAL_QSPI_Init(&hqspi) != HAL_OK) {
+    return -1;
+  }
+
+  /* Quad reads need the QE bit, which is non-volatile. */
+  cmd = stm32_qspi_command(MX25R_READ_STATUS);
+  cmd.DataMode = QSPI_DATA_1_LINE;
+  cmd.NbData = 1;
+  if (HAL_QSPI_Command(&hqspi, &cmd, HAL_QSPI_TIMEOUT_DEFAULT_VALUE) !=
+          HAL_OK ||
+      HAL_QSPI_Receive(&hqspi, &status, HAL_QSPI_TIMEOUT_DEFAULT_VALUE) !=
+          HAL_OK) {
+    return -1;
+  }
+  if ((status & MX25R_SR_QE) != 0u) {
+    return 0;
+  }
+
+  status |= MX25R_SR_QE;
+  cmd = stm32_qspi_command(MX25R_WRITE_STATUS);
+  cmd.DataMode = QSPI_DATA_1_LINE;
+  cmd.NbData = 1;
+  if (stm32_qspi_write_enable(&hqspi) != 0 ||
+      HAL_QSPI_Command(&hqspi, &cmd, HAL_QSPI_TIMEOUT_DEFAULT_VALUE) !=
+          HAL_OK ||
+      HAL_QSPI_Transmit(&hqspi, &status, HAL_QSPI_TIMEOUT_DEFAULT_VALUE) !=
+          HAL_OK) {
+    return -1;
+  }
+  return stm32_qspi_wait_status(
+      &hqspi, MX25R_SR_WIP, 0u, HAL_QSPI_TIMEOUT_DEFAULT_VALUE);
+}
+#endif
+
 /* UART DMA hardware wrapper functions */
 int stm32_uart_rx_start(void* uart, uint8_t* buf, uint16_t len) {
   UART_HandleTypeDef* huart = (UART_HandleTypeDef*)uart;
@@ -165,7 +364,132 @@ uint32_t stm32_now_ms(void* time_ctx) {
 }
 }
 
+namespace {
+
+const struct bld_flash_ops kFlashOps = {
+    .unlock = stm32_flash_unlock,
+    .lock = stm32_flash_lock,
+    .read = stm32_hal_read,
+    .erase_pages = stm32_flash_erase_pages,
+    .program_doubleword = stm32_flash_program_doubleword,
+};
+
+#if BLD_STAGING_QSPI
+const struct bld_qspi_ops kQspiOps = {
+    .read = stm32_qspi_read,
+    .erase_sector = stm32_qspi_erase_sector,
+    .erase_block = stm32_qspi_erase_block,
+    .program_page = stm32_qspi_program_page,
+};
+
+const struct bld_storage_qspi_ctx kStagingCtx = {
+    .region_base = BLD_STAGING_BASE,
+    .region_size = BLD_STAGING_SIZE,
+    .sector_size = BLD_QSPI_SECTOR_SIZE,
+    .block_size = BLD_QSPI_BLOCK_SIZE,
+    .page_size = BLD_QSPI_PAGE_SIZE,
+    .ops = &kQspiOps,
+    .hw = &hqspi,
+};
+#endif
+
+constexpr uint32_t kSlotBases[BLD_SLOT_COUNT] = BLD_SLOT_BASES;
+constexpr uint32_t kSlotSizes[BLD_SLOT_COUNT] = BLD_SLOT_SIZES;
+
+// Filled from kSlotBases and kSlotSizes by MapFlashRegions().
+struct bld_storage_flash_ctx g_slot_ctx[BLD_SLOT_COUNT];
+
+// Slot writes are combined into whole rows, so DATA chunks may have any size.
+struct bld_storage_wc_ctx g_slot_wc[BLD_SLOT_COUNT];
+
+struct bld_storage_flash_ctx g_meta_ctx = {
+    .region_base = BLD_META_BASE,
+    .region_size = BLD_META_SIZE,
+    .page_size = 2048u,
+    .flash_base = FLASH_BASE,
+    .flash_bank_size = FLASH_BANK_SIZE,
+    .flash_page_size = FLASH_PAGE_SIZE,
+    .flash_bank1 = FLASH_BANK_1,
+    .flash_bank2 = FLASH_BANK_2,
+    .ops = &kFlashOps,
+    .hw = NULL,
+};
+
+// Slot regions are laid out like the metadata one. The contexts describe
+// the default memory map; started from bank 2, the boot ROM has swapped the
+// banks, and with them every region.
+void MapFlashRegions(const struct bld_bank_ops* bank) {
+  for (uint32_t i = 0; i < BLD_SLOT_COUNT; ++i) {
+    g_slot_ctx[i] = g_meta_ctx;
+    g_slot_ctx[i].region_base = kSlotBases[i];
+    g_slot_ctx[i].region_size = kSlotSizes[i];
+  }
+
+  if (bank == nullptr || bank->active(bank) != 1) {
+    return;
+  }
+
+  for (auto& ctx : g_slot_ctx) {
+    (void)bld_storage_flash_swap_banks(&ctx);
+  }
+  (void)bld_storage_flash_swap_banks(&g_meta_ctx);
+}
+
+int InitSlotStorage(struct bld_storage* slot_storage) {
+  struct bld_storage flash;
+
+  for (uint32_t i = 0; i < BLD_SLOT_COUNT; ++i) {
+    if (bld_storage_flash_init(&flash, &g_slot_ctx[i]) != 0 ||
+        bld_storage_wc_init(&slot_storage[i],
+                            &g_slot_wc[i],
+                            &flash,
+                            BLD_WRITE_COMBINE_SIZE) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// Runs straight out of reset, on the 4 MHz MSI with nothing initialised:
+// metadata and the vector table are read through memory-mapped flash and
+// the button through one GPIO register. A confirmed image is entered from
+// here without clock, DMA or UART setup; anything else (button held, trial
+// boot pending, metadata or vectors in doubt) returns to the full path.
+void FastBoot(const struct bld_bank_ops* bank) {
+  struct bld_storage slot_storage[BLD_SLOT_COUNT];
+  struct bld_storage meta_storage;
+  uint32_t image_base;
+
+  bsp_button_init();
+  if (bsp_button_status()) {
+    return;
+  }
+
+  if (InitSlotStorage(slot_storage) != 0 ||
+      bld_storage_flash_init(&meta_storage, &g_meta_ctx) != 0) {
+    return;
+  }
+
+  if (bld_engine_fast_boot_slot(
+          &meta_storage, slot_storage, bank, &image_base) == 0) {
+    bld_jump_to_image(image_base);
+  }
+}
+
+}  // namespace
+
 extern "C" int main(void) {
+  // Address mode unless built for the dual-bank boot mode (bld_config.h).
+  const struct bld_bank_ops* bank = nullptr;
+#if BLD_BOOT_BANK_SWAP
+  static struct bld_bank_ops bank_ops;
+  bank_ops = bld_boot_bank_ops();
+  bank = &bank_ops;
+#endif
+  MapFlashRegions(bank);
+
+  FastBoot(bank);
+
   HAL_Init();
 
   SystemClock_Config();
@@ -189,67 +513,30 @@ extern "C" int main(void) {
   bld_uart_dma_start(&g_bld_uart_ctx);
   struct bld_transport transport = bld_transport_uart_dma_make(&g_bld_uart_ctx);
 
-  struct bld_storage slot_a_storage;
-  struct bld_storage slot_b_storage;
+  struct bld_storage slot_storage[BLD_SLOT_COUNT];
   struct bld_storage meta_storage;
 
-  static const struct bld_flash_ops g_flash_ops = {
-      .unlock = stm32_flash_unlock,
-      .lock = stm32_flash_lock,
-      .read = stm32_hal_read,
-      .erase_pages = stm32_flash_erase_pages,
-      .program_doubleword = stm32_flash_program_doubleword,
-  };
+  (void)InitSlotStorage(slot_storage);
+  (void)bld_storage_flash_init(&meta_storage, &g_meta_ctx);
 
-  const struct bld_storage_flash_ctx slot_a_ctx = {
-      .region_base = BLD_SLOT_A_BASE,
-      .region_size = BLD_SLOT_A_SIZE,
-      .page_size = 2048u,
-      .flash_base = FLASH_BASE,
-      .flash_bank_size = FLASH_BANK_SIZE,
-      .flash_page_size = FLASH_PAGE_SIZE,
-      .flash_bank1 = FLASH_BANK_1,
-      .flash_bank2 = FLASH_BANK_2,
-      .ops = &g_flash_ops,
-      .hw = NULL,
-  };
-
-  const struct bld_storage_flash_ctx slot_b_ctx = {
-      .region_base = BLD_SLOT_B_BASE,
-      .region_size = BLD_SLOT_B_SIZE,
-      .page_size = 2048u,
-      .flash_base = FLASH_BASE,
-      .flash_bank_size = FLASH_BANK_SIZE,
-      .flash_page_size = FLASH_PAGE_SIZE,
-      .flash_bank1 = FLASH_BANK_1,
-      .flash_bank2 = FLASH_BANK_2,
-      .ops = &g_flash_ops,
-      .hw = NULL,
-  };
+  // Holds the relocation table of an incoming image; keep it off the stack.
+  static struct bld_engine engine;
+  bld_engine_init(&engine, &transport, slot_storage, &meta_storage);
+  (void)bld_engine_set_bank_ops(&engine, bank);
 
-  const struct bld_storage_flash_ctx meta_ctx = {
-      .region_base = BLD_META_BASE,
-      .region_size = BLD_META_SIZE,
-      .page_size = 2048u,
-      .flash_base = FLASH_BASE,
-      .flash_bank_size = FLASH_BANK_SIZE,
-      .flash_page_size = FLASH_PAGE_SIZE,
-      .flash_bank1 = FLASH_BANK_1,
-      .flash_bank2 = FLASH_BANK_2,
-      .ops = &g_flash_ops,
-      .hw = NULL,
-  };
-
-  (void)bld_storage_flash_init(&slot_a_storage, &slot_a_ctx);
-  (void)bld_storage_flash_init(&slot_b_storage, &slot_b_ctx);
-  (void)bld_storage_flash_init(&meta_storage, &meta_ctx);
-
-  struct bld_engine engine;
-  bld_engine_init(
-      &engine, &transport, &slot_a_storage, &slot_b_storage, &meta_storage);
+#if BLD_STAGING_QSPI
+  // Without the external flash, updates go straight to their slot.
+  static struct bld_storage staging;
+  if (MX_QUADSPI_Init() == 0 &&
+      bld_storage_qspi_init(&staging, &kStagingCtx) == 0) {
+    (void)bld_engine_set_staging(&engine, &staging, BLD_STAGING_SIZE);
+  }
+#endif
 
   /*
-   * Boot application unless the user explicitly requests bootloader mode.
+   * The fast path declined: a trial boot is pending, the confirmed image
+   * looked wrong, or the button is held. Without the button, make the full
+   * decision (verify, count attempts, fall back) and boot if possible.
    */
   if (!bsp_button_status()) {
     (void)bld_engine_boot_decide_and_jump(&engine);
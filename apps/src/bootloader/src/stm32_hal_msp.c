@@ -59,4 +59,35 @@ void HAL_UART_MspInit(UART_HandleTypeDef *huart)
 
 		/* USER CODE END UART4_MspInit 1 */
 	}
-}
\ No newline at end of file
+}
+
+#ifdef HAL_QSPI_MODULE_ENABLED
+void HAL_QSPI_MspInit(QSPI_HandleTypeDef *hqspi)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = { 0 };
+	if (hqspi->Instance == QUADSPI) {
+		/* Peripheral clock enable */
+		__HAL_RCC_QSPI_CLK_ENABLE();
+
+		__HAL_RCC_GPIOE_CLK_ENABLE();
+		/**QUADSPI GPIO Configuration
+    PE10     ------> QUADSPI_CLK
+    PE11     ------> QUADSPI_NCS
+    PE12     ------> QUADSPI_BK1_IO0
+    PE13     ------> QUADSPI_BK1_IO1
+    PE14     ------> QUADSPI_BK1_IO2
+    PE15     ------> QUADSPI_BK1_IO3
+    */
+		GPIO_InitStruct.Pin = QUADSPI_CLK_Pin | QUADSPI_NCS_Pin |
+				      OQUADSPI_BK1_IO0_Pin |
+				      QUADSPI_BK1_IO1_Pin |
+				      QUAD_SPI_BK1_IO2_Pin |
+				      QUAD_SPI_BK1_IO3_Pin;
+		GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+		GPIO_InitStruct.Pull = GPIO_NOPULL;
+		GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+		GPIO_InitStruct.Alternate = GPIO_AF10_QUADSPI;
+		HAL_GPIO_Init(GPIOE, &GPIO_InitStruct);
+	}
+}
+#endif
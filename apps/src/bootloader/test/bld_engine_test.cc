@@ -3,10 +3,12 @@
 #include <bld_meta.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <array>
 #include <vector>
 
 #include "bld_config.h"
+#include "bld_storage_wc.h"
 #include "test_stubs.h"
 
 namespace {
@@ -19,6 +21,13 @@ bld_meta_frame LastMeta(const test::FakeTransportCtx& ctx) {
   return test::ReadStruct<bld_meta_frame>(ctx.last_sent);
 }
 
+bld_meta_slot_wire LastMetaSlot(const test::FakeTransportCtx& ctx,
+                                size_t slot) {
+  return test::ReadStruct<bld_meta_slot_wire>(
+      ctx.last_sent,
+      sizeof(bld_meta_frame) + slot * sizeof(bld_meta_slot_wire));
+}
+
 bld_boot_control MakeEmptyBootCtrl() {
   bld_boot_control ctrl{};
   ctrl.active_slot = BLD_SLOT_ID_NONE;
@@ -34,6 +43,56 @@ bld_boot_control MakeEmptyBootCtrl() {
   return ctrl;
 }
 
+// 40 flash pages of non-repeating bytes.
+std::vector<uint8_t> MakeMultiPageImage() {
+  std::vector<uint8_t> image(40u * BLD_FLASH_PAGE_SIZE + 123u);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<uint8_t>((i * 31u) ^ (i >> 8));
+  }
+  return image;
+}
+
+uint32_t Crc(const std::vector<uint8_t>& bytes) {
+  return bld_crc32_ieee(bytes.data(), bytes.size(), BLD_CRC32_INITIAL);
+}
+
+// Initial stack pointer and Thumb reset handler, as a linked image starts.
+void WriteVectors(std::vector<uint8_t>& slot, uint32_t msp, uint32_t reset) {
+  memcpy(slot.data(), &msp, sizeof(msp));
+  memcpy(slot.data() + sizeof(msp), &reset, sizeof(reset));
+}
+
+// Option bytes of a dual-bank part: the bank the CPU started from and the
+// bank the last select asked for.
+struct FakeBank {
+  int active = 0;
+  int selected = -1;
+  int select_calls = 0;
+  int select_result = 0;
+};
+
+int FakeBankActive(const bld_bank_ops* self) {
+  return static_cast<const FakeBank*>(self->ctx)->active;
+}
+
+int FakeBankSelect(const bld_bank_ops* self, uint8_t bank) {
+  auto* fake = const_cast<FakeBank*>(static_cast<const FakeBank*>(self->ctx));
+  fake->select_calls++;
+  if (fake->select_result != 0) {
+    return fake->select_result;
+  }
+  fake->selected = bank;
+  return 0;
+}
+
+bld_bank_ops MakeFakeBankOps(FakeBank* fake) {
+  bld_bank_ops ops{};
+  ops.active = FakeBankActive;
+  ops.select = FakeBankSelect;
+  ops.ctx = fake;
+  return ops;
+}
+
 }  // namespace
 
 class BldEngineTest : public ::testing::Test {
@@ -45,8 +104,8 @@ class BldEngineTest : public ::testing::Test {
     slot_b_ctx.bytes.resize(BLD_SLOT_B_SIZE, 0xFF);
     meta_ctx.bytes.resize(128u, 0xFF);
 
-    slot_a_storage = test::MakeFakeStorage(&slot_a_ctx);
-    slot_b_storage = test::MakeFakeStorage(&slot_b_ctx);
+    slot_storage[BLD_SLOT_ID_A] = test::MakeFakeStorage(&slot_a_ctx);
+    slot_storage[BLD_SLOT_ID_B] = test::MakeFakeStorage(&slot_b_ctx);
     meta_storage = test::MakeFakeStorage(&meta_ctx);
     transport = test::MakeFakeTransport(&transport_ctx);
   }
@@ -54,8 +113,7 @@ class BldEngineTest : public ::testing::Test {
   void InitEngine() {
     ASSERT_EQ(bld_engine_init(&engine,
                               &transport,
-                              &slot_a_storage,
-                              &slot_b_storage,
+                              slot_storage,
                               &meta_storage),
               0);
   }
@@ -64,6 +122,35 @@ class BldEngineTest : public ::testing::Test {
     ASSERT_EQ(bld_meta_write_boot_control(&meta_storage, &ctrl), 0);
   }
 
+  // Runs START, HEADER and DATA frames for image; END is left to the test.
+  // Returns the slot the image went to.
+  bld_slot_id SendImage(const std::vector<uint8_t>& image,
+                        uint32_t crc,
+                        size_t chunk = 1000u) {
+
+    transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_START);
+    bld_engine_poll(&engine, 1u);
+    const bld_slot_id slot = engine.target_slot;
+
+    transport_ctx.next_frame =
+        test::MakeHeaderFrame(static_cast<uint32_t>(image.size()), crc, 3u);
+    bld_engine_poll(&engine, 1u);
+
+    uint32_t seq = 0u;
+    for (size_t off = 0; off < image.size(); off += chunk) {
+      const size_t n = std::min(chunk, image.size() - off);
+      transport_ctx.next_frame = test::MakeDataFrame(
+          seq++, image.data() + off, static_cast<uint16_t>(n));
+      bld_engine_poll(&engine, 1u);
+    }
+    EXPECT_EQ(engine.state, BLD_STATE_WAIT_END);
+    return slot;
+  }
+
+  test::FakeStorageCtx& SlotCtx(bld_slot_id slot) {
+    return slot == BLD_SLOT_ID_A ? slot_a_ctx : slot_b_ctx;
+  }
+
   bld_boot_control ReadBootCtrl() {
     bld_boot_control ctrl{};
     EXPECT_EQ(bld_meta_read_boot_control(&meta_storage, &ctrl), 0);
@@ -75,8 +162,7 @@ class BldEngineTest : public ::testing::Test {
   test::FakeStorageCtx meta_ctx;
   test::FakeTransportCtx transport_ctx;
 
-  bld_storage slot_a_storage{};
-  bld_storage slot_b_storage{};
+  bld_storage slot_storage[BLD_SLOT_COUNT]{};
   bld_storage meta_storage{};
   bld_transport transport{};
   bld_engine engine{};
@@ -84,22 +170,10 @@ class BldEngineTest : public ::testing::Test {
 
 TEST_F(BldEngineTest, InitRejectsNullArguments) {
   EXPECT_LT(
-      bld_engine_init(
-          nullptr, &transport, &slot_a_storage, &slot_b_storage, &meta_storage),
-      0);
-  EXPECT_LT(
-      bld_engine_init(
-          &engine, nullptr, &slot_a_storage, &slot_b_storage, &meta_storage),
-      0);
-  EXPECT_LT(bld_engine_init(
-                &engine, &transport, nullptr, &slot_b_storage, &meta_storage),
-            0);
-  EXPECT_LT(bld_engine_init(
-                &engine, &transport, &slot_a_storage, nullptr, &meta_storage),
-            0);
-  EXPECT_LT(bld_engine_init(
-                &engine, &transport, &slot_a_storage, &slot_b_storage, nullptr),
-            0);
+      bld_engine_init(nullptr, &transport, slot_storage, &meta_storage), 0);
+  EXPECT_LT(bld_engine_init(&engine, nullptr, slot_storage, &meta_storage), 0);
+  EXPECT_LT(bld_engine_init(&engine, &transport, nullptr, &meta_storage), 0);
+  EXPECT_LT(bld_engine_init(&engine, &transport, slot_storage, nullptr), 0);
 }
 
 TEST_F(BldEngineTest, InitSucceedsAndStartsIdleWhenMetaIsInvalid) {
@@ -156,17 +230,33 @@ TEST_F(BldEngineTest, MetaCommandSendsBootControlFrame) {
   EXPECT_EQ(frame.active_slot, BLD_SLOT_ID_A);
   EXPECT_EQ(frame.confirmed_slot, BLD_SLOT_ID_A);
   EXPECT_EQ(frame.pending_slot, BLD_SLOT_ID_B);
-
-  EXPECT_EQ(frame.slot_a.version, 11u);
-  EXPECT_EQ(frame.slot_a.size, 333u);
-  EXPECT_EQ(frame.slot_a.crc32, 0x11223344u);
-  EXPECT_EQ(frame.slot_a.state, BLD_SLOT_STATE_CONFIRMED);
-
-  EXPECT_EQ(frame.slot_b.version, 12u);
-  EXPECT_EQ(frame.slot_b.size, 444u);
-  EXPECT_EQ(frame.slot_b.crc32, 0x55667788u);
-  EXPECT_EQ(frame.slot_b.state, BLD_SLOT_STATE_PENDING);
-  EXPECT_EQ(frame.slot_b.boot_attempts_left, 3u);
+  EXPECT_EQ(frame.slot_count, BLD_SLOT_COUNT);
+  EXPECT_EQ(frame.target_slot, BLD_SLOT_ID_B);
+
+  // LEN covers the slots actually present; CRC and EOF follow them.
+  const size_t slots_end =
+      sizeof(bld_meta_frame) + BLD_SLOT_COUNT * sizeof(bld_meta_slot_wire);
+  EXPECT_EQ(frame.len, slots_end - 4u);
+  ASSERT_EQ(transport_ctx.last_sent.size(), slots_end + 5u);
+  EXPECT_EQ(test::ReadStruct<uint32_t>(transport_ctx.last_sent, slots_end),
+            test::FrameCrc(transport_ctx.last_sent.data(), slots_end));
+  EXPECT_EQ(transport_ctx.last_sent.back(), BLD_EOF);
+
+  const auto slot_a = LastMetaSlot(transport_ctx, BLD_SLOT_ID_A);
+  EXPECT_EQ(slot_a.version, 11u);
+  EXPECT_EQ(slot_a.size, 333u);
+  EXPECT_EQ(slot_a.crc32, 0x11223344u);
+  EXPECT_EQ(slot_a.state, BLD_SLOT_STATE_CONFIRMED);
+  EXPECT_EQ(slot_a.flags, 0u);
+  EXPECT_EQ(slot_a.load_base, BLD_SLOT_A_BASE);
+
+  const auto slot_b = LastMetaSlot(transport_ctx, BLD_SLOT_ID_B);
+  EXPECT_EQ(slot_b.version, 12u);
+  EXPECT_EQ(slot_b.size, 444u);
+  EXPECT_EQ(slot_b.crc32, 0x55667788u);
+  EXPECT_EQ(slot_b.state, BLD_SLOT_STATE_PENDING);
+  EXPECT_EQ(slot_b.boot_attempts_left, 3u);
+  EXPECT_EQ(slot_b.load_base, BLD_SLOT_B_BASE);
 }
 
 TEST_F(BldEngineTest, StartCommandChoosesOtherThanActiveSlot) {
@@ -363,6 +453,359 @@ TEST_F(BldEngineTest, EndCommandWithBadStoredImageCrcReturnsBadCrc) {
   EXPECT_EQ(status.detail, wrong_crc);
 }
 
+TEST_F(BldEngineTest, SetVerifyModeRejectsUnknownModes) {
+  InitEngine();
+  EXPECT_EQ(engine.verify_mode, BLD_VERIFY_MODE_DEFAULT);
+  EXPECT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_FULL), 0);
+  EXPECT_EQ(engine.verify_mode, BLD_VERIFY_FULL);
+  EXPECT_LT(bld_engine_set_verify_mode(&engine,
+                                       static_cast<bld_verify_mode>(7)),
+            0);
+  EXPECT_LT(bld_engine_set_verify_mode(nullptr, BLD_VERIFY_NONE), 0);
+  EXPECT_EQ(engine.verify_mode, BLD_VERIFY_FULL);
+}
+
+TEST_F(BldEngineTest, RunningCrcEndReadsNothingBack) {
+  const auto image = MakeMultiPageImage();
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_RUNNING), 0);
+  const bld_slot_id slot = SendImage(image, Crc(image));
+  const int reads_before = SlotCtx(slot).read_calls;
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_OK);
+  EXPECT_EQ(SlotCtx(slot).read_calls, reads_before);
+  EXPECT_EQ(ReadBootCtrl().pending_slot, slot);
+}
+
+TEST_F(BldEngineTest, RunningCrcCatchesPayloadThatDoesNotMatchHeader) {
+  const auto image = MakeMultiPageImage();
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_RUNNING), 0);
+  SendImage(image, Crc(image) ^ 1u);
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(engine.state, BLD_STATE_ERROR);
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_BAD_CRC);
+}
+
+TEST_F(BldEngineTest, SampledReadBackCatchesCorruptedWriteInSampledPage) {
+  const auto image = MakeMultiPageImage();
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_SAMPLED), 0);
+  const bld_slot_id slot = SendImage(image, Crc(image));
+
+  // A bit that did not program in the last (partial) page.
+  SlotCtx(slot).bytes[image.size() - 5u] ^= 0x10u;
+  const int reads_before = SlotCtx(slot).read_calls;
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(engine.state, BLD_STATE_ERROR);
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_BAD_CRC);
+  EXPECT_EQ(meta_ctx.write_calls, 0);
+  // At most the sample budget was read back, in 256-byte chunks.
+  EXPECT_LE(static_cast<uint32_t>(SlotCtx(slot).read_calls - reads_before),
+            BLD_VERIFY_SAMPLE_PAGES * (BLD_FLASH_PAGE_SIZE / 256u));
+}
+
+TEST_F(BldEngineTest, SampledReadBackAcceptsCleanImage) {
+  const auto image = MakeMultiPageImage();
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_SAMPLED), 0);
+  const bld_slot_id slot = SendImage(image, Crc(image));
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_OK);
+  EXPECT_EQ(ReadBootCtrl().pending_slot, slot);
+}
+
+TEST_F(BldEngineTest, FullReadBackCatchesCorruptedWriteAnywhere) {
+  const auto image = MakeMultiPageImage();
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_FULL), 0);
+  const bld_slot_id slot = SendImage(image, Crc(image));
+
+  // Page 7 is not among the samples (stride 3), only a full pass sees it.
+  SlotCtx(slot).bytes[7u * BLD_FLASH_PAGE_SIZE + 100u] ^= 0x01u;
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(engine.state, BLD_STATE_ERROR);
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_BAD_CRC);
+}
+
+TEST_F(BldEngineTest, NoVerifyAcceptsImageUnchecked) {
+  const auto image = MakeMultiPageImage();
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_NONE), 0);
+  const bld_slot_id slot = SendImage(image, Crc(image) ^ 1u);
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_OK);
+  EXPECT_EQ(ReadBootCtrl().pending_slot, slot);
+}
+
+TEST_F(BldEngineTest, SetStagingRejectsIncompleteStorage) {
+  test::FakeStorageCtx staging_ctx;
+  bld_storage staging = test::MakeFakeStorage(&staging_ctx);
+  InitEngine();
+
+  EXPECT_LT(bld_engine_set_staging(&engine, &staging, 0u), 0);
+  staging.read = nullptr;
+  EXPECT_LT(bld_engine_set_staging(&engine, &staging, 4096u), 0);
+  EXPECT_LT(bld_engine_set_staging(nullptr, nullptr, 0u), 0);
+  EXPECT_EQ(engine.staging.write, nullptr);
+
+  staging = test::MakeFakeStorage(&staging_ctx);
+  ASSERT_EQ(bld_engine_set_staging(&engine, &staging, 4096u), 0);
+  EXPECT_EQ(engine.staging_size, 4096u);
+  ASSERT_EQ(bld_engine_set_staging(&engine, nullptr, 0u), 0);
+  EXPECT_EQ(engine.staging.write, nullptr);
+}
+
+TEST_F(BldEngineTest, StagedImageReachesSlotOnlyAfterEnd) {
+  const auto image = MakeMultiPageImage();
+  test::FakeStorageCtx staging_ctx;
+  staging_ctx.bytes.resize(BLD_STAGING_SIZE, 0xFF);
+  const bld_storage staging = test::MakeFakeStorage(&staging_ctx);
+
+  // Slot A, where the update goes, still holds an older image.
+  std::fill(slot_a_ctx.bytes.begin(), slot_a_ctx.bytes.end(), 0x5Au);
+  const auto previous = slot_a_ctx.bytes;
+
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_staging(&engine, &staging, BLD_STAGING_SIZE), 0);
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_FULL), 0);
+  const bld_slot_id slot = SendImage(image, Crc(image));
+  ASSERT_EQ(slot, BLD_SLOT_ID_A);
+
+  EXPECT_EQ(slot_a_ctx.erase_calls, 0);
+  EXPECT_EQ(slot_a_ctx.write_calls, 0);
+  EXPECT_EQ(slot_a_ctx.bytes, previous);
+  EXPECT_TRUE(std::equal(image.begin(), image.end(),
+                         staging_ctx.bytes.begin()));
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_OK);
+  EXPECT_TRUE(std::equal(image.begin(), image.end(),
+                         SlotCtx(slot).bytes.begin()));
+  // Copied in whole flash pages.
+  EXPECT_EQ(static_cast<uint32_t>(SlotCtx(slot).write_calls),
+            (image.size() + BLD_STAGING_COPY_CHUNK - 1u) /
+                BLD_STAGING_COPY_CHUNK);
+
+  const auto ctrl = ReadBootCtrl();
+  EXPECT_EQ(ctrl.pending_slot, slot);
+  EXPECT_EQ(ctrl.slots[slot].crc32, Crc(image));
+}
+
+TEST_F(BldEngineTest, StagedImageThatChangedInStagingIsNotInstalled) {
+  const auto image = MakeMultiPageImage();
+  test::FakeStorageCtx staging_ctx;
+  staging_ctx.bytes.resize(BLD_STAGING_SIZE, 0xFF);
+  const bld_storage staging = test::MakeFakeStorage(&staging_ctx);
+
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_staging(&engine, &staging, BLD_STAGING_SIZE), 0);
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_RUNNING), 0);
+  SendImage(image, Crc(image));
+  staging_ctx.bytes[12345u] ^= 0x04u;
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(engine.state, BLD_STATE_ERROR);
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_BAD_CRC);
+  EXPECT_EQ(meta_ctx.write_calls, 0);
+}
+
+TEST_F(BldEngineTest, StagedInstallReadsBackSlotInVerifyMode) {
+  const auto image = MakeMultiPageImage();
+  test::FakeStorageCtx staging_ctx;
+  staging_ctx.bytes.resize(BLD_STAGING_SIZE, 0xFF);
+  const bld_storage staging = test::MakeFakeStorage(&staging_ctx);
+
+  // Slot A drops a bit while the staged copy is programmed into it.
+  slot_storage[BLD_SLOT_ID_A].write = [](const bld_storage* self,
+                                         uint32_t offset,
+                                         const uint8_t* data,
+                                         uint32_t len) {
+    const int rc = test::FakeStorageWrite(self, offset, data, len);
+    auto* ctx = static_cast<test::FakeStorageCtx*>(
+        const_cast<void*>(self->ctx));
+    const uint32_t bad = 7u * BLD_FLASH_PAGE_SIZE + 100u;
+    if (rc == 0 && offset <= bad && bad < offset + len) {
+      ctx->bytes[bad] ^= 0x01u;
+    }
+    return rc;
+  };
+
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_staging(&engine, &staging, BLD_STAGING_SIZE), 0);
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_FULL), 0);
+  ASSERT_EQ(SendImage(image, Crc(image)), BLD_SLOT_ID_A);
+  const int reads_before = slot_a_ctx.read_calls;
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(engine.state, BLD_STATE_ERROR);
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_BAD_CRC);
+  EXPECT_EQ(meta_ctx.write_calls, 0);
+  EXPECT_GT(slot_a_ctx.read_calls, reads_before);
+}
+
+TEST_F(BldEngineTest, StagingSizeLimitsImage) {
+  test::FakeStorageCtx staging_ctx;
+  staging_ctx.bytes.resize(4096u, 0xFF);
+  const bld_storage staging = test::MakeFakeStorage(&staging_ctx);
+
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_staging(&engine, &staging, 4096u), 0);
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_START);
+  bld_engine_poll(&engine, 1u);
+  transport_ctx.next_frame = test::MakeHeaderFrame(4097u, 0x1234u, 1u);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_TOO_LARGE);
+  EXPECT_EQ(staging_ctx.erase_calls, 0);
+}
+
+TEST_F(BldEngineTest, EndSyncsWriteCombinedSlotBeforeVerifying) {
+  const auto image = MakeMultiPageImage();
+  bld_storage_wc_ctx wc_ctx{};
+  const bld_storage inner = slot_storage[BLD_SLOT_ID_A];
+  ASSERT_EQ(bld_storage_wc_init(&slot_storage[BLD_SLOT_ID_A],
+                                &wc_ctx,
+                                &inner,
+                                BLD_WRITE_COMBINE_SIZE),
+            0);
+
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_FULL), 0);
+  const bld_slot_id slot = SendImage(image, Crc(image), 13u);
+  ASSERT_EQ(slot, BLD_SLOT_ID_A);
+
+  // The last, partial row is still held back.
+  const size_t landed = image.size() - image.size() % BLD_WRITE_COMBINE_SIZE;
+  EXPECT_TRUE(std::equal(image.begin(), image.begin() + landed,
+                         slot_a_ctx.bytes.begin()));
+  EXPECT_EQ(slot_a_ctx.bytes[landed], 0xFFu);
+  EXPECT_EQ(static_cast<size_t>(slot_a_ctx.write_calls),
+            landed / BLD_WRITE_COMBINE_SIZE);
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_OK);
+  EXPECT_TRUE(std::equal(image.begin(), image.end(),
+                         slot_a_ctx.bytes.begin()));
+  EXPECT_EQ(slot_a_ctx.last_write_offset, landed);
+  EXPECT_EQ(ReadBootCtrl().pending_slot, BLD_SLOT_ID_A);
+}
+
+TEST_F(BldEngineTest, RelocatableImageIsRebasedToTargetSlot) {
+  // Linked for slot A with two flash pointers; slot A is active, so it goes
+  // to slot B.
+  auto image = MakeMultiPageImage();
+  WriteVectors(image, 0x20018000u, BLD_SLOT_A_BASE + 0x1C1u);
+  const uint32_t table_ptr = BLD_SLOT_A_BASE + 0x9000u;
+  memcpy(image.data() + 0x4000u, &table_ptr, sizeof(table_ptr));
+  const auto artifact =
+      test::MakeRelocImage(image, BLD_SLOT_A_BASE, {4u, 0x4000u});
+
+  auto ctrl = MakeEmptyBootCtrl();
+  ctrl.active_slot = BLD_SLOT_ID_A;
+  ctrl.confirmed_slot = BLD_SLOT_ID_A;
+  WriteBootCtrl(ctrl);
+  InitEngine();
+  ASSERT_EQ(bld_engine_set_verify_mode(&engine, BLD_VERIFY_FULL), 0);
+  ASSERT_EQ(SendImage(artifact, Crc(artifact)), BLD_SLOT_ID_B);
+
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+  ASSERT_EQ(LastStatus(transport_ctx).status, BLD_ST_OK);
+
+  auto installed = image;
+  WriteVectors(installed, 0x20018000u, BLD_SLOT_B_BASE + 0x1C1u);
+  const uint32_t moved_ptr = BLD_SLOT_B_BASE + 0x9000u;
+  memcpy(installed.data() + 0x4000u, &moved_ptr, sizeof(moved_ptr));
+  EXPECT_TRUE(std::equal(
+      installed.begin(), installed.end(), slot_b_ctx.bytes.begin()));
+
+  // META describes the slot contents, not the bytes sent.
+  ctrl = ReadBootCtrl();
+  EXPECT_EQ(ctrl.pending_slot, BLD_SLOT_ID_B);
+  EXPECT_EQ(ctrl.slots[BLD_SLOT_ID_B].size, installed.size());
+  EXPECT_EQ(ctrl.slots[BLD_SLOT_ID_B].crc32, Crc(installed));
+}
+
+TEST_F(BldEngineTest, RelocatableImageKeepsLinkAddressesInItsOwnSlot) {
+  auto image = MakeMultiPageImage();
+  WriteVectors(image, 0x20018000u, BLD_SLOT_A_BASE + 0x1C1u);
+  const auto artifact = test::MakeRelocImage(image, BLD_SLOT_A_BASE, {4u});
+
+  InitEngine();
+  ASSERT_EQ(SendImage(artifact, Crc(artifact)), BLD_SLOT_ID_A);
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_OK);
+  EXPECT_TRUE(
+      std::equal(image.begin(), image.end(), slot_a_ctx.bytes.begin()));
+  EXPECT_EQ(ReadBootCtrl().slots[BLD_SLOT_ID_A].crc32, Crc(image));
+}
+
+TEST_F(BldEngineTest, RelocationPastImageEndFailsEnd) {
+  const auto image = MakeMultiPageImage();
+  const auto artifact = test::MakeRelocImage(
+      image, BLD_SLOT_A_BASE, {4u, static_cast<uint32_t>(image.size() + 8u)});
+
+  InitEngine();
+  SendImage(artifact, Crc(artifact));
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(engine.state, BLD_STATE_ERROR);
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_BAD_FRAME);
+  EXPECT_EQ(meta_ctx.write_calls, 0);
+}
+
+TEST_F(BldEngineTest, RelocationHeaderMustMatchTransfer) {
+  const std::vector<uint8_t> image(64u, 0x11u);
+  auto artifact = test::MakeRelocImage(image, BLD_SLOT_A_BASE, {4u});
+  // Claims more image than the HEADER frame announced.
+  artifact[offsetof(bld_reloc_header, image_size)] += 8u;
+
+  InitEngine();
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_START);
+  bld_engine_poll(&engine, 1u);
+  transport_ctx.next_frame = test::MakeHeaderFrame(
+      static_cast<uint32_t>(artifact.size()), Crc(artifact), 1u);
+  bld_engine_poll(&engine, 1u);
+  transport_ctx.next_frame = test::MakeDataFrame(
+      0u, artifact.data(), static_cast<uint16_t>(artifact.size()));
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(engine.state, BLD_STATE_ERROR);
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_BAD_FRAME);
+  EXPECT_EQ(slot_a_ctx.write_calls, 0);
+}
+
 TEST_F(BldEngineTest, BootDecideAndJumpUsesPendingSlotAndDecrementsAttempts) {
   const std::array<uint8_t, 4> image = {9u, 8u, 7u, 6u};
   const uint32_t crc =
@@ -447,6 +890,264 @@ TEST_F(BldEngineTest, BootDecideAndJumpReturnsErrorWhenNothingBootable) {
   EXPECT_EQ(status.detail, 0u);
 }
 
+TEST_F(BldEngineTest, FastBootPicksConfirmedSlotWithoutVerifyingIt) {
+  WriteVectors(slot_b_ctx.bytes, 0x20018000u, BLD_SLOT_B_BASE + 0x1C5u);
+
+  auto ctrl = MakeEmptyBootCtrl();
+  ctrl.active_slot = BLD_SLOT_ID_B;
+  ctrl.confirmed_slot = BLD_SLOT_ID_B;
+  ctrl.slots[BLD_SLOT_ID_B].size = BLD_SLOT_B_SIZE;
+  ctrl.slots[BLD_SLOT_ID_B].crc32 = 0x12345678u;
+  ctrl.slots[BLD_SLOT_ID_B].state = BLD_SLOT_STATE_CONFIRMED;
+  WriteBootCtrl(ctrl);
+
+  uint32_t base = 0u;
+  ASSERT_EQ(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, nullptr, &base),
+      0);
+  EXPECT_EQ(base, BLD_SLOT_B_BASE);
+
+  // Only the vector table was read, not the image.
+  EXPECT_EQ(slot_b_ctx.read_calls, 1);
+  EXPECT_EQ(slot_b_ctx.last_read_len, 8u);
+  EXPECT_EQ(slot_a_ctx.read_calls, 0);
+}
+
+TEST_F(BldEngineTest, FastBootDefersTrialBootsToFullPath) {
+  WriteVectors(slot_a_ctx.bytes, 0x20018000u, BLD_SLOT_A_BASE + 0x1C5u);
+  WriteVectors(slot_b_ctx.bytes, 0x20018000u, BLD_SLOT_B_BASE + 0x1C5u);
+
+  auto ctrl = MakeEmptyBootCtrl();
+  ctrl.confirmed_slot = BLD_SLOT_ID_B;
+  ctrl.pending_slot = BLD_SLOT_ID_A;
+  ctrl.slots[BLD_SLOT_ID_A].state = BLD_SLOT_STATE_PENDING;
+  ctrl.slots[BLD_SLOT_ID_A].boot_attempts_left = 3u;
+  ctrl.slots[BLD_SLOT_ID_B].state = BLD_SLOT_STATE_CONFIRMED;
+  WriteBootCtrl(ctrl);
+
+  uint32_t base = 0u;
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, nullptr, &base),
+      0);
+  EXPECT_EQ(base, 0u);
+  EXPECT_EQ(ReadBootCtrl().slots[BLD_SLOT_ID_A].boot_attempts_left, 3u);
+}
+
+TEST_F(BldEngineTest, FastBootRejectsImplausibleVectors) {
+  auto ctrl = MakeEmptyBootCtrl();
+  ctrl.confirmed_slot = BLD_SLOT_ID_A;
+  ctrl.slots[BLD_SLOT_ID_A].state = BLD_SLOT_STATE_CONFIRMED;
+  WriteBootCtrl(ctrl);
+
+  uint32_t base = 0u;
+  // Erased flash.
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, nullptr, &base),
+      0);
+
+  // Reset handler in the other slot.
+  WriteVectors(slot_a_ctx.bytes, 0x20018000u, BLD_SLOT_B_BASE + 0x1C5u);
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, nullptr, &base),
+      0);
+
+  // ARM-state (even) reset handler.
+  WriteVectors(slot_a_ctx.bytes, 0x20018000u, BLD_SLOT_A_BASE + 0x1C4u);
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, nullptr, &base),
+      0);
+
+  // Stack pointer past the end of SRAM1.
+  WriteVectors(slot_a_ctx.bytes, 0x20018008u, BLD_SLOT_A_BASE + 0x1C5u);
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, nullptr, &base),
+      0);
+  EXPECT_EQ(base, 0u);
+
+  // Stack at the top of SRAM2 is fine.
+  WriteVectors(slot_a_ctx.bytes, 0x10008000u, BLD_SLOT_A_BASE + 0x1C5u);
+  EXPECT_EQ(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, nullptr, &base),
+      0);
+  EXPECT_EQ(base, BLD_SLOT_A_BASE);
+}
+
+TEST_F(BldEngineTest, FastBootRejectsMissingMetadataAndUnconfirmedSlots) {
+  WriteVectors(slot_a_ctx.bytes, 0x20018000u, BLD_SLOT_A_BASE + 0x1C5u);
+  uint32_t base = 0u;
+
+  // Erased metadata region.
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, nullptr, &base),
+      0);
+
+  auto ctrl = MakeEmptyBootCtrl();
+  ctrl.confirmed_slot = BLD_SLOT_ID_A;
+  ctrl.slots[BLD_SLOT_ID_A].state = BLD_SLOT_STATE_VALID;
+  WriteBootCtrl(ctrl);
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, nullptr, &base),
+      0);
+
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(nullptr, slot_storage, nullptr, &base),
+      0);
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, nullptr, nullptr),
+      0);
+  EXPECT_EQ(base, 0u);
+}
+
+TEST_F(BldEngineTest, SetBankOpsRejectsIncompleteOps) {
+  InitEngine();
+  FakeBank fake;
+  bld_bank_ops ops = MakeFakeBankOps(&fake);
+
+  EXPECT_LT(bld_engine_set_bank_ops(nullptr, &ops), 0);
+  ops.select = nullptr;
+  EXPECT_LT(bld_engine_set_bank_ops(&engine, &ops), 0);
+
+  ops = MakeFakeBankOps(&fake);
+  ASSERT_EQ(bld_engine_set_bank_ops(&engine, &ops), 0);
+  ASSERT_EQ(bld_engine_set_bank_ops(&engine, nullptr), 0);
+  EXPECT_EQ(engine.bank.active, nullptr);
+}
+
+class BldEngineBankTest : public BldEngineTest {
+ protected:
+  // Confirmed image in slot A, trial image in slot B.
+  void SetUpTrial(uint8_t attempts_left) {
+    const std::array<uint8_t, 4> confirmed = {1u, 2u, 3u, 4u};
+    const std::array<uint8_t, 4> trial = {5u, 6u, 7u, 8u};
+    std::copy(confirmed.begin(), confirmed.end(), slot_a_ctx.bytes.begin());
+    std::copy(trial.begin(), trial.end(), slot_b_ctx.bytes.begin());
+
+    auto ctrl = MakeEmptyBootCtrl();
+    ctrl.active_slot = BLD_SLOT_ID_B;
+    ctrl.confirmed_slot = BLD_SLOT_ID_A;
+    ctrl.pending_slot = BLD_SLOT_ID_B;
+    ctrl.slots[BLD_SLOT_ID_A].size = confirmed.size();
+    ctrl.slots[BLD_SLOT_ID_A].crc32 =
+        bld_crc32_ieee(confirmed.data(), confirmed.size(), BLD_CRC32_INITIAL);
+    ctrl.slots[BLD_SLOT_ID_A].state = BLD_SLOT_STATE_CONFIRMED;
+    ctrl.slots[BLD_SLOT_ID_B].size = trial.size();
+    ctrl.slots[BLD_SLOT_ID_B].crc32 =
+        bld_crc32_ieee(trial.data(), trial.size(), BLD_CRC32_INITIAL);
+    ctrl.slots[BLD_SLOT_ID_B].state = BLD_SLOT_STATE_PENDING;
+    ctrl.slots[BLD_SLOT_ID_B].boot_attempts_left = attempts_left;
+    WriteBootCtrl(ctrl);
+
+    InitEngine();
+    const bld_bank_ops ops = MakeFakeBankOps(&bank);
+    ASSERT_EQ(bld_engine_set_bank_ops(&engine, &ops), 0);
+  }
+
+  FakeBank bank;
+};
+
+TEST_F(BldEngineBankTest, TrialInOtherBankSelectsBankWithoutCountingAttempt) {
+  SetUpTrial(3u);
+
+  ASSERT_EQ(bld_engine_boot_decide_and_jump(&engine), 0);
+  EXPECT_EQ(bank.selected, 1);
+  EXPECT_EQ(test::g_last_jump_image_base, 0u);
+
+  // The bootloader in bank 2 counts the attempt after the reset.
+  const auto ctrl = ReadBootCtrl();
+  EXPECT_EQ(ctrl.pending_slot, BLD_SLOT_ID_B);
+  EXPECT_EQ(ctrl.slots[BLD_SLOT_ID_B].boot_attempts_left, 3u);
+  EXPECT_EQ(LastStatus(transport_ctx).detail,
+            static_cast<uint32_t>(BLD_SLOT_ID_B));
+}
+
+TEST_F(BldEngineBankTest, TrialInRunningBankRunsAtSlotAAddress) {
+  SetUpTrial(3u);
+  bank.active = 1;
+
+  ASSERT_EQ(bld_engine_boot_decide_and_jump(&engine), 0);
+  EXPECT_EQ(bank.select_calls, 0);
+  EXPECT_EQ(test::g_last_jump_image_base, BLD_SLOT_A_BASE);
+  EXPECT_EQ(ReadBootCtrl().slots[BLD_SLOT_ID_B].boot_attempts_left, 2u);
+}
+
+TEST_F(BldEngineBankTest, ExhaustedTrialSwitchesBackToConfirmedBank) {
+  SetUpTrial(0u);
+  bank.active = 1;
+
+  ASSERT_EQ(bld_engine_boot_decide_and_jump(&engine), 0);
+  EXPECT_EQ(bank.selected, 0);
+  EXPECT_EQ(test::g_last_jump_image_base, 0u);
+
+  const auto ctrl = ReadBootCtrl();
+  EXPECT_EQ(ctrl.slots[BLD_SLOT_ID_B].state, BLD_SLOT_STATE_BAD);
+  EXPECT_EQ(ctrl.pending_slot, BLD_SLOT_ID_NONE);
+}
+
+TEST_F(BldEngineBankTest, UnselectableBankLeavesTrialPending) {
+  SetUpTrial(3u);
+  bank.select_result = -1;
+
+  ASSERT_EQ(bld_engine_boot_decide_and_jump(&engine), 0);
+  EXPECT_EQ(bank.select_calls, 1);
+  EXPECT_EQ(test::g_last_jump_image_base, BLD_SLOT_A_BASE);
+
+  const auto ctrl = ReadBootCtrl();
+  EXPECT_EQ(ctrl.pending_slot, BLD_SLOT_ID_B);
+  EXPECT_EQ(ctrl.slots[BLD_SLOT_ID_B].state, BLD_SLOT_STATE_PENDING);
+  EXPECT_EQ(ctrl.slots[BLD_SLOT_ID_B].boot_attempts_left, 3u);
+}
+
+TEST_F(BldEngineBankTest, FastBootTakesConfirmedSlotOnlyInRunningBank) {
+  WriteVectors(slot_b_ctx.bytes, 0x20018000u, BLD_SLOT_A_BASE + 0x1C5u);
+
+  auto ctrl = MakeEmptyBootCtrl();
+  ctrl.confirmed_slot = BLD_SLOT_ID_B;
+  ctrl.slots[BLD_SLOT_ID_B].state = BLD_SLOT_STATE_CONFIRMED;
+  WriteBootCtrl(ctrl);
+  const bld_bank_ops ops = MakeFakeBankOps(&bank);
+
+  uint32_t base = 0u;
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, &ops, &base),
+      0);
+  EXPECT_EQ(bank.select_calls, 0);
+
+  bank.active = 1;
+  ASSERT_EQ(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, &ops, &base),
+      0);
+  EXPECT_EQ(base, BLD_SLOT_A_BASE);
+
+  // Vectors must point at the shared run address, not slot B's own.
+  WriteVectors(slot_b_ctx.bytes, 0x20018000u, BLD_SLOT_B_BASE + 0x1C5u);
+  EXPECT_LT(
+      bld_engine_fast_boot_slot(&meta_storage, slot_storage, &ops, &base),
+      0);
+}
+
+TEST_F(BldEngineBankTest, RelocatableImageInstallsUnchangedInEitherBank) {
+  auto image = MakeMultiPageImage();
+  WriteVectors(image, 0x20018000u, BLD_SLOT_A_BASE + 0x1C1u);
+  const auto artifact = test::MakeRelocImage(image, BLD_SLOT_A_BASE, {4u});
+
+  auto ctrl = MakeEmptyBootCtrl();
+  ctrl.active_slot = BLD_SLOT_ID_A;
+  ctrl.confirmed_slot = BLD_SLOT_ID_A;
+  WriteBootCtrl(ctrl);
+  InitEngine();
+  const bld_bank_ops ops = MakeFakeBankOps(&bank);
+  ASSERT_EQ(bld_engine_set_bank_ops(&engine, &ops), 0);
+
+  ASSERT_EQ(SendImage(artifact, Crc(artifact)), BLD_SLOT_ID_B);
+  transport_ctx.next_frame = test::MakeCmdFrame(BLD_CMD_END);
+  bld_engine_poll(&engine, 1u);
+
+  EXPECT_EQ(LastStatus(transport_ctx).status, BLD_ST_OK);
+  EXPECT_TRUE(
+      std::equal(image.begin(), image.end(), slot_b_ctx.bytes.begin()));
+  EXPECT_EQ(ReadBootCtrl().slots[BLD_SLOT_ID_B].crc32, Crc(image));
+}
+
 TEST_F(BldEngineTest, AbortCommandResetsSessionAndReturnsIdle) {
   InitEngine();
 
@@ -0,0 +1,123 @@
+// Built with four slots and slot 0 as the factory slot; see BUILD.bazel.
+#include <bld_meta.h>
+#include <gtest/gtest.h>
+
+#include "test_stubs.h"
+
+static_assert(BLD_SLOT_COUNT == 4u, "built for four slots");
+static_assert(BLD_SLOT_FACTORY == 0u, "built with a factory slot");
+
+namespace {
+
+constexpr bld_slot_id kFactory = static_cast<bld_slot_id>(0);
+constexpr bld_slot_id kSlot1 = static_cast<bld_slot_id>(1);
+constexpr bld_slot_id kSlot2 = static_cast<bld_slot_id>(2);
+constexpr bld_slot_id kSlot3 = static_cast<bld_slot_id>(3);
+
+bld_slot_info Slot(uint32_t version, bld_slot_state state) {
+  bld_slot_info info{};
+  info.version = version;
+  info.size = 64u;
+  info.state = state;
+  return info;
+}
+
+bld_boot_control MakeFactoryOnly() {
+  bld_boot_control ctrl{};
+  ctrl.active_slot = kFactory;
+  ctrl.confirmed_slot = kFactory;
+  ctrl.pending_slot = BLD_SLOT_ID_NONE;
+  ctrl.slots[kFactory] = Slot(1u, BLD_SLOT_STATE_CONFIRMED);
+  return ctrl;
+}
+
+}  // namespace
+
+class BldMetaMultiSlotTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ctx.bytes.resize(4096u, 0xFF);
+    storage = test::MakeFakeStorage(&ctx);
+  }
+
+  void Store(const bld_boot_control& ctrl) {
+    ASSERT_EQ(bld_meta_write_boot_control(&storage, &ctrl), 0);
+  }
+
+  bld_boot_control Load() {
+    bld_boot_control ctrl{};
+    EXPECT_EQ(bld_meta_read_boot_control(&storage, &ctrl), 0);
+    return ctrl;
+  }
+
+  test::FakeStorageCtx ctx;
+  bld_storage storage{};
+};
+
+TEST_F(BldMetaMultiSlotTest, TargetNeverTakesFactorySlot) {
+  bld_boot_control ctrl{};
+  ctrl.active_slot = BLD_SLOT_ID_NONE;
+  ctrl.confirmed_slot = BLD_SLOT_ID_NONE;
+  ctrl.pending_slot = BLD_SLOT_ID_NONE;
+  EXPECT_EQ(bld_meta_choose_target_slot(&ctrl), kSlot1);
+
+  ctrl = MakeFactoryOnly();
+  EXPECT_EQ(bld_meta_choose_target_slot(&ctrl), kSlot1);
+  EXPECT_LT(bld_meta_set_pending(&storage, kFactory, 2u, 64u, 1u, 3u), 0);
+}
+
+TEST_F(BldMetaMultiSlotTest, TargetOverwritesOldestFallback) {
+  bld_boot_control ctrl = MakeFactoryOnly();
+  ctrl.active_slot = kSlot2;
+  ctrl.confirmed_slot = kSlot2;
+  ctrl.slots[kFactory].state = BLD_SLOT_STATE_VALID;
+  ctrl.slots[kSlot1] = Slot(5u, BLD_SLOT_STATE_VALID);
+  ctrl.slots[kSlot2] = Slot(7u, BLD_SLOT_STATE_CONFIRMED);
+  ctrl.slots[kSlot3] = Slot(3u, BLD_SLOT_STATE_VALID);
+  EXPECT_EQ(bld_meta_choose_target_slot(&ctrl), kSlot3);
+
+  // An empty or bad slot goes first.
+  ctrl.slots[kSlot1].state = BLD_SLOT_STATE_BAD;
+  EXPECT_EQ(bld_meta_choose_target_slot(&ctrl), kSlot1);
+}
+
+TEST_F(BldMetaMultiSlotTest, InstallsRotateThroughUpdateSlots) {
+  Store(MakeFactoryOnly());
+
+  for (uint32_t version = 2u; version <= 6u; ++version) {
+    const bld_boot_control before = Load();
+    const bld_slot_id target = bld_meta_choose_target_slot(&before);
+    ASSERT_NE(target, BLD_SLOT_ID_NONE);
+    ASSERT_NE(target, kFactory);
+    ASSERT_EQ(bld_meta_set_pending(&storage, target, version, 64u, 1u, 3u),
+              0);
+    ASSERT_EQ(bld_meta_confirm_slot(&storage), 0);
+    EXPECT_EQ(Load().confirmed_slot, target);
+  }
+
+  // Every update slot now holds one of the three newest images.
+  const bld_boot_control ctrl = Load();
+  EXPECT_EQ(ctrl.slots[kFactory].version, 1u);
+  for (uint8_t i = 1u; i < BLD_SLOT_COUNT; ++i) {
+    EXPECT_GE(ctrl.slots[i].version, 4u) << static_cast<int>(i);
+  }
+}
+
+TEST_F(BldMetaMultiSlotTest, BadSlotFallsBackToNewestThenFactory) {
+  bld_boot_control ctrl = MakeFactoryOnly();
+  ctrl.active_slot = kSlot3;
+  ctrl.confirmed_slot = kSlot3;
+  ctrl.slots[kFactory].state = BLD_SLOT_STATE_VALID;
+  ctrl.slots[kSlot1] = Slot(4u, BLD_SLOT_STATE_VALID);
+  ctrl.slots[kSlot2] = Slot(5u, BLD_SLOT_STATE_VALID);
+  ctrl.slots[kSlot3] = Slot(6u, BLD_SLOT_STATE_CONFIRMED);
+  Store(ctrl);
+
+  ASSERT_EQ(bld_meta_mark_slot_bad(&storage, kSlot3), 0);
+  EXPECT_EQ(Load().confirmed_slot, kSlot2);
+  ASSERT_EQ(bld_meta_mark_slot_bad(&storage, kSlot2), 0);
+  EXPECT_EQ(Load().confirmed_slot, kSlot1);
+  ASSERT_EQ(bld_meta_mark_slot_bad(&storage, kSlot1), 0);
+  EXPECT_EQ(Load().confirmed_slot, kFactory);
+  EXPECT_EQ(Load().active_slot, kFactory);
+}
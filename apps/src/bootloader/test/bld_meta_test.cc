@@ -10,8 +10,8 @@ struct PackedMetaRecord {
   uint8_t active_slot;
   uint8_t confirmed_slot;
   uint8_t pending_slot;
-  uint8_t reserved0;
-  bld_slot_info slots[2];
+  uint8_t slot_count;
+  bld_slot_info slots[BLD_SLOT_COUNT];
   uint32_t record_crc32;
 } __attribute__((packed));
 
@@ -26,7 +26,7 @@ PackedMetaRecord MakeDefaultValidRecord() {
   r.active_slot = static_cast<uint8_t>(BLD_SLOT_ID_NONE);
   r.confirmed_slot = static_cast<uint8_t>(BLD_SLOT_ID_NONE);
   r.pending_slot = static_cast<uint8_t>(BLD_SLOT_ID_NONE);
-  r.reserved0 = 0u;
+  r.slot_count = BLD_SLOT_COUNT;
 
   r.slots[BLD_SLOT_ID_A] = {};
   r.slots[BLD_SLOT_ID_A].state = static_cast<uint8_t>(BLD_SLOT_STATE_EMPTY);
@@ -187,3 +187,69 @@ TEST_F(BldMetaTest, MarkSlotBadClearsPendingIfNeeded) {
   EXPECT_EQ(updated.slots[BLD_SLOT_ID_A].boot_attempts_left, 0u);
   EXPECT_EQ(updated.pending_slot, BLD_SLOT_ID_NONE);
 }
+
+TEST_F(BldMetaTest, ReadBootControlAcceptsLegacyTwoSlotRecord) {
+  PackedMetaRecord record = MakeDefaultValidRecord();
+  record.slot_count = 0u;
+  record.confirmed_slot = BLD_SLOT_ID_A;
+  record.slots[BLD_SLOT_ID_A].state =
+      static_cast<uint8_t>(BLD_SLOT_STATE_CONFIRMED);
+  record.record_crc32 = MetaRecordCrc(record);
+  memcpy(ctx.bytes.data(), &record, sizeof(record));
+
+  bld_boot_control ctrl{};
+  ASSERT_EQ(bld_meta_read_boot_control(&storage, &ctrl), 0);
+  EXPECT_EQ(ctrl.confirmed_slot, BLD_SLOT_ID_A);
+
+  // The next write records the slot count.
+  ASSERT_EQ(bld_meta_write_boot_control(&storage, &ctrl), 0);
+  PackedMetaRecord written{};
+  memcpy(&written, ctx.bytes.data(), sizeof(written));
+  EXPECT_EQ(written.slot_count, BLD_SLOT_COUNT);
+}
+
+TEST_F(BldMetaTest, ReadBootControlRejectsOtherSlotCount) {
+  PackedMetaRecord record = MakeDefaultValidRecord();
+  record.slot_count = BLD_SLOT_COUNT + 1u;
+  record.record_crc32 = MetaRecordCrc(record);
+  memcpy(ctx.bytes.data(), &record, sizeof(record));
+
+  bld_boot_control ctrl{};
+  EXPECT_LT(bld_meta_read_boot_control(&storage, &ctrl), 0);
+}
+
+TEST(BldMetaPolicyTest, TargetSkipsSlotsInUse) {
+  bld_boot_control ctrl{};
+  ctrl.active_slot = BLD_SLOT_ID_NONE;
+  ctrl.confirmed_slot = BLD_SLOT_ID_NONE;
+  ctrl.pending_slot = BLD_SLOT_ID_NONE;
+  EXPECT_EQ(bld_meta_choose_target_slot(&ctrl), BLD_SLOT_ID_A);
+
+  ctrl.active_slot = BLD_SLOT_ID_A;
+  ctrl.confirmed_slot = BLD_SLOT_ID_A;
+  ctrl.slots[BLD_SLOT_ID_A].state = BLD_SLOT_STATE_CONFIRMED;
+  EXPECT_EQ(bld_meta_choose_target_slot(&ctrl), BLD_SLOT_ID_B);
+
+  // A valid fallback is overwritten before the running image.
+  ctrl.slots[BLD_SLOT_ID_B].state = BLD_SLOT_STATE_VALID;
+  EXPECT_EQ(bld_meta_choose_target_slot(&ctrl), BLD_SLOT_ID_B);
+
+  EXPECT_EQ(bld_meta_choose_target_slot(nullptr), BLD_SLOT_ID_NONE);
+}
+
+TEST(BldMetaPolicyTest, FallbackPrefersConfirmedOverPendingUnlessAsked) {
+  bld_boot_control ctrl{};
+  ctrl.slots[BLD_SLOT_ID_A].state = BLD_SLOT_STATE_BAD;
+  ctrl.slots[BLD_SLOT_ID_B].state = BLD_SLOT_STATE_PENDING;
+
+  EXPECT_EQ(bld_meta_choose_fallback_slot(&ctrl, BLD_SLOT_ID_A, 0),
+            BLD_SLOT_ID_NONE);
+  EXPECT_EQ(bld_meta_choose_fallback_slot(&ctrl, BLD_SLOT_ID_A, 1),
+            BLD_SLOT_ID_B);
+
+  ctrl.slots[BLD_SLOT_ID_B].state = BLD_SLOT_STATE_VALID;
+  EXPECT_EQ(bld_meta_choose_fallback_slot(&ctrl, BLD_SLOT_ID_A, 0),
+            BLD_SLOT_ID_B);
+  EXPECT_EQ(bld_meta_choose_fallback_slot(&ctrl, BLD_SLOT_ID_B, 0),
+            BLD_SLOT_ID_NONE);
+}
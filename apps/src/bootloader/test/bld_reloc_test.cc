@@ -0,0 +1,182 @@
+#include "bld_reloc.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "test_stubs.h"
+
+namespace {
+
+constexpr uint32_t kLinkBase = 0x08022000u;
+constexpr uint32_t kLoadBase = 0x08080000u;
+
+void PutWord(std::vector<uint8_t>& image, uint32_t offset, uint32_t value) {
+  memcpy(image.data() + offset, &value, sizeof(value));
+}
+
+uint32_t GetWord(const std::vector<uint8_t>& image, uint32_t offset) {
+  uint32_t value = 0;
+  memcpy(&value, image.data() + offset, sizeof(value));
+  return value;
+}
+
+// 64 words: an SRAM stack pointer, then flash addresses and plain data.
+std::vector<uint8_t> MakeImage() {
+  std::vector<uint8_t> image(256u);
+  for (uint32_t i = 0; i < image.size(); i += 4) {
+    PutWord(image, i, 0xC0DE0000u + i);
+  }
+  PutWord(image, 0u, 0x20018000u);
+  PutWord(image, 4u, kLinkBase + 0x1C1u);
+  PutWord(image, 16u, kLinkBase + 0xFFF0u);  // carries into the high bytes
+  PutWord(image, 200u, kLinkBase + 0x5E000u);
+  return image;
+}
+
+class BldRelocTest : public ::testing::Test {
+ protected:
+  void Load(const std::vector<uint8_t>& image,
+            const std::vector<uint32_t>& offsets) {
+    artifact = test::MakeRelocImage(image, kLinkBase, offsets);
+    hdr = test::ReadStruct<bld_reloc_header>(artifact);
+    table = artifact.data() + sizeof(hdr);
+  }
+
+  std::vector<uint8_t> artifact;
+  bld_reloc_header hdr{};
+  const uint8_t* table = nullptr;
+  bld_reloc reloc{};
+};
+
+}  // namespace
+
+TEST_F(BldRelocTest, RebasesListedWordsOnly) {
+  std::vector<uint8_t> image = MakeImage();
+  Load(image, {4u, 16u, 200u});
+
+  ASSERT_EQ(bld_reloc_begin(&reloc, &hdr, table, kLoadBase), 0);
+  ASSERT_EQ(bld_reloc_apply(&reloc, 0u, image.data(), image.size()), 0);
+  EXPECT_EQ(bld_reloc_finish(&reloc, image.size()), 0);
+
+  const std::vector<uint8_t> linked = MakeImage();
+  EXPECT_EQ(GetWord(image, 0u), 0x20018000u);
+  EXPECT_EQ(GetWord(image, 4u), kLoadBase + 0x1C1u);
+  EXPECT_EQ(GetWord(image, 16u), kLoadBase + 0xFFF0u);
+  EXPECT_EQ(GetWord(image, 200u), kLoadBase + 0x5E000u);
+  for (uint32_t i = 0; i < image.size(); i += 4) {
+    if (i != 4u && i != 16u && i != 200u) {
+      EXPECT_EQ(GetWord(image, i), GetWord(linked, i)) << i;
+    }
+  }
+}
+
+TEST_F(BldRelocTest, WordsMaySpanPieces) {
+  std::vector<uint8_t> whole = MakeImage();
+  std::vector<uint8_t> pieces = MakeImage();
+  Load(whole, {4u, 16u, 200u});
+
+  ASSERT_EQ(bld_reloc_begin(&reloc, &hdr, table, kLoadBase), 0);
+  ASSERT_EQ(bld_reloc_apply(&reloc, 0u, whole.data(), whole.size()), 0);
+
+  // Odd piece sizes split every relocated word somewhere.
+  bld_reloc split{};
+  ASSERT_EQ(bld_reloc_begin(&split, &hdr, table, kLoadBase), 0);
+  for (uint32_t off = 0, n = 1; off < pieces.size(); off += n, n = n % 7 + 1) {
+    n = std::min<uint32_t>(n, pieces.size() - off);
+    ASSERT_EQ(bld_reloc_apply(&split, off, pieces.data() + off, n), 0);
+  }
+  EXPECT_EQ(bld_reloc_finish(&split, pieces.size()), 0);
+  EXPECT_EQ(pieces, whole);
+}
+
+TEST_F(BldRelocTest, LinkBaseLeavesImageUnchanged) {
+  std::vector<uint8_t> image = MakeImage();
+  Load(image, {4u, 16u, 200u});
+
+  ASSERT_EQ(bld_reloc_begin(&reloc, &hdr, table, kLinkBase), 0);
+  ASSERT_EQ(bld_reloc_apply(&reloc, 0u, image.data(), image.size()), 0);
+  EXPECT_EQ(bld_reloc_finish(&reloc, image.size()), 0);
+  EXPECT_EQ(image, MakeImage());
+}
+
+TEST_F(BldRelocTest, LongGapsUseMultiByteEntries) {
+  std::vector<uint8_t> image(64u * 1024u, 0u);
+  PutWord(image, 8u, kLinkBase);
+  PutWord(image, 60000u, kLinkBase + 4u);
+  Load(image, {8u, 60000u});
+  EXPECT_GT(hdr.table_size, hdr.count);
+
+  ASSERT_EQ(bld_reloc_begin(&reloc, &hdr, table, kLoadBase), 0);
+  ASSERT_EQ(bld_reloc_apply(&reloc, 0u, image.data(), image.size()), 0);
+  EXPECT_EQ(bld_reloc_finish(&reloc, image.size()), 0);
+  EXPECT_EQ(GetWord(image, 8u), kLoadBase);
+  EXPECT_EQ(GetWord(image, 60000u), kLoadBase + 4u);
+}
+
+TEST_F(BldRelocTest, PiecesMustBeConsecutive) {
+  std::vector<uint8_t> image = MakeImage();
+  Load(image, {4u});
+
+  ASSERT_EQ(bld_reloc_begin(&reloc, &hdr, table, kLoadBase), 0);
+  ASSERT_EQ(bld_reloc_apply(&reloc, 0u, image.data(), 8u), 0);
+  EXPECT_LT(bld_reloc_apply(&reloc, 16u, image.data() + 16u, 8u), 0);
+  EXPECT_LT(bld_reloc_apply(&reloc, 0u, image.data(), 8u), 0);
+}
+
+TEST_F(BldRelocTest, FinishRejectsUnappliedRelocations) {
+  std::vector<uint8_t> image = MakeImage();
+  Load(image, {4u, 200u});
+
+  ASSERT_EQ(bld_reloc_begin(&reloc, &hdr, table, kLoadBase), 0);
+  ASSERT_EQ(bld_reloc_apply(&reloc, 0u, image.data(), 128u), 0);
+  EXPECT_LT(bld_reloc_finish(&reloc, image.size()), 0);
+
+  // A word past the end of the image can never be applied.
+  Load(image, {4u, 256u});
+  ASSERT_EQ(bld_reloc_begin(&reloc, &hdr, table, kLoadBase), 0);
+  ASSERT_EQ(bld_reloc_apply(&reloc, 0u, image.data(), image.size()), 0);
+  EXPECT_LT(bld_reloc_finish(&reloc, image.size()), 0);
+}
+
+TEST_F(BldRelocTest, MalformedTablesAreRejected) {
+  std::vector<uint8_t> image = MakeImage();
+
+  // The same word twice.
+  Load(image, {4u, 4u});
+  ASSERT_EQ(bld_reloc_begin(&reloc, &hdr, table, kLoadBase), 0);
+  EXPECT_LT(bld_reloc_apply(&reloc, 0u, image.data(), image.size()), 0);
+
+  // An entry that runs off the end of the table.
+  const uint8_t truncated[] = {0x84u, 0x80u};
+  hdr.table_size = sizeof(truncated);
+  hdr.count = 1u;
+  EXPECT_LT(bld_reloc_begin(&reloc, &hdr, truncated, kLoadBase), 0);
+
+  // An entry wider than 32 bits.
+  const uint8_t wide[] = {0xFFu, 0xFFu, 0xFFu, 0xFFu, 0x7Fu};
+  hdr.table_size = sizeof(wide);
+  EXPECT_LT(bld_reloc_begin(&reloc, &hdr, wide, kLoadBase), 0);
+}
+
+TEST_F(BldRelocTest, CheckHeaderMatchesArtifact) {
+  Load(MakeImage(), {4u, 16u, 200u});
+  const uint32_t size = static_cast<uint32_t>(artifact.size());
+
+  EXPECT_EQ(bld_reloc_check_header(&hdr, size, 256u, 64u), 0);
+  EXPECT_LT(bld_reloc_check_header(&hdr, size - 1u, 256u, 64u), 0);
+  EXPECT_LT(bld_reloc_check_header(&hdr, size, 252u, 64u), 0);
+  EXPECT_LT(bld_reloc_check_header(&hdr, size, 256u, hdr.table_size - 1u),
+            0);
+
+  bld_reloc_header bad = hdr;
+  bad.magic = 0x20018000u;
+  EXPECT_LT(bld_reloc_check_header(&bad, size, 256u, 64u), 0);
+
+  // The image must start aligned for flash programming.
+  bad = hdr;
+  bad.table_size += 1u;
+  bad.image_size -= 1u;
+  EXPECT_LT(bld_reloc_check_header(&bad, size, 256u, 64u), 0);
+}
@@ -294,4 +294,42 @@ TEST_F(BldStorageStm32l4Test, CrossBankEraseCallsEraseTwice) {
   EXPECT_EQ(hw.second_erase_num_pages, 1u);
 }
 
+TEST_F(BldStorageStm32l4Test, SwappedBanksEraseAndProgramThroughMappedAddress) {
+  const uint32_t physical = ctx.region_base;
+  ASSERT_EQ(bld_storage_flash_swap_banks(&ctx), 0);
+  EXPECT_EQ(ctx.region_base, physical + ctx.flash_bank_size);
+  ASSERT_EQ(bld_storage_flash_init(&storage, &ctx), 0);
+  hw.base_addr = ctx.region_base;
+
+  // Bank 1 now sits in the upper half; erase still names bank 1.
+  ASSERT_EQ(storage.erase(&storage, 0u, 0x800u), 0);
+  EXPECT_EQ(hw.last_erase_bank, 0x01u);
+  EXPECT_EQ(hw.last_erase_first_page,
+            (physical - ctx.flash_base) / ctx.flash_page_size);
+
+  const uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  ASSERT_EQ(storage.write(&storage, 0u, data, sizeof(data)), 0);
+  EXPECT_EQ(hw.last_program_addr, physical + ctx.flash_bank_size);
+
+  // And back.
+  ASSERT_EQ(bld_storage_flash_swap_banks(&ctx), 0);
+  EXPECT_EQ(ctx.region_base, physical);
+  EXPECT_EQ(ctx.flash_bank1, 0x01u);
+}
+
+TEST_F(BldStorageStm32l4Test, SwapRejectsRegionsAcrossBanks) {
+  ctx.region_base = ctx.flash_base + ctx.flash_bank_size - 0x800u;
+  ctx.region_size = 0x1000u;
+  EXPECT_LT(bld_storage_flash_swap_banks(&ctx), 0);
+
+  ctx.region_base = ctx.flash_base + 2u * ctx.flash_bank_size;
+  ctx.region_size = 0x800u;
+  EXPECT_LT(bld_storage_flash_swap_banks(&ctx), 0);
+
+  ctx.region_base = ctx.flash_base;
+  ctx.flash_bank2 = 0u;
+  EXPECT_LT(bld_storage_flash_swap_banks(&ctx), 0);
+  EXPECT_LT(bld_storage_flash_swap_banks(nullptr), 0);
+}
+
 }  // namespace
@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "bld_storage_qspi.h"
+}
+
+namespace {
+
+constexpr uint32_t kSector = 0x1000u;
+constexpr uint32_t kBlock = 0x10000u;
+constexpr uint32_t kPage = 0x100u;
+
+// NOR flash: erase sets bytes to 0xFF, programming only clears bits, and a
+// program command must stay within one page.
+struct FakeQspiHw {
+  std::vector<uint8_t> mem = std::vector<uint8_t>(4u * kBlock, 0x00u);
+
+  int read_result = 0;
+  int erase_result = 0;
+  int program_result = 0;
+
+  int read_calls = 0;
+  int program_calls = 0;
+  bool page_crossed = false;
+
+  std::vector<uint32_t> sector_erases;
+  std::vector<uint32_t> block_erases;
+  std::vector<uint32_t> program_lens;
+};
+
+int FakeQspiRead(void* hw, uint32_t addr, uint8_t* out, uint32_t len) {
+  auto* ctx = static_cast<FakeQspiHw*>(hw);
+  ctx->read_calls++;
+  if (ctx->read_result != 0 || addr + len > ctx->mem.size()) {
+    return -1;
+  }
+  std::memcpy(out, ctx->mem.data() + addr, len);
+  return 0;
+}
+
+int FakeQspiEraseSector(void* hw, uint32_t addr) {
+  auto* ctx = static_cast<FakeQspiHw*>(hw);
+  ctx->sector_erases.push_back(addr);
+  if (ctx->erase_result != 0 || addr % kSector != 0u) {
+    return -1;
+  }
+  std::memset(ctx->mem.data() + addr, 0xFF, kSector);
+  return 0;
+}
+
+int FakeQspiEraseBlock(void* hw, uint32_t addr) {
+  auto* ctx = static_cast<FakeQspiHw*>(hw);
+  ctx->block_erases.push_back(addr);
+  if (ctx->erase_result != 0 || addr % kBlock != 0u) {
+    return -1;
+  }
+  std::memset(ctx->mem.data() + addr, 0xFF, kBlock);
+  return 0;
+}
+
+int FakeQspiProgramPage(void* hw,
+                        uint32_t addr,
+                        const uint8_t* data,
+                        uint32_t len) {
+  auto* ctx = static_cast<FakeQspiHw*>(hw);
+  ctx->program_calls++;
+  ctx->program_lens.push_back(len);
+  if (addr / kPage != (addr + len - 1u) / kPage) {
+    ctx->page_crossed = true;
+  }
+  if (ctx->program_result != 0) {
+    return ctx->program_result;
+  }
+  for (uint32_t i = 0; i < len; ++i) {
+    ctx->mem[addr + i] &= data[i];
+  }
+  return 0;
+}
+
+const bld_qspi_ops kQspiOps = {
+    .read = FakeQspiRead,
+    .erase_sector = FakeQspiEraseSector,
+    .erase_block = FakeQspiEraseBlock,
+    .program_page = FakeQspiProgramPage,
+};
+
+const bld_qspi_ops kSectorOnlyOps = {
+    .read = FakeQspiRead,
+    .erase_sector = FakeQspiEraseSector,
+    .erase_block = nullptr,
+    .program_page = FakeQspiProgramPage,
+};
+
+class BldStorageQspiTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ctx = {
+        .region_base = kBlock,
+        .region_size = 2u * kBlock + 3u * kSector,
+        .sector_size = kSector,
+        .block_size = kBlock,
+        .page_size = kPage,
+        .ops = &kQspiOps,
+        .hw = &hw,
+    };
+    ASSERT_EQ(bld_storage_qspi_init(&storage, &ctx), 0);
+  }
+
+  FakeQspiHw hw{};
+  bld_storage storage{};
+  bld_storage_qspi_ctx ctx{};
+};
+
+}  // namespace
+
+TEST_F(BldStorageQspiTest, InitRejectsBadGeometry) {
+  bld_storage other{};
+  bld_storage_qspi_ctx bad = ctx;
+
+  EXPECT_LT(bld_storage_qspi_init(nullptr, &ctx), 0);
+  EXPECT_LT(bld_storage_qspi_init(&other, nullptr), 0);
+
+  bad.region_base = kBlock + kPage;
+  EXPECT_LT(bld_storage_qspi_init(&other, &bad), 0);
+
+  bad = ctx;
+  bad.block_size = kBlock + kPage;
+  EXPECT_LT(bld_storage_qspi_init(&other, &bad), 0);
+
+  bad = ctx;
+  bad.ops = &kSectorOnlyOps;
+  EXPECT_LT(bld_storage_qspi_init(&other, &bad), 0);
+  bad.block_size = 0u;
+  EXPECT_EQ(bld_storage_qspi_init(&other, &bad), 0);
+}
+
+TEST_F(BldStorageQspiTest, EraseUsesBlocksWhereTheyFit) {
+  // One sector up to the block, a whole block, then two sectors.
+  const uint32_t offset = kBlock - kSector;
+  ASSERT_EQ(storage.erase(&storage, offset, kSector + kBlock + kSector + 1u),
+            0);
+
+  EXPECT_EQ(hw.sector_erases,
+            (std::vector<uint32_t>{2u * kBlock - kSector,
+                                   3u * kBlock,
+                                   3u * kBlock + kSector}));
+  EXPECT_EQ(hw.block_erases, std::vector<uint32_t>{2u * kBlock});
+}
+
+TEST_F(BldStorageQspiTest, EraseWithoutBlockOpsUsesSectors) {
+  ctx.block_size = 0u;
+  ctx.ops = &kSectorOnlyOps;
+
+  ASSERT_EQ(storage.erase(&storage, 0u, kBlock), 0);
+  EXPECT_EQ(hw.sector_erases.size(), kBlock / kSector);
+  EXPECT_TRUE(hw.block_erases.empty());
+}
+
+TEST_F(BldStorageQspiTest, EraseRejectsMisalignedOrOutOfRange) {
+  EXPECT_LT(storage.erase(&storage, kPage, kSector), 0);
+  EXPECT_LT(storage.erase(&storage, 0u, ctx.region_size + 1u), 0);
+  EXPECT_LT(storage.erase(&storage, 2u * kBlock, 4u * kSector), 0);
+  EXPECT_LT(storage.erase(&storage, 0u, 0u), 0);
+  EXPECT_TRUE(hw.sector_erases.empty());
+  EXPECT_TRUE(hw.block_erases.empty());
+
+  hw.erase_result = -1;
+  EXPECT_LT(storage.erase(&storage, 0u, kSector), 0);
+}
+
+TEST_F(BldStorageQspiTest, WriteTakesAnyOffsetAndSplitsAtPages) {
+  std::vector<uint8_t> data(3u * kPage + 7u);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 13u + 1u);
+  }
+  ASSERT_EQ(storage.erase(&storage, 0u, kSector), 0);
+
+  const uint32_t offset = kPage - 3u;
+  ASSERT_EQ(storage.write(&storage, offset, data.data(), data.size()), 0);
+
+  EXPECT_FALSE(hw.page_crossed);
+  EXPECT_EQ(hw.program_lens,
+            (std::vector<uint32_t>{3u, kPage, kPage, kPage, 4u}));
+  EXPECT_EQ(std::memcmp(hw.mem.data() + ctx.region_base + offset,
+                        data.data(),
+                        data.size()),
+            0);
+
+  std::vector<uint8_t> out(data.size());
+  ASSERT_EQ(storage.read(&storage, offset, out.data(), out.size()), 0);
+  EXPECT_EQ(out, data);
+}
+
+TEST_F(BldStorageQspiTest, WriteAndReadStayInRegion) {
+  uint8_t byte = 0u;
+
+  EXPECT_LT(storage.write(&storage, ctx.region_size, &byte, 1u), 0);
+  EXPECT_LT(storage.read(&storage, ctx.region_size - 1u, &byte, 2u), 0);
+  EXPECT_EQ(hw.program_calls, 0);
+  EXPECT_EQ(hw.read_calls, 0);
+
+  hw.program_result = -1;
+  EXPECT_LT(storage.write(&storage, 0u, &byte, 1u), 0);
+  hw.read_result = -1;
+  EXPECT_LT(storage.read(&storage, 0u, &byte, 1u), 0);
+}
@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "bld_storage_wc.h"
+}
+
+namespace {
+
+constexpr uint32_t kDoubleword = 8u;
+
+// Flash that programs whole units once: a write must start on a unit and
+// may not touch a unit already programmed since the last erase. A partial
+// last unit is padded with 0xFF, as the STM32L4 backend does.
+struct UnitFlash {
+  uint32_t unit = kDoubleword;
+  std::vector<uint8_t> mem = std::vector<uint8_t>(1024u, 0xFFu);
+  std::vector<bool> programmed = std::vector<bool>(1024u, false);
+  int write_result = 0;
+
+  std::vector<uint32_t> write_offsets;
+  std::vector<uint32_t> write_lens;
+  int erase_calls = 0;
+};
+
+int UnitFlashErase(const bld_storage* self, uint32_t offset, uint32_t size) {
+  auto* flash =
+      const_cast<UnitFlash*>(static_cast<const UnitFlash*>(self->ctx));
+  flash->erase_calls++;
+  for (uint32_t i = offset; i < offset + size; ++i) {
+    flash->mem[i] = 0xFFu;
+    flash->programmed[i / flash->unit] = false;
+  }
+  return 0;
+}
+
+int UnitFlashWrite(const bld_storage* self,
+                   uint32_t offset,
+                   const uint8_t* data,
+                   uint32_t len) {
+  auto* flash =
+      const_cast<UnitFlash*>(static_cast<const UnitFlash*>(self->ctx));
+  flash->write_offsets.push_back(offset);
+  flash->write_lens.push_back(len);
+  if (flash->write_result != 0 || offset % flash->unit != 0u) {
+    return -1;
+  }
+  for (uint32_t u = offset / flash->unit;
+       u <= (offset + len - 1u) / flash->unit;
+       ++u) {
+    if (flash->programmed[u]) {
+      return -1;
+    }
+    flash->programmed[u] = true;
+  }
+  std::memcpy(flash->mem.data() + offset, data, len);
+  return 0;
+}
+
+int UnitFlashRead(const bld_storage* self,
+                  uint32_t offset,
+                  uint8_t* out,
+                  uint32_t len) {
+  const auto* flash = static_cast<const UnitFlash*>(self->ctx);
+  std::memcpy(out, flash->mem.data() + offset, len);
+  return 0;
+}
+
+std::vector<uint8_t> MakeData(size_t len) {
+  std::vector<uint8_t> data(len);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 7u + 3u);
+  }
+  return data;
+}
+
+}  // namespace
+
+class BldStorageWcTest : public ::testing::Test {
+ protected:
+  void SetUp() override { Init(kDoubleword); }
+
+  void Init(uint32_t unit) {
+    flash.unit = unit;
+    inner.erase = UnitFlashErase;
+    inner.write = UnitFlashWrite;
+    inner.read = UnitFlashRead;
+    inner.sync = nullptr;
+    inner.ctx = &flash;
+    ASSERT_EQ(bld_storage_wc_init(&storage, &ctx, &inner, unit), 0);
+  }
+
+  // Writes data from offset 0 in pieces of the given sizes, cycling.
+  void WriteInPieces(const std::vector<uint8_t>& data,
+                     const std::vector<uint32_t>& sizes) {
+    size_t off = 0;
+    for (size_t i = 0; off < data.size(); ++i) {
+      uint32_t n = sizes[i % sizes.size()];
+      if (n > data.size() - off) {
+        n = static_cast<uint32_t>(data.size() - off);
+      }
+      ASSERT_EQ(storage.write(&storage, off, data.data() + off, n), 0) << off;
+      off += n;
+    }
+  }
+
+  UnitFlash flash;
+  bld_storage inner{};
+  bld_storage storage{};
+  bld_storage_wc_ctx ctx{};
+};
+
+TEST_F(BldStorageWcTest, InitRejectsBadUnitOrInner) {
+  bld_storage other{};
+  bld_storage_wc_ctx other_ctx{};
+
+  EXPECT_LT(bld_storage_wc_init(&other, &other_ctx, &inner, 0u), 0);
+  EXPECT_LT(bld_storage_wc_init(&other, &other_ctx, &inner, 12u), 0);
+  EXPECT_LT(bld_storage_wc_init(
+                &other, &other_ctx, &inner, 2u * BLD_WRITE_COMBINE_SIZE),
+            0);
+  EXPECT_LT(bld_storage_wc_init(&other, nullptr, &inner, 8u), 0);
+
+  bld_storage incomplete = inner;
+  incomplete.write = nullptr;
+  EXPECT_LT(bld_storage_wc_init(&other, &other_ctx, &incomplete, 8u), 0);
+
+  EXPECT_NE(storage.sync, nullptr);
+}
+
+TEST_F(BldStorageWcTest, OddSizedWritesLandAsWholeUnits) {
+  const auto data = MakeData(601u);
+
+  // Straight to the flash, the second odd write hits a programmed unit.
+  ASSERT_EQ(inner.write(&inner, 0u, data.data(), 7u), 0);
+  EXPECT_LT(inner.write(&inner, 7u, data.data() + 7u, 13u), 0);
+  ASSERT_EQ(inner.erase(&inner, 0u, 1024u), 0);
+  flash.write_offsets.clear();
+  flash.write_lens.clear();
+
+  WriteInPieces(data, {7u, 13u, 1u, 100u, 5u});
+  ASSERT_EQ(storage.sync(&storage), 0);
+
+  EXPECT_EQ(std::vector<uint8_t>(flash.mem.begin(), flash.mem.begin() + 601),
+            data);
+  for (uint32_t offset : flash.write_offsets) {
+    EXPECT_EQ(offset % kDoubleword, 0u);
+  }
+}
+
+TEST_F(BldStorageWcTest, SmallWritesAreBatchedIntoRows) {
+  Init(256u);
+  const auto data = MakeData(1024u);
+
+  WriteInPieces(data, {32u});
+
+  EXPECT_EQ(flash.write_offsets,
+            (std::vector<uint32_t>{0u, 256u, 512u, 768u}));
+  EXPECT_EQ(flash.write_lens,
+            (std::vector<uint32_t>{256u, 256u, 256u, 256u}));
+  ASSERT_EQ(storage.sync(&storage), 0);
+  EXPECT_EQ(flash.write_lens.size(), 4u);
+  EXPECT_EQ(flash.mem, data);
+}
+
+TEST_F(BldStorageWcTest, WholeUnitsInALongWritePassStraightThrough) {
+  const auto data = MakeData(1003u);
+
+  ASSERT_EQ(storage.write(&storage, 0u, data.data(), 3u), 0);
+  ASSERT_EQ(storage.write(&storage, 3u, data.data() + 3u, 1000u), 0);
+  EXPECT_EQ(flash.write_lens, (std::vector<uint32_t>{8u, 992u}));
+
+  ASSERT_EQ(storage.sync(&storage), 0);
+  EXPECT_EQ(flash.write_offsets, (std::vector<uint32_t>{0u, 8u, 1000u}));
+  EXPECT_EQ(flash.write_lens, (std::vector<uint32_t>{8u, 992u, 3u}));
+  EXPECT_EQ(std::vector<uint8_t>(flash.mem.begin(), flash.mem.begin() + 1003),
+            data);
+}
+
+TEST_F(BldStorageWcTest, WriteElsewhereFlushesHeldUnit) {
+  const uint8_t a[] = {1u, 2u, 3u};
+  const uint8_t b[] = {4u, 5u};
+
+  ASSERT_EQ(storage.write(&storage, 0u, a, sizeof(a)), 0);
+  ASSERT_EQ(storage.write(&storage, 67u, b, sizeof(b)), 0);
+  EXPECT_EQ(flash.write_offsets, std::vector<uint32_t>{0u});
+
+  ASSERT_EQ(storage.sync(&storage), 0);
+  // The unit at 64 is written whole, erased bytes in front of 67.
+  EXPECT_EQ(flash.write_offsets, (std::vector<uint32_t>{0u, 64u}));
+  EXPECT_EQ(flash.write_lens, (std::vector<uint32_t>{3u, 5u}));
+  EXPECT_EQ(flash.mem[66], 0xFFu);
+  EXPECT_EQ(flash.mem[67], 4u);
+  EXPECT_EQ(flash.mem[68], 5u);
+
+  // Nothing left to write.
+  ASSERT_EQ(storage.sync(&storage), 0);
+  EXPECT_EQ(flash.write_offsets.size(), 2u);
+}
+
+TEST_F(BldStorageWcTest, ReadsSeeHeldBytesAndEraseDropsThem) {
+  const uint8_t a[] = {0x11u, 0x22u, 0x33u, 0x44u, 0x55u};
+  uint8_t out[16];
+
+  ASSERT_EQ(storage.write(&storage, 18u, a, sizeof(a)), 0);
+  ASSERT_TRUE(flash.write_offsets.empty());
+
+  ASSERT_EQ(storage.read(&storage, 16u, out, sizeof(out)), 0);
+  EXPECT_EQ(out[1], 0xFFu);
+  EXPECT_EQ(std::memcmp(&out[2], a, sizeof(a)), 0);
+  EXPECT_EQ(out[7], 0xFFu);
+  ASSERT_EQ(storage.read(&storage, 20u, out, 1u), 0);
+  EXPECT_EQ(out[0], 0x33u);
+
+  ASSERT_EQ(storage.erase(&storage, 0u, 64u), 0);
+  EXPECT_EQ(flash.erase_calls, 1);
+  ASSERT_EQ(storage.sync(&storage), 0);
+  EXPECT_TRUE(flash.write_offsets.empty());
+}
+
+TEST_F(BldStorageWcTest, FailedFlushIsReported) {
+  const uint8_t a[] = {1u, 2u, 3u};
+
+  ASSERT_EQ(storage.write(&storage, 0u, a, sizeof(a)), 0);
+  flash.write_result = -1;
+  EXPECT_LT(storage.sync(&storage), 0);
+
+  // Filling a unit writes it out at once.
+  const auto data = MakeData(kDoubleword);
+  ASSERT_EQ(storage.write(&storage, 8u, data.data(), 3u), 0);
+  EXPECT_LT(storage.write(&storage, 11u, data.data() + 3u, 5u), 0);
+  EXPECT_LT(storage.write(&storage, 0u, nullptr, 1u), 0);
+}
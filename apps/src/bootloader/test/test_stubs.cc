@@ -204,6 +204,39 @@ std::vector<uint8_t> MakeDataFrame(uint32_t seq,
   return out;
 }
 
+std::vector<uint8_t> MakeRelocImage(const std::vector<uint8_t>& image,
+                                    uint32_t link_base,
+                                    const std::vector<uint32_t>& offsets) {
+  std::vector<uint8_t> table;
+  uint32_t prev = 0;
+  for (uint32_t offset : offsets) {
+    uint32_t gap = offset / 4 - prev;
+    prev = offset / 4;
+    do {
+      const uint8_t byte = gap & 0x7Fu;
+      gap >>= 7;
+      table.push_back(gap != 0 ? (byte | 0x80u) : byte);
+    } while (gap != 0);
+  }
+  while ((sizeof(bld_reloc_header) + table.size()) % BLD_RELOC_ALIGN != 0) {
+    table.push_back(0);
+  }
+
+  bld_reloc_header hdr{};
+  hdr.magic = BLD_RELOC_MAGIC;
+  hdr.link_base = link_base;
+  hdr.image_size = static_cast<uint32_t>(image.size());
+  hdr.image_crc32 = bld_crc32_ieee(image.data(), image.size(), 0);
+  hdr.table_size = static_cast<uint32_t>(table.size());
+  hdr.count = static_cast<uint32_t>(offsets.size());
+
+  std::vector<uint8_t> out(sizeof(hdr));
+  memcpy(out.data(), &hdr, sizeof(hdr));
+  out.insert(out.end(), table.begin(), table.end());
+  out.insert(out.end(), image.begin(), image.end());
+  return out;
+}
+
 }  // namespace test
 
 extern "C" {
@@ -10,6 +10,7 @@ extern "C" {
 #include "bld_crc32.h"
 #include "bld_meta.h"
 #include "bld_protocol.h"
+#include "bld_reloc.h"
 #include "bld_storage.h"
 #include "bld_storage_flash.h"
 #include "bld_transport.h"
@@ -105,6 +106,12 @@ std::vector<uint8_t> MakeDataFrame(uint32_t seq,
                                    const uint8_t* payload,
                                    uint16_t payload_len);
 
+// Relocatable artifact for image linked at link_base, relocating the words
+// at the given ascending byte offsets.
+std::vector<uint8_t> MakeRelocImage(const std::vector<uint8_t>& image,
+                                    uint32_t link_base,
+                                    const std::vector<uint32_t>& offsets);
+
 template <typename T>
 T ReadStruct(const std::vector<uint8_t>& bytes, size_t offset = 0) {
   T out{};
@@ -0,0 +1,149 @@
+/*Button debouncer on EXTI13 + TIM2 for the B-L475E-IOT01A1 board*/
+#include "button.h"
+
+#include "gpio.h"
+#include "stm32l4xx_hal.h"
+
+#define B2_PIN 13
+#define BTN_IRQ_PRIORITY 6U
+/*TIM2 is a 32-bit counter; 10 kHz wraps after ~5 days*/
+#define BTN_TIMER_HZ 10000U
+#define BTN_TICKS_PER_MS (BTN_TIMER_HZ / 1000U)
+#define BTN_MAX_MS 60000U
+
+static struct {
+	bsp_button_cb cb;
+	void *arg;
+	uint32_t debounce_ticks;
+	uint32_t long_ticks;
+	uint32_t last_edge;     /*TIM2 time of the latest edge*/
+	bool pressed;           /*debounced level*/
+	bool settling;          /*edge seen, debounce window running*/
+	bool long_due;          /*long press expired while settling*/
+} btn;
+
+static void compare_arm(volatile uint32_t *ccr, uint32_t ie, uint32_t at)
+{
+	/*a deadline already passed fires on the next count*/
+	if ((int32_t)(at - TIM2->CNT) <= 0)
+		at = TIM2->CNT + 1U;
+	*ccr = at;
+	TIM2->SR = ~(ie == TIM_DIER_CC1IE ? TIM_SR_CC1IF : TIM_SR_CC2IF);
+	TIM2->DIER |= ie;
+}
+
+static void emit(enum bsp_button_event ev, uint32_t at)
+{
+	if (btn.cb != NULL)
+		btn.cb(ev, at / BTN_TICKS_PER_MS, btn.arg);
+}
+
+int bsp_button_debounce_start(const struct bsp_button_config *cfg,
+			      bsp_button_cb cb, void *arg)
+{
+	if (cfg == NULL || cb == NULL || cfg->debounce_ms > BTN_MAX_MS ||
+	    cfg->long_press_ms > BTN_MAX_MS)
+		return -1;
+
+	NVIC_DisableIRQ(EXTI15_10_IRQn);
+	NVIC_DisableIRQ(TIM2_IRQn);
+
+	btn.cb = cb;
+	btn.arg = arg;
+	btn.debounce_ticks = cfg->debounce_ms * BTN_TICKS_PER_MS;
+	btn.long_ticks = cfg->long_press_ms * BTN_TICKS_PER_MS;
+	btn.pressed = bsp_button_status();
+	btn.settling = false;
+	btn.long_due = false;
+
+	/*free-running timestamp counter; CC1 = debounce, CC2 = long press*/
+	RCC->APB1ENR1 |= RCC_APB1ENR1_TIM2EN;
+	TIM2->CR1 = 0;
+	TIM2->PSC = (SystemCoreClock / BTN_TIMER_HZ) - 1U;
+	TIM2->ARR = 0xFFFFFFFFU;
+	TIM2->DIER = 0;
+	TIM2->EGR = TIM_EGR_UG;
+	TIM2->SR = 0;
+	TIM2->CR1 = TIM_CR1_CEN;
+	HAL_NVIC_SetPriority(TIM2_IRQn, BTN_IRQ_PRIORITY, 0);
+
+	/*both edges: a release is seen as soon as it happens*/
+	EXTI->RTSR1 |= (1U << B2_PIN);
+	EXTI->FTSR1 |= (1U << B2_PIN);
+	EXTI->PR1 = (1U << B2_PIN);
+
+	NVIC_EnableIRQ(TIM2_IRQn);
+	NVIC_EnableIRQ(EXTI15_10_IRQn);
+	return 0;
+}
+
+void bsp_button_edge_isr(void)
+{
+	btn.last_edge = TIM2->CNT;
+	btn.settling = true;
+	/*every edge restarts the quiet window*/
+	compare_arm(&TIM2->CCR1, TIM_DIER_CC1IE,
+		    btn.last_edge + btn.debounce_ticks);
+}
+
+static void debounce_expired(void)
+{
+	bool level = bsp_button_status();
+
+	btn.settling = false;
+	if (level != btn.pressed) {
+		btn.pressed = level;
+		btn.long_due = false;
+		if (level) {
+			emit(BSP_BUTTON_PRESS, btn.last_edge);
+			if (btn.long_ticks != 0U)
+				compare_arm(&TIM2->CCR2, TIM_DIER_CC2IE,
+					    btn.last_edge + btn.long_ticks);
+		} else {
+			TIM2->DIER &= ~TIM_DIER_CC2IE;
+			emit(BSP_BUTTON_RELEASE, btn.last_edge);
+		}
+	} else if (btn.long_due) {
+		/*a bounce while held; the press still stands*/
+		btn.long_due = false;
+		emit(BSP_BUTTON_LONG_PRESS, TIM2->CNT);
+	}
+}
+
+static void long_press_expired(void)
+{
+	if (!btn.pressed)
+		return;
+	if (btn.settling) {
+		/*the line is moving; decide once it settles*/
+		btn.long_due = true;
+		return;
+	}
+	emit(BSP_BUTTON_LONG_PRESS, TIM2->CNT);
+}
+
+void TIM2_IRQHandler(void)
+{
+	uint32_t sr = TIM2->SR & TIM2->DIER;
+
+	if (sr & TIM_SR_CC1IF) {
+		TIM2->SR = ~TIM_SR_CC1IF;
+		TIM2->DIER &= ~TIM_DIER_CC1IE;
+		debounce_expired();
+	}
+	if (sr & TIM_SR_CC2IF) {
+		TIM2->SR = ~TIM_SR_CC2IF;
+		TIM2->DIER &= ~TIM_DIER_CC2IE;
+		long_press_expired();
+	}
+}
+
+uint32_t bsp_button_now_ms(void)
+{
+	return TIM2->CNT / BTN_TICKS_PER_MS;
+}
+
+bool bsp_button_busy(void)
+{
+	return btn.settling || (TIM2->DIER & TIM_DIER_CC2IE) != 0U;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Interrupt-driven debouncer for the user button (B2, EXTI13). Both edges
+ * are timestamped on a free-running TIM2 counter; once the line has been
+ * quiet for debounce_ms its level is sampled and, if it changed, a press or
+ * release is reported with the time of the last edge. A press still held
+ * long_press_ms after it started is reported once more as a long press.
+ * Nothing polls: between edges no interrupt fires.
+ */
+enum bsp_button_event {
+	BSP_BUTTON_PRESS,
+	BSP_BUTTON_RELEASE,
+	BSP_BUTTON_LONG_PRESS,
+};
+
+struct bsp_button_config {
+	uint32_t debounce_ms;
+	uint32_t long_press_ms; /*0 disables long-press reports*/
+};
+
+/*called from interrupt context*/
+typedef void (*bsp_button_cb)(enum bsp_button_event ev,
+			      uint32_t timestamp_ms, void *arg);
+
+/*
+ * Start debouncing with cfg; cb(ev, timestamp_ms, arg) receives events.
+ * Returns 0, or -1 if cfg or cb is missing or a time is out of range.
+ */
+int bsp_button_debounce_start(const struct bsp_button_config *cfg,
+			      bsp_button_cb cb, void *arg);
+
+/*feed an EXTI13 edge; call from HAL_GPIO_EXTI_Callback*/
+void bsp_button_edge_isr(void);
+
+/*milliseconds on the timestamp clock, which wraps after about five days*/
+uint32_t bsp_button_now_ms(void);
+
+/*
+ * true while a debounce window or long-press deadline is running on TIM2,
+ * which stops in STOP modes; the timestamp clock is only guaranteed to keep
+ * time while this is true
+ */
+bool bsp_button_busy(void);
+
+#ifdef __cplusplus
+}
+#endif
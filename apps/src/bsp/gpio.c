@@ -1,5 +1,6 @@
 /*Board Support Package (bsp) for the B-L475E-IOT01A1 board*/
 #include "gpio.h"
+#include "led_seq.h"
 
 #include "stm32l4xx_hal.h"
 
@@ -38,12 +39,7 @@ void bsp_init(void)
 	/*disable pull-up and pull-down resistors*/
 	GPIOC->PUPDR |= (1U << (2 * LED_BLUE));
 
-	/*configure as input*/
-	GPIOC->MODER &= ~(3U << 2 * B2_PIN);
-	/*clear pull-up and pull-down*/
-	GPIOC->PUPDR &= ~(3U << 2 * B2_PIN);
-	/*disable pull-up and pull-down resistors*/
-	GPIOC->PUPDR |= (1U << 2 * B2_PIN);
+	bsp_button_init();
 
 	/*clear EXTI13 bits*/
 	SYSCFG->EXTICR[3] &= ~(0xF << (1 * 4));
@@ -65,6 +61,8 @@ void bsp_init(void)
 
 	HAL_NVIC_SetPriority(EXTI15_10_IRQn, 6, 0);
 	NVIC_EnableIRQ(EXTI15_10_IRQn);
+
+	bsp_led_seq_init();
 }
 
 void bsp_led_green_on(void)
@@ -97,26 +95,20 @@ void bsp_led_blue_toggle(void)
 	GPIOC->ODR ^= (1U << LED_BLUE);
 }
 
-bool bsp_button_status(void)
+void bsp_button_init(void)
 {
-	return (GPIOC->IDR & (1U << B2_PIN)) ? 0 : 1;
+	RCC->AHB2ENR |= RCC_AHB2ENR_GPIOCEN;
+	/*configure as input*/
+	GPIOC->MODER &= ~(3U << 2 * B2_PIN);
+	/*clear pull-up and pull-down*/
+	GPIOC->PUPDR &= ~(3U << 2 * B2_PIN);
+	/*disable pull-up and pull-down resistors*/
+	GPIOC->PUPDR |= (1U << 2 * B2_PIN);
+	/*let the input synchroniser sample the pin once before it is read*/
+	(void)GPIOC->IDR;
 }
 
-void bsp_send_morse_code(uint32_t bitmask)
+bool bsp_button_status(void)
 {
-	uint32_t volatile delay_ctr;
-	enum { DOT_DELAY = 150 };
-
-	for (; bitmask != 0U; bitmask <<= 1) {
-		if ((bitmask & (1U << 31)) != 0U) {
-			bsp_led_green_on();
-		} else {
-			bsp_led_green_off();
-		}
-		for (delay_ctr = DOT_DELAY; delay_ctr != 0U; --delay_ctr) {
-		}
-	}
-	bsp_led_green_off();
-	for (delay_ctr = 7 * DOT_DELAY; delay_ctr != 0U; --delay_ctr) {
-	}
-}
\ No newline at end of file
+	return (GPIOC->IDR & (1U << B2_PIN)) ? 0 : 1;
+}
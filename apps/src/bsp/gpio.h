@@ -19,9 +19,13 @@ void bsp_led_green_off(void);
 void bsp_led_green_toggle(void);
 void bsp_led_blue_toggle(void);
 
-bool bsp_button_status(void);
+/*
+ * configure only the button pin as an input (no EXTI), enough for
+ * bsp_button_status(); bsp_init() does this too
+ */
+void bsp_button_init(void);
 
-void bsp_send_morse_code(uint32_t bitmask);
+bool bsp_button_status(void);
 
 #ifdef __cplusplus
 }
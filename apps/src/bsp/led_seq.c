@@ -0,0 +1,300 @@
+/*LED sequencer on TIM7 for the B-L475E-IOT01A1 board*/
+#include "led_seq.h"
+
+#include "gpio.h"
+#include "stm32l4xx_hal.h"
+
+#define SEQ_IRQ_PRIORITY 6U
+/*PWM slots per millisecond; also the brightness resolution*/
+#define SEQ_PWM_SLOTS BSP_LED_LEVEL_MAX
+/*
+ * TIM7 counts twice per slot: a basic timer does not count with ARR = 0,
+ * so a one-slot period needs two counts. The longest step, 4095 ms, is
+ * 65520 counts and still fits the 16-bit ARR.
+ */
+#define SEQ_COUNTS_PER_SLOT 2U
+#define SEQ_COUNT_HZ (1000U * SEQ_PWM_SLOTS * SEQ_COUNTS_PER_SLOT)
+#define SEQ_COUNTS_PER_MS (SEQ_COUNT_HZ / 1000U)
+
+struct led_channel {
+	const bsp_led_step_t *steps; /*NULL when idle*/
+	uint16_t index;
+	uint16_t ms_left;
+	uint8_t level;
+	bsp_led_done_cb done;
+	void *arg;
+};
+
+static struct led_channel channels[BSP_LED_COUNT];
+static uint8_t pwm_slot;
+static uint16_t period_slots; /*slots the current timer period covers*/
+static bool pwm_on;           /*period_slots is one PWM slot*/
+static bool running;
+
+static void led_set(enum bsp_led led, bool on)
+{
+	if (led == BSP_LED_GREEN) {
+		if (on)
+			bsp_led_green_on();
+		else
+			bsp_led_green_off();
+	} else {
+		if (on)
+			bsp_led_blue_on();
+		else
+			bsp_led_blue_off();
+	}
+}
+
+/*
+ * Load the next timed step. Returns false when the table has ended; the
+ * caller finishes the channel.
+ */
+static bool channel_advance(struct led_channel *c)
+{
+	for (;;) {
+		bsp_led_step_t step = c->steps[c->index];
+
+		if (step == BSP_LED_END)
+			return false;
+		if (step == BSP_LED_REPEAT) {
+			c->index = 0;
+			continue;
+		}
+		c->level = (uint8_t)(step >> 12);
+		c->ms_left = step & 0xFFFU;
+		c->index++;
+		if (c->ms_left != 0U)
+			return true;
+	}
+}
+
+/*move the slot clock on and return the milliseconds that ended*/
+static uint16_t clock_advance(uint32_t slots)
+{
+	slots += pwm_slot;
+	pwm_slot = (uint8_t)(slots % SEQ_PWM_SLOTS);
+	return (uint16_t)(slots / SEQ_PWM_SLOTS);
+}
+
+/*
+ * Set the next timer period. A dimmed LED needs every PWM slot; otherwise
+ * each LED is fully on or off until its step ends, so the period runs to
+ * the nearest step boundary and a step costs one interrupt.
+ */
+static void timer_schedule(void)
+{
+	uint16_t ms = UINT16_MAX;
+	bool pwm = false;
+	uint32_t arr;
+	unsigned i;
+
+	for (i = 0; i < BSP_LED_COUNT; i++) {
+		const struct led_channel *c = &channels[i];
+
+		if (c->steps == NULL)
+			continue;
+		if (c->level != 0U && c->level < SEQ_PWM_SLOTS)
+			pwm = true;
+		if (c->ms_left < ms)
+			ms = c->ms_left;
+	}
+	/*with no channel left the next interrupt stops the timer*/
+	if (ms == UINT16_MAX)
+		ms = 1;
+	pwm_on = pwm;
+	if (pwm)
+		period_slots = 1;
+	else
+		period_slots = (uint16_t)(ms * SEQ_PWM_SLOTS - pwm_slot);
+	arr = (uint32_t)period_slots * SEQ_COUNTS_PER_SLOT - 1U;
+	TIM7->ARR = arr;
+	/*a late interrupt may already be past a one-slot period*/
+	if (TIM7->CNT > arr)
+		TIM7->CNT = arr;
+}
+
+/*
+ * Charge the part of the current period that has run to every channel,
+ * so a sequence started mid-period can shorten it. The period ends at or
+ * before every step boundary, so no step ends here. The counter must be
+ * held and the period must not have ended yet.
+ */
+static void timer_sync(void)
+{
+	uint32_t cnt = TIM7->CNT;
+	uint16_t ms = clock_advance(cnt / SEQ_COUNTS_PER_SLOT);
+	unsigned i;
+
+	TIM7->CNT = cnt % SEQ_COUNTS_PER_SLOT;
+	for (i = 0; i < BSP_LED_COUNT; i++) {
+		if (channels[i].steps != NULL)
+			channels[i].ms_left -= ms;
+	}
+}
+
+static void timer_start(void)
+{
+	TIM7->CR1 = 0;
+	/*APB1 is not divided, so TIM7 runs at HCLK*/
+	TIM7->PSC = (SystemCoreClock / SEQ_COUNT_HZ) - 1U;
+	TIM7->CNT = 0;
+	pwm_slot = 0;
+	/*load PSC now; the resulting update flag is not a tick*/
+	TIM7->EGR = TIM_EGR_UG;
+	TIM7->SR = 0;
+	/*ARR is not preloaded, so it takes effect at once*/
+	timer_schedule();
+	TIM7->DIER = TIM_DIER_UIE;
+	TIM7->CR1 = TIM_CR1_CEN;
+	running = true;
+}
+
+static void timer_stop(void)
+{
+	TIM7->CR1 = 0;
+	running = false;
+}
+
+void bsp_led_seq_init(void)
+{
+	RCC->APB1ENR1 |= RCC_APB1ENR1_TIM7EN;
+	/*the done callbacks post to RTOS queues*/
+	HAL_NVIC_SetPriority(TIM7_IRQn, SEQ_IRQ_PRIORITY, 0);
+	NVIC_EnableIRQ(TIM7_IRQn);
+}
+
+int bsp_led_seq_start(enum bsp_led led, const bsp_led_step_t *steps,
+		      bsp_led_done_cb done, void *arg)
+{
+	struct led_channel *c;
+	uint32_t primask;
+	bool ended = false;
+
+	if ((unsigned)led >= BSP_LED_COUNT || steps == NULL ||
+	    steps[0] == BSP_LED_END || steps[0] == BSP_LED_REPEAT)
+		return -1;
+
+	c = &channels[led];
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if (running) {
+		/*hold the count so the period cannot end while it is charged*/
+		TIM7->CR1 = 0;
+		ended = (TIM7->SR & TIM_SR_UIF) != 0U;
+		if (!ended)
+			timer_sync();
+	}
+	c->steps = steps;
+	c->index = 0;
+	c->done = done;
+	c->arg = arg;
+	if (!channel_advance(c)) {
+		c->steps = NULL;
+	} else {
+		led_set(led, pwm_slot < c->level);
+		/*the pending interrupt charges the ended period to c too*/
+		if (ended)
+			c->ms_left += (uint16_t)((pwm_slot + period_slots) /
+						 SEQ_PWM_SLOTS);
+	}
+	if (running) {
+		if (!ended)
+			timer_schedule();
+		TIM7->CR1 = TIM_CR1_CEN;
+	} else if (c->steps != NULL) {
+		timer_start();
+	}
+	__set_PRIMASK(primask);
+	return 0;
+}
+
+void bsp_led_seq_stop(enum bsp_led led)
+{
+	uint32_t primask;
+
+	if ((unsigned)led >= BSP_LED_COUNT)
+		return;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	channels[led].steps = NULL;
+	led_set(led, false);
+	__set_PRIMASK(primask);
+}
+
+bool bsp_led_seq_busy(enum bsp_led led)
+{
+	return (unsigned)led < BSP_LED_COUNT && channels[led].steps != NULL;
+}
+
+uint32_t bsp_led_seq_stop_limit_us(void)
+{
+	uint32_t left;
+
+	if (!running)
+		return UINT32_MAX;
+	if (pwm_on || (TIM7->SR & TIM_SR_UIF))
+		return 0;
+	left = TIM7->ARR + 1U - TIM7->CNT;
+	return left * 1000U / SEQ_COUNTS_PER_MS;
+}
+
+void bsp_led_seq_resume(uint32_t us)
+{
+	uint32_t cnt;
+
+	if (!running)
+		return;
+	cnt = TIM7->CNT + (us * SEQ_COUNTS_PER_MS + 500U) / 1000U;
+	/*
+	 * The wake lands just short of the step boundary: end the period now
+	 * rather than count on to ARR, which would lose part of a count on
+	 * every stop. UG raises UIF and the interrupt runs on exit.
+	 */
+	if (cnt > TIM7->ARR)
+		TIM7->EGR = TIM_EGR_UG;
+	else
+		TIM7->CNT = cnt;
+}
+
+void TIM7_IRQHandler(void)
+{
+	bsp_led_done_cb done[BSP_LED_COUNT];
+	void *arg[BSP_LED_COUNT];
+	bool active = false;
+	uint16_t ms;
+	unsigned i;
+
+	TIM7->SR = 0;
+	ms = clock_advance(period_slots);
+
+	for (i = 0; i < BSP_LED_COUNT; i++) {
+		struct led_channel *c = &channels[i];
+
+		done[i] = NULL;
+		arg[i] = NULL;
+		if (c->steps == NULL)
+			continue;
+		c->ms_left -= ms;
+		if (c->ms_left == 0U && !channel_advance(c)) {
+			done[i] = c->done;
+			arg[i] = c->arg;
+			c->steps = NULL;
+			led_set((enum bsp_led)i, false);
+			continue;
+		}
+		led_set((enum bsp_led)i, pwm_slot < c->level);
+		active = true;
+	}
+	if (!active)
+		timer_stop();
+	else
+		timer_schedule();
+
+	/*callbacks last: they may start a new sequence*/
+	for (i = 0; i < BSP_LED_COUNT; i++) {
+		if (done[i] != NULL)
+			done[i](arg[i]);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * LED sequencer: every LED runs its own step table from the one TIM7
+ * interrupt, with 8-level software PWM at 1 kHz. The timer interrupts at
+ * 8 kHz only while some LED plays a level between 0 and
+ * BSP_LED_LEVEL_MAX; otherwise it fires once per step boundary, and it
+ * stops when no sequence is playing.
+ *
+ * A step is a 16-bit command: brightness 0..BSP_LED_LEVEL_MAX in the top
+ * four bits and a duration of 1..4095 ms below. BSP_LED_END turns the LED
+ * off and finishes the sequence; BSP_LED_REPEAT jumps back to the first
+ * step. Tables are read in place, so they must outlive the sequence
+ * (usually static const).
+ */
+typedef uint16_t bsp_led_step_t;
+
+#define BSP_LED_LEVEL_MAX 8U
+#define BSP_LED_STEP(level, ms) \
+	((bsp_led_step_t)((((level) & 0xFU) << 12) | ((ms) & 0xFFFU)))
+#define BSP_LED_END ((bsp_led_step_t)0x0000U)
+#define BSP_LED_REPEAT ((bsp_led_step_t)0xF000U)
+
+enum bsp_led {
+	BSP_LED_GREEN,
+	BSP_LED_BLUE,
+	BSP_LED_COUNT,
+};
+
+typedef void (*bsp_led_done_cb)(void *arg);
+
+void bsp_led_seq_init(void);
+
+/*
+ * Replace whatever led is playing with steps, atomically with respect to
+ * the sequencer interrupt. done(arg), if set, runs in interrupt context
+ * when the table reaches BSP_LED_END; it is not called for a sequence that
+ * is replaced or stopped. Returns 0, or -1 for a bad led or empty table.
+ */
+int bsp_led_seq_start(enum bsp_led led, const bsp_led_step_t *steps,
+		      bsp_led_done_cb done, void *arg);
+
+/*stop led's sequence (without calling done) and turn it off*/
+void bsp_led_seq_stop(enum bsp_led led);
+
+bool bsp_led_seq_busy(enum bsp_led led);
+
+/*
+ * TIM7 halts in STOP2. bsp_led_seq_stop_limit_us() is how long the clocks
+ * may stop before the next step is due: UINT32_MAX when nothing plays, 0
+ * while an LED is dimmed. bsp_led_seq_resume(us) moves TIM7 on by the
+ * time they were stopped. Call both with interrupts masked.
+ */
+uint32_t bsp_led_seq_stop_limit_us(void);
+void bsp_led_seq_resume(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -53,7 +53,8 @@
   #include <pw_preprocessor/util.h>
   extern uint32_t SystemCoreClock;
   extern void configureTimerForRunTimeStats(void);
-  extern unsigned long getRunTimeCounterValue(void);
+  extern uint64_t getRunTimeCounterValue(void);
+  extern void traceTaskSwitchedIn(uint32_t task_number);
 #endif
 #define configENABLE_FPU                         0
 #define configENABLE_MPU                         0
@@ -74,10 +75,17 @@
 #define configQUEUE_REGISTRY_SIZE                8
 #define configUSE_PORT_OPTIMISED_TASK_SELECTION  1
 #define configUSE_TIMERS                         1
+/* LPTIM1 ticks the kernel and the idle task sleeps in STOP2 (tickless_idle.c) */
+#define configUSE_TICKLESS_IDLE                  2
 
+/* Run-time stats count DWT CPU cycles, extended to 64 bits (cpu_profiler.cc) */
 #define configGENERATE_RUN_TIME_STATS 1
+#define configRUN_TIME_COUNTER_TYPE uint64_t
+#define configUSE_TRACE_FACILITY 1
 #define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS configureTimerForRunTimeStats
 #define portGET_RUN_TIME_COUNTER_VALUE getRunTimeCounterValue
+/* Expanded inside tasks.c, where the TCB is visible */
+#define traceTASK_SWITCHED_IN() traceTaskSwitchedIn(pxCurrentTCB->uxTCBNumber)
 
 #define configTIMER_QUEUE_LENGTH 10
 #define configTIMER_TASK_PRIORITY (6)
@@ -5,27 +5,41 @@
  *
  * Responsibilities:
  *  - Open and configure serial transport
+ *  - Drive the link from an epoll event loop with queued TX and
+ *    incremental RX parsing
  *  - Build and send bootloader protocol frames
  *  - Receive and validate STATUS / META frames
- *  *  - Select target slot from device metadata
- *  - Transfer firmware image to the inactive slot
+ *  - Take the target slot and its load address from device metadata
+ *  - Transfer firmware image to the inactive slot, either the image built
+ *    for that slot or one relocatable image the device rebases on install
  *  - Trigger boot after successful update
+ *  - Drive several devices concurrently, one session thread per port, all
+ *    sharing the same loaded firmware images
  *----------------------------------------------------------------------------*/
 
 #define _GNU_SOURCE
 #include <errno.h>
 #include <fcntl.h>
+#include <glob.h>
 #include <inttypes.h>
-#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
 /*----------------------------------------------------------------------------
  * Host defaults
  *----------------------------------------------------------------------------*/
@@ -33,8 +47,29 @@
 #define BLD_HOST_DEFAULT_CHUNK 128u
 #define BLD_HOST_DEFAULT_TIMEOUT_MS 5000
 #define BLD_HOST_DEFAULT_VERSION 0x00000001u
-#define BLD_HOST_POLL_STEP_MS 50
-#define BLD_HOST_DROP_BUF_SIZE 256u
+#define BLD_HOST_DEFAULT_WINDOW 4u
+#define BLD_HOST_DEFAULT_RETRIES 8u
+#define BLD_HOST_RX_BUF_SIZE 4096u
+#define BLD_HOST_RX_MAX_PAYLOAD 1024u
+#define BLD_HOST_TX_QUEUE_INITIAL 4096u
+#define BLD_HOST_QUIET_MS 50
+#define BLD_HOST_MAX_DEVICES 64u
+#define BLD_HOST_LOG_LINE_SIZE 512u
+#define BLD_HOST_PROGRESS_STEP_PCT 10u
+
+/*
+ * Bytes the host may have outstanding towards the device. Kept at half of
+ * the device's UART DMA ring so in-flight DATA frames never overrun it
+ * while the engine is busy programming flash.
+ */
+#define BLD_HOST_DEVICE_RX_BUDGET 2048u
+
+/*
+ * A staging device erases and programs the whole slot before it answers
+ * END: about 11 ms to erase and 11 ms to program each KiB of internal
+ * flash, so a 376K image needs some 8 s on top of the response timeout.
+ */
+#define BLD_HOST_END_MS_PER_KIB 25u
 
 /*----------------------------------------------------------------------------
  * Protocol frame sizes
@@ -43,10 +78,17 @@
 #define BLD_FRAME_CRC32_SIZE 4u
 #define BLD_FRAME_EOF_SIZE 1u
 #define BLD_FRAME_STATUS_PAYLOAD_SIZE 8u
-#define BLD_FRAME_META_PAYLOAD_SIZE 36u
+#define BLD_FRAME_META_HEAD_SIZE 8u
 #define BLD_CMD_RESERVED_SIZE 3u
 #define BLD_DATA_PREFIX_PAYLOAD_SIZE 6u
 
+/* Largest frame the device engine accepts (BLD_MAX_FRAME_SIZE). */
+#define BLD_HOST_MAX_FRAME_SIZE 1024u
+#define BLD_HOST_MAX_CHUNK                                          \
+	(BLD_HOST_MAX_FRAME_SIZE - BLD_FRAME_PREFIX_SIZE -          \
+	 BLD_DATA_PREFIX_PAYLOAD_SIZE - BLD_FRAME_CRC32_SIZE -      \
+	 BLD_FRAME_EOF_SIZE)
+
 /*----------------------------------------------------------------------------
  * Protocol constants
  *----------------------------------------------------------------------------*/
@@ -55,6 +97,16 @@
 #define BLD_SOF 0xA5u
 #define BLD_EOF 0x5Au
 
+/*
+ * Most slots a device may report. Slot count, target slot and the address
+ * each slot's image runs at all come from META.
+ */
+#define BLD_MAX_SLOTS 16u
+
+/* Relocatable image layout; see bld_reloc.h. */
+#define BLD_RELOC_MAGIC 0x52444C42u
+#define BLD_RELOC_ALIGN 8u
+
 /*----------------------------------------------------------------------------
  * Protocol enums
  *----------------------------------------------------------------------------*/
@@ -87,6 +139,14 @@ enum bld_status {
 	BLD_ST_BOOT_ERR = 8,
 };
 
+enum bld_engine_state {
+	BLD_STATE_IDLE = 0,
+	BLD_STATE_WAIT_HEADER = 1,
+	BLD_STATE_RECV_DATA = 2,
+	BLD_STATE_WAIT_END = 3,
+	BLD_STATE_ERROR = 4,
+};
+
 enum bld_slot_id {
 	BLD_SLOT_ID_A = 0,
 	BLD_SLOT_ID_B = 1,
@@ -146,15 +206,28 @@ struct __attribute__((packed)) bld_status_frame {
 	uint8_t eof;
 };
 
+struct __attribute__((packed)) bld_reloc_header {
+	uint32_t magic;
+	uint32_t link_base;
+	uint32_t image_size;
+	uint32_t image_crc32;
+	uint32_t table_size;
+	uint32_t count;
+};
+
+#define BLD_META_SLOT_FACTORY 0x0001u
+
 struct __attribute__((packed)) bld_meta_slot_wire {
 	uint32_t version;
 	uint32_t size;
 	uint32_t crc32;
 	uint8_t state;
 	uint8_t boot_attempts_left;
-	uint16_t reserved;
+	uint16_t flags;
+	uint32_t load_base;
 };
 
+/* META as received: the 8 byte head, then slot_count slots */
 struct __attribute__((packed)) bld_meta_frame {
 	uint8_t sof;
 	uint8_t type;
@@ -163,19 +236,71 @@ struct __attribute__((packed)) bld_meta_frame {
 	uint8_t active_slot;
 	uint8_t confirmed_slot;
 	uint8_t pending_slot;
-	uint8_t reserved0;
+	uint8_t slot_count;
+	uint8_t target_slot;
+	uint8_t reserved[3];
 
-	struct bld_meta_slot_wire slot_a;
-	struct bld_meta_slot_wire slot_b;
+	struct bld_meta_slot_wire slots[BLD_MAX_SLOTS];
 
 	uint32_t crc32;
 	uint8_t eof;
 };
 
+/*----------------------------------------------------------------------------
+ * Logging
+ *
+ * Each session thread tags its output with its device name so interleaved
+ * lines from concurrent sessions stay attributable. A line is emitted with
+ * a single stdio call so lines from different threads never mix.
+ *----------------------------------------------------------------------------*/
+static __thread const char *host_log_tag;
+
+static void host_vlog(FILE *out, const char *fmt, va_list ap)
+{
+	char line[BLD_HOST_LOG_LINE_SIZE];
+
+	vsnprintf(line, sizeof(line), fmt, ap);
+	if (host_log_tag != NULL) {
+		fprintf(out, "[%s] %s", host_log_tag, line);
+	} else {
+		fputs(line, out);
+	}
+}
+
+static void host_err(const char *fmt, ...)
+	__attribute__((format(printf, 1, 2)));
+static void host_err(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	host_vlog(stderr, fmt, ap);
+	va_end(ap);
+}
+
+static void host_out(const char *fmt, ...)
+	__attribute__((format(printf, 1, 2)));
+static void host_out(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	host_vlog(stdout, fmt, ap);
+	va_end(ap);
+}
+
+static void host_perror(const char *what)
+{
+	host_err("%s: %s\n", what, strerror(errno));
+}
+
 /*----------------------------------------------------------------------------
  * Generic host utility helpers
  *----------------------------------------------------------------------------*/
-static uint32_t crc32_table[256];
+/*
+ * Slice-by-8 tables: crc32_table[k][b] is the CRC of byte b followed by k
+ * zero bytes, so eight input bytes are folded per step. Words are loaded
+ * little-endian, like every other multi-byte field on the wire.
+ */
+static uint32_t crc32_table[8][256];
 
 static void crc32_init(void)
 {
@@ -184,18 +309,64 @@ static void crc32_init(void)
 		for (int bit = 0; bit < 8; ++bit) {
 			c = (c & 1u) ? (BLD_CRC32_POLY ^ (c >> 1)) : (c >> 1);
 		}
-		crc32_table[i] = c;
+		crc32_table[0][i] = c;
+	}
+
+	for (uint32_t i = 0; i < 256u; ++i) {
+		for (int k = 1; k < 8; ++k) {
+			uint32_t prev = crc32_table[k - 1][i];
+			crc32_table[k][i] =
+				(prev >> 8) ^ crc32_table[0][prev & 0xFFu];
+		}
 	}
 }
 
+#if defined(__ARM_FEATURE_CRC32)
+/* The ARMv8 CRC32 instructions implement the same reflected polynomial. */
+static uint32_t crc32_update(uint32_t crc, const uint8_t *buf, size_t len)
+{
+	uint32_t c = crc;
+
+	while (len >= 8u) {
+		uint64_t w;
+		memcpy(&w, buf, sizeof(w));
+		c = __crc32d(c, w);
+		buf += 8;
+		len -= 8u;
+	}
+	while (len > 0u) {
+		c = __crc32b(c, *buf++);
+		--len;
+	}
+	return c;
+}
+#else
 static uint32_t crc32_update(uint32_t crc, const uint8_t *buf, size_t len)
 {
 	uint32_t c = crc;
-	for (size_t i = 0; i < len; ++i) {
-		c = crc32_table[(c ^ buf[i]) & 0xFFu] ^ (c >> 8);
+
+	while (len >= 8u) {
+		uint32_t lo;
+		uint32_t hi;
+		memcpy(&lo, buf, sizeof(lo));
+		memcpy(&hi, buf + 4, sizeof(hi));
+		lo ^= c;
+		c = crc32_table[7][lo & 0xFFu] ^
+		    crc32_table[6][(lo >> 8) & 0xFFu] ^
+		    crc32_table[5][(lo >> 16) & 0xFFu] ^
+		    crc32_table[4][lo >> 24] ^ crc32_table[3][hi & 0xFFu] ^
+		    crc32_table[2][(hi >> 8) & 0xFFu] ^
+		    crc32_table[1][(hi >> 16) & 0xFFu] ^ crc32_table[0][hi >> 24];
+		buf += 8;
+		len -= 8u;
+	}
+	while (len > 0u) {
+		c = crc32_table[0][(c ^ *buf++) & 0xFFu] ^ (c >> 8);
+		--len;
 	}
 	return c;
 }
+#endif
 
 static uint32_t crc32_compute(const uint8_t *buf, size_t len)
 {
@@ -213,62 +384,46 @@ static uint32_t frame_crc32(const uint8_t *frame_bytes, uint16_t payload_len)
 /*----------------------------------------------------------------------------
  * Generic host utility helpers
  *----------------------------------------------------------------------------*/
-static int read_file(const char *path, uint8_t **out_buf, size_t *out_len)
+/*
+ * Maps a firmware file read-only. The kernel pages it in on demand, so no
+ * heap copy of the image is ever made; release with munmap().
+ */
+static int map_file(const char *path, const uint8_t **out_buf,
+		    size_t *out_len)
 {
 	struct stat st;
 	if (path == NULL || out_buf == NULL || out_len == NULL) {
 		return -1;
 	}
-	if (stat(path, &st) != 0) {
-		perror("stat");
-		return -1;
-	}
-	if (st.st_size <= 0) {
-		fprintf(stderr, "File is empty\n");
-		return -1;
-	}
 
-	size_t len = (size_t)st.st_size;
-	uint8_t *buf = (uint8_t *)malloc(len);
-	if (buf == NULL) {
-		fprintf(stderr, "malloc failed\n");
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		host_perror("open");
 		return -1;
 	}
 
-	int fd = open(path, O_RDONLY);
-	if (fd < 0) {
-		perror("open");
-		free(buf);
+	if (fstat(fd, &st) != 0) {
+		host_perror("fstat");
+		close(fd);
 		return -1;
 	}
-
-	size_t off = 0u;
-	while (off < len) {
-		ssize_t r = read(fd, buf + off, len - off);
-		if (r < 0) {
-			if (errno == EINTR) {
-				continue;
-			}
-			perror("read");
-			close(fd);
-			free(buf);
-			return -1;
-		}
-		if (r == 0) {
-			break;
-		}
-		off += (size_t)r;
+	if (st.st_size <= 0) {
+		host_err("File is empty\n");
+		close(fd);
+		return -1;
 	}
 
+	size_t len = (size_t)st.st_size;
+	void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
 	close(fd);
-
-	if (off != len) {
-		fprintf(stderr, "Short read: got %zu expected %zu\n", off, len);
-		free(buf);
+	if (map == MAP_FAILED) {
+		host_perror("mmap");
 		return -1;
 	}
 
-	*out_buf = buf;
+	(void)madvise(map, len, MADV_SEQUENTIAL);
+
+	*out_buf = (const uint8_t *)map;
 	*out_len = len;
 	return 0;
 }
@@ -343,16 +498,15 @@ static const char *slot_state_to_string(uint8_t state)
 
 static const char *slot_id_to_string(uint8_t slot)
 {
-	switch ((enum bld_slot_id)slot) {
-	case BLD_SLOT_ID_A:
-		return "A";
-	case BLD_SLOT_ID_B:
-		return "B";
-	case BLD_SLOT_ID_NONE:
-		return "NONE";
-	default:
-		return "UNKNOWN";
+	static const char *const names[BLD_MAX_SLOTS] = {
+		"A", "B", "C", "D", "E", "F", "G", "H",
+		"I", "J", "K", "L", "M", "N", "O", "P",
+	};
+
+	if (slot < BLD_MAX_SLOTS) {
+		return names[slot];
 	}
+	return (slot == (uint8_t)BLD_SLOT_ID_NONE) ? "NONE" : "UNKNOWN";
 }
 
 /*----------------------------------------------------------------------------
@@ -364,15 +518,15 @@ static int serial_open(const char *dev, int baud)
 		return -1;
 	}
 
-	int fd = open(dev, O_RDWR | O_NOCTTY | O_CLOEXEC);
+	int fd = open(dev, O_RDWR | O_NOCTTY | O_CLOEXEC | O_NONBLOCK);
 	if (fd < 0) {
-		perror("open serial");
+		host_perror("open serial");
 		return -1;
 	}
 
 	struct termios tio;
 	if (tcgetattr(fd, &tio) != 0) {
-		perror("tcgetattr");
+		host_perror("tcgetattr");
 		close(fd);
 		return -1;
 	}
@@ -385,13 +539,13 @@ static int serial_open(const char *dev, int baud)
 
 	speed_t sp = baud_to_speed(baud);
 	if (sp == 0) {
-		fprintf(stderr, "Unsupported baud: %d\n", baud);
+		host_err("Unsupported baud: %d\n", baud);
 		close(fd);
 		return -1;
 	}
 
 	if (cfsetispeed(&tio, sp) != 0 || cfsetospeed(&tio, sp) != 0) {
-		perror("cfset*speed");
+		host_perror("cfset*speed");
 		close(fd);
 		return -1;
 	}
@@ -400,7 +554,7 @@ static int serial_open(const char *dev, int baud)
 	tio.c_cc[VTIME] = 0;
 
 	if (tcsetattr(fd, TCSANOW, &tio) != 0) {
-		perror("tcsetattr");
+		host_perror("tcsetattr");
 		close(fd);
 		return -1;
 	}
@@ -409,81 +563,337 @@ static int serial_open(const char *dev, int baud)
 	return fd;
 }
 
-static int write_all(int fd, const uint8_t *buf, size_t len)
+static int64_t monotonic_ms(void)
 {
-	if (buf == NULL) {
-		return -1;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*----------------------------------------------------------------------------
+ * Incremental RX frame parser
+ *
+ * Bytes are appended as they arrive; complete frames are extracted once
+ * framing, EOF and CRC32 check out. Anything else is skipped one byte at a
+ * time until the next SOF, so a corrupted frame never stalls the stream.
+ *----------------------------------------------------------------------------*/
+struct rx_parser {
+	uint8_t buf[BLD_HOST_RX_BUF_SIZE];
+	size_t len;
+};
+
+struct rx_frame {
+	uint8_t type;
+	uint16_t len;
+	uint8_t payload[BLD_HOST_RX_MAX_PAYLOAD];
+	uint32_t crc32;
+};
+
+static void rx_parser_consume(struct rx_parser *p, size_t count)
+{
+	if (count >= p->len) {
+		p->len = 0u;
+		return;
 	}
+	memmove(p->buf, p->buf + count, p->len - count);
+	p->len -= count;
+}
 
-	size_t off = 0u;
-	while (off < len) {
-		ssize_t written = write(fd, buf + off, len - off);
-		if (written < 0) {
-			if (errno == EINTR) {
-				continue;
-			}
-			perror("write");
+static size_t rx_parser_space(const struct rx_parser *p)
+{
+	return sizeof(p->buf) - p->len;
+}
+
+/*
+ * Returns 1 when a frame was extracted into out, 0 when more bytes are
+ * needed.
+ */
+static int rx_parser_next(struct rx_parser *p, struct rx_frame *out)
+{
+	while (p->len > 0u) {
+		if (p->buf[0] != BLD_SOF) {
+			const uint8_t *sof = memchr(p->buf, BLD_SOF, p->len);
+			rx_parser_consume(p, (sof == NULL) ?
+						     p->len :
+						     (size_t)(sof - p->buf));
+			continue;
+		}
+
+		if (p->len < BLD_FRAME_PREFIX_SIZE) {
+			return 0;
+		}
+
+		uint16_t len = 0u;
+		memcpy(&len, &p->buf[2], sizeof(len));
+		if (len > BLD_HOST_RX_MAX_PAYLOAD) {
+			rx_parser_consume(p, 1u);
+			continue;
+		}
+
+		size_t total = BLD_FRAME_PREFIX_SIZE + (size_t)len +
+			       BLD_FRAME_CRC32_SIZE + BLD_FRAME_EOF_SIZE;
+		if (p->len < total) {
+			return 0;
+		}
+
+		uint32_t rx_crc32 = 0u;
+		memcpy(&rx_crc32, &p->buf[BLD_FRAME_PREFIX_SIZE + len],
+		       sizeof(rx_crc32));
+
+		if (p->buf[total - 1u] != BLD_EOF ||
+		    frame_crc32(p->buf, len) != rx_crc32) {
+			rx_parser_consume(p, 1u);
+			continue;
+		}
+
+		out->type = p->buf[1];
+		out->len = len;
+		memcpy(out->payload, &p->buf[BLD_FRAME_PREFIX_SIZE], len);
+		out->crc32 = rx_crc32;
+		rx_parser_consume(p, total);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*----------------------------------------------------------------------------
+ * TX queue
+ *
+ * Frames are appended here and drained whenever the serial fd is writable,
+ * so the caller never blocks on the line while acknowledgements arrive.
+ *----------------------------------------------------------------------------*/
+struct tx_queue {
+	uint8_t *buf;
+	size_t head;
+	size_t tail;
+	size_t cap;
+};
+
+static size_t tx_queue_pending(const struct tx_queue *q)
+{
+	return q->tail - q->head;
+}
+
+static int tx_queue_push(struct tx_queue *q, const uint8_t *data, size_t len)
+{
+	if (q->head == q->tail) {
+		q->head = 0u;
+		q->tail = 0u;
+	}
+
+	if (q->cap - q->tail < len && q->head > 0u) {
+		memmove(q->buf, q->buf + q->head, tx_queue_pending(q));
+		q->tail -= q->head;
+		q->head = 0u;
+	}
+
+	if (q->cap - q->tail < len) {
+		size_t cap = (q->cap == 0u) ? BLD_HOST_TX_QUEUE_INITIAL :
+					      q->cap;
+		while (cap - q->tail < len) {
+			cap *= 2u;
+		}
+		uint8_t *buf = (uint8_t *)realloc(q->buf, cap);
+		if (buf == NULL) {
+			host_err("realloc failed\n");
 			return -1;
 		}
-		off += (size_t)written;
+		q->buf = buf;
+		q->cap = cap;
+	}
+
+	memcpy(q->buf + q->tail, data, len);
+	q->tail += len;
+	return 0;
+}
+
+static void tx_queue_free(struct tx_queue *q)
+{
+	free(q->buf);
+	memset(q, 0, sizeof(*q));
+}
+
+/*----------------------------------------------------------------------------
+ * Event loop session
+ *
+ * One serial fd registered with epoll. The loop drains the TX queue on
+ * EPOLLOUT and feeds the RX parser on EPOLLIN, so transmission and parsing
+ * of acknowledgements overlap.
+ *----------------------------------------------------------------------------*/
+struct host_session {
+	int fd;
+	int epfd;
+	bool want_out;
+	struct rx_parser rx;
+	struct tx_queue tx;
+
+	/* Optional; called whenever the acknowledged chunk count advances. */
+	void (*on_progress)(void *arg, uint32_t acked, uint32_t total);
+	void *progress_arg;
+};
+
+static int session_update_events(struct host_session *s)
+{
+	bool want_out = tx_queue_pending(&s->tx) > 0u;
+	if (want_out == s->want_out) {
+		return 0;
+	}
+
+	struct epoll_event ev = {
+		.events = EPOLLIN | (want_out ? EPOLLOUT : 0u),
+		.data.fd = s->fd,
+	};
+	if (epoll_ctl(s->epfd, EPOLL_CTL_MOD, s->fd, &ev) != 0) {
+		host_perror("epoll_ctl");
+		return -1;
 	}
+	s->want_out = want_out;
 	return 0;
 }
 
-static ssize_t read_timeout(int fd, uint8_t *buf, size_t max_len,
-			    int timeout_ms)
+static int session_open(struct host_session *s, const char *dev, int baud)
 {
-	if (buf == NULL || max_len == 0u) {
+	memset(s, 0, sizeof(*s));
+	s->epfd = -1;
+
+	s->fd = serial_open(dev, baud);
+	if (s->fd < 0) {
 		return -1;
 	}
 
-	struct pollfd pfd = { .fd = fd, .events = POLLIN };
-	int pr = poll(&pfd, 1, timeout_ms);
-	if (pr < 0) {
-		if (errno == EINTR) {
-			return 0;
-		}
-		perror("poll");
+	s->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (s->epfd < 0) {
+		host_perror("epoll_create1");
+		close(s->fd);
 		return -1;
 	}
-	if (pr == 0) {
-		return 0;
+
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = s->fd };
+	if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->fd, &ev) != 0) {
+		host_perror("epoll_ctl");
+		close(s->epfd);
+		close(s->fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void session_close(struct host_session *s)
+{
+	if (s->epfd >= 0) {
+		close(s->epfd);
 	}
-	if ((pfd.revents & POLLIN) != 0) {
-		ssize_t r = read(fd, buf, max_len);
+	if (s->fd >= 0) {
+		close(s->fd);
+	}
+	tx_queue_free(&s->tx);
+}
+
+static int session_flush(struct host_session *s)
+{
+	while (tx_queue_pending(&s->tx) > 0u) {
+		ssize_t w = write(s->fd, s->tx.buf + s->tx.head,
+				  tx_queue_pending(&s->tx));
+		if (w < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			host_perror("write");
+			return -1;
+		}
+		s->tx.head += (size_t)w;
+	}
+	return session_update_events(s);
+}
+
+static int session_fill(struct host_session *s)
+{
+	while (rx_parser_space(&s->rx) > 0u) {
+		ssize_t r = read(s->fd, s->rx.buf + s->rx.len,
+				 rx_parser_space(&s->rx));
 		if (r < 0) {
 			if (errno == EINTR) {
-				return 0;
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
 			}
-			perror("read");
+			host_perror("read");
 			return -1;
 		}
-		return r;
+		if (r == 0) {
+			break;
+		}
+		s->rx.len += (size_t)r;
 	}
 	return 0;
 }
 
-static int discard_frame_tail(int fd, size_t byte_count, int timeout_ms)
+static int session_queue(struct host_session *s, const uint8_t *buf,
+			 size_t len)
+{
+	if (buf == NULL || tx_queue_push(&s->tx, buf, len) != 0) {
+		return -1;
+	}
+	return session_flush(s);
+}
+
+/*
+ * Runs the event loop until one frame has been parsed.
+ *
+ * Returns 0 on success, -2 on timeout and -1 on I/O error.
+ */
+static int session_next_frame(struct host_session *s, struct rx_frame *out,
+			      int timeout_ms)
 {
-	uint8_t tmp[BLD_HOST_DROP_BUF_SIZE];
-	size_t remaining = byte_count;
+	int64_t deadline = monotonic_ms() + timeout_ms;
+
+	while (true) {
+		if (rx_parser_next(&s->rx, out) != 0) {
+			return 0;
+		}
+
+		int64_t remaining = deadline - monotonic_ms();
+		if (remaining <= 0) {
+			return -2;
+		}
 
-	while (remaining > 0u) {
-		size_t chunk = (remaining > sizeof(tmp)) ? sizeof(tmp) :
-							   remaining;
-		ssize_t r = read_timeout(fd, tmp, chunk, timeout_ms);
-		if (r <= 0) {
+		struct epoll_event ev;
+		int n = epoll_wait(s->epfd, &ev, 1, (int)remaining);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			host_perror("epoll_wait");
+			return -1;
+		}
+		if (n == 0) {
+			continue;
+		}
+
+		if ((ev.events & EPOLLOUT) != 0u && session_flush(s) != 0) {
+			return -1;
+		}
+		if ((ev.events & EPOLLIN) != 0u && session_fill(s) != 0) {
+			return -1;
+		}
+		if ((ev.events & (EPOLLERR | EPOLLHUP)) != 0u &&
+		    (ev.events & EPOLLIN) == 0u) {
+			host_err("serial: device hung up\n");
 			return -1;
 		}
-		remaining -= (size_t)r;
 	}
-	return 0;
 }
 
 /*----------------------------------------------------------------------------
  * Protocol transmit helpers
  *----------------------------------------------------------------------------*/
-static int send_cmd(int fd, enum bld_cmd cmd)
+static int send_cmd(struct host_session *s, enum bld_cmd cmd)
 {
 	struct bld_cmd_frame frame;
 	memset(&frame, 0, sizeof(frame));
@@ -493,11 +903,11 @@ static int send_cmd(int fd, enum bld_cmd cmd)
 	frame.cmd = (uint8_t)cmd;
 	frame.crc32 = frame_crc32((const uint8_t *)&frame, frame.len);
 	frame.eof = BLD_EOF;
-	return write_all(fd, (const uint8_t *)&frame, sizeof(frame));
+	return session_queue(s, (const uint8_t *)&frame, sizeof(frame));
 }
 
-static int send_header(int fd, uint32_t image_size, uint32_t image_crc32,
-		       uint32_t version)
+static int send_header(struct host_session *s, uint32_t image_size,
+		       uint32_t image_crc32, uint32_t version)
 {
 	struct bld_header_frame frame;
 	memset(&frame, 0, sizeof(frame));
@@ -509,25 +919,34 @@ static int send_header(int fd, uint32_t image_size, uint32_t image_crc32,
 	frame.version = version;
 	frame.crc32 = frame_crc32((const uint8_t *)&frame, frame.len);
 	frame.eof = BLD_EOF;
-	return write_all(fd, (const uint8_t *)&frame, sizeof(frame));
+	return session_queue(s, (const uint8_t *)&frame, sizeof(frame));
 }
 
-static int send_data(int fd, uint32_t seq, const uint8_t *chunk,
-		     uint16_t chunk_len)
+/*----------------------------------------------------------------------------
+ * Precomputed DATA frames
+ *
+ * An image is encoded once into back-to-back DATA frames, CRCs included.
+ * Sending, retransmitting and sending the same image to further boards
+ * only copy finished frames into the TX queue.
+ *----------------------------------------------------------------------------*/
+struct data_frames {
+	uint8_t *buf;
+	size_t stride;
+	size_t last_size;
+	uint32_t count;
+};
+
+static size_t data_frame_size(uint16_t chunk_len)
 {
-	if (chunk == NULL || chunk_len == 0u) {
-		return -1;
-	}
+	return BLD_FRAME_PREFIX_SIZE + BLD_DATA_PREFIX_PAYLOAD_SIZE +
+	       (size_t)chunk_len + BLD_FRAME_CRC32_SIZE + BLD_FRAME_EOF_SIZE;
+}
 
+static void encode_data_frame(uint8_t *frame, uint32_t seq,
+			      const uint8_t *chunk, uint16_t chunk_len)
+{
 	uint16_t payload_len =
 		(uint16_t)(BLD_DATA_PREFIX_PAYLOAD_SIZE + chunk_len);
-	size_t total_size = BLD_FRAME_PREFIX_SIZE + (size_t)payload_len +
-			    BLD_FRAME_CRC32_SIZE + BLD_FRAME_EOF_SIZE;
-
-	uint8_t *frame = (uint8_t *)malloc(total_size);
-	if (frame == NULL) {
-		return -1;
-	}
 
 	size_t offset = 0u;
 	frame[offset++] = BLD_SOF;
@@ -544,521 +963,997 @@ static int send_data(int fd, uint32_t seq, const uint8_t *chunk,
 	uint32_t crc32 = frame_crc32(frame, payload_len);
 	memcpy(&frame[offset], &crc32, sizeof(crc32));
 	offset += sizeof(crc32);
-	frame[offset++] = BLD_EOF;
-
-	int rc = write_all(fd, frame, total_size);
-	free(frame);
-	return rc;
+	frame[offset] = BLD_EOF;
 }
 
-/*----------------------------------------------------------------------------
- * Protocol receive helpers
- *----------------------------------------------------------------------------*/
-static int recv_status(int fd, struct bld_status_frame *out, int timeout_ms)
+/*
+ * Encodes every chunk of fw and, in the same pass over the image, computes
+ * the whole-image CRC32 announced in HEADER.
+ */
+static int data_frames_build(struct data_frames *df, const uint8_t *fw,
+			     size_t fw_len, uint16_t chunk_size,
+			     uint32_t *image_crc32)
 {
-	if (out == NULL) {
+	if (fw == NULL || fw_len == 0u || chunk_size == 0u ||
+	    chunk_size > BLD_HOST_MAX_CHUNK) {
 		return -1;
 	}
 
-	uint8_t byte = 0u;
-	int elapsed_ms = 0;
-
-	while (true) {
-		ssize_t r = read_timeout(fd, &byte, 1u, BLD_HOST_POLL_STEP_MS);
-		if (r < 0) {
-			return -1;
-		}
-		if (r == 0) {
-			elapsed_ms += BLD_HOST_POLL_STEP_MS;
-			if (elapsed_ms >= timeout_ms) {
-				return -2;
-			}
-			continue;
-		}
-		if (byte == BLD_SOF) {
-			break;
-		}
-	}
-
-	uint8_t hdr[3];
-	ssize_t r = read_timeout(fd, hdr, sizeof(hdr), timeout_ms);
-	if (r < 0) {
+	size_t count = (fw_len + chunk_size - 1u) / chunk_size;
+	if (count > UINT32_MAX) {
 		return -1;
 	}
-	if (r != (ssize_t)sizeof(hdr)) {
-		return -2;
-	}
-
-	uint8_t type = hdr[0];
-	uint16_t len = 0u;
-	memcpy(&len, &hdr[1], sizeof(len));
-
-	if (type != BLD_PKT_STATUS) {
-		if (discard_frame_tail(fd,
-				       (size_t)len + BLD_FRAME_CRC32_SIZE +
-					       BLD_FRAME_EOF_SIZE,
-				       timeout_ms) != 0) {
-			return -1;
-		}
-		return -3;
-	}
 
-	size_t rest_size =
-		(size_t)len + BLD_FRAME_CRC32_SIZE + BLD_FRAME_EOF_SIZE;
-	uint8_t *rest = (uint8_t *)malloc(rest_size);
-	if (rest == NULL) {
+	memset(df, 0, sizeof(*df));
+	df->stride = data_frame_size(chunk_size);
+	df->count = (uint32_t)count;
+	df->buf = (uint8_t *)malloc(df->stride * count);
+	if (df->buf == NULL) {
+		host_err("malloc failed\n");
 		return -1;
 	}
 
-	size_t got = 0u;
-	while (got < rest_size) {
-		ssize_t rr = read_timeout(fd, rest + got, rest_size - got,
-					  timeout_ms);
-		if (rr < 0) {
-			free(rest);
-			return -1;
-		}
-		if (rr == 0) {
-			free(rest);
-			return -2;
+	uint32_t crc = BLD_CRC32_INITIAL;
+	for (uint32_t seq = 0u; seq < df->count; ++seq) {
+		size_t off = (size_t)seq * chunk_size;
+		uint16_t chunk_len = chunk_size;
+		if (fw_len - off < (size_t)chunk_len) {
+			chunk_len = (uint16_t)(fw_len - off);
 		}
-		got += (size_t)rr;
-	}
 
-	size_t crc_input_len = BLD_FRAME_PREFIX_SIZE + (size_t)len;
-	uint8_t *crc_buf = (uint8_t *)malloc(crc_input_len);
-	if (crc_buf == NULL) {
-		free(rest);
-		return -1;
+		encode_data_frame(df->buf + (size_t)seq * df->stride, seq,
+				  fw + off, chunk_len);
+		crc = crc32_update(crc, fw + off, chunk_len);
+		df->last_size = data_frame_size(chunk_len);
 	}
 
-	crc_buf[0] = BLD_SOF;
-	crc_buf[1] = type;
-	memcpy(&crc_buf[2], &len, sizeof(len));
-	memcpy(&crc_buf[4], rest, len);
+	*image_crc32 = crc ^ BLD_CRC32_INITIAL;
+	return 0;
+}
 
-	uint32_t rx_crc32 = 0u;
-	memcpy(&rx_crc32, rest + len, sizeof(rx_crc32));
-	uint8_t rx_eof = rest[len + BLD_FRAME_CRC32_SIZE];
-	uint32_t calc_crc32 = crc32_compute(crc_buf, crc_input_len);
+static void data_frames_free(struct data_frames *df)
+{
+	free(df->buf);
+	memset(df, 0, sizeof(*df));
+}
 
-	free(crc_buf);
+static int send_data_frame(struct host_session *s,
+			   const struct data_frames *df, uint32_t seq)
+{
+	size_t len = (seq + 1u == df->count) ? df->last_size : df->stride;
+	return session_queue(s, df->buf + (size_t)seq * df->stride, len);
+}
 
-	if (rx_eof != BLD_EOF) {
-		free(rest);
-		return -4;
+/*----------------------------------------------------------------------------
+ * Protocol receive helpers
+ *----------------------------------------------------------------------------*/
+static void decode_status(const struct rx_frame *frame,
+			  struct bld_status_frame *out)
+{
+	memset(out, 0, sizeof(*out));
+	out->sof = BLD_SOF;
+	out->type = frame->type;
+	out->len = frame->len;
+	if (frame->len >= BLD_FRAME_STATUS_PAYLOAD_SIZE) {
+		out->status = frame->payload[0];
+		out->state = frame->payload[1];
+		memcpy(&out->reserved, frame->payload + 2,
+		       sizeof(out->reserved));
+		memcpy(&out->detail, frame->payload + 4, sizeof(out->detail));
+	}
+	out->crc32 = frame->crc32;
+	out->eof = BLD_EOF;
+}
+
+static int recv_status(struct host_session *s, struct bld_status_frame *out,
+		       int timeout_ms)
+{
+	struct rx_frame frame;
+
+	if (out == NULL) {
+		return -1;
 	}
-	if (calc_crc32 != rx_crc32) {
-		free(rest);
-		return -5;
+
+	int rc = session_next_frame(s, &frame, timeout_ms);
+	if (rc != 0) {
+		return rc;
 	}
 
-	memset(out, 0, sizeof(*out));
-	out->sof = BLD_SOF;
-	out->type = type;
-	out->len = len;
-	if (len >= BLD_FRAME_STATUS_PAYLOAD_SIZE) {
-		out->status = rest[0];
-		out->state = rest[1];
-		memcpy(&out->reserved, rest + 2, sizeof(out->reserved));
-		memcpy(&out->detail, rest + 4, sizeof(out->detail));
-	}
-	out->crc32 = rx_crc32;
-	out->eof = rx_eof;
-
-	free(rest);
+	if (frame.type != BLD_PKT_STATUS) {
+		return -3;
+	}
+
+	decode_status(&frame, out);
 	return 0;
 }
 
-static int recv_meta(int fd, struct bld_meta_frame *out, int timeout_ms)
+static int recv_meta(struct host_session *s, struct bld_meta_frame *out,
+		     int timeout_ms)
 {
+	struct rx_frame frame;
+
 	if (out == NULL) {
 		return -1;
 	}
 
-	uint8_t byte = 0u;
-	int elapsed_ms = 0;
+	int rc = session_next_frame(s, &frame, timeout_ms);
+	if (rc != 0) {
+		return rc;
+	}
 
-	while (true) {
-		ssize_t r = read_timeout(fd, &byte, 1u, BLD_HOST_POLL_STEP_MS);
-		if (r < 0) {
-			return -1;
-		}
-		if (r == 0) {
-			elapsed_ms += BLD_HOST_POLL_STEP_MS;
-			if (elapsed_ms >= timeout_ms) {
-				return -2;
-			}
-			continue;
-		}
-		if (byte == BLD_SOF) {
-			break;
-		}
+	if (frame.type != BLD_PKT_META) {
+		return -3;
+	}
+
+	memset(out, 0, sizeof(*out));
+	out->sof = BLD_SOF;
+	out->type = frame.type;
+	out->len = frame.len;
+
+	if (frame.len < BLD_FRAME_META_HEAD_SIZE) {
+		return -4;
+	}
+
+	/* the head matches the frame struct field for field */
+	memcpy(&out->active_slot, frame.payload, BLD_FRAME_META_HEAD_SIZE);
+	if (out->slot_count == 0u || out->slot_count > BLD_MAX_SLOTS ||
+	    frame.len != BLD_FRAME_META_HEAD_SIZE +
+				 out->slot_count *
+					 sizeof(struct bld_meta_slot_wire)) {
+		return -4;
 	}
 
-	uint8_t hdr[3];
-	ssize_t r = read_timeout(fd, hdr, sizeof(hdr), timeout_ms);
-	if (r < 0) {
+	memcpy(out->slots, frame.payload + BLD_FRAME_META_HEAD_SIZE,
+	       out->slot_count * sizeof(struct bld_meta_slot_wire));
+
+	out->crc32 = frame.crc32;
+	out->eof = BLD_EOF;
+	return 0;
+}
+
+static int expect_ok_status(struct host_session *s, int timeout_ms,
+			    const char *where)
+{
+	struct bld_status_frame frame;
+	int rc = recv_status(s, &frame, timeout_ms);
+	if (rc == -2) {
+		host_err("%s: timeout waiting STATUS\n", where);
 		return -1;
 	}
-	if (r != (ssize_t)sizeof(hdr)) {
-		return -2;
+	if (rc != 0) {
+		host_err("%s: failed to parse STATUS (rc=%d)\n", where,
+			 rc);
+		return -1;
+	}
+	if (frame.status != BLD_ST_OK) {
+		host_err(
+			"%s: STATUS=%s(%u) state=%u detail=0x%08" PRIx32 "\n",
+			where, status_to_string(frame.status), frame.status,
+			frame.state, frame.detail);
+		return -1;
 	}
+	return 0;
+}
 
-	uint8_t type = hdr[0];
-	uint16_t len = 0u;
-	memcpy(&len, &hdr[1], sizeof(len));
+/* END may install a staged image first (BLD_HOST_END_MS_PER_KIB). */
+static int end_timeout_ms(int timeout_ms, size_t image_len)
+{
+	size_t kib = (image_len + 1023u) / 1024u;
+
+	return timeout_ms + (int)(kib * BLD_HOST_END_MS_PER_KIB);
+}
 
-	if (type != BLD_PKT_META) {
-		if (discard_frame_tail(fd,
-				       (size_t)len + BLD_FRAME_CRC32_SIZE +
-					       BLD_FRAME_EOF_SIZE,
-				       timeout_ms) != 0) {
+/*----------------------------------------------------------------------------
+ * Pipelined image transfer
+ *
+ * Up to `window` DATA frames are kept in flight. The engine answers every
+ * frame it parses with exactly one STATUS, in order, so each OK advances the
+ * device's expected sequence by one. On a corrupted frame the device reports
+ * BAD_CRC/BAD_FRAME and then SEQ_ERR (detail = expected seq) for every frame
+ * behind it; the host stops sending, drains the outstanding statuses and
+ * resends from the first unacknowledged chunk (go-back-N). A timeout does
+ * the same, which also covers a frame or STATUS lost on the line.
+ *----------------------------------------------------------------------------*/
+static bool status_is_retryable(uint8_t status)
+{
+	return status == BLD_ST_BAD_CRC || status == BLD_ST_BAD_FRAME ||
+	       status == BLD_ST_SEQ_ERR;
+}
+
+static int send_image_data(struct host_session *s,
+			   const struct data_frames *df, unsigned window,
+			   unsigned max_retries, int timeout_ms)
+{
+	uint32_t total = df->count;
+	uint32_t acked = 0u;
+	uint32_t next = 0u;
+	uint32_t inflight = 0u;
+	bool recovering = false;
+	unsigned retries = 0u;
+
+	/* The retry budget applies per chunk and is refilled on progress. */
+	while (acked < total) {
+		uint32_t acked_before = acked;
+
+		while (!recovering && next < total && inflight < window) {
+			if (send_data_frame(s, df, next) != 0) {
+				return -1;
+			}
+			++next;
+			++inflight;
+		}
+
+		struct bld_status_frame st;
+		int rc = recv_status(s, &st, timeout_ms);
+		if (rc == -3) {
+			continue;
+		}
+		if (rc == -2) {
+			if (retries++ >= max_retries) {
+				host_err(
+					"data: timeout waiting STATUS at seq=%" PRIu32
+					"\n",
+					acked);
+				return -1;
+			}
+			inflight = 0u;
+			recovering = false;
+			next = acked;
+			continue;
+		}
+		if (rc != 0) {
+			host_err("data: failed to parse STATUS (rc=%d)\n",
+				 rc);
 			return -1;
 		}
-		return -3;
-	}
 
-	size_t rest_size =
-		(size_t)len + BLD_FRAME_CRC32_SIZE + BLD_FRAME_EOF_SIZE;
-	uint8_t *rest = (uint8_t *)malloc(rest_size);
-	if (rest == NULL) {
-		return -1;
-	}
+		if (inflight > 0u) {
+			--inflight;
+		}
 
-	size_t got = 0u;
-	while (got < rest_size) {
-		ssize_t rr = read_timeout(fd, rest + got, rest_size - got,
-					  timeout_ms);
-		if (rr < 0) {
-			free(rest);
+		if (st.status == BLD_ST_OK) {
+			++acked;
+		} else if (st.status == BLD_ST_BAD_STATE &&
+			   st.detail == BLD_STATE_WAIT_END) {
+			/* The OK for the last chunk was lost on the way. */
+			acked = total;
+		} else if (status_is_retryable(st.status)) {
+			/* SEQ_ERR carries the sequence the device expects. */
+			if (st.status == BLD_ST_SEQ_ERR && st.detail > acked &&
+			    st.detail <= next) {
+				acked = st.detail;
+			}
+			if (!recovering && retries++ >= max_retries) {
+				host_err(
+					"data: STATUS=%s(%u) detail=0x%08" PRIx32
+					", retries exhausted at seq=%" PRIu32 "\n",
+					status_to_string(st.status), st.status,
+					st.detail, acked);
+				return -1;
+			}
+			recovering = true;
+		} else {
+			host_err(
+				"data: STATUS=%s(%u) state=%u detail=0x%08" PRIx32
+				"\n",
+				status_to_string(st.status), st.status,
+				st.state, st.detail);
+			host_err("Failed at seq=%" PRIu32 "\n", acked);
 			return -1;
 		}
-		if (rr == 0) {
-			free(rest);
-			return -2;
+
+		if (acked != acked_before) {
+			retries = 0u;
+			if (s->on_progress != NULL) {
+				s->on_progress(s->progress_arg, acked, total);
+			}
+		}
+		if (recovering && inflight == 0u) {
+			recovering = false;
+			next = acked;
 		}
-		got += (size_t)rr;
 	}
 
-	size_t crc_input_len = BLD_FRAME_PREFIX_SIZE + (size_t)len;
-	uint8_t *crc_buf = (uint8_t *)malloc(crc_input_len);
-	if (crc_buf == NULL) {
-		free(rest);
-		return -1;
+	/*
+	 * Frames behind the last chunk, and any a resynchronisation split or
+	 * merged, are still answered. Swallow those statuses so END sees only
+	 * its own.
+	 */
+	while (true) {
+		struct bld_status_frame st;
+		int wait_ms = (inflight > 0u) ? timeout_ms : BLD_HOST_QUIET_MS;
+		int rc = recv_status(s, &st, wait_ms);
+		if (rc == -2) {
+			break;
+		}
+		if (rc == -1) {
+			return -1;
+		}
+		if (inflight > 0u) {
+			--inflight;
+		}
 	}
 
-	crc_buf[0] = BLD_SOF;
-	crc_buf[1] = type;
-	memcpy(&crc_buf[2], &len, sizeof(len));
-	memcpy(&crc_buf[4], rest, len);
+	return 0;
+}
 
-	uint32_t rx_crc32 = 0u;
-	memcpy(&rx_crc32, rest + len, sizeof(rx_crc32));
-	uint8_t rx_eof = rest[len + BLD_FRAME_CRC32_SIZE];
-	uint32_t calc_crc32 = crc32_compute(crc_buf, crc_input_len);
+/*----------------------------------------------------------------------------
+ * Shared firmware images
+ *
+ * Each image is mapped, CRC'd and encoded into DATA frames at most once, on
+ * first use. The frames are then shared read-only by every session that
+ * targets a slot it serves.
+ *
+ * A relocatable image serves every slot with one set of frames. The device
+ * stores it rebased to the slot's load address from META, so what META
+ * reports for the slot is worked out here by applying the relocations for
+ * that address; each address is worked out once. An image linked for one
+ * address serves every slot only on a device whose slots all run there
+ * (the dual-bank boot mode).
+ *----------------------------------------------------------------------------*/
+struct fw_image {
+	const char *path;
+	const uint8_t *map;
+	size_t len;
+	uint32_t crc32;
+	struct data_frames frames;
+	bool relocatable;
+	/* size of the image as stored in a slot */
+	uint32_t stored_len;
+	/* CRC of the image as stored at each load address seen so far */
+	uint32_t load_base[BLD_MAX_SLOTS];
+	uint32_t load_crc32[BLD_MAX_SLOTS];
+	unsigned load_count;
+	bool loaded;
+	int load_rc;
+};
 
-	free(crc_buf);
+/* one image for every slot, or one per slot in slot order */
+struct fw_images {
+	pthread_mutex_t lock;
+	uint16_t chunk_size;
+	unsigned count;
+	struct fw_image img[BLD_MAX_SLOTS];
+};
 
-	if (rx_eof != BLD_EOF) {
-		free(rest);
-		return -4;
-	}
-	if (calc_crc32 != rx_crc32) {
-		free(rest);
-		return -5;
+static void fw_images_init(struct fw_images *imgs, char *const *paths,
+			   unsigned count, uint16_t chunk_size)
+{
+	memset(imgs, 0, sizeof(*imgs));
+	pthread_mutex_init(&imgs->lock, NULL);
+	imgs->chunk_size = chunk_size;
+	imgs->count = count;
+	for (unsigned i = 0u; i < count; ++i) {
+		imgs->img[i].path = paths[i];
 	}
+}
 
-	memset(out, 0, sizeof(*out));
-	out->sof = BLD_SOF;
-	out->type = type;
-	out->len = len;
+static void fw_image_free(struct fw_image *img)
+{
+	data_frames_free(&img->frames);
+	if (img->map != NULL) {
+		munmap((void *)img->map, img->len);
+		img->map = NULL;
+	}
+}
 
-	if (len >= BLD_FRAME_META_PAYLOAD_SIZE) {
-		size_t off = 0u;
+static int reloc_read_gap(const uint8_t *table, uint32_t size,
+			  uint32_t *pos, uint32_t *gap)
+{
+	uint32_t value = 0u;
+	unsigned shift = 0u;
+	uint8_t byte;
 
-		memcpy(&out->active_slot, rest + off, sizeof(out->active_slot));
-		off += sizeof(out->active_slot);
+	do {
+		if (*pos >= size || shift > 28u) {
+			return -1;
+		}
+		byte = table[(*pos)++];
+		value |= (uint32_t)(byte & 0x7Fu) << shift;
+		shift += 7u;
+	} while ((byte & 0x80u) != 0u);
 
-		memcpy(&out->confirmed_slot, rest + off,
-		       sizeof(out->confirmed_slot));
-		off += sizeof(out->confirmed_slot);
+	*gap = value;
+	return 0;
+}
 
-		memcpy(&out->pending_slot, rest + off,
-		       sizeof(out->pending_slot));
-		off += sizeof(out->pending_slot);
+/* CRC of a relocatable image as the device stores it at load_base. */
+static int reloc_slot_crc32(const struct fw_image *img, uint32_t load_base,
+			    uint32_t *crc)
+{
+	struct bld_reloc_header hdr;
+	const uint8_t *table;
+	uint8_t *image;
+	uint32_t pos = 0u;
+	uint32_t index = 0u;
+	uint32_t gap;
+	uint32_t word;
+
+	memcpy(&hdr, img->map, sizeof(hdr));
+	table = img->map + sizeof(hdr);
+
+	image = malloc(hdr.image_size);
+	if (image == NULL) {
+		host_perror("malloc");
+		return -1;
+	}
+	memcpy(image, table + hdr.table_size, hdr.image_size);
 
-		memcpy(&out->reserved0, rest + off, sizeof(out->reserved0));
-		off += sizeof(out->reserved0);
+	for (uint32_t i = 0u; i < hdr.count; ++i) {
+		if (reloc_read_gap(table, hdr.table_size, &pos, &gap) != 0 ||
+		    (i != 0u && gap == 0u) ||
+		    (uint64_t)index + gap >= hdr.image_size / 4u) {
+			host_err("%s: bad relocation table\n", img->path);
+			free(image);
+			return -1;
+		}
+		index += gap;
+		memcpy(&word, image + index * 4u, sizeof(word));
+		word += load_base - hdr.link_base;
+		memcpy(image + index * 4u, &word, sizeof(word));
+	}
 
-		memcpy(&out->slot_a, rest + off, sizeof(out->slot_a));
-		off += sizeof(out->slot_a);
+	*crc = crc32_compute(image, hdr.image_size);
+	free(image);
+	return 0;
+}
 
-		memcpy(&out->slot_b, rest + off, sizeof(out->slot_b));
+static int fw_image_load_reloc(struct fw_image *img)
+{
+	struct bld_reloc_header hdr;
+	size_t prefix;
+
+	memcpy(&hdr, img->map, sizeof(hdr));
+	prefix = sizeof(hdr) + (size_t)hdr.table_size;
+	if (prefix % BLD_RELOC_ALIGN != 0u || prefix > img->len ||
+	    img->len - prefix != hdr.image_size || hdr.image_size == 0u) {
+		host_err("%s: relocatable image is truncated or corrupt\n",
+			 img->path);
+		return -1;
 	}
 
-	out->crc32 = rx_crc32;
-	out->eof = rx_eof;
+	if (crc32_compute(img->map + prefix, hdr.image_size) !=
+	    hdr.image_crc32) {
+		host_err("%s: image CRC does not match its header\n",
+			 img->path);
+		return -1;
+	}
 
-	free(rest);
+	img->relocatable = true;
+	img->stored_len = hdr.image_size;
 	return 0;
 }
 
-static int expect_ok_status(int fd, int timeout_ms, const char *where)
+static int fw_image_load(struct fw_image *img, uint16_t chunk_size)
 {
-	struct bld_status_frame frame;
-	int rc = recv_status(fd, &frame, timeout_ms);
-	if (rc == -2) {
-		fprintf(stderr, "%s: timeout waiting STATUS\n", where);
+	uint32_t magic = 0u;
+
+	if (map_file(img->path, &img->map, &img->len) != 0) {
 		return -1;
 	}
-	if (rc != 0) {
-		fprintf(stderr, "%s: failed to parse STATUS (rc=%d)\n", where,
-			rc);
+
+	if (img->len >= sizeof(struct bld_reloc_header)) {
+		memcpy(&magic, img->map, sizeof(magic));
+	}
+
+	if (magic == BLD_RELOC_MAGIC && fw_image_load_reloc(img) != 0) {
+		fw_image_free(img);
 		return -1;
 	}
-	if (frame.status != BLD_ST_OK) {
-		fprintf(stderr,
-			"%s: STATUS=%s(%u) state=%u detail=0x%08" PRIx32 "\n",
-			where, status_to_string(frame.status), frame.status,
-			frame.state, frame.detail);
+
+	if (data_frames_build(&img->frames, img->map, img->len, chunk_size,
+			      &img->crc32) != 0) {
+		fw_image_free(img);
 		return -1;
 	}
+
+	if (!img->relocatable) {
+		img->stored_len = (uint32_t)img->len;
+	}
 	return 0;
 }
 
-/*----------------------------------------------------------------------------
- * Metadata interpretation helpers
- *----------------------------------------------------------------------------*/
-static enum bld_slot_id
-choose_target_slot_from_meta(const struct bld_meta_frame *meta)
+static void fw_images_free(struct fw_images *imgs)
 {
-	if (meta == NULL) {
-		return BLD_SLOT_ID_A;
+	for (unsigned i = 0u; i < imgs->count; ++i) {
+		fw_image_free(&imgs->img[i]);
 	}
+	pthread_mutex_destroy(&imgs->lock);
+}
 
-	if (meta->active_slot == (uint8_t)BLD_SLOT_ID_A) {
-		return BLD_SLOT_ID_B;
+static bool meta_one_load_base(const struct bld_meta_frame *meta)
+{
+	for (uint8_t i = 1u; i < meta->slot_count; ++i) {
+		if (meta->slots[i].load_base != meta->slots[0].load_base) {
+			return false;
+		}
 	}
+	return true;
+}
 
-	if (meta->active_slot == (uint8_t)BLD_SLOT_ID_B) {
-		return BLD_SLOT_ID_A;
+static struct fw_image *fw_images_get(struct fw_images *imgs,
+				      const struct bld_meta_frame *meta,
+				      uint8_t slot)
+{
+	struct fw_image *img;
+	/* a single image serves every slot */
+	bool shared = imgs->count == 1u;
+
+	if (slot >= meta->slot_count || (!shared && slot >= imgs->count)) {
+		host_err("no image given for slot %s\n",
+			 slot_id_to_string(slot));
+		return NULL;
 	}
+	img = &imgs->img[shared ? 0u : slot];
 
-	if (meta->confirmed_slot == (uint8_t)BLD_SLOT_ID_A) {
-		return BLD_SLOT_ID_B;
+	pthread_mutex_lock(&imgs->lock);
+	if (!img->loaded) {
+		img->load_rc = fw_image_load(img, imgs->chunk_size);
+		img->loaded = true;
 	}
+	pthread_mutex_unlock(&imgs->lock);
 
-	if (meta->confirmed_slot == (uint8_t)BLD_SLOT_ID_B) {
-		return BLD_SLOT_ID_A;
+	if (img->load_rc != 0) {
+		return NULL;
 	}
 
-	return BLD_SLOT_ID_A;
+	if (shared && !img->relocatable && !meta_one_load_base(meta)) {
+		host_err("%s is linked for one slot; pass a relocatable image "
+			 "or one image per slot\n",
+			 img->path);
+		return NULL;
+	}
+	return img;
 }
 
-static const char *choose_binary_path(enum bld_slot_id slot,
-				      const char *slot_a_bin,
-				      const char *slot_b_bin)
+/* CRC of img as the device stores it at load_base. */
+static int fw_images_stored_crc32(struct fw_images *imgs,
+				  struct fw_image *img, uint32_t load_base,
+				  uint32_t *crc)
 {
-	if (slot == BLD_SLOT_ID_A) {
-		return slot_a_bin;
+	int rc = 0;
+
+	if (!img->relocatable) {
+		*crc = img->crc32;
+		return 0;
 	}
 
-	if (slot == BLD_SLOT_ID_B) {
-		return slot_b_bin;
+	pthread_mutex_lock(&imgs->lock);
+	for (unsigned i = 0u; i < img->load_count; ++i) {
+		if (img->load_base[i] == load_base) {
+			*crc = img->load_crc32[i];
+			pthread_mutex_unlock(&imgs->lock);
+			return 0;
+		}
 	}
 
-	return NULL;
+	rc = reloc_slot_crc32(img, load_base, crc);
+	if (rc == 0 && img->load_count < BLD_MAX_SLOTS) {
+		img->load_base[img->load_count] = load_base;
+		img->load_crc32[img->load_count] = *crc;
+		img->load_count++;
+	}
+	pthread_mutex_unlock(&imgs->lock);
+	return rc;
 }
 
 /*----------------------------------------------------------------------------
  * High-level host commands
  *----------------------------------------------------------------------------*/
-static int do_query(int fd, int timeout_ms)
+struct write_opts {
+	uint32_t version;
+	uint16_t chunk_size;
+	unsigned window;
+	unsigned retries;
+	int timeout_ms;
+	bool verbose;
+};
+
+struct write_result {
+	enum bld_slot_id slot;
+	size_t bytes;
+	bool up_to_date;
+};
+
+static int do_query(struct host_session *s, int timeout_ms)
 {
 	struct bld_status_frame frame;
-	if (send_cmd(fd, BLD_CMD_QUERY) != 0) {
+	if (send_cmd(s, BLD_CMD_QUERY) != 0) {
 		return -1;
 	}
-	if (recv_status(fd, &frame, timeout_ms) != 0) {
-		fprintf(stderr, "query: failed to receive STATUS\n");
+	if (recv_status(s, &frame, timeout_ms) != 0) {
+		host_err("query: failed to receive STATUS\n");
 		return -1;
 	}
-	printf("STATUS=%s(%u) state=%u detail=0x%08" PRIx32 "\n",
-	       status_to_string(frame.status), frame.status, frame.state,
-	       frame.detail);
+	host_out("STATUS=%s(%u) state=%u detail=0x%08" PRIx32 "\n",
+		 status_to_string(frame.status), frame.status, frame.state,
+		 frame.detail);
 	return 0;
 }
 
-static int do_abort(int fd, int timeout_ms)
+static int do_abort(struct host_session *s, int timeout_ms)
 {
-	if (send_cmd(fd, BLD_CMD_ABORT) != 0) {
+	if (send_cmd(s, BLD_CMD_ABORT) != 0) {
 		return -1;
 	}
-	return expect_ok_status(fd, timeout_ms, "abort");
+	return expect_ok_status(s, timeout_ms, "abort");
 }
 
-static int do_meta(int fd, int timeout_ms, bool verbose)
+static int do_meta(struct host_session *s, int timeout_ms, bool verbose)
 {
 	struct bld_meta_frame frame;
-	if (send_cmd(fd, BLD_CMD_META) != 0) {
+	if (send_cmd(s, BLD_CMD_META) != 0) {
 		return -1;
 	}
-	if (recv_meta(fd, &frame, timeout_ms) != 0) {
-		fprintf(stderr, "meta: failed to receive META\n");
+	if (recv_meta(s, &frame, timeout_ms) != 0) {
+		host_err("meta: failed to receive META\n");
 		return -1;
 	}
 
 	if (verbose) {
-		fprintf(stderr, "META frame received\n");
+		host_err("META frame received\n");
 	}
 
-	printf("active_slot=%s(%u) confirmed_slot=%s(%u) pending_slot=%s(%u)\n",
-	       slot_id_to_string(frame.active_slot), frame.active_slot,
-	       slot_id_to_string(frame.confirmed_slot), frame.confirmed_slot,
-	       slot_id_to_string(frame.pending_slot), frame.pending_slot);
+	host_out("active_slot=%s(%u) confirmed_slot=%s(%u) pending_slot=%s(%u)\n",
+		 slot_id_to_string(frame.active_slot), frame.active_slot,
+		 slot_id_to_string(frame.confirmed_slot), frame.confirmed_slot,
+		 slot_id_to_string(frame.pending_slot), frame.pending_slot);
+
+	host_out("slot_count=%u target_slot=%s(%u)\n", frame.slot_count,
+		 slot_id_to_string(frame.target_slot), frame.target_slot);
 
-	printf("slot_a: version=%" PRIu32 " size=%" PRIu32 " crc32=0x%08" PRIx32
-	       " state=%s(%u) attempts=%u\n",
-	       frame.slot_a.version, frame.slot_a.size, frame.slot_a.crc32,
-	       slot_state_to_string(frame.slot_a.state), frame.slot_a.state,
-	       frame.slot_a.boot_attempts_left);
+	for (uint8_t i = 0u; i < frame.slot_count; ++i) {
+		const struct bld_meta_slot_wire *slot = &frame.slots[i];
 
-	printf("slot_b: version=%" PRIu32 " size=%" PRIu32 " crc32=0x%08" PRIx32
-	       " state=%s(%u) attempts=%u\n",
-	       frame.slot_b.version, frame.slot_b.size, frame.slot_b.crc32,
-	       slot_state_to_string(frame.slot_b.state), frame.slot_b.state,
-	       frame.slot_b.boot_attempts_left);
+		host_out("slot_%s: version=%" PRIu32 " size=%" PRIu32
+			 " crc32=0x%08" PRIx32 " state=%s(%u) attempts=%u"
+			 " load_base=0x%08" PRIx32 "%s\n",
+			 slot_id_to_string(i), slot->version, slot->size,
+			 slot->crc32, slot_state_to_string(slot->state),
+			 slot->state, slot->boot_attempts_left,
+			 slot->load_base,
+			 (slot->flags & BLD_META_SLOT_FACTORY) ? " factory" :
+								 "");
+	}
 	return 0;
 }
 
-static int do_write(int fd, const char *slot_a_path, const char *slot_b_path,
-		    uint32_t version, uint16_t chunk_size, int timeout_ms,
-		    bool verbose)
+static bool slot_holds_image(const struct bld_meta_slot_wire *slot,
+			     const struct fw_image *img, uint32_t stored_crc32,
+			     uint32_t version)
+{
+	return slot->crc32 == stored_crc32 &&
+	       slot->size == img->stored_len &&
+	       slot->version == version &&
+	       (slot->state == (uint8_t)BLD_SLOT_STATE_VALID ||
+		slot->state == (uint8_t)BLD_SLOT_STATE_CONFIRMED ||
+		slot->state == (uint8_t)BLD_SLOT_STATE_PENDING);
+}
+
+static int do_write(struct host_session *s, struct fw_images *imgs,
+		    const struct write_opts *opts, struct write_result *result)
 {
 	struct bld_meta_frame meta;
-	enum bld_slot_id target_slot;
-	const char *firmware_path;
-	uint8_t *fw = NULL;
-	size_t fw_len = 0u;
-	uint32_t image_crc32;
-	uint32_t image_size;
+	uint8_t target_slot;
+	struct fw_image *img;
+	const struct bld_meta_slot_wire *slot_meta;
+	uint32_t stored_crc32;
+
+	memset(result, 0, sizeof(*result));
+	result->slot = BLD_SLOT_ID_NONE;
 
-	if (slot_a_path == NULL || slot_b_path == NULL) {
+	if (send_cmd(s, BLD_CMD_META) != 0) {
+		host_err("write: failed to request META\n");
 		return -1;
 	}
 
-	if (send_cmd(fd, BLD_CMD_META) != 0) {
-		fprintf(stderr, "write: failed to request META\n");
+	if (recv_meta(s, &meta, opts->timeout_ms) != 0) {
+		host_err("write: failed to receive META\n");
 		return -1;
 	}
 
-	if (recv_meta(fd, &meta, timeout_ms) != 0) {
-		fprintf(stderr, "write: failed to receive META\n");
+	/* the device picks the slot; it never offers its factory slot */
+	target_slot = meta.target_slot;
+	result->slot = (enum bld_slot_id)target_slot;
+	if (target_slot >= meta.slot_count) {
+		host_err("write: device has no slot to write\n");
 		return -1;
 	}
+	slot_meta = &meta.slots[target_slot];
 
-	target_slot = choose_target_slot_from_meta(&meta);
-	firmware_path =
-		choose_binary_path(target_slot, slot_a_path, slot_b_path);
-	if (firmware_path == NULL) {
-		fprintf(stderr, "write: failed to choose firmware path\n");
+	if (opts->verbose) {
+		host_err("Target slot from META: %s at 0x%08" PRIx32 "\n",
+			 slot_id_to_string(target_slot), slot_meta->load_base);
+	}
+
+	img = fw_images_get(imgs, &meta, target_slot);
+	if (img == NULL ||
+	    fw_images_stored_crc32(imgs, img, slot_meta->load_base,
+				   &stored_crc32) != 0) {
+		host_err("write: failed to load image for slot %s\n",
+			 slot_id_to_string(target_slot));
 		return -1;
 	}
 
-	if (verbose) {
-		fprintf(stderr, "Target slot decided from META: %s\n",
-			slot_id_to_string((uint8_t)target_slot));
-		fprintf(stderr, "Selected image: %s\n", firmware_path);
+	if (opts->verbose) {
+		host_err("Selected image: %s%s\n", img->path,
+			 img->relocatable ? " (relocatable)" : "");
+		host_err("Image size = %zu\n", img->len);
+		host_err("Image crc32 = 0x%08" PRIx32 "\n", img->crc32);
+		if (img->relocatable) {
+			host_err("Installed crc32 = 0x%08" PRIx32 "\n",
+				 stored_crc32);
+		}
+		host_err("Image version = 0x%08" PRIx32 "\n", opts->version);
 	}
 
-	if (read_file(firmware_path, &fw, &fw_len) != 0) {
+	if (slot_holds_image(slot_meta, img, stored_crc32, opts->version)) {
+		host_err("Selected slot %s already contains this image\n",
+			 slot_id_to_string(target_slot));
+		result->up_to_date = true;
+		return 0;
+	}
+
+	if (send_cmd(s, BLD_CMD_START) != 0 ||
+	    expect_ok_status(s, opts->timeout_ms, "start") != 0) {
 		return -1;
 	}
 
-	image_crc32 = crc32_compute(fw, fw_len);
-	image_size = (uint32_t)fw_len;
+	if (send_header(s, (uint32_t)img->len, img->crc32, opts->version) !=
+		    0 ||
+	    expect_ok_status(s, opts->timeout_ms, "header") != 0) {
+		return -1;
+	}
 
-	if (verbose) {
-		fprintf(stderr, "Image size = %" PRIu32 "\n", image_size);
-		fprintf(stderr, "Image crc32 = 0x%08" PRIx32 "\n", image_crc32);
-		fprintf(stderr, "Image version = 0x%08" PRIx32 "\n", version);
-	}
-
-	if (target_slot == BLD_SLOT_ID_A) {
-		if (meta.slot_a.crc32 == image_crc32 &&
-		    meta.slot_a.size == image_size &&
-		    meta.slot_a.version == version &&
-		    (meta.slot_a.state == (uint8_t)BLD_SLOT_STATE_VALID ||
-		     meta.slot_a.state == (uint8_t)BLD_SLOT_STATE_CONFIRMED ||
-		     meta.slot_a.state == (uint8_t)BLD_SLOT_STATE_PENDING)) {
-			fprintf(stderr,
-				"Selected slot A already contains this image\n");
-			free(fw);
-			return 0;
-		}
-	} else if (target_slot == BLD_SLOT_ID_B) {
-		if (meta.slot_b.crc32 == image_crc32 &&
-		    meta.slot_b.size == image_size &&
-		    meta.slot_b.version == version &&
-		    (meta.slot_b.state == (uint8_t)BLD_SLOT_STATE_VALID ||
-		     meta.slot_b.state == (uint8_t)BLD_SLOT_STATE_CONFIRMED ||
-		     meta.slot_b.state == (uint8_t)BLD_SLOT_STATE_PENDING)) {
-			fprintf(stderr,
-				"Selected slot B already contains this image\n");
-			free(fw);
-			return 0;
-		}
+	if (send_image_data(s, &img->frames, opts->window, opts->retries,
+			    opts->timeout_ms) != 0) {
+		return -1;
 	}
+	result->bytes = img->len;
 
-	if (send_cmd(fd, BLD_CMD_START) != 0 ||
-	    expect_ok_status(fd, timeout_ms, "start") != 0) {
-		free(fw);
+	if (send_cmd(s, BLD_CMD_END) != 0 ||
+	    expect_ok_status(s, end_timeout_ms(opts->timeout_ms, img->len),
+			     "end") != 0) {
 		return -1;
 	}
 
-	if (send_header(fd, image_size, image_crc32, version) != 0 ||
-	    expect_ok_status(fd, timeout_ms, "header") != 0) {
-		free(fw);
+	if (send_cmd(s, BLD_CMD_BOOT) != 0 ||
+	    expect_ok_status(s, opts->timeout_ms, "boot") != 0) {
 		return -1;
 	}
 
-	uint32_t seq = 0u;
-	size_t off = 0u;
-	while (off < fw_len) {
-		uint16_t chunk_len = chunk_size;
-		if (fw_len - off < (size_t)chunk_len) {
-			chunk_len = (uint16_t)(fw_len - off);
-		}
+	return 0;
+}
 
-		if (send_data(fd, seq, fw + off, chunk_len) != 0 ||
-		    expect_ok_status(fd, timeout_ms, "data") != 0) {
-			fprintf(stderr, "Failed at seq=%" PRIu32 " off=%zu\n",
-				seq, off);
-			free(fw);
-			return -1;
-		}
+/*----------------------------------------------------------------------------
+ * Device jobs
+ *
+ * One job per serial device. With a single device the job runs inline;
+ * with several, each job gets its own thread, session and epoll instance
+ * so a slow or failing board never stalls the others.
+ *----------------------------------------------------------------------------*/
+struct job_config {
+	const char *cmd;
+	int baud;
+	bool show_progress;
+	struct write_opts write;
+	struct fw_images *imgs;
+};
+
+struct device_job {
+	const char *device;
+	const char *tag;
+	const struct job_config *cfg;
+	pthread_t thread;
+	bool started;
+	int rc;
+	struct write_result result;
+	int64_t elapsed_ms;
+	unsigned last_pct;
+};
+
+static void job_progress(void *arg, uint32_t acked, uint32_t total)
+{
+	struct device_job *job = (struct device_job *)arg;
+	unsigned pct = (unsigned)((uint64_t)acked * 100u / total);
 
-		off += chunk_len;
-		++seq;
+	if (pct < job->last_pct + BLD_HOST_PROGRESS_STEP_PCT &&
+	    acked != total) {
+		return;
 	}
+	job->last_pct = pct;
+	host_err("data: %3u%% (%" PRIu32 "/%" PRIu32 " chunks)\n", pct, acked,
+		 total);
+}
+
+static int run_job(struct device_job *job)
+{
+	const struct job_config *cfg = job->cfg;
+	struct host_session session;
+	int64_t start_ms = monotonic_ms();
+	int rc = -1;
 
-	if (send_cmd(fd, BLD_CMD_END) != 0 ||
-	    expect_ok_status(fd, timeout_ms, "end") != 0) {
-		free(fw);
+	host_log_tag = job->tag;
+	job->result.slot = BLD_SLOT_ID_NONE;
+
+	if (session_open(&session, job->device, cfg->baud) != 0) {
+		job->rc = -1;
 		return -1;
 	}
 
-	if (send_cmd(fd, BLD_CMD_BOOT) != 0 ||
-	    expect_ok_status(fd, timeout_ms, "boot") != 0) {
-		free(fw);
+	if (cfg->show_progress) {
+		session.on_progress = job_progress;
+		session.progress_arg = job;
+	}
+
+	if (strcmp(cfg->cmd, "write") == 0) {
+		rc = do_write(&session, cfg->imgs, &cfg->write, &job->result);
+	} else if (strcmp(cfg->cmd, "query") == 0) {
+		rc = do_query(&session, cfg->write.timeout_ms);
+	} else if (strcmp(cfg->cmd, "abort") == 0) {
+		rc = do_abort(&session, cfg->write.timeout_ms);
+	} else if (strcmp(cfg->cmd, "meta") == 0) {
+		rc = do_meta(&session, cfg->write.timeout_ms,
+			     cfg->write.verbose);
+	}
+
+	session_close(&session);
+	job->elapsed_ms = monotonic_ms() - start_ms;
+	job->rc = rc;
+	return rc;
+}
+
+static void *job_thread(void *arg)
+{
+	(void)run_job((struct device_job *)arg);
+	return NULL;
+}
+
+static const char *job_result_string(const struct device_job *job)
+{
+	if (job->rc != 0) {
+		return "FAIL";
+	}
+	return job->result.up_to_date ? "SKIP" : "OK";
+}
+
+static void print_job_summary(const struct device_job *jobs, size_t count,
+			      int64_t wall_ms)
+{
+	size_t ok = 0u;
+	size_t total_bytes = 0u;
+
+	printf("\n%-24s %-6s %-4s %10s %9s %10s\n", "device", "result",
+	       "slot", "bytes", "time", "rate");
+	for (size_t i = 0u; i < count; ++i) {
+		const struct device_job *job = &jobs[i];
+		double secs = (double)job->elapsed_ms / 1000.0;
+		double rate = (secs > 0.0) ? (double)job->result.bytes / secs :
+					     0.0;
+
+		printf("%-24s %-6s %-4s %10zu %8.2fs %8.0fB/s\n", job->device,
+		       job_result_string(job),
+		       slot_id_to_string((uint8_t)job->result.slot),
+		       job->result.bytes, secs, rate);
+
+		if (job->rc == 0) {
+			++ok;
+		}
+		total_bytes += job->result.bytes;
+	}
+
+	double wall = (double)wall_ms / 1000.0;
+	printf("%zu/%zu devices OK, %zu bytes in %.2fs wall (%.0f B/s aggregate)\n",
+	       ok, count, total_bytes, wall,
+	       (wall > 0.0) ? (double)total_bytes / wall : 0.0);
+}
+
+/*----------------------------------------------------------------------------
+ * Device list
+ *
+ * -d may be repeated and each argument may be a glob pattern, so a rack of
+ * adapters can be addressed as -d '/dev/serial/by-id/usb-STM*'.
+ *----------------------------------------------------------------------------*/
+struct device_list {
+	char *paths[BLD_HOST_MAX_DEVICES];
+	size_t count;
+};
+
+static int device_list_add(struct device_list *list, const char *path)
+{
+	if (list->count >= BLD_HOST_MAX_DEVICES) {
+		host_err("Too many devices (max %u)\n",
+			 (unsigned)BLD_HOST_MAX_DEVICES);
 		return -1;
 	}
 
-	free(fw);
+	for (size_t i = 0u; i < list->count; ++i) {
+		if (strcmp(list->paths[i], path) == 0) {
+			return 0;
+		}
+	}
+
+	list->paths[list->count] = strdup(path);
+	if (list->paths[list->count] == NULL) {
+		host_err("strdup failed\n");
+		return -1;
+	}
+	++list->count;
 	return 0;
 }
 
+static int device_list_add_pattern(struct device_list *list,
+				   const char *pattern)
+{
+	if (strpbrk(pattern, "*?[") == NULL) {
+		return device_list_add(list, pattern);
+	}
+
+	glob_t g;
+	int grc = glob(pattern, 0, NULL, &g);
+	if (grc == GLOB_NOMATCH) {
+		host_err("No devices match %s\n", pattern);
+		return -1;
+	}
+	if (grc != 0) {
+		host_err("glob failed for %s\n", pattern);
+		return -1;
+	}
+
+	int rc = 0;
+	for (size_t i = 0u; i < g.gl_pathc && rc == 0; ++i) {
+		rc = device_list_add(list, g.gl_pathv[i]);
+	}
+	globfree(&g);
+	return rc;
+}
+
+static void device_list_free(struct device_list *list)
+{
+	for (size_t i = 0u; i < list->count; ++i) {
+		free(list->paths[i]);
+	}
+	list->count = 0u;
+}
+
+static const char *device_tag(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	return (slash != NULL) ? slash + 1 : path;
+}
+
+static int run_jobs(struct device_job *jobs, size_t count)
+{
+	int64_t start_ms = monotonic_ms();
+	int rc = 0;
+
+	if (count == 1u) {
+		return (run_job(&jobs[0]) == 0) ? 0 : 1;
+	}
+
+	for (size_t i = 0u; i < count; ++i) {
+		int prc = pthread_create(&jobs[i].thread, NULL, job_thread,
+					 &jobs[i]);
+		if (prc != 0) {
+			host_err("pthread_create: %s\n", strerror(prc));
+			jobs[i].rc = -1;
+		}
+		jobs[i].started = (prc == 0);
+	}
+
+	for (size_t i = 0u; i < count; ++i) {
+		if (jobs[i].started) {
+			pthread_join(jobs[i].thread, NULL);
+		}
+		if (jobs[i].rc != 0) {
+			rc = 1;
+		}
+	}
+
+	print_job_summary(jobs, count, monotonic_ms() - start_ms);
+	return rc;
+}
+
 /*----------------------------------------------------------------------------
  * CLI helpers
  *----------------------------------------------------------------------------*/
@@ -1066,23 +1961,32 @@ static void usage(const char *prog)
 {
 	fprintf(stderr,
 		"Usage:\n"
-		"  %s -d <device> [-B baud] [-c chunk] [-t ms] [-v hexver] [-V] <cmd> [args]\n"
+		"  %s -d <device> [-d <device>...] [-B baud] [-c chunk] [-w window] [-R retries] [-t ms] [-v hexver] [-V] <cmd> [args]\n"
 		"\n"
 		"Commands:\n"
-		"  write <slot_a.bin> <slot_b.bin>   Read META, choose target slot, and send matching binary\n"
+		"  write <image.bin>      Read META and send the relocatable image to the slot it names\n"
+		"  write <slot_a.bin> <slot_b.bin>...   Same, sending the binary linked for that slot\n"
+		"                         (per-slot binaries must come from another build)\n"
 		"  query                  Send QUERY and print STATUS\n"
 		"  abort                  Send ABORT\n"
 		"  meta                   Send META and print metadata\n"
 		"\n"
 		"Options:\n"
-		"  -d <device>   Serial device (for example /dev/ttyACM0)\n"
+		"  -d <device>   Serial device (for example /dev/ttyACM0). Repeat the\n"
+		"                option or pass a quoted glob (/dev/ttyACM*) to run the\n"
+		"                command on several devices concurrently\n"
 		"  -B <baud>     Baud rate (default %d)\n"
 		"  -c <chunk>    Data chunk size in bytes (default %u)\n"
-		"  -t <ms>       Response timeout in milliseconds (default %d)\n"
+		"  -w <frames>   DATA frames kept in flight (default %u)\n"
+		"  -R <count>    Retransmission rounds before giving up (default %u)\n"
+		"  -t <ms>       Response timeout in milliseconds (default %d);\n"
+		"                END gets %u ms more per KiB of image\n"
 		"  -v <hex>      Firmware version for HEADER (default 0x%08x)\n"
 		"  -V            Verbose output\n",
 		prog, BLD_HOST_DEFAULT_BAUD, BLD_HOST_DEFAULT_CHUNK,
-		BLD_HOST_DEFAULT_TIMEOUT_MS, BLD_HOST_DEFAULT_VERSION);
+		BLD_HOST_DEFAULT_WINDOW, BLD_HOST_DEFAULT_RETRIES,
+		BLD_HOST_DEFAULT_TIMEOUT_MS, BLD_HOST_END_MS_PER_KIB,
+		BLD_HOST_DEFAULT_VERSION);
 }
 
 /*----------------------------------------------------------------------------
@@ -1090,80 +1994,132 @@ static void usage(const char *prog)
  *----------------------------------------------------------------------------*/
 int main(int argc, char **argv)
 {
-	const char *device = NULL;
-	int baud = BLD_HOST_DEFAULT_BAUD;
-	uint16_t chunk = BLD_HOST_DEFAULT_CHUNK;
-	int timeout_ms = BLD_HOST_DEFAULT_TIMEOUT_MS;
-	uint32_t version = BLD_HOST_DEFAULT_VERSION;
-	bool verbose = false;
+	static struct device_job jobs[BLD_HOST_MAX_DEVICES];
+	struct device_list devices = { .count = 0u };
+	struct fw_images imgs;
+	struct job_config cfg = {
+		.baud = BLD_HOST_DEFAULT_BAUD,
+		.write = {
+			.version = BLD_HOST_DEFAULT_VERSION,
+			.chunk_size = BLD_HOST_DEFAULT_CHUNK,
+			.window = BLD_HOST_DEFAULT_WINDOW,
+			.retries = BLD_HOST_DEFAULT_RETRIES,
+			.timeout_ms = BLD_HOST_DEFAULT_TIMEOUT_MS,
+		},
+		.imgs = &imgs,
+	};
+	struct write_opts *wo = &cfg.write;
 
 	crc32_init();
 
 	int opt = 0;
-	while ((opt = getopt(argc, argv, "d:B:c:t:v:Vh")) != -1) {
+	while ((opt = getopt(argc, argv, "d:B:c:w:R:t:v:Vh")) != -1) {
 		switch (opt) {
 		case 'd':
-			device = optarg;
+			if (device_list_add_pattern(&devices, optarg) != 0) {
+				device_list_free(&devices);
+				return 1;
+			}
 			break;
 		case 'B':
-			baud = atoi(optarg);
+			cfg.baud = atoi(optarg);
 			break;
 		case 'c':
-			chunk = (uint16_t)strtoul(optarg, NULL, 0);
+			wo->chunk_size = (uint16_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			wo->window = (unsigned)strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			wo->retries = (unsigned)strtoul(optarg, NULL, 0);
 			break;
 		case 't':
-			timeout_ms = atoi(optarg);
+			wo->timeout_ms = atoi(optarg);
 			break;
 		case 'v':
-			version = (uint32_t)strtoul(optarg, NULL, 0);
+			wo->version = (uint32_t)strtoul(optarg, NULL, 0);
 			break;
 		case 'V':
-			verbose = true;
+			wo->verbose = true;
 			break;
 		case 'h':
 		default:
 			usage(argv[0]);
+			device_list_free(&devices);
 			return 0;
 		}
 	}
 
-	if (device == NULL || optind >= argc) {
+	if (devices.count == 0u || optind >= argc) {
 		usage(argv[0]);
+		device_list_free(&devices);
 		return 1;
 	}
 
-	const char *cmd = argv[optind++];
-
-	int fd = serial_open(device, baud);
-	if (fd < 0) {
+	if (wo->chunk_size == 0u || wo->chunk_size > BLD_HOST_MAX_CHUNK) {
+		host_err("Chunk size must be 1..%u\n",
+			 (unsigned)BLD_HOST_MAX_CHUNK);
+		device_list_free(&devices);
 		return 1;
 	}
 
-	int rc = 0;
-	if (strcmp(cmd, "write") == 0) {
+	/* Never queue more than the device ring can absorb. */
+	unsigned max_window = (unsigned)(BLD_HOST_DEVICE_RX_BUDGET /
+					 data_frame_size(wo->chunk_size));
+	if (max_window == 0u) {
+		max_window = 1u;
+	}
+	if (wo->window == 0u) {
+		wo->window = 1u;
+	}
+	if (wo->window > max_window) {
+		if (wo->verbose) {
+			printf("window clamped to %u for chunk %u\n",
+			       max_window, wo->chunk_size);
+		}
+		wo->window = max_window;
+	}
+
+	cfg.cmd = argv[optind++];
+	if (strcmp(cfg.cmd, "write") == 0) {
 		if (optind >= argc) {
-			fprintf(stderr,
-				"write: missing slot_a.bin and slot_b.bin\n");
-			rc = 1;
-		} else {
-			rc = (do_write(fd, argv[optind], argv[optind + 1],
-				       version, chunk, timeout_ms,
-				       verbose) == 0) ?
-				     0 :
-				     1;
+			host_err("write: missing image.bin\n");
+			device_list_free(&devices);
+			return 1;
+		}
+		if ((unsigned)(argc - optind) > BLD_MAX_SLOTS) {
+			host_err("write: at most %u images\n",
+				 (unsigned)BLD_MAX_SLOTS);
+			device_list_free(&devices);
+			return 1;
 		}
-	} else if (strcmp(cmd, "query") == 0) {
-		rc = (do_query(fd, timeout_ms) == 0) ? 0 : 1;
-	} else if (strcmp(cmd, "abort") == 0) {
-		rc = (do_abort(fd, timeout_ms) == 0) ? 0 : 1;
-	} else if (strcmp(cmd, "meta") == 0) {
-		rc = (do_meta(fd, timeout_ms, verbose) == 0) ? 0 : 1;
+		fw_images_init(&imgs, &argv[optind],
+			       (unsigned)(argc - optind), wo->chunk_size);
+	} else if (strcmp(cfg.cmd, "query") == 0 ||
+		   strcmp(cfg.cmd, "abort") == 0 ||
+		   strcmp(cfg.cmd, "meta") == 0) {
+		fw_images_init(&imgs, NULL, 0u, wo->chunk_size);
 	} else {
-		fprintf(stderr, "Unknown command: %s\n", cmd);
+		host_err("Unknown command: %s\n", cfg.cmd);
 		usage(argv[0]);
-		rc = 1;
+		device_list_free(&devices);
+		return 1;
 	}
 
-	close(fd);
+	/* Progress lines only help when several boards report at once. */
+	cfg.show_progress = devices.count > 1u || wo->verbose;
+
+	for (size_t i = 0u; i < devices.count; ++i) {
+		jobs[i].device = devices.paths[i];
+		jobs[i].tag = (devices.count > 1u) ?
+				      device_tag(devices.paths[i]) :
+				      NULL;
+		jobs[i].cfg = &cfg;
+	}
+
+	int rc = run_jobs(jobs, devices.count);
+
+	fw_images_free(&imgs);
+	device_list_free(&devices);
 	return rc;
-}
\ No newline at end of file
+}
@@ -0,0 +1,470 @@
+/*----------------------------------------------------------------------------
+ * bld_reloc.c
+ *
+ * Build-time tool: turns an application ELF into one relocatable image the
+ * bootloader can install into either slot.
+ *
+ * Usage:
+ *
+ *   bld_reloc <application.elf> <image.bin>
+ *
+ * The ELF must be linked with -Wl,--emit-relocs so that the static
+ * relocations survive into the executable. Every R_ARM_ABS32/R_ARM_TARGET1
+ * word whose linked value points into the image (vector table, literal
+ * pools, function pointers, initialised data) is listed in the table; the
+ * bootloader adds load_base - link_base to exactly those words while it
+ * programs the slot. PC-relative code needs nothing. Absolute MOVW/MOVT
+ * pairs into the image cannot be rebased word-wise and are rejected.
+ *
+ * Output layout (see bld_reloc.h):
+ *
+ *   bld_reloc_header | ULEB128 word-index gaps, zero padded | flat image
+ *
+ * The flat image matches objcopy -O binary: every loadable segment at its
+ * load address, gaps zero-filled.
+ *----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include <elf.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------
+ * Image format; must match bld_reloc.h and BLD_RELOC_TABLE_MAX
+ *----------------------------------------------------------------------------*/
+#define BLD_RELOC_MAGIC 0x52444C42u
+#define BLD_RELOC_ALIGN 8u
+#define BLD_RELOC_TABLE_MAX 4096u
+
+#define CRC32_POLY 0xEDB88320u
+
+struct __attribute__((packed)) bld_reloc_header {
+	uint32_t magic;
+	uint32_t link_base;
+	uint32_t image_size;
+	uint32_t image_crc32;
+	uint32_t table_size;
+	uint32_t count;
+};
+
+struct elf_file {
+	const uint8_t *map;
+	size_t len;
+	const Elf32_Ehdr *ehdr;
+	const Elf32_Phdr *phdr;
+	const Elf32_Shdr *shdr;
+};
+
+struct flat_image {
+	uint32_t link_base;
+	uint32_t size;
+	uint8_t *bytes;
+};
+
+struct offsets {
+	uint32_t *v;
+	size_t count;
+	size_t cap;
+};
+
+static uint32_t crc32_compute(const uint8_t *buf, size_t len)
+{
+	uint32_t crc = 0xFFFFFFFFu;
+
+	for (size_t i = 0; i < len; ++i) {
+		crc ^= buf[i];
+		for (unsigned b = 0; b < 8u; ++b) {
+			crc = (crc >> 1) ^ (CRC32_POLY & (0u - (crc & 1u)));
+		}
+	}
+	return ~crc;
+}
+
+/*----------------------------------------------------------------------------
+ * ELF access
+ *----------------------------------------------------------------------------*/
+static bool elf_range_ok(const struct elf_file *elf, size_t off, size_t len)
+{
+	return off <= elf->len && len <= elf->len - off;
+}
+
+static int elf_open(struct elf_file *elf, const char *path)
+{
+	struct stat st;
+	const Elf32_Ehdr *eh;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		perror(path);
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+
+	elf->len = (size_t)st.st_size;
+	elf->map = mmap(NULL, elf->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (elf->map == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+
+	eh = (const Elf32_Ehdr *)elf->map;
+	if (elf->len < sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG) ||
+	    eh->e_ident[EI_CLASS] != ELFCLASS32 ||
+	    eh->e_ident[EI_DATA] != ELFDATA2LSB || eh->e_machine != EM_ARM ||
+	    eh->e_type != ET_EXEC) {
+		fprintf(stderr, "%s: not a 32-bit little-endian ARM executable\n",
+			path);
+		return -1;
+	}
+
+	if (!elf_range_ok(elf, eh->e_phoff,
+			  (size_t)eh->e_phnum * sizeof(Elf32_Phdr)) ||
+	    !elf_range_ok(elf, eh->e_shoff,
+			  (size_t)eh->e_shnum * sizeof(Elf32_Shdr))) {
+		fprintf(stderr, "%s: truncated ELF headers\n", path);
+		return -1;
+	}
+
+	elf->ehdr = eh;
+	elf->phdr = (const Elf32_Phdr *)(elf->map + eh->e_phoff);
+	elf->shdr = (const Elf32_Shdr *)(elf->map + eh->e_shoff);
+	return 0;
+}
+
+static bool segment_loads(const Elf32_Phdr *ph)
+{
+	return ph->p_type == PT_LOAD && ph->p_filesz != 0u;
+}
+
+/*
+ * Offset in the flat image of the byte linked at run address vaddr, found
+ * through the segment that loads it. Returns -1 if no segment does.
+ */
+static int64_t image_offset(const struct elf_file *elf,
+			    const struct flat_image *img, uint32_t vaddr)
+{
+	for (unsigned i = 0; i < elf->ehdr->e_phnum; ++i) {
+		const Elf32_Phdr *ph = &elf->phdr[i];
+
+		if (segment_loads(ph) && vaddr >= ph->p_vaddr &&
+		    vaddr - ph->p_vaddr < ph->p_filesz) {
+			return (int64_t)ph->p_paddr - img->link_base +
+			       (vaddr - ph->p_vaddr);
+		}
+	}
+	return -1;
+}
+
+/*----------------------------------------------------------------------------
+ * Flat image
+ *----------------------------------------------------------------------------*/
+static int flat_image_build(const struct elf_file *elf, struct flat_image *img)
+{
+	uint32_t lo = UINT32_MAX;
+	uint64_t hi = 0u;
+
+	for (unsigned i = 0; i < elf->ehdr->e_phnum; ++i) {
+		const Elf32_Phdr *ph = &elf->phdr[i];
+
+		if (!segment_loads(ph)) {
+			continue;
+		}
+		if (!elf_range_ok(elf, ph->p_offset, ph->p_filesz)) {
+			fprintf(stderr, "segment %u lies outside the file\n", i);
+			return -1;
+		}
+		if (ph->p_paddr < lo) {
+			lo = ph->p_paddr;
+		}
+		if ((uint64_t)ph->p_paddr + ph->p_filesz > hi) {
+			hi = (uint64_t)ph->p_paddr + ph->p_filesz;
+		}
+	}
+
+	if (hi == 0u) {
+		fprintf(stderr, "no loadable segments\n");
+		return -1;
+	}
+
+	img->link_base = lo;
+	img->size = (uint32_t)(hi - lo);
+	img->bytes = calloc(1, img->size);
+	if (img->bytes == NULL) {
+		perror("calloc");
+		return -1;
+	}
+
+	for (unsigned i = 0; i < elf->ehdr->e_phnum; ++i) {
+		const Elf32_Phdr *ph = &elf->phdr[i];
+
+		if (segment_loads(ph)) {
+			memcpy(img->bytes + (ph->p_paddr - lo),
+			       elf->map + ph->p_offset, ph->p_filesz);
+		}
+	}
+	return 0;
+}
+
+/*----------------------------------------------------------------------------
+ * Relocation scan
+ *----------------------------------------------------------------------------*/
+static int offsets_push(struct offsets *o, uint32_t off)
+{
+	if (o->count == o->cap) {
+		size_t cap = o->cap ? o->cap * 2u : 256u;
+		uint32_t *v = realloc(o->v, cap * sizeof(*v));
+
+		if (v == NULL) {
+			perror("realloc");
+			return -1;
+		}
+		o->v = v;
+		o->cap = cap;
+	}
+	o->v[o->count++] = off;
+	return 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static bool points_into(const struct flat_image *img, uint32_t value)
+{
+	/* one-past-the-end symbols such as _etext move with the image too */
+	return value >= img->link_base && value - img->link_base <= img->size;
+}
+
+static int scan_rel_section(const struct elf_file *elf,
+			    const struct flat_image *img,
+			    const Elf32_Shdr *rel, struct offsets *out,
+			    size_t *seen)
+{
+	const Elf32_Shdr *target;
+	const Elf32_Shdr *symtab;
+	const Elf32_Sym *syms;
+	size_t nsyms;
+	size_t n;
+
+	if (rel->sh_info >= elf->ehdr->e_shnum ||
+	    rel->sh_link >= elf->ehdr->e_shnum) {
+		return -1;
+	}
+
+	/* debug info and other non-loaded sections never reach flash */
+	target = &elf->shdr[rel->sh_info];
+	if (!(target->sh_flags & SHF_ALLOC)) {
+		return 0;
+	}
+
+	symtab = &elf->shdr[rel->sh_link];
+	if (!elf_range_ok(elf, rel->sh_offset, rel->sh_size) ||
+	    !elf_range_ok(elf, symtab->sh_offset, symtab->sh_size)) {
+		return -1;
+	}
+	syms = (const Elf32_Sym *)(elf->map + symtab->sh_offset);
+	nsyms = symtab->sh_size / sizeof(Elf32_Sym);
+	n = rel->sh_size / sizeof(Elf32_Rel);
+
+	for (size_t i = 0; i < n; ++i) {
+		const Elf32_Rel *r =
+			(const Elf32_Rel *)(elf->map + rel->sh_offset) + i;
+		uint32_t type = ELF32_R_TYPE(r->r_info);
+		uint32_t sym = ELF32_R_SYM(r->r_info);
+		int64_t off;
+		uint32_t value;
+
+		(*seen)++;
+		switch (type) {
+		case R_ARM_ABS32:
+		case R_ARM_TARGET1:
+			off = image_offset(elf, img, r->r_offset);
+			if (off < 0) {
+				continue;
+			}
+			memcpy(&value, img->bytes + off, sizeof(value));
+			if (!points_into(img, value)) {
+				continue;
+			}
+			if ((off & 3) != 0) {
+				fprintf(stderr,
+					"unaligned pointer into the image at "
+					"0x%08" PRIx32 "\n",
+					r->r_offset);
+				return -1;
+			}
+			if (offsets_push(out, (uint32_t)off) != 0) {
+				return -1;
+			}
+			break;
+		case R_ARM_MOVW_ABS_NC:
+		case R_ARM_MOVT_ABS:
+		case R_ARM_THM_MOVW_ABS_NC:
+		case R_ARM_THM_MOVT_ABS:
+			if (sym < nsyms && points_into(img, syms[sym].st_value)) {
+				fprintf(stderr,
+					"MOVW/MOVT address of the image at "
+					"0x%08" PRIx32 "; build with literal "
+					"pools\n",
+					r->r_offset);
+				return -1;
+			}
+			break;
+		default:
+			/* PC-relative: moves with the code */
+			break;
+		}
+	}
+	return 0;
+}
+
+static int scan_relocations(const struct elf_file *elf,
+			    const struct flat_image *img, struct offsets *out)
+{
+	size_t seen = 0u;
+	size_t kept = 0u;
+
+	for (unsigned i = 0; i < elf->ehdr->e_shnum; ++i) {
+		if (elf->shdr[i].sh_type == SHT_REL &&
+		    scan_rel_section(elf, img, &elf->shdr[i], out, &seen) !=
+			    0) {
+			fprintf(stderr, "bad relocation section %u\n", i);
+			return -1;
+		}
+	}
+
+	if (seen == 0u) {
+		fprintf(stderr,
+			"no relocations found; link with -Wl,--emit-relocs\n");
+		return -1;
+	}
+
+	qsort(out->v, out->count, sizeof(*out->v), cmp_u32);
+	for (size_t i = 0; i < out->count; ++i) {
+		if (kept == 0u || out->v[i] != out->v[kept - 1u]) {
+			out->v[kept++] = out->v[i];
+		}
+	}
+	out->count = kept;
+	return 0;
+}
+
+/*----------------------------------------------------------------------------
+ * Output
+ *----------------------------------------------------------------------------*/
+static size_t encode_table(const struct offsets *o, uint8_t *table,
+			   size_t cap)
+{
+	size_t len = 0u;
+	uint32_t prev = 0u;
+
+	for (size_t i = 0; i < o->count; ++i) {
+		uint32_t gap = o->v[i] / 4u - prev;
+
+		prev = o->v[i] / 4u;
+		do {
+			uint8_t byte = gap & 0x7Fu;
+
+			gap >>= 7;
+			if (len == cap) {
+				return SIZE_MAX;
+			}
+			table[len++] = gap ? (byte | 0x80u) : byte;
+		} while (gap != 0u);
+	}
+
+	while ((sizeof(struct bld_reloc_header) + len) % BLD_RELOC_ALIGN) {
+		if (len == cap) {
+			return SIZE_MAX;
+		}
+		table[len++] = 0u;
+	}
+	return len;
+}
+
+static int write_image(const char *path, const struct flat_image *img,
+		       const struct offsets *o)
+{
+	static uint8_t table[BLD_RELOC_TABLE_MAX];
+	struct bld_reloc_header hdr;
+	size_t table_len;
+	FILE *f;
+
+	table_len = encode_table(o, table, sizeof(table));
+	if (table_len == SIZE_MAX) {
+		fprintf(stderr,
+			"%zu relocations do not fit the bootloader's %u-byte "
+			"table\n",
+			o->count, BLD_RELOC_TABLE_MAX);
+		return -1;
+	}
+
+	hdr.magic = BLD_RELOC_MAGIC;
+	hdr.link_base = img->link_base;
+	hdr.image_size = img->size;
+	hdr.image_crc32 = crc32_compute(img->bytes, img->size);
+	hdr.table_size = (uint32_t)table_len;
+	hdr.count = (uint32_t)o->count;
+
+	f = fopen(path, "wb");
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    fwrite(table, 1, table_len, f) != table_len ||
+	    fwrite(img->bytes, 1, img->size, f) != img->size) {
+		perror(path);
+		fclose(f);
+		return -1;
+	}
+	if (fclose(f) != 0) {
+		perror(path);
+		return -1;
+	}
+
+	printf("link base 0x%08" PRIx32 ", image %" PRIu32 " bytes, "
+	       "%zu relocations in %zu bytes\n",
+	       img->link_base, img->size, o->count, table_len);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct elf_file elf;
+	struct flat_image img = { 0 };
+	struct offsets relocs = { 0 };
+	int rc = 1;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <application.elf> <image.bin>\n",
+			argv[0]);
+		return 1;
+	}
+
+	if (elf_open(&elf, argv[1]) == 0 && flat_image_build(&elf, &img) == 0 &&
+	    scan_relocations(&elf, &img, &relocs) == 0 &&
+	    write_image(argv[2], &img, &relocs) == 0) {
+		rc = 0;
+	}
+
+	free(relocs.v);
+	free(img.bytes);
+	return rc;
+}
@@ -0,0 +1,725 @@
+/*----------------------------------------------------------------------------
+ * bld_sim.c
+ *
+ * Host-side bootloader simulator.
+ *
+ * Responsibilities:
+ *  - Expose a Linux pseudo-terminal that bld_host can open as a serial port
+ *  - Run the real bootloader engine, UART DMA transport and flash storage
+ *    backend on top of a RAM-backed STM32L4 flash model
+ *  - Simulate line baud rate, flash erase/program latency and bit errors
+ *  - Report transfer and flash statistics so end-to-end runs can be timed
+ *
+ * Typical regression run:
+ *
+ *   bld_sim -l /tmp/bld_sim_tty -x &
+ *   time bld_host -d /tmp/bld_sim_tty write application_image.bin
+ *----------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bld_config.h"
+#include "bld_engine.h"
+#include "bld_meta.h"
+#include "bld_storage_flash.h"
+#include "bld_storage_wc.h"
+#include "bld_transport_uart_dma.h"
+
+/*----------------------------------------------------------------------------
+ * Simulator defaults
+ *----------------------------------------------------------------------------*/
+#define BLD_SIM_DEFAULT_BAUD 115200u
+#define BLD_SIM_DEFAULT_ERASE_US 22000u
+#define BLD_SIM_DEFAULT_PROGRAM_US 82u
+#define BLD_SIM_POLL_TIMEOUT_MS 200u
+#define BLD_SIM_HANGUP_WAIT_MS 2000
+#define BLD_SIM_IDLE_WAIT_MS 1
+#define BLD_SIM_MIN_SLEEP_NS 1000000ull
+#define BLD_SIM_UART_BITS_PER_BYTE 10ull
+
+#define BLD_SIM_FLASH_SIZE (2u * BLD_FLASH_BANK_SIZE)
+#define BLD_SIM_FLASH_BANK_1 1u
+#define BLD_SIM_FLASH_BANK_2 2u
+#define BLD_SIM_FLASH_ERASED_BYTE 0xFFu
+#define BLD_SIM_DOUBLEWORD_ERASED 0xFFFFFFFFFFFFFFFFull
+
+#define NS_PER_US 1000ull
+#define NS_PER_MS 1000000ull
+#define NS_PER_S 1000000000ull
+
+/*----------------------------------------------------------------------------
+ * Simulator state
+ *----------------------------------------------------------------------------*/
+struct bld_sim_stats {
+	uint64_t rx_bytes;
+	uint64_t tx_bytes;
+	uint64_t pages_erased;
+	uint64_t doublewords_programmed;
+	uint64_t program_errors;
+	uint64_t bits_flipped;
+	uint64_t first_rx_ns;
+	uint64_t last_tx_ns;
+	uint32_t jumps;
+};
+
+struct bld_sim {
+	int master_fd;
+	uint32_t baud;
+	uint32_t erase_us;
+	uint32_t program_us;
+	double bit_error_rate;
+	unsigned short rng[3];
+	bool verbose;
+	bool auto_confirm;
+	bool exit_on_jump;
+
+	uint8_t *flash;
+	uint64_t start_ns;
+	uint64_t latency_debt_ns;
+
+	/* Bytes read from the PTY that have not yet "arrived" on the line. */
+	uint8_t line[BLD_UART_DMA_RX_CHUNK];
+	size_t line_len;
+	size_t line_off;
+	uint64_t line_t0_ns;
+	uint64_t line_delivered;
+
+	struct bld_uart_dma_ctx uart;
+	struct bld_storage meta_storage;
+	struct bld_sim_stats stats;
+	bool jumped;
+};
+
+static struct bld_sim *g_sim;
+static volatile sig_atomic_t g_stop;
+
+/*----------------------------------------------------------------------------
+ * Time helpers
+ *----------------------------------------------------------------------------*/
+static uint64_t mono_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NS_PER_S + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ns(uint64_t ns)
+{
+	struct timespec ts = {
+		.tv_sec = (time_t)(ns / NS_PER_S),
+		.tv_nsec = (long)(ns % NS_PER_S),
+	};
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+	}
+}
+
+/*
+ * Accumulates simulated latency and only sleeps once at least a millisecond
+ * is owed, so per-doubleword costs stay accurate despite timer granularity.
+ */
+static void sim_add_latency(struct bld_sim *sim, uint64_t ns)
+{
+	sim->latency_debt_ns += ns;
+	if (sim->latency_debt_ns >= BLD_SIM_MIN_SLEEP_NS) {
+		uint64_t t0 = mono_ns();
+		sleep_ns(sim->latency_debt_ns);
+		uint64_t slept = mono_ns() - t0;
+		sim->latency_debt_ns = (slept >= sim->latency_debt_ns) ?
+					       0u :
+					       sim->latency_debt_ns - slept;
+	}
+}
+
+/*----------------------------------------------------------------------------
+ * Line error model
+ *----------------------------------------------------------------------------*/
+static void sim_corrupt(struct bld_sim *sim, uint8_t *buf, size_t len)
+{
+	if (sim->bit_error_rate <= 0.0) {
+		return;
+	}
+
+	for (size_t i = 0u; i < len; ++i) {
+		for (uint8_t bit = 0u; bit < 8u; ++bit) {
+			if (erand48(sim->rng) < sim->bit_error_rate) {
+				buf[i] ^= (uint8_t)(1u << bit);
+				sim->stats.bits_flipped++;
+			}
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------
+ * RAM-backed STM32L4 flash model
+ *----------------------------------------------------------------------------*/
+static int sim_flash_addr_valid(uint32_t addr, uint32_t len)
+{
+	if (addr < BLD_FLASH_BASE) {
+		return -1;
+	}
+	if ((addr - BLD_FLASH_BASE) > BLD_SIM_FLASH_SIZE ||
+	    len > BLD_SIM_FLASH_SIZE - (addr - BLD_FLASH_BASE)) {
+		return -1;
+	}
+	return 0;
+}
+
+static int sim_flash_unlock(void *hw)
+{
+	(void)hw;
+	return 0;
+}
+
+static int sim_flash_lock(void *hw)
+{
+	(void)hw;
+	return 0;
+}
+
+static int sim_flash_read(void *hw, uint32_t addr, uint8_t *out, uint32_t len)
+{
+	struct bld_sim *sim = (struct bld_sim *)hw;
+
+	if (sim_flash_addr_valid(addr, len) != 0) {
+		return -1;
+	}
+
+	memcpy(out, &sim->flash[addr - BLD_FLASH_BASE], len);
+	return 0;
+}
+
+static int sim_flash_erase_pages(void *hw, uint32_t bank, uint32_t first_page,
+				 uint32_t num_pages)
+{
+	struct bld_sim *sim = (struct bld_sim *)hw;
+	uint32_t bank_base;
+	uint32_t addr;
+	uint32_t len;
+
+	if (bank == BLD_SIM_FLASH_BANK_1) {
+		bank_base = BLD_FLASH_BASE;
+	} else if (bank == BLD_SIM_FLASH_BANK_2) {
+		bank_base = BLD_FLASH_BASE + BLD_FLASH_BANK_SIZE;
+	} else {
+		return -1;
+	}
+
+	addr = bank_base + first_page * BLD_FLASH_PAGE_SIZE;
+	len = num_pages * BLD_FLASH_PAGE_SIZE;
+	if (sim_flash_addr_valid(addr, len) != 0) {
+		return -1;
+	}
+
+	memset(&sim->flash[addr - BLD_FLASH_BASE], BLD_SIM_FLASH_ERASED_BYTE,
+	       len);
+	sim->stats.pages_erased += num_pages;
+	sim_add_latency(sim, (uint64_t)num_pages * sim->erase_us * NS_PER_US);
+	return 0;
+}
+
+static int sim_flash_program_doubleword(void *hw, uint32_t addr, uint64_t data)
+{
+	struct bld_sim *sim = (struct bld_sim *)hw;
+	uint64_t current;
+
+	if ((addr & 7u) != 0u || sim_flash_addr_valid(addr, 8u) != 0) {
+		return -1;
+	}
+
+	/* The STM32L4 rejects programming a doubleword that is not erased. */
+	memcpy(&current, &sim->flash[addr - BLD_FLASH_BASE], sizeof(current));
+	if (current != BLD_SIM_DOUBLEWORD_ERASED) {
+		sim->stats.program_errors++;
+		return -1;
+	}
+
+	memcpy(&sim->flash[addr - BLD_FLASH_BASE], &data, sizeof(data));
+	sim->stats.doublewords_programmed++;
+	sim_add_latency(sim, (uint64_t)sim->program_us * NS_PER_US);
+	return 0;
+}
+
+static const struct bld_flash_ops sim_flash_ops = {
+	.unlock = sim_flash_unlock,
+	.lock = sim_flash_lock,
+	.read = sim_flash_read,
+	.erase_pages = sim_flash_erase_pages,
+	.program_doubleword = sim_flash_program_doubleword,
+};
+
+/*----------------------------------------------------------------------------
+ * UART model over the PTY master
+ *----------------------------------------------------------------------------*/
+
+/*
+ * Moves bytes that have "arrived" on the simulated line into the transport
+ * ring buffer, emulating the UART receive-to-idle DMA interrupt.
+ */
+static void sim_pump_rx(struct bld_sim *sim, int wait_ms)
+{
+	uint64_t now;
+	size_t ready;
+
+	if (sim->line_off >= sim->line_len) {
+		struct pollfd pfd = { .fd = sim->master_fd, .events = POLLIN };
+		ssize_t r;
+
+		if (poll(&pfd, 1, wait_ms) <= 0 ||
+		    (pfd.revents & POLLIN) == 0) {
+			return;
+		}
+
+		r = read(sim->master_fd, sim->line, sizeof(sim->line));
+		if (r <= 0) {
+			return;
+		}
+
+		sim_corrupt(sim, sim->line, (size_t)r);
+		sim->line_len = (size_t)r;
+		sim->line_off = 0u;
+
+		now = mono_ns();
+		if (sim->stats.first_rx_ns == 0u) {
+			sim->stats.first_rx_ns = now;
+		}
+		/* A new burst starts the line clock unless one is running. */
+		if (sim->line_delivered == 0u ||
+		    sim->baud == 0u) {
+			sim->line_t0_ns = now;
+		}
+	}
+
+	now = mono_ns();
+	ready = sim->line_len - sim->line_off;
+
+	if (sim->baud != 0u) {
+		uint64_t on_wire = ((now - sim->line_t0_ns) * sim->baud) /
+				   (BLD_SIM_UART_BITS_PER_BYTE * NS_PER_S);
+		uint64_t allowed = (on_wire > sim->line_delivered) ?
+					   on_wire - sim->line_delivered :
+					   0u;
+
+		if (allowed < ready) {
+			ready = (size_t)allowed;
+		}
+	}
+
+	if (ready == 0u) {
+		return;
+	}
+
+	memcpy(sim->uart.dma_rx, &sim->line[sim->line_off], ready);
+	bld_uart_dma_on_rx_event(&sim->uart, (uint16_t)ready);
+
+	sim->line_off += ready;
+	sim->line_delivered += ready;
+	sim->stats.rx_bytes += ready;
+
+	/* Line went idle: the next burst restarts the baud clock. */
+	if (sim->line_off >= sim->line_len) {
+		struct pollfd pfd = { .fd = sim->master_fd, .events = POLLIN };
+		if (poll(&pfd, 1, 0) <= 0) {
+			sim->line_delivered = 0u;
+		}
+	}
+}
+
+static int sim_uart_rx_start(void *uart, uint8_t *buf, uint16_t len)
+{
+	(void)uart;
+	(void)buf;
+	(void)len;
+	return 0;
+}
+
+static int sim_uart_tx_blocking(void *uart, uint8_t *buf, uint16_t len,
+				uint32_t timeout_ms)
+{
+	struct bld_sim *sim = (struct bld_sim *)uart;
+	uint8_t tmp[UINT16_MAX];
+	size_t off = 0u;
+
+	(void)timeout_ms;
+
+	memcpy(tmp, buf, len);
+	sim_corrupt(sim, tmp, len);
+
+	while (off < len) {
+		ssize_t w = write(sim->master_fd, tmp + off, len - off);
+		if (w < 0) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			}
+			/* No host attached: the byte is lost on the wire. */
+			if (errno == EIO) {
+				break;
+			}
+			perror("write pty");
+			return -1;
+		}
+		off += (size_t)w;
+	}
+
+	if (sim->baud != 0u) {
+		sleep_ns(((uint64_t)len * BLD_SIM_UART_BITS_PER_BYTE *
+			  NS_PER_S) /
+			 sim->baud);
+	}
+
+	sim->stats.tx_bytes += len;
+	sim->stats.last_tx_ns = mono_ns();
+	return 0;
+}
+
+static void sim_dma_disable_it(void *dma_rx)
+{
+	(void)dma_rx;
+}
+
+static uint32_t sim_now_ms(void *time_ctx)
+{
+	struct bld_sim *sim = (struct bld_sim *)time_ctx;
+
+	/*
+	 * The transport parser spins on now_ms() while waiting for a frame,
+	 * which is where the DMA interrupt would fire on target.
+	 */
+	sim_pump_rx(sim, BLD_SIM_IDLE_WAIT_MS);
+	return (uint32_t)((mono_ns() - sim->start_ns) / NS_PER_MS);
+}
+
+static const struct bld_uart_dma_ll_ops sim_uart_ops = {
+	.rx_start = sim_uart_rx_start,
+	.tx_blocking = sim_uart_tx_blocking,
+	.disable_dma_it = sim_dma_disable_it,
+	.now_ms = sim_now_ms,
+};
+
+/*----------------------------------------------------------------------------
+ * Boot hook
+ *----------------------------------------------------------------------------*/
+static const uint32_t sim_slot_bases[BLD_SLOT_COUNT] = BLD_SLOT_BASES;
+static const uint32_t sim_slot_sizes[BLD_SLOT_COUNT] = BLD_SLOT_SIZES;
+
+static const char *sim_slot_name(uint32_t image_base)
+{
+	static const char names[] = "ABCDEFGHIJKLMNOP";
+	static char name[2];
+
+	for (uint32_t i = 0u; i < BLD_SLOT_COUNT; ++i) {
+		if (image_base == sim_slot_bases[i]) {
+			name[0] = names[i];
+			return name;
+		}
+	}
+	return "?";
+}
+
+/*
+ * Replaces the target jump. The simulated application optionally confirms
+ * itself the way bld_confirm_running_image() does on hardware.
+ */
+void bld_jump_to_image(uint32_t image_base)
+{
+	if (g_sim == NULL) {
+		return;
+	}
+
+	g_sim->stats.jumps++;
+	g_sim->jumped = true;
+	fprintf(stderr, "bld_sim: jump to slot %s (0x%08" PRIx32 ")\n",
+		sim_slot_name(image_base), image_base);
+
+	if (g_sim->auto_confirm &&
+	    bld_meta_confirm_slot(&g_sim->meta_storage) == 0 &&
+	    g_sim->verbose) {
+		fprintf(stderr, "bld_sim: application confirmed image\n");
+	}
+}
+
+/*----------------------------------------------------------------------------
+ * PTY helpers
+ *----------------------------------------------------------------------------*/
+static int pty_open(char *slave_path, size_t slave_path_len)
+{
+	struct termios tio;
+	int fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+	if (fd < 0) {
+		perror("posix_openpt");
+		return -1;
+	}
+
+	if (grantpt(fd) != 0 || unlockpt(fd) != 0) {
+		perror("grantpt/unlockpt");
+		close(fd);
+		return -1;
+	}
+
+	if (ptsname_r(fd, slave_path, slave_path_len) != 0) {
+		perror("ptsname_r");
+		close(fd);
+		return -1;
+	}
+
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		(void)tcsetattr(fd, TCSANOW, &tio);
+	}
+
+	return fd;
+}
+
+/*----------------------------------------------------------------------------
+ * Reporting
+ *----------------------------------------------------------------------------*/
+static void sim_print_stats(const struct bld_sim *sim)
+{
+	const struct bld_sim_stats *st = &sim->stats;
+	double secs = 0.0;
+
+	if (st->first_rx_ns != 0u && st->last_tx_ns > st->first_rx_ns) {
+		secs = (double)(st->last_tx_ns - st->first_rx_ns) /
+		       (double)NS_PER_S;
+	}
+
+	fprintf(stderr,
+		"bld_sim: rx=%" PRIu64 " B tx=%" PRIu64 " B active=%.3f s"
+		" (%.1f B/s rx)\n",
+		st->rx_bytes, st->tx_bytes, secs,
+		(secs > 0.0) ? (double)st->rx_bytes / secs : 0.0);
+	fprintf(stderr,
+		"bld_sim: erased=%" PRIu64 " pages programmed=%" PRIu64
+		" dwords program_errors=%" PRIu64 " bit_flips=%" PRIu64
+		" jumps=%" PRIu32 "\n",
+		st->pages_erased, st->doublewords_programmed,
+		st->program_errors, st->bits_flipped, st->jumps);
+}
+
+/*----------------------------------------------------------------------------
+ * CLI helpers
+ *----------------------------------------------------------------------------*/
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage:\n"
+		"  %s [-l link] [-B baud] [-E us] [-P us] [-r ber] [-s seed] [-C] [-x] [-V]\n"
+		"\n"
+		"Options:\n"
+		"  -l <path>     Create a symlink to the PTY slave at <path>\n"
+		"  -B <baud>     Simulated line baud rate, 0 = unthrottled (default %u)\n"
+		"  -E <us>       Flash page erase latency in microseconds (default %u)\n"
+		"  -P <us>       Flash doubleword program latency in microseconds (default %u)\n"
+		"  -r <ber>      Bit error rate applied to both directions (default 0)\n"
+		"  -s <seed>     Seed for the bit error generator\n"
+		"  -C            Confirm the image on jump, like the application does\n"
+		"  -x            Exit after the first jump to an image\n"
+		"  -V            Verbose output\n",
+		prog, BLD_SIM_DEFAULT_BAUD, BLD_SIM_DEFAULT_ERASE_US,
+		BLD_SIM_DEFAULT_PROGRAM_US);
+}
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	g_stop = 1;
+}
+
+/*
+ * Closing the master discards whatever the host has not read yet, such as
+ * the STATUS answering BOOT. Wait until the host closes its end (with our
+ * own slave descriptor closed, that is the hangup) or timeout_ms passes.
+ */
+static void sim_wait_for_hangup(int master_fd, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = master_fd, .events = 0 };
+	uint64_t deadline = mono_ns() + (uint64_t)timeout_ms * NS_PER_MS;
+	uint64_t now;
+
+	while ((now = mono_ns()) < deadline) {
+		int rc = poll(&pfd, 1, (int)((deadline - now) / NS_PER_MS) + 1);
+
+		if (rc > 0 && (pfd.revents & (POLLHUP | POLLERR)) != 0) {
+			return;
+		}
+		if (rc < 0 && errno != EINTR) {
+			return;
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------
+ * Program entry point
+ *----------------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+	static struct bld_sim sim;
+	const char *link_path = NULL;
+	char slave_path[128];
+	unsigned long seed = 1u;
+
+	sim.baud = BLD_SIM_DEFAULT_BAUD;
+	sim.erase_us = BLD_SIM_DEFAULT_ERASE_US;
+	sim.program_us = BLD_SIM_DEFAULT_PROGRAM_US;
+
+	int opt = 0;
+	while ((opt = getopt(argc, argv, "l:B:E:P:r:s:CxVh")) != -1) {
+		switch (opt) {
+		case 'l':
+			link_path = optarg;
+			break;
+		case 'B':
+			sim.baud = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'E':
+			sim.erase_us = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'P':
+			sim.program_us = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			sim.bit_error_rate = strtod(optarg, NULL);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'C':
+			sim.auto_confirm = true;
+			break;
+		case 'x':
+			sim.exit_on_jump = true;
+			break;
+		case 'V':
+			sim.verbose = true;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return 0;
+		}
+	}
+
+	sim.rng[0] = 0x330Eu;
+	sim.rng[1] = (unsigned short)(seed & 0xFFFFu);
+	sim.rng[2] = (unsigned short)((seed >> 16) & 0xFFFFu);
+
+	sim.flash = (uint8_t *)malloc(BLD_SIM_FLASH_SIZE);
+	if (sim.flash == NULL) {
+		fprintf(stderr, "malloc failed\n");
+		return 1;
+	}
+	memset(sim.flash, BLD_SIM_FLASH_ERASED_BYTE, BLD_SIM_FLASH_SIZE);
+
+	sim.master_fd = pty_open(slave_path, sizeof(slave_path));
+	if (sim.master_fd < 0) {
+		free(sim.flash);
+		return 1;
+	}
+
+	if (link_path != NULL) {
+		(void)unlink(link_path);
+		if (symlink(slave_path, link_path) != 0) {
+			perror("symlink");
+			close(sim.master_fd);
+			free(sim.flash);
+			return 1;
+		}
+	}
+
+	/*
+	 * Keep a slave descriptor open so the master does not report EIO
+	 * between host sessions.
+	 */
+	int keep_fd = open(slave_path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+	g_sim = &sim;
+	sim.start_ns = mono_ns();
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	sim.uart.uart = &sim;
+	sim.uart.dma_rx_handle = NULL;
+	sim.uart.time_ctx = &sim;
+	sim.uart.ops = &sim_uart_ops;
+	bld_uart_dma_start(&sim.uart);
+	struct bld_transport transport = bld_transport_uart_dma_make(&sim.uart);
+
+	const struct bld_storage_flash_ctx meta_ctx = {
+		.region_base = BLD_META_BASE,
+		.region_size = BLD_META_SIZE,
+		.page_size = BLD_FLASH_PAGE_SIZE,
+		.flash_base = BLD_FLASH_BASE,
+		.flash_bank_size = BLD_FLASH_BANK_SIZE,
+		.flash_page_size = BLD_FLASH_PAGE_SIZE,
+		.flash_bank1 = BLD_SIM_FLASH_BANK_1,
+		.flash_bank2 = BLD_SIM_FLASH_BANK_2,
+		.ops = &sim_flash_ops,
+		.hw = &sim,
+	};
+
+	/*
+	 * slot regions differ from the metadata one only in place and size;
+	 * as on the board, writes to them are combined into whole rows
+	 */
+	struct bld_storage_flash_ctx slot_ctx[BLD_SLOT_COUNT];
+	struct bld_storage_wc_ctx slot_wc[BLD_SLOT_COUNT];
+	struct bld_storage slot_storage[BLD_SLOT_COUNT];
+
+	for (uint32_t i = 0u; i < BLD_SLOT_COUNT; ++i) {
+		struct bld_storage flash;
+
+		slot_ctx[i] = meta_ctx;
+		slot_ctx[i].region_base = sim_slot_bases[i];
+		slot_ctx[i].region_size = sim_slot_sizes[i];
+		(void)bld_storage_flash_init(&flash, &slot_ctx[i]);
+		(void)bld_storage_wc_init(&slot_storage[i], &slot_wc[i], &flash,
+					  BLD_WRITE_COMBINE_SIZE);
+	}
+	(void)bld_storage_flash_init(&sim.meta_storage, &meta_ctx);
+
+	struct bld_engine engine;
+	bld_engine_init(&engine, &transport, slot_storage, &sim.meta_storage);
+
+	printf("%s\n", (link_path != NULL) ? link_path : slave_path);
+	fflush(stdout);
+	if (sim.verbose) {
+		fprintf(stderr,
+			"bld_sim: pty=%s baud=%" PRIu32 " erase=%" PRIu32
+			"us program=%" PRIu32 "us ber=%g\n",
+			slave_path, sim.baud, sim.erase_us, sim.program_us,
+			sim.bit_error_rate);
+	}
+
+	while (!g_stop) {
+		bld_engine_poll(&engine, BLD_SIM_POLL_TIMEOUT_MS);
+		if (sim.jumped && sim.exit_on_jump) {
+			break;
+		}
+	}
+
+	sim_print_stats(&sim);
+
+	if (keep_fd >= 0) {
+		close(keep_fd);
+	}
+	sim_wait_for_hangup(sim.master_fd, BLD_SIM_HANGUP_WAIT_MS);
+	close(sim.master_fd);
+	if (link_path != NULL) {
+		(void)unlink(link_path);
+	}
+	free(sim.flash);
+	return 0;
+}
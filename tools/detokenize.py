@@ -0,0 +1,50 @@
+"""Detokenize the application's UART log.
+
+The application logs through pw_log_tokenized: every record arrives as a
+prefixed Base64 line ("$<base64>"). This looks the tokens up in the
+database built from the application images and prints plain text. Lines
+that are not tokenized (e.g. drop notices, crash reports) pass through.
+
+Usage:
+  bazel run //tools:detokenize -- --device /dev/ttyACM0
+  bazel run //tools:detokenize -- --input captured.log
+"""
+import argparse
+import sys
+
+import serial
+from python.runfiles import runfiles
+from pw_tokenizer import database, detokenize
+
+_DATABASE_PATH = "_main/apps/application_tokens.csv"
+
+
+def main():
+  r = runfiles.Create()
+  parser = argparse.ArgumentParser()
+  source = parser.add_mutually_exclusive_group()
+  source.add_argument('--device', help='serial port to read the log from')
+  source.add_argument('--input', help='file with a captured log')
+  parser.add_argument('--baudrate', type=int, default=115200)
+  parser.add_argument(
+    '--database',
+    default=r.Rlocation(_DATABASE_PATH),
+    help='token database (defaults to the one built with the app)',
+  )
+  args = parser.parse_args()
+
+  detokenizer = detokenize.Detokenizer(database.load_token_database(
+      args.database))
+
+  if args.device:
+    with serial.Serial(args.device, args.baudrate) as port:
+      detokenizer.detokenize_text_live(port, sys.stdout.buffer)
+  elif args.input:
+    with open(args.input, 'rb') as log:
+      detokenizer.detokenize_text_live(log, sys.stdout.buffer)
+  else:
+    detokenizer.detokenize_text_live(sys.stdin.buffer, sys.stdout.buffer)
+
+
+if __name__ == "__main__":
+  main()